@@ -26,6 +26,7 @@ void ArgsParser::InitOptionsMap() const {
     kOptionsMap["quiet"] << Option::SetOption(false);
     kOptionsMap["winograd"] << Option::SetOption(true);
     kOptionsMap["fp16"] << Option::SetOption(true);
+    kOptionsMap["int8"] << Option::SetOption(false);
     kOptionsMap["capture_all_dead"] << Option::SetOption(false);
 
     kOptionsMap["timemanage"] << Option::SetOption(std::string{"off"});
@@ -35,17 +36,27 @@ void ArgsParser::InitOptionsMap() const {
     kOptionsMap["defualt_komi"] << Option::SetOption(kDefaultKomi);
 
     kOptionsMap["cache_memory_mib"] << Option::SetOption(400);
+    kOptionsMap["tree_memory_mib"] << Option::SetOption(0);
     kOptionsMap["playouts"] << Option::SetOption(-1);
     kOptionsMap["ponder_factor"] << Option::SetOption(100);
     kOptionsMap["const_time"] << Option::SetOption(0);
     kOptionsMap["batch_size"] << Option::SetOption(0);
     kOptionsMap["threads"] << Option::SetOption(0);
+    kOptionsMap["thread_affinity"] << Option::SetOption(std::string{"none"});
+    kOptionsMap["numa"] << Option::SetOption(false);
+    kOptionsMap["batched_search"] << Option::SetOption(false);
+    kOptionsMap["graph_search"] << Option::SetOption(false);
+    kOptionsMap["graph_table_mib"] << Option::SetOption(32);
 
     kOptionsMap["kgs_hint"] << Option::SetOption(std::string{});
     kOptionsMap["weights_file"] << Option::SetOption(std::string{});
     kOptionsMap["weights_dir"] << Option::SetOption(std::string{});
     kOptionsMap["book_file"] << Option::SetOption(std::string{});
     kOptionsMap["patterns_file"] << Option::SetOption(std::string{});
+    kOptionsMap["int8_calibration"] << Option::SetOption(std::string{});
+    kOptionsMap["benchmark_suite"] << Option::SetOption(std::string{});
+    kOptionsMap["benchmark_positions"] << Option::SetOption(20);
+    kOptionsMap["benchmark_playouts"] << Option::SetOption(400);
 
     kOptionsMap["use_gpu"] << Option::SetOption(false);
     kOptionsMap["gpus"] << Option::SetOption(-1);
@@ -109,11 +120,15 @@ void ArgsParser::InitOptionsMap() const {
 
     kOptionsMap["num_games"] << Option::SetOption(0);
     kOptionsMap["parallel_games"] << Option::SetOption(1);
+    kOptionsMap["cooperative_threads"] << Option::SetOption(0);
     kOptionsMap["komi_stddev"] << Option::SetOption(0.f);
     kOptionsMap["komi_big_stddev"] << Option::SetOption(0.f);
     kOptionsMap["komi_big_stddev_prob"] << Option::SetOption(0.f, 1.f, 0.f);
     kOptionsMap["handicap_fair_komi_prob"] << Option::SetOption(0.f, 1.f, 0.f);
     kOptionsMap["target_directory"] << Option::SetOption(std::string{});
+    kOptionsMap["binary_data"] << Option::SetOption(false);
+    kOptionsMap["compression_level"] << Option::SetOption(6, 9, 0);
+    kOptionsMap["stats_interval"] << Option::SetOption(60);
 }
 
 void ArgsParser::InitBasicParameters() const {
@@ -127,6 +142,7 @@ void ArgsParser::InitBasicParameters() const {
     // If the threads is zero, program select a reasonable number
     // and the batch size is same.
     bool already_set_thread = !IsOptionDefault("threads");
+    bool already_set_batchsize = !IsOptionDefault("batch_size");
     bool use_gpu = GetOption<bool>("use_gpu");
 
     const int cores = std::max((int)std::thread::hardware_concurrency(), 1);
@@ -145,6 +161,9 @@ void ArgsParser::InitBasicParameters() const {
     // case 1. if no args are given, use thread count of 6
     // case 2. if number of threads are 0, use thread count of (number of cpu cores) * 1
     // case 3. number of threads are given
+    // The CPU only uses one batch unless the batch size is given. The BLAS
+    // backend will gather the inputs from search threads if it is greater
+    // than one.
 
     // TODO: The most modern CPUs, eg i5-13500, have so many cores. Should
     //       we use the greater 'threads_base'?
@@ -165,8 +184,14 @@ void ArgsParser::InitBasicParameters() const {
         select_batchsize = select_threads/2;
     }
     if (!use_gpu) {
-        // the CPU only uses one batch
-        select_batchsize = 1;
+        // the CPU only uses one batch by default
+        select_batchsize = already_set_batchsize ?
+                               GetOption<int>("batch_size") : 1;
+    }
+    if (GetOption<bool>("batched_search") && use_gpu && !already_set_thread) {
+        // Every thread collects a whole batch by itself. Two threads
+        // are enough to keep the GPU busy.
+        select_threads = 2;
     }
 
     SetOption("threads", std::max(select_threads, 1));
@@ -409,6 +434,26 @@ void ArgsParser::Parse(Splitter &spt) {
         spt.RemoveWord(res->Index());
     }
 
+    if (const auto res = spt.Find("--batched-search")) {
+        SetOption("batched_search", true);
+        spt.RemoveWord(res->Index());
+    }
+
+    if (const auto res = spt.Find("--graph-search")) {
+        SetOption("graph_search", true);
+        spt.RemoveWord(res->Index());
+    }
+
+    if (const auto res = spt.Find("--numa")) {
+        SetOption("numa", true);
+        spt.RemoveWord(res->Index());
+    }
+
+    if (const auto res = spt.Find("--int8")) {
+        SetOption("int8", true);
+        spt.RemoveWord(res->Index());
+    }
+
     if (const auto res = spt.Find("--capture-all-dead")) {
         SetOption("capture_all_dead", true);
         spt.RemoveWord(res->Index());
@@ -551,6 +596,14 @@ void ArgsParser::Parse(Splitter &spt) {
         }
     }
 
+    if (const auto res = spt.FindNext("--thread-affinity")) {
+        if (IsParameter(res->Get<>()) &&
+                AcceptSet(res->Get<>(), {"none", "core", "numa"})) {
+            SetOption("thread_affinity", res->Get<>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
     if (const auto res = spt.FindNext({"--batch-size", "-b"})) {
         if (IsParameter(res->Get<>())) {
             SetOption("batch_size", res->Get<int>());
@@ -565,6 +618,20 @@ void ArgsParser::Parse(Splitter &spt) {
         }
     }
 
+    if (const auto res = spt.FindNext("--tree-memory-mib")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("tree_memory_mib", res->Get<int>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--graph-table-mib")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("graph_table_mib", res->Get<int>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
     if (const auto res = spt.FindNext({"--playouts", "-p"})) {
         if (IsParameter(res->Get<>())) {
             SetOption("playouts", res->Get<int>());
@@ -636,6 +703,34 @@ void ArgsParser::Parse(Splitter &spt) {
         }
     }
 
+    if (const auto res = spt.FindNext("--int8-calibration")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("int8_calibration", res->Get<>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--benchmark-suite")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("benchmark_suite", res->Get<>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--benchmark-positions")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("benchmark_positions", std::max(res->Get<int>(), 1));
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--benchmark-playouts")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("benchmark_playouts", std::max(res->Get<int>(), 1));
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
     if (const auto res = spt.FindNext("--book")) {
         if (IsParameter(res->Get<>())) {
             SetOption("book_file", res->Get<>());
@@ -811,6 +906,13 @@ void ArgsParser::Parse(Splitter &spt) {
         }
     }
 
+    if (const auto res = spt.FindNext("--cooperative-threads")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("cooperative_threads", res->Get<int>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
     if (const auto res = spt.FindNext("--komi-stddev")) {
         if (IsParameter(res->Get<>())) {
             SetOption("komi_stddev", res->Get<float>());
@@ -846,6 +948,25 @@ void ArgsParser::Parse(Splitter &spt) {
         }
     }
 
+    if (const auto res = spt.Find("--binary-data")) {
+        SetOption("binary_data", true);
+        spt.RemoveWord(res->Index());
+    }
+
+    if (const auto res = spt.FindNext("--compression-level")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("compression_level", res->Get<int>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--stats-interval")) {
+        if (IsParameter(res->Get<>())) {
+            SetOption("stats_interval", res->Get<int>());
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
     while (const auto res = spt.FindNext("--selfplay-query")) {
         if (IsParameter(res->Get<>())) {
             auto query = GetOption<std::string>("selfplay_query");
@@ -896,6 +1017,9 @@ void ArgsParser::DumpHelper() const {
                 << "\t--cache-memory-mib <integer>\n"
                 << "\t\tSet the NN cache size in MiB.\n\n"
 
+                << "\t--tree-memory-mib <integer>\n"
+                << "\t\tStop the search if the tree uses more memory than it. Zero means no limit.\n\n"
+
                 << "\t--playouts, -p <integer>\n"
                 << "\t\tThe number of maximum playouts.\n\n"
 
@@ -908,8 +1032,42 @@ void ArgsParser::DumpHelper() const {
                 << "\t--threads, -t <integer>\n"
                 << "\t\tThe number of threads used. Select 0 to let engine pick a reasonable default.\n\n"
 
+                << "\t--thread-affinity <none/core/numa>\n"
+                << "\t\tPin the worker threads to one CPU each (core) or to the CPUs of one NUMA node each (numa).\n"
+                << "\t\tDefault is none, the OS places them.\n\n"
+
+                << "\t--numa\n"
+                << "\t\tSpread the threads over the NUMA nodes and pin them. Every node has its own NN cache and\n"
+                << "\t\tits own copy of the CPU network weights. It overrides --thread-affinity.\n\n"
+
                 << "\t--batch-size, -b <integer>\n"
-                << "\t\tThe number of batches for a single evaluation. Select 0 to let engine pick a reasonable default.\n\n"
+                << "\t\tThe number of batches for a single evaluation. Select 0 to let engine pick a reasonable default.\n"
+                << "\t\tThe CPU backend uses one batch unless it is given.\n\n"
+
+                << "\t--batched-search\n"
+                << "\t\tEvery search thread collects batch size leaves with virtual loss and evaluates them at once.\n\n"
+
+                << "\t--graph-search\n"
+                << "\t\tShare the nodes of transposed positions. The tree becomes a directed acyclic graph.\n\n"
+
+                << "\t--graph-table-mib <integer>\n"
+                << "\t\tSet the transposition table size of graph search in MiB.\n\n"
+
+                << "\t--int8\n"
+                << "\t\tQuantize the residual tower to INT8 on the CPU backend. It is faster but less accurate.\n\n"
+
+                << "\t--int8-calibration <SGF file name>\n"
+                << "\t\tCalibrate the INT8 activation scales from the positions of SGF file.\n\n"
+
+                << "\t--benchmark-suite <SGF file name>\n"
+                << "\t\tSearch the windows of consecutive moves of SGF file with 1, 2, 4 ... threads and 1, 2, 4 ...\n"
+                << "\t\tbatch size, print the JSON report and exit. The max values are the --threads and the --batch-size.\n\n"
+
+                << "\t--benchmark-positions <integer>\n"
+                << "\t\tThe number of positions of the benchmark suite. Default is 20.\n\n"
+
+                << "\t--benchmark-playouts <integer>\n"
+                << "\t\tThe playouts per position of the benchmark suite. Default is 400.\n\n"
 
                 << "\t--lag-buffer <float>\n"
                 << "\t\tSafety margin for time usage in seconds.\n\n"
@@ -1603,14 +1603,10 @@ void Board::ComputeScoreArea(std::vector<int> &result) const {
 
 std::vector<LadderType> Board::GetLadderMap() const {
     auto result = std::vector<LadderType>(num_intersections_, LadderType::kNotLadder);
-    auto ladder = std::vector<int>{};
-    auto not_ladder = std::vector<int>{};
 
-    const auto VectorFind = [](std::vector<int> &arr, int element) -> bool {
-        auto begin = std::begin(arr);
-        auto end = std::end(arr);
-        return std::find(begin, end, element) != end;
-    };
+    // The search result of every string, indexed by its parent.
+    enum : std::uint8_t { kUnknown = 0, kIsLadder, kNotLadder };
+    auto searched = std::vector<std::uint8_t>(num_vertices_, kUnknown);
 
     for (int y = 0; y < board_size_; ++y) {
         for (int x = 0; x < board_size_; ++x) {
@@ -1627,19 +1623,19 @@ std::vector<LadderType> Board::GetLadderMap() const {
             int libs = 0;
             auto parent = strings_.GetParent(vtx);
 
-            if (VectorFind(ladder, parent)) {
+            if (searched[parent] == kIsLadder) {
                 // Be found! It is a ladder.
                 libs = strings_.GetLiberty(parent);
-            } else if (!VectorFind(not_ladder, parent)) {
+            } else if (searched[parent] == kUnknown) {
                 // Not be found! Now Search it.
                 if (IsLadder(vtx, vital_moves)) {
                     // It is a ladder.
-                    ladder.emplace_back(parent);
+                    searched[parent] = kIsLadder;
                     first_found = true;
                     libs = strings_.GetLiberty(parent);
                 } else {
                     // It is not a ladder.
-                    not_ladder.emplace_back(parent);
+                    searched[parent] = kNotLadder;
                     continue;
                 }
             } else {
@@ -1703,6 +1699,30 @@ void Board::ComputeSafeArea(std::vector<bool> &result, bool mark_seki) const {
     }
 }
 
+void Board::ComputeScoreAndSafeArea(std::vector<int> &score_area,
+                                    std::vector<bool> &safe_area) const {
+    if (safe_area.size() != (size_t) num_intersections_) {
+        safe_area.resize(num_intersections_);
+    }
+    std::fill(std::begin(safe_area), std::end(safe_area), false);
+
+    ComputeReachArea(score_area);
+    auto pass_alive = std::vector<bool>(num_intersections_);
+
+    // Same as ComputeScoreArea() and ComputeSafeArea().
+    for (int c = 0; c < 2; ++c) {
+        std::fill(std::begin(pass_alive), std::end(pass_alive), false);
+        ComputePassAliveArea(pass_alive, c, true, true);
+
+        for (int i = 0; i < num_intersections_; ++i) {
+            if (pass_alive[i]) {
+                score_area[i] = c;
+                safe_area[i] = true;
+            }
+        }
+    }
+}
+
 void Board::ComputePassAliveArea(std::vector<bool> &result,
                                  const int color,
                                  bool mark_vitals,
@@ -59,6 +59,10 @@ public:
     // Get zobrist hash.
     std::uint64_t GetHash() const;
 
+    // Get the hash of the whole-board analyses. It only depends on
+    // the stones, the ko move and the board size.
+    std::uint64_t GetAnalysisHash() const;
+
     // Get number of captured stones.
     int GetPrisoner(const int color) const;
 
@@ -182,6 +186,11 @@ public:
     // all empty points seki if 'mark_seki' is true.
     void ComputeSafeArea(std::vector<bool> &result, bool mark_seki) const;
 
+    // Compute both the score area and the safe area. They share the
+    // pass-alive area of both colors.
+    void ComputeScoreAndSafeArea(std::vector<int> &score_area,
+                                 std::vector<bool> &safe_area) const;
+
     // Compute the empty area in the Seki.
     void ComputeSekiPoints(std::vector<bool> &result) const;
 
@@ -552,6 +561,12 @@ inline std::uint64_t Board::GetHash() const {
     return hash_;
 }
 
+inline std::uint64_t Board::GetAnalysisHash() const {
+    return ko_hash_ ^
+               Zobrist::kKoMove[ko_move_] ^
+               (0x9E3779B97F4A7C15ULL * board_size_);
+}
+
 inline std::uint64_t Board::GetMoveHash(const int vtx, const int color) const {
     std::uint64_t hash = Zobrist::kState[color][vtx];
     if (color == to_move_) {
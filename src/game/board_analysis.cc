@@ -0,0 +1,104 @@
+#include "game/board_analysis.h"
+
+BoardAnalysisCache& BoardAnalysisCache::Get() {
+    static BoardAnalysisCache cache;
+    return cache;
+}
+
+BoardAnalysisCache::BoardAnalysisCache() {
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        shard.entries.resize(kEntriesPerShard);
+    }
+}
+
+void BoardAnalysisCache::Compute(const Board &board, BoardAnalysis &analysis) {
+    const int num_intersections = board.GetNumIntersections();
+
+    auto score_area = std::vector<int>(num_intersections, kInvalid);
+    auto safe_area = std::vector<bool>(num_intersections, false);
+    board.ComputeScoreAndSafeArea(score_area, safe_area);
+    const auto ladders = board.GetLadderMap();
+
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        analysis.score_area[idx] = score_area[idx];
+        analysis.safe_area[idx] = safe_area[idx];
+        analysis.ladders[idx] = ladders[idx];
+    }
+}
+
+void BoardAnalysisCache::GetAnalysis(const Board &board, BoardAnalysis &analysis) {
+    const auto key = board.GetAnalysisHash();
+    const int board_size = board.GetBoardSize();
+    auto &shard = GetShard(key);
+
+    {
+        SpinLock::Lock lock(shard.mutex);
+        const auto &entry = shard.entries[key % kEntriesPerShard];
+
+        shard.stats.lookups += 1;
+        if (entry.key == key && entry.board_size == board_size) {
+            shard.stats.hits += 1;
+            analysis = entry.analysis;
+            return;
+        }
+    }
+
+    // Do not hold the lock during the ladder search.
+    Compute(board, analysis);
+
+    SpinLock::Lock lock(shard.mutex);
+    auto &entry = shard.entries[key % kEntriesPerShard];
+    entry.key = key;
+    entry.board_size = board_size;
+    entry.analysis = analysis;
+}
+
+bool BoardAnalysisCache::LookupSafeArea(const Board &board, std::vector<bool> &safe_area) {
+    const auto key = board.GetAnalysisHash();
+    const int board_size = board.GetBoardSize();
+    const int num_intersections = board.GetNumIntersections();
+    auto &shard = GetShard(key);
+
+    SpinLock::Lock lock(shard.mutex);
+    const auto &entry = shard.entries[key % kEntriesPerShard];
+
+    shard.stats.lookups += 1;
+    if (entry.key != key || entry.board_size != board_size) {
+        return false;
+    }
+    shard.stats.hits += 1;
+
+    safe_area.resize(num_intersections);
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        safe_area[idx] = entry.analysis.safe_area[idx];
+    }
+    return true;
+}
+
+void BoardAnalysisCache::Clear() {
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        for (auto &entry : shard.entries) {
+            entry.key = 0;
+            entry.board_size = 0;
+        }
+    }
+}
+
+void BoardAnalysisCache::ResetStats() {
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        shard.stats = Stats{};
+    }
+}
+
+BoardAnalysisCache::Stats BoardAnalysisCache::GetStats() {
+    auto stats = Stats{};
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        stats.lookups += shard.stats.lookups;
+        stats.hits += shard.stats.hits;
+    }
+    return stats;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "game/board.h"
+#include "game/types.h"
+#include "utils/mutex.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// The results of the whole-board analyses. Both the network encoder
+// and the move pruning of node expansion need them.
+struct BoardAnalysis {
+    // The owner of every intersection with Tromp Taylor rule and the
+    // pass-alive area. Same as Board::ComputeScoreArea().
+    std::array<std::int8_t, kNumIntersections> score_area;
+
+    // Same as Board::ComputeSafeArea() without seki.
+    std::array<bool, kNumIntersections> safe_area;
+
+    // Same as Board::GetLadderMap().
+    std::array<std::uint8_t, kNumIntersections> ladders;
+};
+
+// The memoized analyses keyed by the board analysis hash. The same
+// board is analyzed again and again by the encoder and the expansion,
+// the symmetry ensemble and the transpositions. The table is fixed-size
+// and direct-mapped. The new entry replaces the old one.
+class BoardAnalysisCache {
+public:
+    struct Stats {
+        std::uint64_t lookups{0};
+        std::uint64_t hits{0};
+    };
+
+    static BoardAnalysisCache& Get();
+
+    BoardAnalysisCache();
+
+    // Get the analysis of the board. Compute and insert it if it is
+    // not in the cache.
+    void GetAnalysis(const Board &board, BoardAnalysis &analysis);
+
+    // Get the safe area only. Return false if the board is not in the
+    // cache. Nothing is computed.
+    bool LookupSafeArea(const Board &board, std::vector<bool> &safe_area);
+
+    // Remove all items.
+    void Clear();
+
+    // Reset the hit/miss counters.
+    void ResetStats();
+
+    Stats GetStats();
+
+private:
+    struct Entry {
+        std::uint64_t key{0};
+        int board_size{0};
+        BoardAnalysis analysis;
+    };
+
+    struct Shard {
+        SpinLock mutex;
+
+        std::vector<Entry> entries GUARDED_BY(mutex);
+        Stats stats GUARDED_BY(mutex);
+    };
+
+    static constexpr size_t kNumShards = 16;
+    static constexpr size_t kEntriesPerShard = 256;
+
+    Shard& GetShard(std::uint64_t key) {
+        return shards_[(key >> 48) % kNumShards];
+    }
+
+    // Compute the analysis of the board.
+    static void Compute(const Board &board, BoardAnalysis &analysis);
+
+    std::array<Shard, kNumShards> shards_;
+};
@@ -64,6 +64,8 @@ static std::vector<std::string> kGtpCommandsList = {
 
     "clear_cache",
 
+    "cache_stats",
+
     "selfplay-genmove",      // For self-play debug.
 
     "selfplay",              // For self-play debug.
@@ -90,6 +92,8 @@ static std::vector<std::string> kGtpCommandsList = {
 
     "sayuri-genmove_analyze",
 
+    "sayuri-profile",
+
     "kgs-game_over",
 
     "kgs-time_settings",
@@ -100,6 +104,20 @@ static std::vector<std::string> kGtpCommandsList = {
 
     "benchmark",
 
+    "benchmark_suite",
+
+    "benchmark_sgemm",
+
+    "benchmark_puct",
+
+    "benchmark_backup",
+
+    "benchmark_threadpool",
+
+    "int8_accuracy",
+
+    "convert_weights",
+
     "genbook",
 
     "genpatterns",
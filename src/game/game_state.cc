@@ -1,4 +1,5 @@
 #include "game/game_state.h"
+#include "game/board_analysis.h"
 #include "game/types.h"
 #include "utils/splitter.h"
 #include "utils/log.h"
@@ -11,7 +12,21 @@
 #include <random>
 #include <cmath>
 
+const Board *BoardPool::Push(const Board &board) {
+    if (used_ == boards_.size()) {
+        boards_.emplace_back(std::make_unique<Board>());
+    }
+    auto &buf = *boards_[used_++];
+    buf = board;
+    return &buf;
+}
+
+void BoardPool::Clear() {
+    used_ = 0;
+}
+
 void GameState::Reset(const int boardsize, const float komi) {
+    board_pool_ = nullptr;
     board_.Reset(boardsize);
     SetKomi(komi);
     ko_hash_history_.clear();
@@ -91,17 +106,97 @@ bool GameState::PlayMove(const int vtx, const int color) {
         // Cut off unused history.
         ko_hash_history_.resize(move_number_);
         game_history_.resize(move_number_);
-        comments_.resize(move_number_);
-
         ko_hash_history_.emplace_back(GetKoHash());
-        game_history_.emplace_back(std::make_shared<Board>(board_));
-        PushComment();
 
+        if (board_pool_) {
+            // The forked state. Refer the board in the pool. The
+            // empty owner avoids the reference counting.
+            game_history_.emplace_back(
+                std::shared_ptr<const Board>{}, board_pool_->Push(board_));
+        } else {
+            comments_.resize(move_number_);
+            game_history_.emplace_back(std::make_shared<Board>(board_));
+            PushComment();
+        }
         return true;
     }
     return false;
 }
 
+GameState::GameState(const GameState &other) {
+    CopyFrom(other);
+}
+
+GameState& GameState::operator=(const GameState &other) {
+    if (this != &other) {
+        CopyFrom(other);
+    }
+    return *this;
+}
+
+void GameState::CopyFrom(const GameState &other) {
+    board_ = other.board_;
+
+    if (other.board_pool_) {
+        // The past boards of forked state are not owned by it. Copy
+        // them, so they do not dangle.
+        const auto history_size = other.game_history_.size();
+        game_history_.clear();
+        game_history_.reserve(history_size);
+        for (size_t i = 0; i < history_size; ++i) {
+            game_history_.emplace_back(
+                std::make_shared<const Board>(*other.game_history_[i]));
+        }
+    } else {
+        game_history_ = other.game_history_;
+    }
+
+    ko_hash_history_ = other.ko_hash_history_;
+    append_moves_ = other.append_moves_;
+    comments_ = other.comments_;
+    last_comment_ = other.last_comment_;
+
+    handicap_ = other.handicap_;
+    komi_integer_ = other.komi_integer_;
+    komi_half_ = other.komi_half_;
+    komi_negative_ = other.komi_negative_;
+    move_number_ = other.move_number_;
+    komi_hash_ = other.komi_hash_;
+    winner_ = other.winner_;
+
+    board_pool_ = nullptr;
+}
+
+void GameState::ForkFrom(const GameState &other, BoardPool *pool) {
+    board_ = other.board_;
+
+    ko_hash_history_.assign(std::begin(other.ko_hash_history_),
+                                std::end(other.ko_hash_history_));
+
+    const auto history_size = other.game_history_.size();
+    game_history_.resize(history_size);
+    for (size_t i = 0; i < history_size; ++i) {
+        game_history_[i] = std::shared_ptr<const Board>(
+                               std::shared_ptr<const Board>{},
+                               other.game_history_[i].get());
+    }
+
+    append_moves_.assign(std::begin(other.append_moves_),
+                             std::end(other.append_moves_));
+    comments_.clear();
+    last_comment_.clear();
+
+    handicap_ = other.handicap_;
+    komi_integer_ = other.komi_integer_;
+    komi_half_ = other.komi_half_;
+    komi_negative_ = other.komi_negative_;
+    move_number_ = other.move_number_;
+    komi_hash_ = other.komi_hash_;
+    winner_ = other.winner_;
+
+    board_pool_ = pool;
+}
+
 bool GameState::UndoMove() {
     if (move_number_ >= 1) {
         // Cut off unused history.
@@ -745,7 +840,11 @@ std::vector<int> GameState::GetStringList(const int vtx) const {
 
 std::vector<bool> GameState::GetStrictSafeArea() const {
     auto result = std::vector<bool>(GetNumIntersections(), false);
-    board_.ComputeSafeArea(result, false);
+
+    // The encoder has usually analyzed this board.
+    if (!BoardAnalysisCache::Get().LookupSafeArea(board_, result)) {
+        board_.ComputeSafeArea(result, false);
+    }
     return result;
 }
 
@@ -7,10 +7,37 @@
 
 #include "game/board.h"
 
+// The storage of boards played during the tree search descent. The
+// boards are reused by every playout, so the descent does not allocate
+// the memory once the pool is large enough.
+class BoardPool {
+public:
+    // Copy the board to the pool. The pointer is valid until Clear().
+    const Board *Push(const Board &board);
+
+    // Make all boards reusable.
+    void Clear();
+
+private:
+    std::vector<std::unique_ptr<Board>> boards_;
+    size_t used_{0};
+};
+
 class GameState {
 public:
     Board board_;
 
+    GameState() = default;
+
+    // The copy of a forked state is a normal state. It owns the copies
+    // of past boards and does not push the boards to the pool, so it
+    // is still valid after the pool is cleared.
+    GameState(const GameState &other);
+    GameState& operator=(const GameState &other);
+
+    GameState(GameState &&) = default;
+    GameState& operator=(GameState &&) = default;
+
     void Reset(const int boardsize, const float komi);
 
     // GTP interface to clear the board.
@@ -24,6 +51,12 @@ public:
 
     bool UndoMove();
 
+    // Copy the other state for the tree search. The past boards are
+    // referred without the ownership so the other state must outlive
+    // this one. The new boards are stored in the pool and the comments
+    // are not recorded. It reuses the buffers of this state.
+    void ForkFrom(const GameState &other, BoardPool *pool);
+
     void SetKomi(float komi);
 
     void SetToMove(const int color);
@@ -144,6 +177,8 @@ private:
 
     void PushComment();
 
+    void CopyFrom(const GameState &other);
+
     std::string GetStateString() const;
 
     std::vector<std::shared_ptr<const Board>> game_history_;
@@ -154,6 +189,9 @@ private:
 
     std::vector<std::string> comments_;
 
+    // The pool of the forked state. It is NULL for the normal state.
+    BoardPool *board_pool_{nullptr};
+
     // Comment for next move.
     std::string last_comment_;
 
@@ -1,13 +1,22 @@
 #include "game/gtp.h"
 #include "game/sgf.h"
+#include "game/board_analysis.h"
 #include "game/commands_list.h"
 #include "utils/log.h"
 #include "utils/time.h"
 #include "utils/komi.h"
 #include "utils/gogui_helper.h"
 #include "utils/filesystem.h"
+#include "utils/threadpool_benchmark.h"
 #include "pattern/mm_trainer.h"
 #include "neural/encoder.h"
+#include "neural/loader.h"
+#include "neural/blas/sgemm_benchmark.h"
+#include "neural/blas/int8_calibration.h"
+#include "mcts/puct_benchmark.h"
+#include "mcts/backup_benchmark.h"
+#include "mcts/scaling_benchmark.h"
+#include "mcts/suite_benchmark.h"
 #include "summary/accuracy.h"
 #include "summary/selfplay_accumulation.h"
 
@@ -261,6 +270,19 @@ std::string GtpLoop::Execute(Splitter &spt, bool &try_ponder) {
         agent_->GetSearch().ReleaseTree();
         agent_->GetNetwork().ClearCache();
         out << GtpSuccess("");
+    } else if (const auto res = spt.Find("cache_stats", 0)) {
+        const auto analysis_stats = BoardAnalysisCache::Get().GetStats();
+        const auto stats = agent_->GetNetwork().GetCacheStatsString() +
+                               Format("\nanalysis lookups: %llu\nanalysis hits: %llu",
+                                   (unsigned long long)analysis_stats.lookups,
+                                   (unsigned long long)analysis_stats.hits);
+        if (const auto input = spt.GetWord(1)) {
+            if (input->Get<>() == "reset") {
+                agent_->GetNetwork().ResetCacheStats();
+                BoardAnalysisCache::Get().ResetStats();
+            }
+        }
+        out << GtpSuccess(stats);
     } else if (const auto res = spt.Find("final_score", 0)) {
         auto result = agent_->GetSearch().Computation(400, Search::kForced);
         auto color = agent_->GetState().GetToMove();
@@ -380,6 +402,8 @@ std::string GtpLoop::Execute(Splitter &spt, bool &try_ponder) {
         agent_->GetState().PlayMove(move);
         DUMPING << "play " << agent_->GetState().VertexToText(move) << "\n\n";
         try_ponder = true;
+    } else if (const auto res = spt.Find("sayuri-profile", 0)) {
+        out << GtpSuccess(agent_->GetSearch().GetProfileString());
     } else if (const auto res = spt.Find("undo", 0)) {
         if (agent_->GetState().UndoMove()) {
             out << GtpSuccess("");
@@ -571,6 +595,20 @@ std::string GtpLoop::Execute(Splitter &spt, bool &try_ponder) {
         } else {
             out << GtpFail("symmetry must be from 0 to 7");
         }
+    } else if (spt.Find("benchmark", 0) && spt.Find("scaling", 1)) {
+        int playouts = 1600;
+        int max_threads = GetOption<int>("threads");
+
+        if (const auto p = spt.GetWord(2)) {
+            playouts = std::max(p->Get<int>(), 1);
+        }
+        if (const auto t = spt.GetWord(3)) {
+            max_threads = std::max(t->Get<int>(), 1);
+        }
+
+        out << GtpSuccess(BenchmarkSearchScaling(
+                              agent_->GetState(), agent_->GetNetwork(),
+                              max_threads, playouts));
     } else if (const auto res = spt.Find("benchmark", 0)) {
         int eval_cnt = 3200;
 
@@ -606,6 +644,136 @@ std::string GtpLoop::Execute(Splitter &spt, bool &try_ponder) {
                 count.load(),
                 count.load()/elapsed,
                 threads, batch_size));
+    } else if (const auto res = spt.Find("benchmark_suite", 0)) {
+        auto sgf_file = std::string{};
+        int playouts = GetOption<int>("benchmark_playouts");
+        int positions = GetOption<int>("benchmark_positions");
+        int max_threads = GetOption<int>("threads");
+        int max_batch_size = GetOption<int>("batch_size");
+
+        if (const auto sgf = spt.GetWord(1)) {
+            sgf_file = sgf->Get<>();
+        }
+        if (const auto p = spt.GetWord(2)) {
+            playouts = std::max(p->Get<int>(), 1);
+        }
+        if (const auto n = spt.GetWord(3)) {
+            positions = std::max(n->Get<int>(), 1);
+        }
+        if (const auto t = spt.GetWord(4)) {
+            max_threads = std::max(t->Get<int>(), 1);
+        }
+        if (const auto b = spt.GetWord(5)) {
+            max_batch_size = std::max(b->Get<int>(), 1);
+        }
+
+        if (sgf_file.empty()) {
+            out << GtpFail("file name is empty");
+        } else {
+            const auto report = BenchmarkSuite(
+                                    GetOption<std::string>("weights_file"),
+                                    sgf_file, positions, playouts,
+                                    max_threads, max_batch_size);
+            if (report.empty()) {
+                out << GtpFail("no position in the SGF file");
+            } else {
+                out << GtpSuccess(report);
+            }
+        }
+    } else if (const auto res = spt.Find("benchmark_sgemm", 0)) {
+        int channels = 128;
+        int batch_size = GetOption<int>("batch_size");
+
+        if (const auto c = spt.GetWord(1)) {
+            channels = std::max(c->Get<int>(), 1);
+        }
+        if (const auto b = spt.GetWord(2)) {
+            batch_size = std::max(b->Get<int>(), 1);
+        }
+
+        out << GtpSuccess(BenchmarkSgemm(
+                              channels, batch_size,
+                              agent_->GetState().GetBoardSize()));
+    } else if (const auto res = spt.Find("benchmark_puct", 0)) {
+        int board_size = 19;
+        int selections = 100000;
+
+        if (const auto b = spt.GetWord(1)) {
+            board_size = std::min(std::max(b->Get<int>(), 2), kBoardSize);
+        }
+        if (const auto s = spt.GetWord(2)) {
+            selections = std::max(s->Get<int>(), 1);
+        }
+
+        out << GtpSuccess(BenchmarkPuct(board_size, selections));
+    } else if (const auto res = spt.Find("benchmark_backup", 0)) {
+        int threads = GetOption<int>("threads");
+        int updates = 100000;
+
+        if (const auto t = spt.GetWord(1)) {
+            threads = std::max(t->Get<int>(), 1);
+        }
+        if (const auto u = spt.GetWord(2)) {
+            updates = std::max(u->Get<int>(), 2);
+        }
+
+        out << GtpSuccess(BenchmarkBackup(threads, updates));
+    } else if (const auto res = spt.Find("benchmark_threadpool", 0)) {
+        int threads = GetOption<int>("threads");
+        int tasks = 1000;
+
+        if (const auto t = spt.GetWord(1)) {
+            threads = std::max(t->Get<int>(), 1);
+        }
+        if (const auto n = spt.GetWord(2)) {
+            tasks = std::max(n->Get<int>(), 1);
+        }
+
+        out << GtpSuccess(BenchmarkThreadPool(threads, tasks));
+    } else if (const auto res = spt.Find("int8_accuracy", 0)) {
+        auto sgf_file = std::string{};
+        int positions = 1000;
+
+        if (const auto sgf = spt.GetWord(1)) {
+            sgf_file = sgf->Get<>();
+        }
+        if (const auto p = spt.GetWord(2)) {
+            positions = std::max(p->Get<int>(), 1);
+        }
+
+        if (!sgf_file.empty()) {
+            out << GtpSuccess(ReportInt8Accuracy(
+                                  GetOption<std::string>("weights_file"),
+                                  sgf_file, positions));
+        } else {
+            out << GtpFail("file name is empty");
+        }
+    } else if (const auto res = spt.Find("convert_weights", 0)) {
+        auto weights_file = std::string{};
+        auto binary_file = std::string{};
+        bool winograd = false;
+
+        if (const auto w = spt.GetWord(1)) {
+            weights_file = w->Get<>();
+        }
+        if (const auto b = spt.GetWord(2)) {
+            binary_file = b->Get<>();
+        }
+        if (const auto w = spt.GetWord(3)) {
+            winograd = w->Get<>() == "winograd";
+        }
+
+        if (!weights_file.empty() && !binary_file.empty()) {
+            auto weights = std::make_shared<DNNWeights>();
+            DNNLoder::Get().FromFile(weights, weights_file);
+            if (DNNLoder::Get().ToBinaryFile(weights, binary_file, winograd)) {
+                out << GtpSuccess("");
+            } else {
+                out << GtpFail("fail to convert the weights");
+            }
+        } else {
+            out << GtpFail("file name is empty");
+        }
     } else if (const auto res = spt.Find("genbook", 0)) {
         auto sgf_file = std::string{};
         auto data_file = std::string{};
@@ -2,6 +2,7 @@
 
 #include "game/gtp.h"
 #include "selfplay/pipe.h"
+#include "mcts/suite_benchmark.h"
 #include "utils/threadpool.h"
 #include "utils/log.h"
 #include "utils/format.h"
@@ -0,0 +1,146 @@
+#include "loader/data_loader.h"
+#include "utils/gzip_helper.h"
+#include "utils/random.h"
+#include "utils/log.h"
+
+#include <algorithm>
+
+DataLoader::DataLoader(std::vector<std::string> filenames,
+                       int num_threads,
+                       size_t buffer_size,
+                       int down_sample)
+    : done_(std::move(filenames)),
+      buffer_size_(std::max(buffer_size, size_t{1})),
+      down_sample_(down_sample) {
+    if (done_.empty()) {
+        exhausted_ = true;
+        return;
+    }
+    shuffle_buffer_.reserve(buffer_size_);
+
+    num_threads = std::max(num_threads, 1);
+    for (int i = 0; i < num_threads; ++i) {
+        decoders_.emplace_back([this]() { Loop(); });
+    }
+}
+
+DataLoader::~DataLoader() {
+    Stop();
+}
+
+void DataLoader::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    output_cv_.notify_all();
+    space_cv_.notify_all();
+    for (auto &t : decoders_) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+bool DataLoader::Next(TrainingRecord &rec) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        output_cv_.wait(lock, [this]() {
+            return !output_.empty() || exhausted_ || !running_;
+        });
+        if (output_.empty()) {
+            return false;
+        }
+        rec = std::move(output_.front());
+        output_.pop_front();
+    }
+    space_cv_.notify_one();
+    return true;
+}
+
+std::uint64_t DataLoader::GetLoadedChunks() const {
+    return loaded_chunks_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t DataLoader::GetBrokenChunks() const {
+    return broken_chunks_.load(std::memory_order_relaxed);
+}
+
+bool DataLoader::GetNextFile(std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || exhausted_) {
+        return false;
+    }
+    if (tasks_.empty()) {
+        // Start the next epoch in the new random order.
+        std::swap(tasks_, done_);
+        std::shuffle(std::begin(tasks_), std::end(tasks_), Random<>::Get());
+    }
+    filename = tasks_.back();
+    tasks_.pop_back();
+    done_.emplace_back(filename);
+    return true;
+}
+
+void DataLoader::RemoveFile(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // The next epoch may have started, so it may be in any list.
+    for (auto *files : {&tasks_, &done_}) {
+        files->erase(std::remove(std::begin(*files), std::end(*files), filename),
+                     std::end(*files));
+    }
+    if (tasks_.empty() && done_.empty()) {
+        exhausted_ = true;
+        output_cv_.notify_all();
+    }
+}
+
+bool DataLoader::InsertRecords(std::vector<TrainingRecord> &records) {
+    auto &rng = Random<>::Get();
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (auto &rec : records) {
+        space_cv_.wait(lock, [this]() {
+            return output_.size() < kMaxOutputSize || !running_;
+        });
+        if (!running_) {
+            return false;
+        }
+
+        const auto size = shuffle_buffer_.size();
+        if (size > 0) {
+            // Swap with the random record, the Fisher-Yates shuffle.
+            std::swap(rec, shuffle_buffer_[rng.Generate() % size]);
+        }
+        if (size < buffer_size_) {
+            shuffle_buffer_.emplace_back(std::move(rec));
+        } else {
+            output_.emplace_back(std::move(rec));
+            output_cv_.notify_one();
+        }
+    }
+    return true;
+}
+
+void DataLoader::Loop() {
+    auto chunk = std::string{};
+    auto records = std::vector<TrainingRecord>{};
+
+    auto filename = std::string{};
+    while (GetNextFile(filename)) {
+        records.clear();
+        const bool loaded = LoadGzip(filename, chunk);
+        if (!loaded || !ParseChunk(chunk, down_sample_, records)) {
+            // Use the records before the broken one this time, but never
+            // read it again.
+            broken_chunks_.fetch_add(1, std::memory_order_relaxed);
+            LOGGING << "Fail to load the chunk: " << filename << '\n';
+            RemoveFile(filename);
+        }
+        loaded_chunks_.fetch_add(1, std::memory_order_relaxed);
+
+        if (!InsertRecords(records)) {
+            return;
+        }
+    }
+}
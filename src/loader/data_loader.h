@@ -0,0 +1,70 @@
+#pragma once
+
+#include "loader/record.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The multi-threaded loader of self-play chunks. The decoder threads read
+// and parse the chunks, then insert the records into the reservoir shuffle
+// buffer. Once the buffer is full, every insertion swaps out one random
+// record for the output. The chunks are read again and again in the
+// random order, like the python loader.
+class DataLoader {
+public:
+    DataLoader(std::vector<std::string> filenames,
+               int num_threads,
+               size_t buffer_size,
+               int down_sample);
+    ~DataLoader();
+
+    // Wait for the next shuffled record. Return false if none of the
+    // chunks can be read. The broken chunks are read only once.
+    bool Next(TrainingRecord &rec);
+
+    void Stop();
+
+    std::uint64_t GetLoadedChunks() const;
+    std::uint64_t GetBrokenChunks() const;
+
+private:
+    static constexpr size_t kMaxOutputSize = 4096;
+
+    void Loop();
+
+    // Return false if the loader is stopped.
+    bool GetNextFile(std::string &filename);
+
+    // Remove the broken chunk from the file list.
+    void RemoveFile(const std::string &filename);
+
+    // Return false if the loader is stopped.
+    bool InsertRecords(std::vector<TrainingRecord> &records);
+
+    std::vector<std::string> tasks_;
+    std::vector<std::string> done_;
+
+    std::vector<TrainingRecord> shuffle_buffer_;
+    size_t buffer_size_;
+    int down_sample_;
+
+    std::deque<TrainingRecord> output_;
+
+    std::mutex mutex_;
+    std::condition_variable output_cv_;
+    std::condition_variable space_cv_;
+
+    bool running_{true};
+    bool exhausted_{false};
+
+    std::atomic<std::uint64_t> loaded_chunks_{0};
+    std::atomic<std::uint64_t> broken_chunks_{0};
+
+    std::vector<std::thread> decoders_;
+};
@@ -0,0 +1,240 @@
+#include "loader/data_loader.h"
+#include "loader/training_batch.h"
+#include "game/symmetry.h"
+#include "utils/filesystem.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/random.h"
+#include "utils/splitter.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+// The standalone loader of self-play data for the trainer. It reads the
+// chunks, shuffles the records and writes the fixed-size batches to the
+// stdout or the file. See loader/training_batch.h for the batch format.
+
+namespace {
+
+struct LoaderOptions {
+    std::string data_directory;
+    std::string output{"-"};
+    int num_chunks{0};
+    int batch_size{256};
+    int board_size{19};
+    int input_channels{43};
+    int threads{std::max((int)std::thread::hardware_concurrency() - 2, 1)};
+    int buffer_size{256 * 1000};
+    int down_sample{16};
+    int num_batches{0};
+    bool help{false};
+    bool error{false};
+};
+
+bool IsParameter(const std::string &param) {
+    return !param.empty() && param[0] != '-';
+}
+
+void DumpHelper() {
+    LOGGING << "Usage: sayuri-loader --data-directory <path> [options]\n\n"
+                << "Arguments:\n"
+                << "\t--data-directory <path>\n"
+                << "\t\tThe directory of self-play chunks. It is searched recursively.\n\n"
+
+                << "\t--output <path>\n"
+                << "\t\tWrite the batches to the file. Default is -, the stdout.\n\n"
+
+                << "\t--num-chunks <integer>\n"
+                << "\t\tOnly load the last N chunks by the modification time. Default is all.\n\n"
+
+                << "\t--batch-size <integer>\n"
+                << "\t\tThe number of records per batch. Default is 256.\n\n"
+
+                << "\t--board-size <integer>\n"
+                << "\t\tThe board size of batch. The smaller boards are placed at the top-left corner.\n\n"
+
+                << "\t--input-channels <integer>\n"
+                << "\t\tThe input channels of network. Default is 43.\n\n"
+
+                << "\t--threads, -t <integer>\n"
+                << "\t\tThe number of decoder threads.\n\n"
+
+                << "\t--buffer-size <integer>\n"
+                << "\t\tThe number of records in the shuffle buffer. Default is 256000.\n\n"
+
+                << "\t--down-sample <integer>\n"
+                << "\t\tKeep one of N records. Default is 16.\n\n"
+
+                << "\t--num-batches <integer>\n"
+                << "\t\tStop after N batches. Default is 0, never stop.\n\n";
+}
+
+LoaderOptions ParseOptions(int argc, char **argv) {
+    auto options = LoaderOptions{};
+    auto spt = Splitter(argc, argv);
+    spt.RemoveWord(0);
+
+    const auto IntegerOption = [&spt](const std::initializer_list<std::string> names,
+                                      int &val, int min_val) {
+        if (const auto res = spt.FindNext(names)) {
+            if (IsParameter(res->Get<>()) && res->IsDigit()) {
+                val = std::max(res->Get<int>(), min_val);
+                spt.RemoveSlice(res->Index()-1, res->Index()+1);
+            }
+        }
+    };
+
+    if (const auto res = spt.FindNext("--data-directory")) {
+        if (IsParameter(res->Get<>())) {
+            options.data_directory = res->Get<>();
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.FindNext("--output")) {
+        if (IsParameter(res->Get<>()) || res->Get<>() == "-") {
+            options.output = res->Get<>();
+            spt.RemoveSlice(res->Index()-1, res->Index()+1);
+        }
+    }
+
+    if (const auto res = spt.Find({"--help", "-h"})) {
+        options.help = true;
+        spt.RemoveWord(res->Index());
+    }
+
+    IntegerOption({"--num-chunks"}, options.num_chunks, 0);
+    IntegerOption({"--batch-size"}, options.batch_size, 1);
+    IntegerOption({"--board-size"}, options.board_size, 2);
+    IntegerOption({"--input-channels"}, options.input_channels, 7);
+    IntegerOption({"--threads", "-t"}, options.threads, 1);
+    IntegerOption({"--buffer-size"}, options.buffer_size, 1);
+    IntegerOption({"--down-sample"}, options.down_sample, 0);
+    IntegerOption({"--num-batches"}, options.num_batches, 0);
+
+    if (spt.GetCount() != 0) {
+        LOGGING << "Command(s) Error:" << std::endl;
+        for (auto i = size_t{0}; i < spt.GetCount(); ++i) {
+            LOGGING << " " << i+1 << ". " << spt.GetWord(i)->Get<>() << std::endl;
+        }
+        LOGGING << " are not understood." << std::endl;
+        options.error = true;
+    }
+    options.board_size = std::min(options.board_size, kBoardSize);
+    return options;
+}
+
+// Gather all chunks of the directory tree. Keep the newest ones if the
+// number of chunks is limited.
+std::vector<std::string> GatherChunks(const std::string &directory, int num_chunks) {
+    auto chunks = std::vector<std::string>{};
+    auto dirs = std::vector<std::string>{directory};
+
+    while (!dirs.empty()) {
+        const auto dir = dirs.back();
+        dirs.pop_back();
+
+        for (const auto &name : GetFileList(dir)) {
+            chunks.emplace_back(ConcatPath(dir, name));
+        }
+        for (const auto &name : GetDirectoryList(dir)) {
+            dirs.emplace_back(ConcatPath(dir, name));
+        }
+    }
+
+    if (num_chunks > 0 && (int)chunks.size() > num_chunks) {
+        auto timed_chunks = std::vector<std::pair<time_t, std::string>>{};
+        for (auto &c : chunks) {
+            timed_chunks.emplace_back(GetFileTime(c), c);
+        }
+        std::sort(std::rbegin(timed_chunks), std::rend(timed_chunks));
+
+        chunks.clear();
+        for (int i = 0; i < num_chunks; ++i) {
+            chunks.emplace_back(timed_chunks[i].second);
+        }
+    }
+    return chunks;
+}
+
+int RunLoader(const LoaderOptions &options) {
+    auto chunks = GatherChunks(options.data_directory, options.num_chunks);
+    if (chunks.empty()) {
+        LOGGING << "No chunk in the directory: " << options.data_directory << '\n';
+        return 1;
+    }
+
+    auto file = std::ofstream{};
+    if (options.output != "-") {
+        file.open(options.output, std::ios_base::binary);
+        if (!file.is_open()) {
+            LOGGING << "Fail to open the file: " << options.output << '\n';
+            return 1;
+        }
+    }
+    auto &out = options.output == "-" ? std::cout : file;
+
+    LOGGING << Format("Load %zu chunks with %d threads, the shuffle buffer is %d records.\n",
+                          chunks.size(), options.threads, options.buffer_size);
+
+    DataLoader loader(chunks, options.threads,
+                      options.buffer_size, options.down_sample);
+    TrainingBatch batch(options.batch_size,
+                        options.board_size, options.input_channels);
+
+    auto rec = TrainingRecord{};
+    auto timer = Timer{};
+    int batches = 0;
+    int skipped = 0;
+
+    while (options.num_batches == 0 || batches < options.num_batches) {
+        for (int i = 0; i < batch.GetBatchSize(); ++i) {
+            bool filled = false;
+            while (!filled) {
+                if (!loader.Next(rec)) {
+                    LOGGING << "None of the chunks can be loaded.\n";
+                    return 1;
+                }
+                const int symm = Random<>::Get().RandFix<Symmetry::kNumSymmetris>();
+                filled = batch.Fill(i, rec, symm);
+                if (!filled && skipped++ == 0) {
+                    LOGGING << Format("Skip the record of %dx%d board with %d planes. It does not fit the batch.\n",
+                                          rec.board_size, rec.board_size, rec.num_planes);
+                }
+            }
+        }
+        if (!batch.Write(out)) {
+            // The trainer is closed.
+            break;
+        }
+        batches += 1;
+    }
+    loader.Stop();
+
+    const auto elapsed = std::max(timer.GetDuration(), 1e-3f);
+    LOGGING << Format("Wrote %d batches (%.1f batches/sec) from %llu chunks, %llu broken chunks, %d skipped records.\n",
+                          batches, batches / elapsed,
+                          (unsigned long long)loader.GetLoadedChunks(),
+                          (unsigned long long)loader.GetBrokenChunks(),
+                          skipped);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const auto options = ParseOptions(argc, argv);
+    if (options.help || options.error || options.data_directory.empty()) {
+        DumpHelper();
+        return options.help && !options.error ? 0 : 1;
+    }
+
+    // The stdout is the binary pipe.
+    std::ios_base::sync_with_stdio(false);
+
+    Symmetry::Get().Initialize();
+    return RunLoader(options);
+}
@@ -0,0 +1,331 @@
+#include "loader/record.h"
+#include "game/types.h"
+#include "utils/half.h"
+#include "utils/random.h"
+#include "utils/log.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+static constexpr char kBinaryMagic[4] = {'S', 'Y', 'B', 'D'};
+
+// The magic and the version are the same in all versions.
+static constexpr size_t kBinaryPrefixSize = 5;
+
+// The text data has the fixed number of lines and binary features.
+static constexpr int kTextDataLines = 53;
+static constexpr int kTextNumPlanes = 37;
+
+size_t GetPlaneBytes(int num_intersections) {
+    return (num_intersections + 7) / 8;
+}
+
+size_t GetBodySize(int num_planes, int num_intersections) {
+    return num_planes * GetPlaneBytes(num_intersections) +
+               2 * (num_intersections + 1) * sizeof(half_float_t) +
+               (num_intersections + 3) / 4;
+}
+
+// Return the header size of the binary version. Return zero if the
+// version is not supported. The version 2 has no network hash.
+size_t GetBinaryHeaderSize(int version) {
+    switch (version) {
+        case 2: return 72;
+        case 3: return 80;
+        default: return 0;
+    }
+}
+
+bool IsValidBoardSize(int board_size) {
+    return board_size >= kMinGTPBoardSize && board_size <= kBoardSize;
+}
+
+bool KeepThisRecord(int down_sample) {
+    if (down_sample <= 1) {
+        return true;
+    }
+    return Random<>::Get().Generate() % down_sample == 0;
+}
+
+template<typename T>
+T BinaryGet(const char *ptr) {
+    // Assume that the machine is little-endian.
+    T val;
+    std::memcpy(&val, ptr, sizeof(T));
+    return val;
+}
+
+bool ParseBinaryChunk(const std::string &chunk, int down_sample,
+                      std::vector<TrainingRecord> &records) {
+    size_t pos = 0;
+    while (pos < chunk.size()) {
+        if (pos + kBinaryPrefixSize > chunk.size()) {
+            return false;
+        }
+        const char *header = chunk.data() + pos;
+        if (std::memcmp(header, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+            return false;
+        }
+        const int version = BinaryGet<std::uint8_t>(header + 4);
+        const auto header_size = GetBinaryHeaderSize(version);
+        if (header_size == 0) {
+            LOGGING << "The binary data version " << version << " is not supported.\n";
+            return false;
+        }
+        const int board_size = BinaryGet<std::uint8_t>(header + 6);
+        const int num_planes = BinaryGet<std::uint8_t>(header + 9);
+        if (!IsValidBoardSize(board_size)) {
+            return false;
+        }
+        const auto body_size = GetBodySize(num_planes, board_size * board_size);
+        if (pos + header_size + body_size > chunk.size()) {
+            return false;
+        }
+
+        if (KeepThisRecord(down_sample)) {
+            auto rec = TrainingRecord{};
+            rec.board_size = board_size;
+            rec.num_planes = num_planes;
+            rec.black_to_move = BinaryGet<std::uint8_t>(header + 7) == 1;
+            rec.result = BinaryGet<std::int8_t>(header + 8);
+
+            // Skip the reserved bytes.
+            const char *vals = header + 12;
+            const auto NextFloat = [&vals]() {
+                const auto v = BinaryGet<float>(vals);
+                vals += sizeof(float);
+                return v;
+            };
+            rec.komi = NextFloat();
+            rec.rule = NextFloat();
+            rec.wave = NextFloat();
+            for (auto &v : rec.q_values) {
+                v = NextFloat();
+            }
+            rec.final_score = NextFloat();
+            for (auto &v : rec.scores) {
+                v = NextFloat();
+            }
+            rec.body.assign(header + header_size, body_size);
+            records.emplace_back(std::move(rec));
+        }
+        pos += header_size + body_size;
+    }
+    return true;
+}
+
+class LineReader {
+public:
+    LineReader(const std::string &chunk) : chunk_(chunk) {}
+
+    // Return null if there is no more line. The line is ended by the
+    // '\n' or the '\0' of the chunk, so the strtof() never reads out
+    // of the chunk.
+    const char *Next() {
+        if (pos_ >= chunk_.size()) {
+            return nullptr;
+        }
+        const char *line = chunk_.data() + pos_;
+        const void *end = std::memchr(line, '\n', chunk_.size() - pos_);
+        length_ = end ? (const char *)end - line : chunk_.size() - pos_;
+        pos_ += length_ + 1;
+        return line;
+    }
+
+    size_t GetLength() const {
+        return length_;
+    }
+
+    bool Finished() const {
+        return pos_ >= chunk_.size();
+    }
+
+private:
+    const std::string &chunk_;
+    size_t pos_{0};
+    size_t length_{0};
+};
+
+int HexToInt(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Parse the values of one line into the array. Return false if there
+// are not enough values.
+bool ParseFloats(const char *line, float *vals, int size) {
+    for (int i = 0; i < size; ++i) {
+        char *end;
+        vals[i] = std::strtof(line, &end);
+        if (end == line) {
+            return false;
+        }
+        line = end;
+    }
+    return true;
+}
+
+bool ParseTextPlane(const char *line, size_t length,
+                    int num_intersections, std::uint8_t *plane) {
+    const size_t hex_size = num_intersections / 4;
+    const bool remaining = num_intersections % 4 != 0;
+    if (length < hex_size + remaining) {
+        return false;
+    }
+
+    std::memset(plane, 0, GetPlaneBytes(num_intersections));
+    for (size_t i = 0; i < hex_size; ++i) {
+        const int hex = HexToInt(line[i]);
+        if (hex < 0) {
+            return false;
+        }
+        // Two hex chars per byte, the first one is the lower bits.
+        plane[i / 2] |= hex << (4 * (i % 2));
+    }
+    if (remaining && line[hex_size] == '1') {
+        const int idx = num_intersections - 1;
+        plane[idx / 8] |= 1 << (idx % 8);
+    }
+    return true;
+}
+
+bool ParseTextRecord(LineReader &reader, TrainingRecord &rec) {
+    // The version line is read by the caller.
+    const char *lines[kTextDataLines];
+    size_t lengths[kTextDataLines];
+    for (int i = 1; i < kTextDataLines; ++i) {
+        lines[i] = reader.Next();
+        if (!lines[i]) {
+            return false;
+        }
+        lengths[i] = reader.GetLength();
+    }
+
+    // The line L(n) is lines[n-1].
+    rec.board_size = std::atoi(lines[2]);
+    if (!IsValidBoardSize(rec.board_size)) {
+        return false;
+    }
+    rec.num_planes = kTextNumPlanes;
+    rec.komi = std::strtof(lines[3], nullptr);
+    rec.rule = std::strtof(lines[4], nullptr);
+    rec.wave = std::strtof(lines[5], nullptr);
+
+    const int num_intersections = rec.board_size * rec.board_size;
+    const auto plane_bytes = GetPlaneBytes(num_intersections);
+    rec.body.assign(GetBodySize(rec.num_planes, num_intersections), '\0');
+    auto *body = (std::uint8_t *)&rec.body[0];
+
+    for (int p = 0; p < rec.num_planes; ++p) {
+        if (!ParseTextPlane(lines[6 + p], lengths[6 + p],
+                                num_intersections, body + p * plane_bytes)) {
+            return false;
+        }
+    }
+    rec.black_to_move = std::atoi(lines[43]) == 1;
+
+    auto prob = std::vector<float>(num_intersections + 1);
+    auto *prob_out = body + rec.num_planes * plane_bytes;
+    for (int l : {44, 45}) {
+        if (!ParseFloats(lines[l], prob.data(), num_intersections + 1)) {
+            return false;
+        }
+        for (const auto v : prob) {
+            const auto fp16 = GetFp16(v);
+            std::memcpy(prob_out, &fp16, sizeof(fp16));
+            prob_out += sizeof(fp16);
+        }
+    }
+
+    if (lengths[46] < (size_t)num_intersections) {
+        return false;
+    }
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        // The text code is the same as the binary one.
+        const int code = lines[46][idx] - '0';
+        prob_out[idx / 4] |= (code & 3) << (2 * (idx % 4));
+    }
+
+    rec.result = std::atoi(lines[47]);
+    rec.final_score = std::strtof(lines[49], nullptr);
+    return ParseFloats(lines[48], rec.q_values, 4) &&
+               ParseFloats(lines[50], rec.scores, 4);
+}
+
+bool ParseTextChunk(const std::string &chunk, int down_sample,
+                    std::vector<TrainingRecord> &records) {
+    auto reader = LineReader(chunk);
+    while (const char *line = reader.Next()) {
+        if (reader.GetLength() == 0 && reader.Finished()) {
+            break;
+        }
+        if (std::atoi(line) != 2) {
+            // Only support the version 2.
+            return false;
+        }
+        if (!KeepThisRecord(down_sample)) {
+            for (int i = 1; i < kTextDataLines; ++i) {
+                if (!reader.Next()) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        auto rec = TrainingRecord{};
+        if (!ParseTextRecord(reader, rec)) {
+            return false;
+        }
+        records.emplace_back(std::move(rec));
+    }
+    return true;
+}
+
+} // namespace
+
+int TrainingRecord::GetNumIntersections() const {
+    return board_size * board_size;
+}
+
+bool TrainingRecord::GetPlane(int plane, int idx) const {
+    const auto offset = plane * GetPlaneBytes(GetNumIntersections()) + idx / 8;
+    return (body[offset] >> (idx % 8)) & 1;
+}
+
+float TrainingRecord::GetProbability(int idx) const {
+    const auto offset = num_planes * GetPlaneBytes(GetNumIntersections());
+    return GetFp32(BinaryGet<half_float_t>(
+               body.data() + offset + idx * sizeof(half_float_t)));
+}
+
+float TrainingRecord::GetAuxiliaryProbability(int idx) const {
+    const int num_intersections = GetNumIntersections();
+    const auto offset = num_planes * GetPlaneBytes(num_intersections) +
+                            (num_intersections + 1) * sizeof(half_float_t);
+    return GetFp32(BinaryGet<half_float_t>(
+               body.data() + offset + idx * sizeof(half_float_t)));
+}
+
+int TrainingRecord::GetOwnership(int idx) const {
+    const int num_intersections = GetNumIntersections();
+    const auto offset = num_planes * GetPlaneBytes(num_intersections) +
+                            2 * (num_intersections + 1) * sizeof(half_float_t);
+    const int code = (body[offset + idx / 4] >> (2 * (idx % 4))) & 3;
+    return code == 1 ? 1 : (code == 3 ? -1 : 0);
+}
+
+bool ParseChunk(const std::string &chunk, int down_sample,
+                std::vector<TrainingRecord> &records) {
+    if (chunk.size() >= sizeof(kBinaryMagic) &&
+            std::memcmp(chunk.data(), kBinaryMagic, sizeof(kBinaryMagic)) == 0) {
+        return ParseBinaryChunk(chunk, down_sample, records);
+    }
+    return ParseTextChunk(chunk, down_sample, records);
+}
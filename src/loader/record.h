@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One training record in the memory. The body keeps the layout of binary
+// training data (see neural/training.h), so one 19x19 record is about 3
+// KiB and the shuffle buffer can hold millions of them.
+struct TrainingRecord {
+    int board_size;
+    int num_planes;  // The number of binary features.
+    bool black_to_move;
+    int result;
+
+    float komi, rule, wave;
+    float q_values[4]; // Average Q value, short, middle, long.
+    float final_score;
+    float scores[4];   // Average score lead, short, middle, long.
+
+    std::string body;
+
+    int GetNumIntersections() const;
+
+    bool GetPlane(int plane, int idx) const;
+
+    // The index of pass move is the number of intersections.
+    float GetProbability(int idx) const;
+    float GetAuxiliaryProbability(int idx) const;
+
+    // Return 1, -1 or 0.
+    int GetOwnership(int idx) const;
+};
+
+// Parse all records of one chunk. Both the text and the binary format are
+// accepted. Every record is kept with the probability 1/down_sample if
+// the down_sample is greater than 1. Return false if the chunk is broken.
+// The records before the broken one are kept.
+bool ParseChunk(const std::string &chunk, int down_sample,
+                std::vector<TrainingRecord> &records);
@@ -0,0 +1,133 @@
+#include "loader/training_batch.h"
+#include "game/symmetry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+static constexpr char kBatchMagic[4] = {'S', 'Y', 'B', 'B'};
+
+TrainingBatch::TrainingBatch(int batch_size, int board_size, int input_channels)
+    : batch_size_(batch_size),
+      board_size_(board_size),
+      input_channels_(input_channels),
+      num_intersections_(board_size * board_size) {
+    const size_t n = batch_size_;
+
+    planes_offset_ = 0;
+    prob_offset_ = planes_offset_ + n * input_channels_ * num_intersections_;
+    aux_prob_offset_ = prob_offset_ + n * (num_intersections_ + 1);
+    ownership_offset_ = aux_prob_offset_ + n * (num_intersections_ + 1);
+    wdl_offset_ = ownership_offset_ + n * num_intersections_;
+    q_values_offset_ = wdl_offset_ + n * 3;
+    scores_offset_ = q_values_offset_ + n * 5;
+
+    data_.resize(scores_offset_ + n * 5);
+}
+
+bool TrainingBatch::Fill(int index, const TrainingRecord &rec, int symmetry) {
+    const int bsize = rec.board_size;
+    const int num_intersections = rec.GetNumIntersections();
+    const int num_planes = input_channels_ - kNumMiscFeatures;
+
+    if (bsize > board_size_ || rec.num_planes != num_planes) {
+        return false;
+    }
+
+    // The index of record board to the index of batch board after the
+    // symmetry.
+    auto index_table = std::vector<int>(num_intersections);
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        const auto symm_idx = Symmetry::Get().TransformIndex(bsize, symmetry, idx);
+        index_table[idx] = (symm_idx / bsize) * board_size_ + (symm_idx % bsize);
+    }
+
+    // input planes
+    auto *planes = data_.data() + planes_offset_ +
+                       (size_t)index * input_channels_ * num_intersections_;
+    std::fill(planes, planes + input_channels_ * num_intersections_, 0.f);
+
+    for (int p = 0; p < num_planes; ++p) {
+        auto *plane = planes + p * num_intersections_;
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            if (rec.GetPlane(p, idx)) {
+                plane[index_table[idx]] = 1.f;
+            }
+        }
+    }
+
+    const float komi = rec.black_to_move ? rec.komi : -rec.komi;
+    const float misc[kNumMiscFeatures] = {
+        rec.rule,
+        rec.wave,
+        komi/20.f,
+        -komi/20.f,
+        static_cast<float>(num_intersections)/361.f,
+        1.f
+    };
+    for (int m = 0; m < kNumMiscFeatures; ++m) {
+        auto *plane = planes + (num_planes + m) * num_intersections_;
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            plane[index_table[idx]] = misc[m];
+        }
+    }
+
+    // probabilities and auxiliary probabilities
+    auto *prob = data_.data() + prob_offset_ +
+                     (size_t)index * (num_intersections_ + 1);
+    auto *aux_prob = data_.data() + aux_prob_offset_ +
+                         (size_t)index * (num_intersections_ + 1);
+    std::fill(prob, prob + num_intersections_ + 1, 0.f);
+    std::fill(aux_prob, aux_prob + num_intersections_ + 1, 0.f);
+
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        prob[index_table[idx]] = rec.GetProbability(idx);
+        aux_prob[index_table[idx]] = rec.GetAuxiliaryProbability(idx);
+    }
+    prob[num_intersections_] = rec.GetProbability(num_intersections);
+    aux_prob[num_intersections_] = rec.GetAuxiliaryProbability(num_intersections);
+
+    // ownership
+    auto *ownership = data_.data() + ownership_offset_ +
+                          (size_t)index * num_intersections_;
+    std::fill(ownership, ownership + num_intersections_, 0.f);
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        ownership[index_table[idx]] = rec.GetOwnership(idx);
+    }
+
+    // winrate
+    auto *wdl = data_.data() + wdl_offset_ + (size_t)index * 3;
+    std::fill(wdl, wdl + 3, 0.f);
+    wdl[1 - std::min(std::max(rec.result, -1), 1)] = 1.f;
+
+    // all q values and scores
+    auto *q_values = data_.data() + q_values_offset_ + (size_t)index * 5;
+    auto *scores = data_.data() + scores_offset_ + (size_t)index * 5;
+    q_values[0] = rec.result;
+    scores[0] = rec.final_score;
+    for (int i = 0; i < 4; ++i) {
+        q_values[i+1] = rec.q_values[i];
+        scores[i+1] = rec.scores[i];
+    }
+    return true;
+}
+
+bool TrainingBatch::Write(std::ostream &out) const {
+    char header[16];
+    const std::int32_t sizes[3] = {batch_size_, board_size_, input_channels_};
+    std::memcpy(header, kBatchMagic, sizeof(kBatchMagic));
+    std::memcpy(header + sizeof(kBatchMagic), sizes, sizeof(sizes));
+
+    out.write(header, sizeof(header));
+    out.write((const char *)data_.data(), data_.size() * sizeof(float));
+    out.flush();
+    return out.good();
+}
+
+int TrainingBatch::GetBatchSize() const {
+    return batch_size_;
+}
+
+size_t TrainingBatch::GetSize() const {
+    return 16 + data_.size() * sizeof(float);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "loader/record.h"
+
+#include <ostream>
+#include <vector>
+
+// The fixed-size batch of float32 tensors. The tensors are the same as
+// the python BatchGenerator, so the trainer reads them by the
+// numpy.frombuffer(). The smaller board is placed at the top-left corner.
+// All values are little-endian.
+//
+//  ------- Header (16 bytes) -------
+//   char[4]   : Magic "SYBB"
+//   int32     : Batch Size (N)
+//   int32     : Board Size (B)
+//   int32     : Input Channels (C)
+//
+//  ------- Body (float32) -------
+//   Planes                  : [N, C, B, B]
+//   Probabilities           : [N, B*B+1]
+//   Auxiliary Probabilities : [N, B*B+1]
+//   Ownership               : [N, B*B]
+//   WDL                     : [N, 3]
+//   Q Values                : [N, 5], result, average, short, middle, long
+//   Scores                  : [N, 5], final, average, short, middle, long
+class TrainingBatch {
+public:
+    TrainingBatch(int batch_size, int board_size, int input_channels);
+
+    // Fill the record with the symmetry into the slot. Return false if
+    // the record does not fit the batch.
+    bool Fill(int index, const TrainingRecord &rec, int symmetry);
+
+    bool Write(std::ostream &out) const;
+
+    int GetBatchSize() const;
+
+    // The size in bytes of one batch, including the header.
+    size_t GetSize() const;
+
+private:
+    static constexpr int kNumMiscFeatures = 6;
+
+    int batch_size_;
+    int board_size_;
+    int input_channels_;
+    int num_intersections_;
+
+    // The offsets of every tensor in the data.
+    size_t planes_offset_;
+    size_t prob_offset_;
+    size_t aux_prob_offset_;
+    size_t ownership_offset_;
+    size_t wdl_offset_;
+    size_t q_values_offset_;
+    size_t scores_offset_;
+
+    std::vector<float> data_;
+};
@@ -23,6 +23,21 @@ void StartSelfplayLoop() {
     auto loop = std::make_unique<SelfPlayPipe>();
 }
 
+void StartBenchmarkSuite() {
+    const auto report = BenchmarkSuite(
+                            GetOption<std::string>("weights_file"),
+                            GetOption<std::string>("benchmark_suite"),
+                            GetOption<int>("benchmark_positions"),
+                            GetOption<int>("benchmark_playouts"),
+                            GetOption<int>("threads"),
+                            GetOption<int>("batch_size"));
+    if (report.empty()) {
+        LOGGING << "There is no position in the SGF file." << std::endl;
+    } else {
+        DUMPING << report << "\n";
+    }
+}
+
 int main(int argc, char **argv) {
     ArgsParser(argc, argv);
 
@@ -30,7 +45,18 @@ int main(int argc, char **argv) {
 
     ThreadPool::Get(0);
 
-    if (GetOption<std::string>("mode") == "gtp") {
+    auto affinity = GetAffinityMode(GetOption<std::string>("thread_affinity"));
+    if (GetOption<bool>("numa")) {
+        affinity = AffinityMode::kNuma;
+        LOGGING << Format("Use the NUMA mode with %d nodes.\n", GetNumNumaNodes());
+    }
+    if (!ThreadPool::Get().SetAffinity(affinity)) {
+        LOGGING << "Fail to pin the threads to the CPUs.\n";
+    }
+
+    if (!GetOption<std::string>("benchmark_suite").empty()) {
+        StartBenchmarkSuite();
+    } else if (GetOption<std::string>("mode") == "gtp") {
         StartGtpLoop();
     } else if (GetOption<std::string>("mode") == "selfplay") {
         StartSelfplayLoop();
@@ -0,0 +1,229 @@
+#include "mcts/backup_benchmark.h"
+#include "mcts/node.h"
+#include "mcts/node_arena.h"
+#include "mcts/parameters.h"
+#include "utils/atomic.h"
+#include "utils/random.h"
+#include "utils/format.h"
+#include "utils/threadpool.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Every thread cycles through its own evals.
+constexpr int kEvalsPerThread = 64;
+
+// The accumulators of the old node. The variance is from Welford's
+// online algorithm and the sums are updated by the CAS loops.
+struct CasAccumulators {
+    std::atomic<double> squared_eval_diff{1e-4};
+    std::atomic<double> squared_score_diff{1e-4};
+    std::atomic<double> accumulated_black_fs{0.0};
+    std::atomic<double> accumulated_black_wl{0.0};
+    std::atomic<double> accumulated_draw{0.0};
+    std::atomic<int> visits{0};
+
+    void Update(const NodeEvals &evals) {
+        auto WelfordDelta = [](double eval,
+                               double old_acc_eval,
+                               int old_visits) {
+            const double old_delta = old_visits > 0 ? eval - old_acc_eval / old_visits : 0.0f;
+            const double new_delta = eval - (old_acc_eval + eval) / (old_visits+1);
+            return old_delta * new_delta;
+        };
+        const double eval = evals.black_wl;
+        const double draw = evals.draw;
+        const double score = evals.black_final_score;
+
+        const double old_acc_eval = accumulated_black_wl.load(std::memory_order_relaxed);
+        const double old_acc_score = accumulated_black_fs.load(std::memory_order_relaxed);
+        const int old_visits = visits.load(std::memory_order_relaxed);
+
+        const double eval_delta = WelfordDelta(eval, old_acc_eval, old_visits);
+        const double score_delta = WelfordDelta(score, old_acc_score, old_visits);
+
+        visits.fetch_add(1, std::memory_order_relaxed);
+        AtomicFetchAdd(accumulated_black_wl, eval);
+        AtomicFetchAdd(accumulated_draw    , draw);
+        AtomicFetchAdd(accumulated_black_fs, score);
+        AtomicFetchAdd(squared_eval_diff   , eval_delta);
+        AtomicFetchAdd(squared_score_diff  , score_delta);
+    }
+
+    double GetMeanWL() const {
+        return accumulated_black_wl.load() / visits.load();
+    }
+
+    double GetWLStddev() const {
+        return std::sqrt(squared_eval_diff.load() / (visits.load() - 1));
+    }
+
+    double GetScoreStddev() const {
+        return std::sqrt(squared_score_diff.load() / (visits.load() - 1));
+    }
+};
+
+// The same accumulators as the node without the ownership.
+struct FixedPointAccumulators {
+    static constexpr double kWLScale = 2147483648.0;
+    static constexpr double kScoreScale = 4194304.0;
+    static constexpr double kSquaredScoreScale = 8192.0;
+
+    std::atomic<std::int64_t> accumulated_black_fs{0};
+    std::atomic<std::int64_t> accumulated_black_wl{0};
+    std::atomic<std::int64_t> accumulated_draw{0};
+    std::atomic<std::int64_t> squared_black_fs{0};
+    std::atomic<std::int64_t> squared_black_wl{0};
+    std::atomic<int> visits{0};
+
+    void Update(const NodeEvals &evals) {
+        const double eval = evals.black_wl;
+        const double draw = evals.draw;
+        const double score = evals.black_final_score;
+
+        visits.fetch_add(1, std::memory_order_relaxed);
+        accumulated_black_wl.fetch_add(std::llrint(eval * kWLScale), std::memory_order_relaxed);
+        accumulated_draw.fetch_add(std::llrint(draw * kWLScale), std::memory_order_relaxed);
+        accumulated_black_fs.fetch_add(std::llrint(score * kScoreScale), std::memory_order_relaxed);
+        squared_black_wl.fetch_add(std::llrint(eval * eval * kWLScale), std::memory_order_relaxed);
+        squared_black_fs.fetch_add(std::llrint(score * score * kSquaredScoreScale), std::memory_order_relaxed);
+    }
+
+    double GetMeanWL() const {
+        return accumulated_black_wl.load() / kWLScale / visits.load();
+    }
+
+    double GetWLStddev() const {
+        const double n = visits.load();
+        const double sum = accumulated_black_wl.load() / kWLScale;
+        const double sq = squared_black_wl.load() / kWLScale;
+        return std::sqrt((1e-4 + sq - sum * sum / n) / (n - 1));
+    }
+
+    double GetScoreStddev() const {
+        const double n = visits.load();
+        const double sum = accumulated_black_fs.load() / kScoreScale;
+        const double sq = squared_black_fs.load() / kSquaredScoreScale;
+        return std::sqrt((1e-4 + sq - sum * sum / n) / (n - 1));
+    }
+};
+
+// Run the updates on the given number of threads. Return the
+// updates per second.
+double RunThreads(const int threads, const int updates,
+                  std::function<void(int, int)> update) {
+    auto group = ThreadGroup<void>(&ThreadPool::Get(threads));
+    std::atomic<int> ready{0};
+
+    Timer timer;
+    timer.Clock();
+    for (int t = 0; t < threads; ++t) {
+        group.AddTask([&, t]() {
+            // Start together, so all threads hit the node at the
+            // same time.
+            ready.fetch_add(1, std::memory_order_relaxed);
+            while (ready.load(std::memory_order_relaxed) < threads) {}
+
+            for (int i = 0; i < updates; ++i) {
+                update(t, i % kEvalsPerThread);
+            }
+        });
+    }
+    group.WaitToJoin();
+    const auto elapsed = timer.GetDuration();
+    return (double)threads * updates / std::max(elapsed, 1e-6f);
+}
+
+} // namespace
+
+std::string BenchmarkBackup(const int threads, const int updates) {
+    auto param = Parameters{};
+    param.Reset();
+    param.graph_search = false;
+
+    auto &rng = Random<>::Get();
+    auto unit = std::uniform_real_distribution<float>(0.f, 1.f);
+
+    // Generate the evals. The ownership is not used.
+    auto evals = std::vector<NodeEvals>(threads * kEvalsPerThread);
+    for (auto &e : evals) {
+        e.black_wl = unit(rng);
+        e.draw = 0.2f * unit(rng);
+        e.black_final_score = 60.f * (unit(rng) - 0.5f);
+        e.black_ownership.fill(0.f);
+    }
+
+    // The exact values. Every thread repeats its evals.
+    double sum_wl = 0.0;
+    double sum_score = 0.0;
+    for (int t = 0; t < threads; ++t) {
+        for (int i = 0; i < updates; ++i) {
+            const auto &e = evals[t * kEvalsPerThread + i % kEvalsPerThread];
+            sum_wl += e.black_wl;
+            sum_score += e.black_final_score;
+        }
+    }
+    const double total = (double)threads * updates;
+    const double mean_wl = sum_wl / total;
+    const double mean_score = sum_score / total;
+    double sq_wl = 1e-4;
+    double sq_score = 1e-4;
+    for (int t = 0; t < threads; ++t) {
+        for (int i = 0; i < updates; ++i) {
+            const auto &e = evals[t * kEvalsPerThread + i % kEvalsPerThread];
+            sq_wl += (e.black_wl - mean_wl) * (e.black_wl - mean_wl);
+            sq_score += (e.black_final_score - mean_score) * (e.black_final_score - mean_score);
+        }
+    }
+    const double stddev_wl = std::sqrt(sq_wl / (total - 1));
+    const double stddev_score = std::sqrt(sq_score / (total - 1));
+
+    // The old accumulators.
+    CasAccumulators cas;
+    const double cas_rate = RunThreads(threads, updates, [&](int t, int i) {
+        cas.Update(evals[t * kEvalsPerThread + i]);
+    });
+
+    // The new accumulators.
+    FixedPointAccumulators fixed;
+    const double fixed_rate = RunThreads(threads, updates, [&](int t, int i) {
+        fixed.Update(evals[t * kEvalsPerThread + i]);
+    });
+
+    // The whole update of a busy node. It accumulates the ownership
+    // too.
+    NodeArena arena;
+    auto node = arena.New<Node>(&arena, &param, kPass, 1.0f);
+    node->EnableOwnership();
+    const double node_rate = RunThreads(threads, updates, [&](int t, int i) {
+        node->Update(&evals[t * kEvalsPerThread + i]);
+    });
+
+    auto out = std::ostringstream{};
+    out << Format("threads=%d, updates=%d per thread\n", threads, updates);
+    out << Format("exact: visits=%d, mean wl=%.6f, wl-stddev=%.6f, score-stddev=%.4f\n",
+                      (int)total, mean_wl, stddev_wl, stddev_score);
+    out << Format("%-16s %14s %10s %10s %12s %12s\n",
+                      "accumulators", "updates/s", "visits", "mean-wl",
+                      "wl-stddev", "score-stddev");
+    out << Format("%-16s %14.0f %10d %10.6f %12.6f %12.4f\n",
+                      "cas-double", cas_rate, cas.visits.load(),
+                      cas.GetMeanWL(), cas.GetWLStddev(), cas.GetScoreStddev());
+    out << Format("%-16s %14.0f %10d %10.6f %12.6f %12.4f\n",
+                      "fixed-point", fixed_rate, fixed.visits.load(),
+                      fixed.GetMeanWL(), fixed.GetWLStddev(), fixed.GetScoreStddev());
+    out << Format("%-16s %14.0f %10d %10.6f %12.6f %12.4f",
+                      "node", node_rate, node->GetVisits(),
+                      node->GetWL(kBlack, false),
+                      node->GetWLStddev(), node->GetScoreStddev());
+
+    return out.str();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+// Let many threads back up the evals into one node at the same time,
+// like the root and the first ply nodes in the search. Compare the
+// fixed-point accumulators with the old floating-point ones updated
+// by the CAS loops, and verify the mean and the variance. Return the
+// report.
+std::string BenchmarkBackup(const int threads, const int updates);
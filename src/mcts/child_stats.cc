@@ -0,0 +1,262 @@
+#include "mcts/child_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PUCT_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// The kernels load the atomic arrays as the plain integers.
+static_assert(sizeof(std::atomic<int>) == sizeof(std::int32_t), "");
+
+namespace {
+
+constexpr float kForcedPlayoutsBonus = 1e6f;
+
+template<typename T>
+T *AllocateArray(NodeArena &arena, const int size) {
+    return static_cast<T*>(arena.Allocate(size * sizeof(T)));
+}
+
+#ifdef PUCT_X86_DISPATCH
+// The 8-lane AVX2/FMA kernel. Every lane keeps its own best value
+// and index. They are reduced at the end.
+__attribute__((target("avx2,fma")))
+int SelectPuctChildAvx2(const ChildStats &stats, const PuctArgs &args) {
+    const auto *visits = reinterpret_cast<const std::int32_t*>(stats.visits);
+    const auto *running = reinterpret_cast<const std::int32_t*>(stats.running);
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 cpuct = _mm256_set1_ps(args.cpuct);
+    const __m256 numerator = _mm256_set1_ps(args.numerator);
+    const __m256 fpu_value = _mm256_set1_ps(args.fpu_value);
+    const __m256 expanding_value = _mm256_set1_ps(args.expanding_value);
+    const __m256 virtual_loss = _mm256_set1_ps(args.virtual_loss);
+    const __m256 alpha = _mm256_set1_ps(args.cpuct_dynamic_alpha);
+    const __m256 one_minus_alpha = _mm256_set1_ps(1.f - args.cpuct_dynamic_alpha);
+    const __m256 forced_playouts_k = _mm256_set1_ps(args.forced_playouts_k);
+    const __m256 parentvisits = _mm256_set1_ps(args.parentvisits);
+    const __m256 forced_bonus = _mm256_set1_ps(kForcedPlayoutsBonus);
+    const __m256 lowest = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    const __m256i active_status = _mm256_set1_epi32(ChildStats::kActive);
+    const __m256i zero_i = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(kChildStatsLanes);
+    const bool use_noise = stats.noise && args.noise_epsilon > 0.f;
+    const bool use_forced = args.forced_playouts_k > 0.f;
+    const __m256 epsilon = _mm256_set1_ps(args.noise_epsilon);
+    const __m256 one_minus_epsilon = _mm256_set1_ps(1.f - args.noise_epsilon);
+
+    __m256 best_value = lowest;
+    __m256i best_index = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int i = 0; i < stats.size; i += kChildStatsLanes) {
+        __m256 psa = _mm256_loadu_ps(stats.policy + i);
+        if (use_noise) {
+            psa = _mm256_fmadd_ps(psa, one_minus_epsilon,
+                      _mm256_mul_ps(epsilon, _mm256_loadu_ps(stats.noise + i)));
+        }
+        const __m256i visits_i = _mm256_loadu_si256(
+                                     reinterpret_cast<const __m256i*>(visits + i));
+        const __m256i running_i = _mm256_loadu_si256(
+                                      reinterpret_cast<const __m256i*>(running + i));
+        const __m256i status = _mm256_cvtepu8_epi32(
+                                   _mm_loadl_epi64(
+                                       reinterpret_cast<const __m128i*>(stats.status + i)));
+        const __m256 n = _mm256_cvtepi32_ps(visits_i);
+        const __m256 vloss = _mm256_mul_ps(_mm256_cvtepi32_ps(running_i), virtual_loss);
+
+        const __m256 visited = _mm256_cmp_ps(n, zero, _CMP_GT_OQ);
+        const __m256 expanding = _mm256_andnot_ps(
+                                     visited,
+                                     _mm256_castsi256_ps(_mm256_cmpgt_epi32(running_i, zero_i)));
+        const __m256 active = _mm256_castsi256_ps(
+                                  _mm256_cmpeq_epi32(status, active_status));
+
+        // The Q value of visited child with virtual loss.
+        __m256 q_visited = _mm256_add_ps(
+                               _mm256_div_ps(_mm256_loadu_ps(stats.stm_wl + i),
+                                             _mm256_add_ps(n, vloss)),
+                               _mm256_loadu_ps(stats.utility + i));
+        if (use_forced) {
+            const __m256 forced_n = _mm256_round_ps(
+                                        _mm256_mul_ps(_mm256_mul_ps(forced_playouts_k, psa), parentvisits),
+                                        _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+            q_visited = _mm256_fmadd_ps(_mm256_max_ps(_mm256_sub_ps(forced_n, n), zero),
+                                        forced_bonus, q_visited);
+        }
+        __m256 q = _mm256_blendv_ps(fpu_value, expanding_value, expanding);
+        q = _mm256_blendv_ps(q, q_visited, visited);
+
+        const __m256 factor = _mm256_fmadd_ps(
+                                  alpha, _mm256_loadu_ps(stats.cpuct_factor + i), one_minus_alpha);
+        const __m256 puct = _mm256_mul_ps(
+                                _mm256_mul_ps(_mm256_mul_ps(cpuct, factor), psa),
+                                _mm256_div_ps(numerator, _mm256_add_ps(one, n)));
+        __m256 value = _mm256_add_ps(q, puct);
+        value = _mm256_blendv_ps(lowest, value, active);
+
+        const __m256 greater = _mm256_cmp_ps(value, best_value, _CMP_GT_OQ);
+        best_value = _mm256_blendv_ps(best_value, value, greater);
+        best_index = _mm256_castps_si256(
+                         _mm256_blendv_ps(_mm256_castsi256_ps(best_index),
+                                          _mm256_castsi256_ps(index), greater));
+        index = _mm256_add_epi32(index, step);
+    }
+
+    alignas(32) float lane_values[kChildStatsLanes];
+    alignas(32) std::int32_t lane_indices[kChildStatsLanes];
+    _mm256_store_ps(lane_values, best_value);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_indices), best_index);
+
+    int best = -1;
+    float best_lane_value = std::numeric_limits<float>::lowest();
+    for (int lane = 0; lane < kChildStatsLanes; ++lane) {
+        const int idx = lane_indices[lane];
+        if (idx < 0) {
+            continue;
+        }
+        if (best < 0 ||
+                lane_values[lane] > best_lane_value ||
+                (lane_values[lane] == best_lane_value && idx < best)) {
+            best = idx;
+            best_lane_value = lane_values[lane];
+        }
+    }
+    return best;
+}
+#endif
+
+enum class KernelType {
+    kGeneric,
+    kAvx2
+};
+
+KernelType SelectKernel() {
+#ifdef PUCT_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") &&
+            __builtin_cpu_supports("fma")) {
+        return KernelType::kAvx2;
+    }
+#endif
+    return KernelType::kGeneric;
+}
+
+const KernelType kSelectedKernel = SelectKernel();
+
+} // namespace
+
+ChildStats *AllocateChildStats(NodeArena &arena, const int num_children) {
+    const int size = (num_children + kChildStatsLanes - 1) /
+                         kChildStatsLanes * kChildStatsLanes;
+
+    auto stats = arena.New<ChildStats>();
+    stats->num_children = num_children;
+    stats->size = size;
+    stats->draw = 0.f;
+    stats->policy = AllocateArray<float>(arena, size);
+    stats->noise = nullptr;
+    stats->visits = AllocateArray<std::atomic<int>>(arena, size);
+    stats->running = AllocateArray<std::atomic<int>>(arena, size);
+    stats->stm_wl = AllocateArray<float>(arena, size);
+    stats->utility = AllocateArray<float>(arena, size);
+    stats->cpuct_factor = AllocateArray<float>(arena, size);
+    stats->status = AllocateArray<std::uint8_t>(arena, size);
+
+    for (int i = 0; i < size; ++i) {
+        stats->policy[i] = 0.f;
+        new (&stats->visits[i]) std::atomic<int>{0};
+        new (&stats->running[i]) std::atomic<int>{0};
+        stats->stm_wl[i] = 0.f;
+        stats->utility[i] = 0.f;
+        stats->cpuct_factor[i] = 1.f;
+        stats->status[i] = i < num_children ?
+                               ChildStats::kActive : ChildStats::kInvalid;
+    }
+    return stats;
+}
+
+void GatherChildStats(const ChildStats &stats,
+                      int &parentvisits,
+                      float &total_visited_policy) {
+    parentvisits = 0;
+    total_visited_policy = 0.f;
+    for (int i = 0; i < stats.num_children; ++i) {
+        if (stats.status[i] == ChildStats::kInvalid) {
+            continue;
+        }
+        const int visits = stats.visits[i].load(std::memory_order_relaxed);
+        parentvisits += visits;
+        if (visits > 0) {
+            total_visited_policy += stats.policy[i];
+        }
+    }
+}
+
+int SelectPuctChildReference(const ChildStats &stats, const PuctArgs &args) {
+    const bool use_noise = stats.noise && args.noise_epsilon > 0.f;
+
+    int best = -1;
+    float best_value = std::numeric_limits<float>::lowest();
+
+    for (int i = 0; i < stats.num_children; ++i) {
+        if (stats.status[i] != ChildStats::kActive) {
+            continue;
+        }
+        float psa = stats.policy[i];
+        if (use_noise) {
+            psa = psa * (1.f - args.noise_epsilon) + args.noise_epsilon * stats.noise[i];
+        }
+        const int visits = stats.visits[i].load(std::memory_order_relaxed);
+        const int running = stats.running[i].load(std::memory_order_relaxed);
+        const float n = visits;
+
+        float q = args.fpu_value;
+        if (visits > 0) {
+            q = stats.stm_wl[i] / (n + running * args.virtual_loss) + stats.utility[i];
+
+            const int forced_n = args.forced_playouts_k * psa * args.parentvisits;
+            if (forced_n - visits > 0) {
+                q += (forced_n - visits) * kForcedPlayoutsBonus;
+            }
+        } else if (running > 0) {
+            q = args.expanding_value;
+        }
+
+        const float factor = args.cpuct_dynamic_alpha * stats.cpuct_factor[i] +
+                                 (1.f - args.cpuct_dynamic_alpha);
+        const float puct = args.cpuct * factor * psa * (args.numerator / (1.f + n));
+        const float value = q + puct;
+
+        if (value > best_value) {
+            best_value = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+int SelectPuctChild(const ChildStats &stats, const PuctArgs &args) {
+    switch (kSelectedKernel) {
+#ifdef PUCT_X86_DISPATCH
+        case KernelType::kAvx2:
+            return SelectPuctChildAvx2(stats, args);
+#endif
+        default:
+            return SelectPuctChildReference(stats, args);
+    }
+}
+
+std::string GetPuctKernelName() {
+    switch (kSelectedKernel) {
+        case KernelType::kAvx2:
+            return "avx2";
+        default:
+            return "generic";
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "mcts/node_arena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// The statistics of all children of a node in the structure of arrays.
+// The PUCT selection reads these continuous arrays instead of the
+// scattered child nodes. The parent refreshes the slot of a child
+// after every playout through it. So the values may be a little
+// behind the child node, but they are never behind more than the
+// running playouts.
+//
+// The arrays are padded to the multiple of kChildStatsLanes. The
+// padding slots are invalid.
+static constexpr int kChildStatsLanes = 8;
+
+struct ChildStats {
+    // Same as the status of node.
+    enum Status : std::uint8_t {
+        kInvalid = 0,
+        kPruned,
+        kActive
+    };
+
+    // Serialize the graph search update of the node, so the values of
+    // one recompute are stored together.
+    SpinLock mutex;
+
+    // The number of children and the padded size of arrays.
+    int num_children;
+    int size;
+
+    // The network draw value of the node itself. Only for the graph
+    // search.
+    float draw;
+
+    // The edge policy.
+    float *policy;
+
+    // The root dirichlet noise. It is null for the other nodes.
+    float *noise;
+
+    // The visits of every child. It is the edge visits in the graph
+    // search.
+    std::atomic<int> *visits;
+
+    // The threads below every child. It is the virtual loss.
+    std::atomic<int> *running;
+
+    // The accumulated side to move win-loss value.
+    float *stm_wl;
+
+    // The draw value and the score utility of the visited child.
+    float *utility;
+
+    // The dynamic cpuct factor of the child. It is 1 if the child
+    // does not have enough visits.
+    float *cpuct_factor;
+
+    std::uint8_t *status;
+};
+
+// Allocate the arrays for the children from the arena. All slots are
+// unvisited and active except the padding slots.
+ChildStats *AllocateChildStats(NodeArena &arena, const int num_children);
+
+// The arguments of PUCT selection which are same for all children.
+struct PuctArgs {
+    float cpuct;
+    float numerator;           // sqrt(parent visits)
+    float fpu_value;           // The Q value of unvisited child.
+    float expanding_value;     // The Q value of expanding child.
+    float noise_epsilon;       // Zero if there is no noise.
+    float forced_playouts_k;   // Zero if there is no forced playouts.
+    float parentvisits;
+    float cpuct_dynamic_alpha; // Zero if the dynamic cpuct is off.
+    float virtual_loss;        // The virtual loss of one thread.
+};
+
+// Gather the parent visits and the policy of visited children. Only
+// the valid children are counted.
+void GatherChildStats(const ChildStats &stats,
+                      int &parentvisits,
+                      float &total_visited_policy);
+
+// Return the index of the active child with the best PUCT value. The
+// first one wins if there are several best children. Return -1 if
+// there is no active child. The kernel is selected at runtime. The
+// AVX2/FMA kernel is used if the CPU supports it.
+int SelectPuctChild(const ChildStats &stats, const PuctArgs &args);
+
+// The portable loop. Only for verifying and benchmarking.
+int SelectPuctChildReference(const ChildStats &stats, const PuctArgs &args);
+
+// Return the name of selected kernel, e.g. "avx2".
+std::string GetPuctKernelName();
@@ -1,7 +1,6 @@
 #include "mcts/node.h"
 #include "mcts/lcb.h"
 #include "mcts/rollout.h"
-#include "utils/atomic.h"
 #include "utils/random.h"
 #include "utils/format.h"
 #include "utils/logits.h"
@@ -18,16 +17,34 @@
 
 #define VIRTUAL_LOSS_COUNT (3)
 
-Node::Node(Parameters *param, std::int16_t vertex, float policy) {
+namespace {
+
+// The scales of fixed-point accumulators. One update adds at most
+// 2^31, so the sums do not overflow before the visits do.
+constexpr double kWLScale = 2147483648.0;        // 2^31, for [0, 1]
+constexpr double kScoreScale = 4194304.0;        // 2^22, for [-512, 512]
+constexpr double kSquaredScoreScale = 8192.0;    // 2^13, for [0, 512^2]
+
+// The initial squared difference. Avoid the zero variance.
+constexpr double kSquaredDiffInit = 1e-4;
+
+std::int64_t ToFixedPoint(const double val, const double scale) {
+    return std::llrint(val * scale);
+}
+
+double FromFixedPoint(const std::atomic<std::int64_t> &val, const double scale) {
+    return val.load(std::memory_order_relaxed) / scale;
+}
+
+} // namespace
+
+Node::Node(NodeArena *arena, Parameters *param, std::int16_t vertex, float policy)
+    : children_(arena) {
     param_ = param;
     vertex_ = vertex;
     policy_ = policy;
 }
 
-Node::~Node() {
-    ReleaseAllChildren();
-}
-
 bool Node::PrepareRootNode(Network &network,
                            GameState &state,
                            NodeEvals &node_evals,
@@ -37,6 +54,14 @@ bool Node::PrepareRootNode(Network &network,
     assert(HasChildren());
 
     InflateAllChildren();
+
+    // Only the root and its children keep the ownership for
+    // the analysis.
+    EnableOwnership();
+    for (auto &child : children_) {
+        child.Get()->EnableOwnership();
+    }
+
     if (!success) {
         // The setting of root policy and children may be different,
         // like softmax temperature, so we refill the children policy.
@@ -69,6 +94,11 @@ bool Node::PrepareRootNode(Network &network,
         }
     }
 
+    // The root always keeps the children statistics. Refill them
+    // because the children, the policy and the bouns may be changed.
+    EnableChildStats();
+    ResyncChildStats();
+
     return success;
 }
 
@@ -82,7 +112,7 @@ void Node::Recompute(Network &network,
 
     const float temp = is_root ?
                 param_->root_policy_temp : param_->policy_temp;
-    auto raw_netlist = network.GetOutput(state, Network::kRandom, temp);
+    auto raw_netlist = network.GetPolicyOutput(state, Network::kRandom, temp);
 
     const auto num_intersections = state.GetNumIntersections();
     auto legal_accumulate = 0.f;
@@ -130,8 +160,6 @@ bool Node::ExpandChildren(Network &network,
         return false;
     }
 
-    color_ = state.GetToMove();
-
     // Get network computation result.
 
     // Policy softmax temperature. If 't' is greater than 1,
@@ -141,6 +169,19 @@ bool Node::ExpandChildren(Network &network,
                     param_->root_policy_temp : param_->policy_temp;
     auto raw_netlist = network.GetOutput(state, Network::kRandom, temp);
 
+    ExpandChildren(raw_netlist, state, node_evals, config);
+
+    return true;
+}
+
+void Node::ExpandChildren(const Network::Result &raw_netlist,
+                          GameState &state,
+                          NodeEvals &node_evals,
+                          AnalysisConfig &config) {
+    assert(IsExpanding());
+
+    color_ = state.GetToMove();
+
     // Store the network reuslt.
     ApplyNetOutput(state, raw_netlist, node_evals, color_);
 
@@ -230,22 +271,26 @@ bool Node::ExpandChildren(Network &network,
     // Extend the nodes.
     LinkNodeList(nodelist);
 
+    if (param_->graph_search) {
+        EnableGraph(node_evals.draw);
+    }
+
     // Release the lock owner.
     ExpandDone();
-
-    return true;
 }
 
 void Node::LinkNodeList(std::vector<Network::PolicyVertexPair> &nodelist) {
     // Besure that the best policy is on the top.
     std::stable_sort(std::rbegin(nodelist), std::rend(nodelist));
 
+    // Reserve the exact size because the arena never reuses the
+    // memory of reallocation.
+    children_.reserve(nodelist.size());
     for (const auto &node : nodelist) {
         const auto vertex = (std::uint16_t)node.second;
         const auto policy = node.first;
         children_.emplace_back(vertex, policy);
     }
-    children_.shrink_to_fit();
     assert(!children_.empty());
 }
 
@@ -280,7 +325,11 @@ void Node::ApplyNetOutput(GameState& state,
             owner = 0.f - owner;
         }
         black_ownership[idx] = owner;
-        avg_black_ownership_[idx] = 0.f;
+    }
+    if (auto ownership = ownership_.load(std::memory_order_acquire)) {
+        SpinLock::Lock lock(ownership->mtx);
+        ownership->visits = 0;
+        ownership->avg_black_ownership.fill(0.f);
     }
 
     if (param_->use_rollout) {
@@ -399,8 +448,6 @@ Node *Node::ProbSelectChild(bool allow_pass) {
 }
 
 float Node::GetDynamicCpuctFactor(Node *node, const int visits, const int parentvisits) {
-    // Imported form http://www.yss-aya.com/bbs/patio.cgi?read=33&ukey=0
-
     bool cpuct_dynamic = param_->cpuct_dynamic;
     if (!cpuct_dynamic ||
             node == nullptr ||
@@ -408,22 +455,35 @@ float Node::GetDynamicCpuctFactor(Node *node, const int visits, const int parent
         return 1.0f;
     }
 
-    double cpuct_dynamic_k_factor = param_->cpuct_dynamic_k_factor;
     double cpuct_dynamic_k_base = param_->cpuct_dynamic_k_base;
 
+    double k = GetDynamicCpuctK(node, visits);
+    double alpha = 1.0 / (1.0 + std::sqrt(parentvisits/cpuct_dynamic_k_base));
+    k = alpha*k + (1.0-alpha) * 1.0;
+    return k;
+}
+
+float Node::GetDynamicCpuctK(Node *node, const int visits) const {
+    // Imported form http://www.yss-aya.com/bbs/patio.cgi?read=33&ukey=0
+
+    if (!param_->cpuct_dynamic ||
+            node == nullptr ||
+            visits <= 1) {
+        return 1.0f;
+    }
+
+    double cpuct_dynamic_k_factor = param_->cpuct_dynamic_k_factor;
+
     double variance = node->GetWLVariance(1.0f, visits);
     double stddev = std::sqrt(variance);
     double k = cpuct_dynamic_k_factor * (stddev / visits);
 
     k = std::max(0.5, k);
     k = std::min(1.4, k);
-
-    double alpha = 1.0 / (1.0 + std::sqrt(parentvisits/cpuct_dynamic_k_base));
-    k = alpha*k + (1.0-alpha) * 1.0;
     return k;
 }
 
-Node *Node::PuctSelectChild(const int color, const bool is_root) {
+Node::Edge *Node::PuctSelectChild(const int color, const bool is_root) {
     WaitExpanded();
     assert(HasChildren());
     // assert(color == color_);
@@ -432,12 +492,63 @@ Node *Node::PuctSelectChild(const int color, const bool is_root) {
     // search. Use the PUCT directly if we fail to find the
     // next Gumbel move.
     if (is_root && param_->gumbel) {
-        auto node = GumbelSelectChild(color, false);
-        if (node) {
-            return node;
+        auto edge = GumbelSelectChild(color, false);
+        if (edge) {
+            return edge;
+        }
+    }
+
+    const auto cpuct_init           = param_->cpuct_init;
+    const auto cpuct_base_factor    = param_->cpuct_base_factor;
+    const auto cpuct_base           = param_->cpuct_base;
+    const auto draw_factor          = param_->draw_factor;
+    const auto score_utility_factor = param_->score_utility_factor;
+    const auto score_utility_div    = param_->score_utility_div;
+    const auto noise                = is_root ? param_->dirichlet_noise  : false;
+    const auto fpu_reduction_factor = is_root ? param_->fpu_root_reduction : param_->fpu_reduction;
+    const auto forced_playouts_k    = is_root ? param_->forced_playouts_k : 0.f;
+
+    const bool graph_search = param_->graph_search;
+    auto stats = stats_.load(std::memory_order_acquire);
+
+    if (stats && !graph_search && color == color_) {
+        // Select the child from the children statistics. All values
+        // are same as the loop below except that they may be a
+        // little behind the children.
+        int parentvisits = 0;
+        float total_visited_policy = 0.0f;
+        GatherChildStats(*stats, parentvisits, total_visited_policy);
+
+        const float fpu_reduction = fpu_reduction_factor * std::sqrt(total_visited_policy);
+
+        PuctArgs args;
+        args.cpuct = cpuct_init + cpuct_base_factor *
+                         std::log((float(parentvisits) + cpuct_base + 1) / cpuct_base);
+        args.numerator = std::sqrt(float(parentvisits));
+        args.fpu_value = GetNetWL(color) - fpu_reduction;
+        args.expanding_value = -1.0f - fpu_reduction;
+        args.noise_epsilon = noise ? param_->dirichlet_epsilon : 0.f;
+        args.forced_playouts_k = forced_playouts_k;
+        args.parentvisits = parentvisits;
+        args.cpuct_dynamic_alpha = param_->cpuct_dynamic ?
+            1.0 / (1.0 + std::sqrt(parentvisits/param_->cpuct_dynamic_k_base)) : 0.f;
+        args.virtual_loss = VIRTUAL_LOSS_COUNT;
+
+        const int idx = SelectPuctChild(*stats, args);
+        if (idx >= 0) {
+            // Apply the virtual loss until the child is synced.
+            stats->running[idx].fetch_add(1, std::memory_order_relaxed);
+            Inflate(children_[idx]);
+            return &children_[idx];
         }
     }
 
+    // The graph search counts the visits through the edges because
+    // the child may be shared by other parents.
+    const auto GetChildVisits = [this, graph_search](const Edge &child, const Node *node) {
+        return graph_search ? GetEdgeVisits(&child - children_.data()) : node->GetVisits();
+    };
+
     // Gather all parent's visits.
     int parentvisits = 0;
     float total_visited_policy = 0.0f;
@@ -447,7 +558,7 @@ Node *Node::PuctSelectChild(const int color, const bool is_root) {
 
         if (is_pointer && node->IsValid()) {
             // The node status is pruned or active.
-            const auto visits = node->GetVisits();
+            const auto visits = GetChildVisits(child, node);
             parentvisits += visits;
             if (visits > 0) {
                 total_visited_policy += child.GetPolicy();
@@ -455,16 +566,6 @@ Node *Node::PuctSelectChild(const int color, const bool is_root) {
         }
     }
 
-    const auto cpuct_init           = param_->cpuct_init;
-    const auto cpuct_base_factor    = param_->cpuct_base_factor;
-    const auto cpuct_base           = param_->cpuct_base;
-    const auto draw_factor          = param_->draw_factor;
-    const auto score_utility_factor = param_->score_utility_factor;
-    const auto score_utility_div    = param_->score_utility_div;
-    const auto noise                = is_root ? param_->dirichlet_noise  : false;
-    const auto fpu_reduction_factor = is_root ? param_->fpu_root_reduction : param_->fpu_reduction;
-    const auto forced_playouts_k    = is_root ? param_->forced_playouts_k : 0.f;
-
     const float raw_cpuct     = cpuct_init + cpuct_base_factor *
                                     std::log((float(parentvisits) + cpuct_base + 1) / cpuct_base);
     const float numerator     = std::sqrt(float(parentvisits));
@@ -496,13 +597,13 @@ Node *Node::PuctSelectChild(const int color, const bool is_root) {
         float cpuct = raw_cpuct;
 
         if (is_pointer) {
-            const auto visits = node->GetVisits();
+            const auto visits = GetChildVisits(child, node);
 
             if (node->IsExpanding()) {
                 // Like virtual loss, give it a bad value because there are other
                 // threads in this node.
                 q_value = -1.0f - fpu_reduction;
-            } else if (visits > 0) {
+            } else if (visits > 0 && node->GetVisits() > 0) {
                 // Transfer win-draw-loss to side-to-move value (Q value).
                 const float eval = node->GetWL(color);
                 const float draw_value = node->GetDraw() * draw_factor;
@@ -534,7 +635,7 @@ Node *Node::PuctSelectChild(const int color, const bool is_root) {
     }
 
     Inflate(*best_node);
-    return best_node->Get();
+    return best_node;
 }
 
 int Node::RandomMoveProportionally(float temp, int min_visits) {
@@ -545,7 +646,7 @@ int Node::RandomMoveProportionally(float temp, int min_visits) {
     for (const auto &child : children_) {
         auto node = child.Get();
         const auto visits = node->GetVisits();
-        const auto vertex = node->GetVertex();
+        const auto vertex = child.GetVertex();
         if (visits > min_visits) {
             accum += std::pow((float)visits, (1.0 / temp));
             accum_vector.emplace_back(std::pair<float, int>(accum, vertex));
@@ -640,49 +741,121 @@ int Node::RandomMoveWithLogitsQ(GameState &state, int temp, int min_visits) {
 }
 
 void Node::Update(const NodeEvals *evals) {
-    auto WelfordDelta = [](double eval,
-                           double old_acc_eval,
-                           int old_visits) {
-        // Welford's online algorithm for calculating variance.
-        const double old_delta = old_visits > 0 ? eval - old_acc_eval / old_visits : 0.0f;
-        const double new_delta = eval - (old_acc_eval + eval) / (old_visits+1);
-        const double delta = old_delta * new_delta;
-        return delta;
-    };
-
     // type casting
     const double eval = evals->black_wl;
     const double draw = evals->draw;
     const double score = evals->black_final_score;
 
-    const double old_acc_eval = accumulated_black_wl_.load(std::memory_order_relaxed);
-    const double old_acc_score = accumulated_black_fs_.load(std::memory_order_relaxed);
+    // Only the plain additions. Unlike Welford's online algorithm,
+    // the variance does not depend on the visits at the update time.
+    const int old_visits = visits_.fetch_add(1, std::memory_order_relaxed);
+    accumulated_black_wl_.fetch_add(ToFixedPoint(eval, kWLScale), std::memory_order_relaxed);
+    accumulated_draw_.fetch_add(ToFixedPoint(draw, kWLScale), std::memory_order_relaxed);
+    accumulated_black_fs_.fetch_add(ToFixedPoint(score, kScoreScale), std::memory_order_relaxed);
+    squared_black_wl_.fetch_add(ToFixedPoint(eval * eval, kWLScale), std::memory_order_relaxed);
+    squared_black_fs_.fetch_add(ToFixedPoint(score * score, kSquaredScoreScale), std::memory_order_relaxed);
 
-    const int old_visits = visits_.load(std::memory_order_relaxed);
+    UpdateOwnership(evals, old_visits+1);
 
-    // TODO: According to Kata Go, It is not necessary to use
-    //       Welford's online algorithm. The accuracy of simplify
-    //       algorithm is enough.
-    const double eval_delta = WelfordDelta(eval, old_acc_eval, old_visits);
-    const double score_delta = WelfordDelta(score, old_acc_score, old_visits);
+    if (old_visits+1 >= kChildStatsVisitsThreshold &&
+            !param_->graph_search &&
+            !stats_.load(std::memory_order_relaxed) &&
+            HasChildren()) {
+        EnableChildStats();
+    }
+}
 
-    visits_.fetch_add(1, std::memory_order_relaxed);
-    AtomicFetchAdd(accumulated_black_wl_, eval);
-    AtomicFetchAdd(accumulated_draw_    , draw);
-    AtomicFetchAdd(accumulated_black_fs_, score);
-    AtomicFetchAdd(squared_eval_diff_   , eval_delta);
-    AtomicFetchAdd(squared_score_diff_  , score_delta);
+void Node::GraphUpdate(const NodeEvals *evals, const int vertex) {
+    auto stats = stats_.load(std::memory_order_acquire);
+    if (!stats) {
+        Update(evals);
+        return;
+    }
 
+    // The node itself contributes its network evals once. Every
+    // child contributes its average values weighted by the edge
+    // visits. So do the squared values. The threads recompute one by
+    // one, otherwise an older result may overwrite the newer one.
+    int visits = 1;
     {
-        std::lock_guard<std::mutex> lock(os_mtx_);
+        SpinLock::Lock lock(stats->mutex);
+
+        double acc_eval = black_wl_;
+        double acc_draw = stats->draw;
+        double acc_score = black_fs_;
+        double sq_eval = black_wl_ * black_wl_;
+        double sq_score = black_fs_ * black_fs_;
+
+        const auto num_children = children_.size();
+        for (size_t idx = 0; idx < num_children; ++idx) {
+            if (children_[idx].GetVertex() == vertex) {
+                stats->visits[idx].fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+        for (size_t idx = 0; idx < num_children; ++idx) {
+            // Only touch the visited children.
+            const auto edge_visits = GetEdgeVisits(idx);
+            if (edge_visits == 0) {
+                continue;
+            }
+            const auto node = children_[idx].Get();
+            if (!node || !node->IsValid()) {
+                continue;
+            }
+            const int child_visits = node->GetVisits();
+            if (child_visits == 0) {
+                continue;
+            }
+            const double factor = (double)edge_visits / child_visits;
+            acc_eval += factor * node->GetAccumulatedWL();
+            acc_draw += factor * node->GetAccumulatedDraw();
+            acc_score += factor * node->GetAccumulatedScore();
+            sq_eval += factor * node->GetSquaredWL();
+            sq_score += factor * node->GetSquaredScore();
+            visits += edge_visits;
+        }
+
+        visits_.store(visits, std::memory_order_relaxed);
+        accumulated_black_wl_.store(ToFixedPoint(acc_eval, kWLScale), std::memory_order_relaxed);
+        accumulated_draw_.store(ToFixedPoint(acc_draw, kWLScale), std::memory_order_relaxed);
+        accumulated_black_fs_.store(ToFixedPoint(acc_score, kScoreScale), std::memory_order_relaxed);
+        squared_black_wl_.store(ToFixedPoint(sq_eval, kWLScale), std::memory_order_relaxed);
+        squared_black_fs_.store(ToFixedPoint(sq_score, kSquaredScoreScale), std::memory_order_relaxed);
+    }
+
+    UpdateOwnership(evals, visits);
+}
+
+void Node::UpdateOwnership(const NodeEvals *evals, const int visits) {
+    auto ownership = ownership_.load(std::memory_order_acquire);
+    if (!ownership && visits >= kOwnershipVisitsThreshold) {
+        EnableOwnership();
+        ownership = ownership_.load(std::memory_order_acquire);
+    }
+    if (ownership) {
+        // The ownership is the average of all accumulated evals. Only
+        // the root and the nodes with many visits get here, so the lock
+        // is rarely contended.
+        SpinLock::Lock lock(ownership->mtx);
+        const int owner_visits = ++ownership->visits;
         for (int idx = 0; idx < kNumIntersections; ++idx) {
             const double eval_owner = evals->black_ownership[idx];
-            const double avg_owner  = avg_black_ownership_[idx];
-            const double diff_owner = (eval_owner - avg_owner) / (old_visits+1);
+            const double avg_owner  = ownership->avg_black_ownership[idx];
+            const double diff_owner = (eval_owner - avg_owner) / owner_visits;
+
+            ownership->avg_black_ownership[idx] += diff_owner;
+        }
+    }
+}
 
-            avg_black_ownership_[idx] += diff_owner;
+bool Node::ReplaceChild(Node *old_node, Node *new_node) {
+    for (auto &child : children_) {
+        if (child.Get() == old_node) {
+            return child.Replace(old_node, new_node);
         }
     }
+    return false;
 }
 
 void Node::ApplyEvals(const NodeEvals *evals) {
@@ -691,11 +864,17 @@ void Node::ApplyEvals(const NodeEvals *evals) {
 }
 
 std::array<float, kNumIntersections> Node::GetOwnership(int color) {
-    std::lock_guard<std::mutex> lock(os_mtx_);
-
     auto out = std::array<float, kNumIntersections>{};
+    out.fill(0.f);
+
+    auto ownership = ownership_.load(std::memory_order_acquire);
+    if (!ownership) {
+        return out;
+    }
+
+    SpinLock::Lock lock(ownership->mtx);
     for (int idx = 0; idx < kNumIntersections; ++idx) {
-        auto owner = avg_black_ownership_[idx];
+        auto owner = ownership->avg_black_ownership[idx];
         if (color == kWhite) {
             owner = 0.f - owner;
         }
@@ -704,6 +883,124 @@ std::array<float, kNumIntersections> Node::GetOwnership(int color) {
     return out;
 }
 
+void Node::EnableOwnership() {
+    if (ownership_.load(std::memory_order_acquire)) {
+        return;
+    }
+    auto ownership = GetArena()->New<NodeOwnership>();
+    ownership->avg_black_ownership.fill(0.f);
+
+    // Other threads may allocate it at the same time. Keep the
+    // first one. The other one is released with the arena.
+    NodeOwnership *expected = nullptr;
+    ownership_.compare_exchange_strong(expected, ownership,
+                                       std::memory_order_acq_rel);
+}
+
+void Node::EnableChildStats() {
+    if (stats_.load(std::memory_order_acquire) ||
+            !HasChildren()) {
+        return;
+    }
+    auto stats = AllocateChildStats(*GetArena(), children_.size());
+    for (size_t idx = 0; idx < children_.size(); ++idx) {
+        FillChildStats(stats, idx);
+    }
+
+    // Same as the ownership. Keep the first one.
+    ChildStats *expected = nullptr;
+    stats_.compare_exchange_strong(expected, stats,
+                                   std::memory_order_acq_rel);
+}
+
+void Node::SyncChildStats(const Edge &child) {
+    auto stats = stats_.load(std::memory_order_acquire);
+
+    // The graph search updates the edges by itself.
+    if (!stats || param_->graph_search) {
+        return;
+    }
+    FillChildStats(stats, &child - children_.data());
+}
+
+void Node::FillChildStats(ChildStats *stats, const size_t idx) {
+    const auto &child = children_[idx];
+    const auto node = child.Get();
+
+    stats->policy[idx] = child.GetPolicy();
+    if (!node) {
+        stats->visits[idx].store(0, std::memory_order_relaxed);
+        stats->running[idx].store(0, std::memory_order_relaxed);
+        stats->stm_wl[idx] = 0.f;
+        stats->utility[idx] = 0.f;
+        stats->cpuct_factor[idx] = 1.f;
+        stats->status[idx] = ChildStats::kActive;
+        return;
+    }
+
+    const int visits = node->GetVisits();
+    stats->running[idx].store(
+        node->running_threads_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    stats->status[idx] = static_cast<std::uint8_t>(
+                             node->status_.load(std::memory_order_relaxed));
+
+    if (visits > 0) {
+        // The side to move value without the virtual loss. The
+        // selection adds it later.
+        const double black_wl = node->GetAccumulatedWL();
+        stats->stm_wl[idx] = color_ == kBlack ? black_wl : visits - black_wl;
+        stats->utility[idx] =
+            node->GetDraw() * param_->draw_factor +
+            param_->score_utility_factor * node->GetScoreUtility(
+                color_, param_->score_utility_div, GetNetScore(color_));
+        stats->cpuct_factor[idx] = GetDynamicCpuctK(node, visits);
+    } else {
+        stats->stm_wl[idx] = 0.f;
+        stats->utility[idx] = 0.f;
+        stats->cpuct_factor[idx] = 1.f;
+    }
+
+    stats->visits[idx].store(visits, std::memory_order_relaxed);
+}
+
+void Node::ResyncChildStats() {
+    auto stats = stats_.load(std::memory_order_acquire);
+    if (!stats) {
+        return;
+    }
+
+    const int num_children = children_.size();
+    for (int idx = 0; idx < stats->num_children; ++idx) {
+        if (idx >= num_children) {
+            // The child is removed.
+            stats->visits[idx].store(0, std::memory_order_relaxed);
+            stats->running[idx].store(0, std::memory_order_relaxed);
+            stats->status[idx] = ChildStats::kInvalid;
+        } else if (param_->graph_search) {
+            // Nothing else can reach the root children, so their visits
+            // and policy are the edge ones.
+            stats->visits[idx].store(children_[idx].GetVisits());
+            stats->policy[idx] = children_[idx].GetPolicy();
+        } else {
+            FillChildStats(stats, idx);
+        }
+    }
+    stats->num_children = std::min(stats->num_children, num_children);
+
+    if (param_->dirichlet_noise) {
+        if (!stats->noise) {
+            stats->noise = static_cast<float*>(
+                GetArena()->Allocate(stats->size * sizeof(float)));
+        }
+        for (int idx = 0; idx < stats->size; ++idx) {
+            stats->noise[idx] = idx < num_children ?
+                param_->dirichlet_buffer[children_[idx].GetVertex()] : 0.f;
+        }
+    } else {
+        stats->noise = nullptr;
+    }
+}
+
 float Node::GetScoreUtility(const int color,
                             float div,
                             float parent_score) const {
@@ -713,9 +1010,16 @@ float Node::GetScoreUtility(const int color,
 }
 
 float Node::GetScoreVariance(const float default_var, const int visits) const {
-    return visits > 1 ?
-               squared_score_diff_.load(std::memory_order_relaxed) / (visits - 1) :
-               default_var;
+    if (visits <= 1) {
+        return default_var;
+    }
+    // The sum of squared differences is from the sums of this node.
+    // The threads may update them between the loads. Never let it
+    // be negative.
+    const int node_visits = std::max(GetVisits(), 1);
+    const double sum = GetAccumulatedScore();
+    const double diff = GetSquaredScore() - sum * sum / node_visits;
+    return (kSquaredDiffInit + std::max(diff, 0.0)) / (visits - 1);
 }
 
 float Node::GetScoreStddev() const {
@@ -725,9 +1029,33 @@ float Node::GetScoreStddev() const {
 }
 
 float Node::GetWLVariance(const float default_var, const int visits) const {
-    return visits > 1 ?
-               squared_eval_diff_.load(std::memory_order_relaxed) / (visits - 1) :
-               default_var;
+    if (visits <= 1) {
+        return default_var;
+    }
+    const int node_visits = std::max(GetVisits(), 1);
+    const double sum = GetAccumulatedWL();
+    const double diff = GetSquaredWL() - sum * sum / node_visits;
+    return (kSquaredDiffInit + std::max(diff, 0.0)) / (visits - 1);
+}
+
+double Node::GetAccumulatedWL() const {
+    return FromFixedPoint(accumulated_black_wl_, kWLScale);
+}
+
+double Node::GetAccumulatedDraw() const {
+    return FromFixedPoint(accumulated_draw_, kWLScale);
+}
+
+double Node::GetAccumulatedScore() const {
+    return FromFixedPoint(accumulated_black_fs_, kScoreScale);
+}
+
+double Node::GetSquaredWL() const {
+    return FromFixedPoint(squared_black_wl_, kWLScale);
+}
+
+double Node::GetSquaredScore() const {
+    return FromFixedPoint(squared_black_fs_, kSquaredScoreScale);
 }
 
 float Node::GetWLStddev() const {
@@ -764,9 +1092,9 @@ std::string Node::GetPathVerboseString(GameState &state, int color,
     int depth = 0;
 
     while (depth < (int)moves.size() && curr_node) {
-        curr_node = curr_node->GetChild(moves[depth++]);
+        const auto vertex = moves[depth++];
+        curr_node = curr_node->GetChild(vertex);
         if (curr_node) {
-            const auto vertex = curr_node->GetVertex();
             const auto winrate = curr_node->GetWL(color, false);
             const auto score = curr_node->GetFinalScore(color);
             const auto policy = curr_node->GetPolicy();
@@ -1011,14 +1339,65 @@ Node *Node::GetChild(const int vertex) {
     return nullptr;
 }
 
-Node *Node::PopChild(const int vertex) {
-    auto node = GetChild(vertex);
-    if (node) {
-        auto ite = std::remove_if(std::begin(children_), std::end(children_),
-                                  [node](Edge &ele) {
-                                      return ele.Get() == node;
-                                  });
-        children_.erase(ite, std::end(children_));
+Node *Node::CloneTree(NodeArena &arena) const {
+    if (param_->graph_search) {
+        auto cloned = std::unordered_map<const Node*, Node*>{};
+        return CloneTree(arena, &cloned);
+    }
+    return CloneTree(arena, nullptr);
+}
+
+Node *Node::CloneTree(NodeArena &arena,
+                      std::unordered_map<const Node*, Node*> *cloned) const {
+    if (cloned) {
+        auto it = cloned->find(this);
+        if (it != std::end(*cloned)) {
+            return it->second;
+        }
+    }
+    auto node = arena.New<Node>(&arena, param_, vertex_, policy_);
+    if (cloned) {
+        cloned->emplace(this, node);
+    }
+
+    node->status_.store(status_.load(std::memory_order_relaxed));
+    node->expand_state_.store(expand_state_.load(std::memory_order_relaxed));
+    node->color_ = color_;
+    node->score_bouns_ = score_bouns_;
+    node->black_wl_ = black_wl_;
+    node->black_fs_ = black_fs_;
+    node->accumulated_black_fs_.store(accumulated_black_fs_.load(std::memory_order_relaxed));
+    node->accumulated_black_wl_.store(accumulated_black_wl_.load(std::memory_order_relaxed));
+    node->accumulated_draw_.store(accumulated_draw_.load(std::memory_order_relaxed));
+    node->squared_black_fs_.store(squared_black_fs_.load(std::memory_order_relaxed));
+    node->squared_black_wl_.store(squared_black_wl_.load(std::memory_order_relaxed));
+    node->visits_.store(visits_.load(std::memory_order_relaxed));
+
+    if (auto ownership = ownership_.load(std::memory_order_acquire)) {
+        auto new_ownership = arena.New<NodeOwnership>();
+        new_ownership->visits = ownership->visits;
+        new_ownership->avg_black_ownership = ownership->avg_black_ownership;
+        node->ownership_.store(new_ownership, std::memory_order_release);
+    }
+
+    node->children_.reserve(children_.size());
+    for (const auto &child : children_) {
+        node->children_.emplace_back(child.GetVertex(), child.GetPolicy());
+        if (const auto child_node = child.Get()) {
+            node->children_.back().Assign(child_node->CloneTree(arena, cloned));
+        }
+    }
+    if (auto stats = stats_.load(std::memory_order_acquire)) {
+        if (param_->graph_search) {
+            node->EnableGraph(stats->draw);
+            auto new_stats = node->stats_.load(std::memory_order_relaxed);
+            for (size_t idx = 0; idx < children_.size(); ++idx) {
+                new_stats->visits[idx].store(GetEdgeVisits(idx));
+                new_stats->policy[idx] = stats->policy[idx];
+            }
+        } else {
+            node->EnableChildStats();
+        }
     }
     return node;
 }
@@ -1062,7 +1441,7 @@ std::vector<std::pair<float, int>> Node::GetLcbUtilityList(const int color) {
                                    color, score_utility_div, parent_score);
             const auto ulcb = (lcb + utility) * (1.f - lcb_reduction) +
                                   lcb_reduction * ((float)visits/parentvisits);
-            list.emplace_back(ulcb, node->GetVertex());
+            list.emplace_back(ulcb, child.GetVertex());
         }
     }
 
@@ -1100,7 +1479,7 @@ int Node::GetBestMove(bool allow_pass) {
     return best_move;
 }
 
-const std::vector<Node::Edge> &Node::GetChildren() const {
+const Node::EdgeList &Node::GetChildren() const {
     return children_;
 }
 
@@ -1122,7 +1501,7 @@ int Node::GetVisits() const {
 }
 
 float Node::GetFinalScore(const int color) const {
-    auto score = accumulated_black_fs_.load(std::memory_order_relaxed) / GetVisits();
+    auto score = GetAccumulatedScore() / GetVisits();
 
     if (color == kBlack) {
         return score;
@@ -1131,7 +1510,7 @@ float Node::GetFinalScore(const int color) const {
 }
 
 float Node::GetDraw() const {
-    return accumulated_draw_.load(std::memory_order_relaxed) / GetVisits();
+    return GetAccumulatedDraw() / GetVisits();
 }
 
 float Node::GetNetWL(const int color) const {
@@ -1158,7 +1537,7 @@ float Node::GetWL(const int color, const bool use_virtual_loss) const {
     }
 
     auto visits = GetVisits() + virtual_loss;
-    auto accumulated_wl = accumulated_black_wl_.load(std::memory_order_relaxed);
+    auto accumulated_wl = GetAccumulatedWL();
     if (color == kWhite && use_virtual_loss) {
         accumulated_wl += static_cast<double>(virtual_loss);
     }
@@ -1176,20 +1555,27 @@ void Node::InflateAllChildren() {
     }
 }
 
-void Node::ReleaseAllChildren() {
-    for (auto &child : children_) {
-         Release(child);
+void Node::EnableGraph(const float draw) {
+    // The shared child keeps the policy of its first parent, so
+    // every edge has its own policy.
+    auto stats = AllocateChildStats(*GetArena(), children_.size());
+    stats->draw = draw;
+    for (size_t idx = 0; idx < children_.size(); ++idx) {
+        stats->policy[idx] = children_[idx].GetPolicy();
     }
+    stats_.store(stats, std::memory_order_release);
 }
 
-void Node::Inflate(Edge& child) {
-    if (child.Inflate(param_)) {
-        // do nothing...
-    }
+int Node::GetEdgeVisits(const size_t idx) const {
+    return stats_.load(std::memory_order_relaxed)->visits[idx].load(std::memory_order_relaxed);
+}
+
+NodeArena *Node::GetArena() const {
+    return children_.GetArena();
 }
 
-void Node::Release(Edge& child) {
-    if (child.Release()) {
+void Node::Inflate(Edge& child) {
+    if (child.Inflate(*GetArena(), param_)) {
         // do nothing...
     }
 }
@@ -1309,7 +1695,9 @@ void Node::ApplyDirichletNoise(const float alpha) {
 }
 
 float Node::GetSearchPolicy(Node::Edge& child, bool noise) {
-    auto policy = child.GetPolicy();
+    auto policy = param_->graph_search ?
+                      stats_.load(std::memory_order_relaxed)->policy[&child - children_.data()] :
+                      child.GetPolicy();
     if (noise) {
         const auto vertex = child.GetVertex();
         const auto epsilon = param_->dirichlet_epsilon;
@@ -1702,7 +2090,7 @@ end_loop:;
     return true;
 }
 
-Node *Node::GumbelSelectChild(int color, bool only_max_visits) {
+Node::Edge *Node::GumbelSelectChild(int color, bool only_max_visits) {
     WaitExpanded();
     assert(HasChildren());
 
@@ -1724,7 +2112,7 @@ Node *Node::GumbelSelectChild(int color, bool only_max_visits) {
         }
     }
     Inflate(*best_node);
-    return best_node->Get();
+    return best_node;
 }
 
 int Node::GetGumbelMove(bool allow_pass) {
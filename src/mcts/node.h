@@ -2,6 +2,7 @@
 
 #include "game/game_state.h"
 #include "game/types.h"
+#include "mcts/child_stats.h"
 #include "mcts/node_pointer.h"
 #include "mcts/parameters.h"
 #include "neural/network.h"
@@ -11,6 +12,7 @@
 #include <atomic>
 #include <string>
 #include <mutex>
+#include <unordered_map>
 
 struct NodeEvals {
     float black_final_score{0.0f};
@@ -84,12 +86,28 @@ struct AnalysisConfig {
     }
 };
 
+// The accumulated ownership of a node. Almost all nodes are leaves
+// and nobody reads their ownership, so it is kept out of the node and
+// only allocated for the root, its children and the nodes with enough
+// visits.
+struct NodeOwnership {
+    SpinLock mtx;
+
+    // The number of evals accumulated since it was allocated.
+    int visits{0};
+
+    // The black average ownership value.
+    std::array<float, kNumIntersections> avg_black_ownership;
+};
+
 class Node {
 public:
     using Edge = NodePointer<Node>;
+    using EdgeList = ArenaVector<Edge>;
 
-    explicit Node(Parameters *param, std::int16_t vertex, float policy);
-    ~Node();
+    // The node and its children are allocated from the arena. They
+    // are released with the arena.
+    explicit Node(NodeArena *arena, Parameters *param, std::int16_t vertex, float policy);
 
     // Expand this node.
     bool ExpandChildren(Network &network,
@@ -98,6 +116,13 @@ public:
                         AnalysisConfig &config,
                         const bool is_root);
 
+    // Expand this node with the network result computed outside. The
+    // caller must already own the expanding state by AcquireExpanding().
+    void ExpandChildren(const Network::Result &raw_netlist,
+                        GameState &state,
+                        NodeEvals& node_evals,
+                        AnalysisConfig &config);
+
     // Expand root node children before starting tree search.
     bool PrepareRootNode(Network &network,
                          GameState &state,
@@ -107,8 +132,10 @@ public:
     // Select the best policy node.
     Node *ProbSelectChild(bool allow_pass);
 
-    // Select the best PUCT value node.
-    Node *PuctSelectChild(const int color, const bool is_root);
+    // Select the best PUCT value edge. Use the vertex of edge instead
+    // of the node. The shared node of graph search may be created by
+    // another move.
+    Edge *PuctSelectChild(const int color, const bool is_root);
 
     // Randomly select one child by visits.
     int RandomMoveProportionally(float temp, int min_visits);
@@ -119,6 +146,16 @@ public:
     // Update the node.
     void Update(const NodeEvals *evals);
 
+    // Update the node of graph search after the playout went through
+    // the child with given vertex. The values are recomputed from the
+    // network evals and the children, so the shared children are not
+    // counted twice. The leaf node still uses Update().
+    void GraphUpdate(const NodeEvals *evals, const int vertex);
+
+    // Let the edge points to the shared node instead of the old
+    // child. Return false if the edge had been changed.
+    bool ReplaceChild(Node *old_node, Node *new_node);
+
     // Get children's LCB values.
     std::vector<std::pair<float, int>> GetLcbUtilityList(const int color);
 
@@ -128,7 +165,7 @@ public:
     // Get best move(vertex) with Gumbel-Top-k trick.
     int GetGumbelMove(bool allow_pass);
 
-    const std::vector<Edge> &GetChildren() const;
+    const EdgeList &GetChildren() const;
 
     bool HasChildren() const;
     bool SetTerminal();
@@ -140,9 +177,8 @@ public:
     // there is no correspond child.
     Node *GetChild(const int vertex);
 
-    // Get the child pointer and remove it according to vertex. Return
-    // NULL if there is no correspond child.
-    Node *PopChild(const int vertex);
+    // Copy this sub-tree to another arena. Return the new root.
+    Node *CloneTree(NodeArena &arena) const;
 
     // Get the visit number of this node.
     int GetVisits() const;
@@ -168,9 +204,21 @@ public:
     // Get the average draw value.
     float GetDraw() const;
 
-    // Get the average ownership value.
+    // Get the average ownership value. It is zero if the node does
+    // not accumulate the ownership.
     std::array<float, kNumIntersections> GetOwnership(int color);
 
+    // Start to accumulate the ownership for this node.
+    void EnableOwnership();
+
+    // Start to keep the children statistics in the structure of
+    // arrays. The PUCT selection reads them instead of the children.
+    void EnableChildStats();
+
+    // Refresh the statistics of the child after a playout went
+    // through it. Do nothing if the node does not keep them.
+    void SyncChildStats(const Edge &child);
+
     // Set the network win-loss value from outside.
     void ApplyEvals(const NodeEvals *evals);
 
@@ -189,6 +237,12 @@ public:
     bool IsExpanding() const;
     bool IsExpanded() const;
 
+    // kInitial -> kExpanding
+    bool AcquireExpanding();
+
+    // kExpanding -> kInitial
+    void ExpandCancel();
+
     bool IsPruned() const;
     void SetActive(const bool active);
     void Invalidate();
@@ -209,6 +263,7 @@ private:
                    GameState &state,
                    const bool is_root);
     float GetDynamicCpuctFactor(Node *node, const int visits, const int parentvisits);
+    float GetDynamicCpuctK(Node *node, const int visits) const;
     void ApplyDirichletNoise(const float alpha);
     void ApplyNetOutput(GameState& state,
                         const Network::Result &raw_netlist,
@@ -222,13 +277,39 @@ private:
     float GetScoreUtility(const int color, float div, float parent_score) const;
     float GetScoreVariance(const float default_var, const int visits) const;
     float GetWLVariance(const float default_var, const int visits) const;
+
+    // Get the accumulated values from the fixed point.
+    double GetAccumulatedWL() const;
+    double GetAccumulatedDraw() const;
+    double GetAccumulatedScore() const;
+    double GetSquaredWL() const;
+    double GetSquaredScore() const;
     float GetLcb(const int color) const;
 
+    NodeArena *GetArena() const;
+
+    // Accumulate the ownership evals if the node has enough visits.
+    void UpdateOwnership(const NodeEvals *evals, const int visits);
+
+    // Allocate the edge data of graph search after linking the
+    // children. The edge visits and policy are kept in the children
+    // statistics.
+    void EnableGraph(const float draw);
+    int GetEdgeVisits(const size_t idx) const;
+
+    // Copy the child values into the slot of the statistics.
+    void FillChildStats(ChildStats *stats, const size_t idx);
+
+    // Refill all slots after the root children are changed.
+    void ResyncChildStats();
+
+    // The shared nodes are only copied once.
+    Node *CloneTree(NodeArena &arena,
+                    std::unordered_map<const Node*, Node*> *cloned) const;
+
     void Inflate(Edge& child);
-    void Release(Edge& child);
 
     void InflateAllChildren();
-    void ReleaseAllChildren();
     int GetVirtualLoss() const;
 
     float GetGumbelQValue(int color, float parent_score) const;
@@ -238,7 +319,7 @@ private:
     bool ProcessGumbelLogits(std::vector<float> &gumbel_logits,
                              const int color,
                              bool only_max_visits);
-    Node *GumbelSelectChild(int color, bool only_max_visits);
+    Edge *GumbelSelectChild(int color, bool only_max_visits);
     void MixLogitsCompletedQ(GameState &state, std::vector<float> &prob);
 
     void KillRootSuperkos(GameState &state);
@@ -259,18 +340,15 @@ private:
     };
     std::atomic<ExpandState> expand_state_{ExpandState::kInitial};
 
-    // kInitial -> kExpanding
-    bool AcquireExpanding();
-
     // kExpanding -> done
     void ExpandDone();
 
-    // kExpanding -> kInitial
-    void ExpandCancel();
-
     // wait until we are on kExpanded state
     void WaitExpanded() const;
 
+    // The played move.
+    std::int16_t vertex_;
+
     // Color of the node. Set kInvalid if there are no children.
     int color_{kInvalid};
 
@@ -290,20 +368,34 @@ private:
     // The network final score value.
     float black_fs_{0.0f};
 
-    // The accumulated squared difference values.
-    std::atomic<double> squared_eval_diff_{1e-4f};
-    std::atomic<double> squared_score_diff_{1e-4f};
+    // The move probability value of this node.
+    float policy_;
 
-    // The black accumulated values.
-    std::atomic<double> accumulated_black_fs_{0.0f};
-    std::atomic<double> accumulated_black_wl_{0.0f};
-    std::atomic<double> accumulated_draw_{0.0f};
+    // The nodes with at least this visits accumulate the ownership.
+    static constexpr int kOwnershipVisitsThreshold = 128;
 
-    // The black average ownership value.
-    std::array<float, kNumIntersections> avg_black_ownership_;
+    // The ownership values. Only allocated by EnableOwnership().
+    std::atomic<NodeOwnership*> ownership_{nullptr};
 
-    // The ownership lock.
-    std::mutex os_mtx_;
+    // The nodes with at least this visits keep the children
+    // statistics.
+    static constexpr int kChildStatsVisitsThreshold = 32;
+
+    // The children statistics. Allocated by EnableChildStats() for
+    // the root and the busy nodes. In the graph search mode, every
+    // node with children allocates it for the edge data.
+    std::atomic<ChildStats*> stats_{nullptr};
+
+    // The black accumulated values and squared values in the fixed
+    // point. The update is a plain integer addition, so the threads
+    // never spin on the busy nodes. The integer sums are exact, so
+    // the values do not depend on the order of updates. See the
+    // scales in node.cc.
+    std::atomic<std::int64_t> accumulated_black_fs_{0};
+    std::atomic<std::int64_t> accumulated_black_wl_{0};
+    std::atomic<std::int64_t> accumulated_draw_{0};
+    std::atomic<std::int64_t> squared_black_fs_{0};
+    std::atomic<std::int64_t> squared_black_wl_{0};
 
     // The visits number of this node.
     std::atomic<int> visits_{0};
@@ -312,11 +404,5 @@ private:
     std::atomic<int> running_threads_{0};
 
     // The children of this node.
-    std::vector<Edge> children_;
-
-    // The played move.
-    std::int16_t vertex_;
-
-    // The move probability value of this node.
-    float policy_;
+    EdgeList children_;
 };
@@ -0,0 +1,86 @@
+#include "mcts/node_arena.h"
+#include "utils/fiber.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+std::uint64_t NextEpoch() {
+    static std::atomic<std::uint64_t> epoch{0};
+    return epoch.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace
+
+NodeArena::NodeArena() {
+    epoch_.store(NextEpoch(), std::memory_order_relaxed);
+}
+
+NodeArena::~NodeArena() {
+    Reset();
+}
+
+void *NodeArena::Allocate(size_t bytes) {
+    // The games in the fibers of one thread have the different arenas.
+    auto &thread_slabs = GetFiberLocal<ThreadSlabs>();
+
+    bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+
+    const auto epoch = epoch_.load(std::memory_order_acquire);
+    ThreadSlab *slab = nullptr;
+    for (auto &s : thread_slabs.slabs) {
+        if (s.epoch == epoch) {
+            slab = &s;
+            break;
+        }
+    }
+    if (!slab) {
+        // Replace the slab of the least recently used arena. Its rest
+        // is left to that arena.
+        slab = &*std::min_element(
+                   std::begin(thread_slabs.slabs), std::end(thread_slabs.slabs),
+                   [](const auto &a, const auto &b) { return a.last_use < b.last_use; });
+        *slab = ThreadSlab{};
+        slab->epoch = epoch;
+    }
+    slab->last_use = ++thread_slabs.clock;
+
+    if ((size_t)(slab->end - slab->ptr) < bytes) {
+        const auto slab_bytes = std::max(bytes, slab->next_bytes);
+        slab->next_bytes = std::min(2 * slab->next_bytes, kSlabBytes);
+        slab->ptr = AllocateSlab(slab_bytes);
+        slab->end = slab->ptr + slab_bytes;
+    }
+
+    void *ptr = slab->ptr;
+    slab->ptr += bytes;
+    return ptr;
+}
+
+char *NodeArena::AllocateSlab(size_t bytes) {
+    auto slab = static_cast<char*>(std::malloc(bytes));
+    if (!slab) {
+        throw std::bad_alloc{};
+    }
+    used_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+
+    SpinLock::Lock lock(mutex_);
+    slabs_.emplace_back(slab);
+    return slab;
+}
+
+void NodeArena::Reset() {
+    SpinLock::Lock lock(mutex_);
+
+    epoch_.store(NextEpoch(), std::memory_order_release);
+    for (auto slab : slabs_) {
+        std::free(slab);
+    }
+    slabs_.clear();
+    used_bytes_.store(0, std::memory_order_relaxed);
+}
+
+size_t NodeArena::GetUsedBytes() const {
+    return used_bytes_.load(std::memory_order_relaxed);
+}
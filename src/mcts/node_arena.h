@@ -0,0 +1,152 @@
+#pragma once
+
+#include "utils/mutex.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The memory arena of the search tree. Every thread bump allocates the
+// nodes from its own slab, so the allocation is lock-free unless the slab
+// is exhausted. The objects are never destructed one by one. All of them
+// are released at once by Reset() or the destructor. Only the trivially
+// releasable objects, like the nodes, may be allocated here.
+class NodeArena {
+public:
+    NodeArena();
+    ~NodeArena();
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    // Allocate the memory from the slab of current thread.
+    void *Allocate(size_t bytes);
+
+    template<typename T, typename... Args>
+    T *New(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "The object of arena is never destructed.");
+        return new (Allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Release all objects. The slabs held by the threads are invalid
+    // after it. Be sure that no one uses the tree.
+    void Reset();
+
+    // Return the bytes of all slabs.
+    size_t GetUsedBytes() const;
+
+private:
+    // The first slab of a thread is small, so the games in the fibers
+    // do not pin much memory. The next ones grow to the max size.
+    static constexpr size_t kMinSlabBytes = 64 * 1024;
+    static constexpr size_t kSlabBytes = 1024 * 1024;
+    static constexpr size_t kAlignment = 16;
+
+    // The number of arenas that a thread keeps the slabs of.
+    static constexpr int kMaxThreadArenas = 4;
+
+    struct ThreadSlab {
+        std::uint64_t epoch{0};
+        char *ptr{nullptr};
+        char *end{nullptr};
+        size_t next_bytes{kMinSlabBytes};
+        std::uint64_t last_use{0};
+    };
+
+    // The slabs of recent arenas of a thread. The worker may serve
+    // several searches, so switching between them does not drop the
+    // current slabs. The least recently used one is replaced.
+    struct ThreadSlabs {
+        std::array<ThreadSlab, kMaxThreadArenas> slabs;
+        std::uint64_t clock{0};
+    };
+
+    // Allocate a new slab for current thread.
+    char *AllocateSlab(size_t bytes);
+
+    // The slab of a thread is only valid in the same epoch. Every
+    // arena and every Reset() get an unique epoch, so the epoch also
+    // tells the arena of the slab.
+    std::atomic<std::uint64_t> epoch_;
+
+    std::atomic<size_t> used_bytes_{0};
+
+    SpinLock mutex_;
+    std::vector<char*> slabs_ GUARDED_BY(mutex_);
+};
+
+// The growable array in the arena. It never destructs the elements
+// and the old buffer is left in the arena when it grows, so it is
+// trivially destructible and may be a member of the arena objects.
+template<typename T>
+class ArenaVector {
+public:
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "The element of arena vector is never destructed.");
+
+    explicit ArenaVector(NodeArena *arena) : arena_(arena) {}
+
+    ArenaVector(const ArenaVector&) = delete;
+    ArenaVector& operator=(const ArenaVector&) = delete;
+
+    void reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        auto data = static_cast<T*>(arena_->Allocate(capacity * sizeof(T)));
+        for (size_t i = 0; i < size_; ++i) {
+            new (&data[i]) T(std::move(data_[i]));
+        }
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            reserve(std::max(2 * capacity_, size_t{4}));
+        }
+        new (&data_[size_++]) T(std::forward<Args>(args)...);
+    }
+
+    // Remove the elements from first to the end, like the tail of
+    // std::remove_if().
+    void erase(T *first, T *last) {
+        assert(last == end());
+        (void)last;
+        size_ = first - data_;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+
+    T &operator[](size_t idx) { return data_[idx]; }
+    const T &operator[](size_t idx) const { return data_[idx]; }
+
+    T &back() { return data_[size_ - 1]; }
+    const T &back() const { return data_[size_ - 1]; }
+
+    T *begin() { return data_; }
+    T *end() { return data_ + size_; }
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + size_; }
+
+    NodeArena *GetArena() const { return arena_; }
+
+private:
+    NodeArena *arena_;
+    T *data_{nullptr};
+    size_t size_{0};
+    size_t capacity_{0};
+};
@@ -7,6 +7,7 @@
 #include <cstring>
 
 #include "mcts/parameters.h"
+#include "mcts/node_arena.h"
 
 #define POINTER_MASK (3ULL)
 
@@ -16,6 +17,12 @@ static constexpr std::uint64_t kPointer    = 0ULL;
 
 static_assert(sizeof(float) == sizeof(std::uint32_t), "");
 
+// The user space address only uses the low 48 bits. The inflated
+// pointer keeps the vertex of edge in the high 16 bits, so the edge
+// still knows its move if it points to a shared node.
+static constexpr int kVertexShift = 48;
+static constexpr std::uint64_t kAddressMask = (1ULL << kVertexShift) - 1ULL;
+
 template<typename NodeType>
 class NodePointer {
 public:
@@ -37,8 +44,17 @@ public:
 
     NodeType *Get() const;
 
-    bool Inflate(Parameters *param);
-    bool Release();
+    // Allocate the node from the arena. The memory is released
+    // with the arena.
+    bool Inflate(NodeArena &arena, Parameters *param);
+
+    // Point to an existing node. Only for building the
+    // compacted tree.
+    void Assign(NodeType *node);
+
+    // Replace the node if the pointer still points to the old
+    // one. Return true if it succeeds.
+    bool Replace(NodeType *old_node, NodeType *new_node);
 
     int GetVertex() const;
     float GetPolicy() const;
@@ -48,6 +64,8 @@ private:
     std::atomic<std::uint64_t> pointer_{kUninflated};
 
     NodeType *ReadPointer(uint64_t v) const;
+    std::uint64_t MakePointer(NodeType *node, std::int16_t vertex) const;
+    int ReadPointerVertex(std::uint64_t v) const;
     int ReadVertex(std::uint64_t v) const;
     float ReadPolicy(std::uint64_t v) const;
 
@@ -124,7 +142,21 @@ inline bool NodePointer<NodeType>::IsUninflated() const {
 template<typename NodeType>
 inline NodeType *NodePointer<NodeType>::ReadPointer(uint64_t v) const {
     assert(IsPointer(v));
-    return reinterpret_cast<NodeType *>(v & ~(POINTER_MASK));
+    return reinterpret_cast<NodeType *>(v & kAddressMask & ~(POINTER_MASK));
+}
+
+template<typename NodeType>
+inline std::uint64_t NodePointer<NodeType>::MakePointer(NodeType *node,
+                                                        std::int16_t vertex) const {
+    const auto address = reinterpret_cast<std::uint64_t>(node);
+    assert((address & ~kAddressMask) == 0ULL);
+
+    return address | ((std::uint64_t)(std::uint16_t)vertex << kVertexShift) | kPointer;
+}
+
+template<typename NodeType>
+inline int NodePointer<NodeType>::ReadPointerVertex(std::uint64_t v) const {
+    return (std::int16_t)(std::uint16_t)(v >> kVertexShift);
 }
 
 template<typename NodeType>
@@ -136,7 +168,7 @@ inline NodeType *NodePointer<NodeType>::Get() const {
 }
 
 template<typename NodeType>
-inline bool NodePointer<NodeType>::Inflate(Parameters *param) {
+inline bool NodePointer<NodeType>::Inflate(NodeArena &arena, Parameters *param) {
 
 inflate_loop: // Try to allocate new memory for the pointer.
 
@@ -162,8 +194,7 @@ inflate_loop: // Try to allocate new memory for the pointer.
 
     // Success to get the owner. Now allocate new memory.
     auto new_pointer =
-             reinterpret_cast<std::uint64_t>(
-                 new NodeType(param, vertex, policy)) | kPointer;
+             MakePointer(arena.New<NodeType>(&arena, param, vertex, policy), vertex);
     auto old_pointer = pointer_.exchange(new_pointer);
 #ifdef NDEBUG
     (void) old_pointer;
@@ -174,21 +205,21 @@ inflate_loop: // Try to allocate new memory for the pointer.
 }
 
 template<typename NodeType>
-inline bool NodePointer<NodeType>::Release() {
-    // Becare that only one thread can release the memory. Two
-    // or above may release same memory many times.
+inline void NodePointer<NodeType>::Assign(NodeType *node) {
     auto v = pointer_.load(std::memory_order_relaxed);
+    assert(IsUninflated(v));
+    pointer_.store(MakePointer(node, ReadVertex(v)),
+                       std::memory_order_relaxed);
+}
 
-    if (IsPointer(v)) {
-        delete ReadPointer(v);
-        auto pointer = pointer_.exchange(kUninflated);
-#ifdef NDEBUG
-        (void) pointer;
-#endif
-        assert(pointer == v);
-        return true;
+template<typename NodeType>
+inline bool NodePointer<NodeType>::Replace(NodeType *old_node, NodeType *new_node) {
+    auto v = pointer_.load(std::memory_order_relaxed);
+    if (!IsPointer(v) || ReadPointer(v) != old_node) {
+        return false;
     }
-    return false;
+    return pointer_.compare_exchange_strong(
+               v, MakePointer(new_node, ReadPointerVertex(v)));
 }
 
 template<typename NodeType>
@@ -215,7 +246,7 @@ inline int NodePointer<NodeType>::GetVertex() const {
         v = pointer_.load(std::memory_order_relaxed);
     }
     if (IsPointer(v)) {
-        return ReadPointer(v)->GetVertex();
+        return ReadPointerVertex(v);
     }
     return ReadVertex(v);
 }
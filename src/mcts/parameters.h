@@ -16,9 +16,13 @@ public:
 
         threads = GetOption<int>("threads");
         batch_size = GetOption<int>("batch_size");
+        batched_search = GetOption<bool>("batched_search");
+        graph_search = GetOption<bool>("graph_search");
+        graph_table_mib = GetOption<int>("graph_table_mib");
         playouts = GetOption<int>("playouts");
         ponder_factor = GetOption<int>("ponder_factor");
         const_time = GetOption<int>("const_time");
+        tree_memory_mib = GetOption<int>("tree_memory_mib");
 
         resign_threshold = GetOption<float>("resign_threshold");
         lcb_reduction = GetOption<float>("lcb_reduction");
@@ -81,6 +85,8 @@ public:
     int playouts;
     int ponder_factor;
     int const_time;
+    int tree_memory_mib;
+    int graph_table_mib;
     int random_min_visits;
     float random_moves_factor;
 
@@ -135,6 +141,8 @@ public:
     bool cpuct_dynamic;
     bool use_rollout;
     bool capture_all_dead;
+    bool batched_search;
+    bool graph_search;
 
     std::array<float, kNumVertices + 10> dirichlet_buffer;
 };
@@ -0,0 +1,190 @@
+#include "mcts/puct_benchmark.h"
+#include "mcts/child_stats.h"
+#include "mcts/node.h"
+#include "mcts/node_arena.h"
+#include "mcts/parameters.h"
+#include "utils/random.h"
+#include "utils/format.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <sstream>
+
+namespace {
+
+// Run the function until it takes enough time. Every call does
+// 'selections' selections. Return the selections per second.
+double MeasureRate(const int selections, std::function<void()> func) {
+    constexpr float kMinSeconds = 0.2f;
+
+    func(); // warm up
+
+    Timer timer;
+    timer.Clock();
+
+    int iterations = 0;
+    float elapsed = 0.f;
+    while (elapsed < kMinSeconds) {
+        func();
+        iterations++;
+        elapsed = timer.GetDuration();
+    }
+    return (double)selections * iterations / std::max(elapsed, 1e-6f);
+}
+
+// Fill the statistics with the random values of a searched node.
+void RandomizeChildStats(ChildStats &stats, PuctArgs &args) {
+    auto &rng = Random<>::Get();
+    auto unit = std::uniform_real_distribution<float>(0.f, 1.f);
+    auto visits = std::uniform_int_distribution<int>(0, 200);
+
+    float policy_sum = 0.f;
+    for (int i = 0; i < stats.num_children; ++i) {
+        policy_sum += (stats.policy[i] = unit(rng));
+    }
+    int parentvisits = 0;
+    for (int i = 0; i < stats.num_children; ++i) {
+        const int n = unit(rng) < 0.5f ? visits(rng) : 0;
+        stats.policy[i] /= policy_sum;
+        stats.visits[i].store(n);
+        stats.running[i].store(unit(rng) < 0.05f ? 1 : 0);
+        stats.stm_wl[i] = n * unit(rng);
+        stats.utility[i] = 0.1f * (unit(rng) - 0.5f);
+        stats.cpuct_factor[i] = 0.5f + 0.9f * unit(rng);
+        stats.status[i] = unit(rng) < 0.05f ?
+                              ChildStats::kPruned : ChildStats::kActive;
+        parentvisits += n;
+    }
+
+    args.cpuct = 0.9f + unit(rng);
+    args.numerator = std::sqrt((float)parentvisits);
+    args.fpu_value = 0.5f - 0.25f * unit(rng);
+    args.expanding_value = -1.f;
+    args.noise_epsilon = 0.f;
+    args.forced_playouts_k = 0.f;
+    args.parentvisits = parentvisits;
+    args.cpuct_dynamic_alpha = unit(rng);
+    args.virtual_loss = 3.f;
+}
+
+} // namespace
+
+std::string BenchmarkPuct(const int board_size, const int selections) {
+    auto param = Parameters{};
+    param.Reset();
+    param.gumbel = false;
+    param.dirichlet_noise = false;
+    param.graph_search = false;
+    param.symm_pruning = false;
+    param.use_rollout = false;
+    param.first_pass_bonus = false;
+
+    auto state = GameState{};
+    state.Reset(board_size, 7.5f);
+
+    auto &rng = Random<>::Get();
+    auto unit = std::uniform_real_distribution<float>(0.f, 1.f);
+
+    // Expand the root with a synthetic network result, so every
+    // legal move is a child.
+    const int num_intersections = state.GetNumIntersections();
+    auto result = Network::Result{};
+    result.board_size = board_size;
+    result.komi = 7.5f;
+    result.wdl = {0.45f, 0.1f, 0.45f};
+    result.stm_winrate = 0.5f;
+
+    float policy_sum = 0.f;
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        policy_sum += (result.probabilities[idx] = unit(rng) * unit(rng));
+    }
+    result.pass_probability = 0.01f * policy_sum;
+    policy_sum += result.pass_probability;
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        result.probabilities[idx] /= policy_sum;
+    }
+    result.pass_probability /= policy_sum;
+
+    NodeArena arena;
+    auto config = AnalysisConfig{};
+    auto root_evals = NodeEvals{};
+    auto root = arena.New<Node>(&arena, &param, kPass, 1.0f);
+    root->AcquireExpanding();
+    root->ExpandChildren(result, state, root_evals, config);
+
+    const int color = state.GetToMove();
+    const int num_children = root->GetChildren().size();
+
+    // Give the children some visits. The root is not updated, so it
+    // does not keep the statistics yet.
+    for (int i = 0; i < 4 * num_children; ++i) {
+        auto edge = root->PuctSelectChild(color, false);
+        auto evals = NodeEvals{};
+        evals.black_wl = unit(rng);
+        evals.draw = 0.1f * unit(rng);
+        evals.black_final_score = 10.f * (unit(rng) - 0.5f);
+        edge->Get()->Update(&evals);
+    }
+
+    // The children do not change, so both paths keep selecting the
+    // same child.
+    const auto RunSelection = [&]() {
+        for (int i = 0; i < selections; ++i) {
+            auto edge = root->PuctSelectChild(color, false);
+            root->SyncChildStats(*edge);
+        }
+    };
+
+    const int node_vertex = root->PuctSelectChild(color, false)->GetVertex();
+    const double node_rate = MeasureRate(selections, RunSelection);
+
+    root->EnableChildStats();
+    auto soa_edge = root->PuctSelectChild(color, false);
+    const int soa_vertex = soa_edge->GetVertex();
+    root->SyncChildStats(*soa_edge);
+    const double soa_rate = MeasureRate(selections, RunSelection);
+
+    // Compare the kernels on the random statistics.
+    constexpr int kTrials = 1000;
+    auto stats = AllocateChildStats(arena, num_children);
+    auto args = PuctArgs{};
+    int mismatches = 0;
+    for (int t = 0; t < kTrials; ++t) {
+        RandomizeChildStats(*stats, args);
+        if (SelectPuctChild(*stats, args) !=
+                SelectPuctChildReference(*stats, args)) {
+            mismatches += 1;
+        }
+    }
+
+    volatile int sink = 0;
+    const double kernel_rate = MeasureRate(selections, [&]() {
+        for (int i = 0; i < selections; ++i) {
+            sink = SelectPuctChild(*stats, args);
+        }
+    });
+    const double reference_rate = MeasureRate(selections, [&]() {
+        for (int i = 0; i < selections; ++i) {
+            sink = SelectPuctChildReference(*stats, args);
+        }
+    });
+    (void) sink;
+
+    auto out = std::ostringstream{};
+    out << Format("kernel=%s, board size=%d, children=%d, selections=%d\n",
+                      GetPuctKernelName().c_str(), board_size,
+                      num_children, selections);
+    out << Format("%-12s %14s\n", "path", "selections/s");
+    out << Format("%-12s %14.0f\n", "node", node_rate);
+    out << Format("%-12s %14.0f\n", "stats", soa_rate);
+    out << Format("%-12s %14.0f\n", "kernel", kernel_rate);
+    out << Format("%-12s %14.0f\n", "reference", reference_rate);
+    out << Format("same move: %s, kernel mismatches: %d/%d",
+                      node_vertex == soa_vertex ? "yes" : "no",
+                      mismatches, kTrials);
+
+    return out.str();
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Measure the PUCT selection at the root of an empty board. Compare
+// the selection walking the child nodes with the one reading the
+// children statistics, and the runtime selected kernel with the
+// portable loop. Return the report.
+std::string BenchmarkPuct(const int board_size, const int selections);
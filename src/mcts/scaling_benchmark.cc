@@ -0,0 +1,53 @@
+#include "mcts/scaling_benchmark.h"
+#include "mcts/search.h"
+#include "utils/affinity.h"
+#include "utils/format.h"
+#include "utils/option.h"
+#include "utils/threadpool.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+std::string BenchmarkSearchScaling(const GameState &state,
+                                   Network &network,
+                                   const int max_threads,
+                                   const int playouts) {
+    // The search reads the number of threads from the options.
+    const auto saved_threads = GetOption<int>("threads");
+
+    auto threads_list = std::vector<int>{};
+    for (int t = 1; t < max_threads; t *= 2) {
+        threads_list.emplace_back(t);
+    }
+    threads_list.emplace_back(max_threads);
+
+    auto out = std::ostringstream{};
+    out << Format("playouts=%d, affinity=%s, numa nodes=%d\n",
+                      playouts,
+                      GetAffinityModeName(ThreadPool::Get().GetAffinity()).c_str(),
+                      GetNumNumaNodes());
+    out << Format("%8s %12s %10s %10s", "threads", "p/sec", "speedup", "efficiency");
+
+    double base_rate = 0.0;
+    for (const int threads : threads_list) {
+        SetOption("threads", threads);
+        ThreadPool::Get(threads);
+
+        auto search_state = state;
+        Search search(search_state, network);
+        network.ClearCache();
+
+        const auto result = search.Computation(playouts, Search::kNullTag);
+        const double rate = result.playouts / std::max(result.seconds, 1e-6f);
+        if (base_rate == 0.0) {
+            base_rate = rate;
+        }
+        const double speedup = rate / std::max(base_rate, 1e-6);
+        out << Format("\n%8d %12.2f %9.2fx %9.2f%%",
+                          threads, rate, speedup, 100.0 * speedup / threads);
+    }
+
+    SetOption("threads", saved_threads);
+    return out.str();
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "game/game_state.h"
+#include "neural/network.h"
+
+#include <string>
+
+// Search the position with 1, 2, 4 ... max_threads threads and the
+// same playouts. Every run starts from the empty tree and the empty
+// NN cache. Return the playouts per second and the efficiency of
+// every run compared with the single thread.
+std::string BenchmarkSearchScaling(const GameState &state,
+                                   Network &network,
+                                   const int max_threads,
+                                   const int playouts);
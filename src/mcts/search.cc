@@ -13,6 +13,7 @@
 #include "utils/format.h"
 #include "utils/random.h"
 #include "utils/kldivergence.h"
+#include "utils/fiber.h"
 #include "game/book.h"
 
 #ifdef WIN32
@@ -41,7 +42,13 @@ void Search::Initialize() {
 
     analysis_config_.Clear();
     last_state_ = root_state_;
-    root_node_.reset(nullptr);
+    root_node_ = nullptr;
+    node_arena_ = std::make_unique<NodeArena>();
+    transposition_table_ = std::make_unique<TranspositionTable>();
+    if (param_->graph_search) {
+        transposition_table_->SetMemory(
+            (size_t)param_->graph_table_mib * 1024 * 1024);
+    }
 
     group_ = std::make_unique<ThreadGroup<void>>(&ThreadPool::Get());
 
@@ -79,8 +86,12 @@ void Search::PlaySimulation(GameState &currstate, Node *const node,
             // is under this node. Skip the simulation stage this time. However,
             // it still has a chance do PUCT/UCT.
             auto node_evals = NodeEvals{};
-            const bool success = node->ExpandChildren(
-                network_, currstate, node_evals, analysis_config_, false);
+            auto success = false;
+            {
+                PROFILE_SCOPE(kProfileExpand);
+                success = node->ExpandChildren(
+                    network_, currstate, node_evals, analysis_config_, false);
+            }
 
             if (!has_children && success) {
                 search_result.FromNetEvals(node_evals);
@@ -89,27 +100,228 @@ void Search::PlaySimulation(GameState &currstate, Node *const node,
     }
 
     // Not the terminated node, search the next node.
+    int next_vertex = kNullVertex;
     if (node->HasChildren() && !search_result.IsValid()) {
         auto color = currstate.GetToMove();
-        Node *next = nullptr;
 
         // Go to the next node by PUCT algoritim.
-        next = node->PuctSelectChild(color, depth == 0);
-
-        auto vtx = next->GetVertex();
-        currstate.PlayMove(vtx, color);
+        Node::Edge *edge;
+        {
+            PROFILE_SCOPE(kProfileSelect);
+            edge = node->PuctSelectChild(color, depth == 0);
+        }
+        next_vertex = edge->GetVertex();
+        {
+            PROFILE_SCOPE(kProfilePlayMove);
+            currstate.PlayMove(next_vertex, color);
+        }
+        auto next = ResolveTransposition(node, edge->Get(), currstate);
 
         // Recursive calls.
         PlaySimulation(currstate, next, depth+1, search_result);
+
+        PROFILE_SCOPE(kProfileBackup);
+        node->SyncChildStats(*edge);
+    } else {
+        // The leaf of this playout.
+        PROFILE_COUNT(kProfileLeaves, 1);
+        PROFILE_COUNT(kProfileLeafDepth, depth);
     }
 
     // Now Update this node if it valid.
+    PROFILE_SCOPE(kProfileBackup);
     if (search_result.IsValid()) {
-        node->Update(search_result.GetEvals());
+        if (param_->graph_search && next_vertex != kNullVertex) {
+            node->GraphUpdate(search_result.GetEvals(), next_vertex);
+        } else {
+            node->Update(search_result.GetEvals());
+        }
     }
     node->DecrementThreads();
 }
 
+Node *Search::ResolveTransposition(Node *const parent, Node *const child,
+                                   GameState &currstate) {
+    if (!param_->graph_search || !child->Expandable()) {
+        return child;
+    }
+
+    // The superko depends on the path. Do not share this position.
+    if (currstate.GetLastMove() != kPass &&
+            currstate.IsSuperko()) {
+        return child;
+    }
+
+    // The hash includes the ko move, passes and prisoners, so no
+    // position can be the same as its ancestors. The graph is
+    // always acyclic.
+    auto shared = transposition_table_->LookupOrInsert(currstate.GetHash(), child);
+    if (shared == child || !shared->IsValid()) {
+        return child;
+    }
+    if (!parent->ReplaceChild(child, shared)) {
+        // Another thread has changed the edge.
+        return child;
+    }
+    return shared;
+}
+
+int Search::PlayBatchedSimulation(const int batch_size) {
+    PROFILE_SCOPE(kProfilePlayout);
+
+    struct Descent {
+        GameState state;
+        BoardPool pool;
+        std::vector<Node*> path;
+        std::vector<Node::Edge*> edges;
+        SearchResult result;
+        bool had_children{false};
+    };
+
+    // Every thread reuses its own descents. The first 'num_leaves'
+    // ones are waiting for the network.
+    auto &descents = GetFiberLocal<std::vector<Descent>>();
+    if ((int)descents.size() < batch_size) {
+        descents.resize(batch_size);
+    }
+    int num_leaves = 0;
+    int playouts = 0;
+
+    // Update the nodes on the path from the leaf to the root and
+    // release the virtual loss.
+    const bool graph_search = param_->graph_search;
+    const auto Backup = [graph_search](Descent &descent) {
+        PROFILE_SCOPE(kProfileBackup);
+        PROFILE_COUNT(kProfileLeaves, 1);
+        PROFILE_COUNT(kProfileLeafDepth, descent.path.size() - 1);
+
+        const int size = descent.path.size();
+        for (int i = size - 1; i >= 0; --i) {
+            auto node = descent.path[i];
+            if (i + 1 < size) {
+                // The child below is already released.
+                node->SyncChildStats(*descent.edges[i]);
+            }
+            if (descent.result.IsValid()) {
+                if (graph_search && i + 1 < size) {
+                    node->GraphUpdate(descent.result.GetEvals(),
+                                      descent.edges[i]->GetVertex());
+                } else {
+                    node->Update(descent.result.GetEvals());
+                }
+            }
+            node->DecrementThreads();
+        }
+    };
+
+    // Stop collecting if the descents keep hitting the leaves which
+    // are already collected.
+    int collisions = 0;
+    while (num_leaves < batch_size && collisions < batch_size) {
+        auto &descent = descents[num_leaves];
+        descent.pool.Clear();
+        descent.state.ForkFrom(root_state_, &descent.pool);
+        descent.path.clear();
+        descent.edges.clear();
+        descent.result = SearchResult{};
+        descent.had_children = false;
+
+        auto &currstate = descent.state;
+        auto &search_result = descent.result;
+        Node *node = root_node_;
+        bool pending = false;
+
+        while (true) {
+            node->IncrementThreads();
+            descent.path.emplace_back(node);
+
+            const bool end_by_passes = currstate.GetPasses() >= 2;
+            if (end_by_passes) {
+                search_result.FromGameOver(currstate);
+            }
+
+            // Terminated node, try to expand it.
+            if (node->Expandable()) {
+                const auto last_move = currstate.GetLastMove();
+
+                if (end_by_passes) {
+                    if (node->SetTerminal() &&
+                            search_result.IsValid()) {
+                        // The game is over, setting the game result value.
+                        node->ApplyEvals(search_result.GetEvals());
+                    }
+                } else if (last_move != kPass &&
+                               currstate.IsSuperko()) {
+                    // Prune this superko move.
+                    node->Invalidate();
+                } else if (node->AcquireExpanding()) {
+                    // Own this leaf. It is expanded after the batch
+                    // forwarding.
+                    descent.had_children = node->HasChildren();
+                    pending = true;
+                    break;
+                }
+            }
+
+            // Not the terminated node, search the next node.
+            if (!node->HasChildren() || search_result.IsValid()) {
+                break;
+            }
+            const auto color = currstate.GetToMove();
+            Node::Edge *edge;
+            {
+                PROFILE_SCOPE(kProfileSelect);
+                edge = node->PuctSelectChild(color, descent.path.size() == 1);
+            }
+            descent.edges.emplace_back(edge);
+            {
+                PROFILE_SCOPE(kProfilePlayMove);
+                currstate.PlayMove(edge->GetVertex(), color);
+            }
+            node = ResolveTransposition(node, edge->Get(), currstate);
+        }
+
+        if (pending) {
+            num_leaves += 1;
+        } else {
+            if (search_result.IsValid()) {
+                playouts += 1;
+            } else {
+                collisions += 1;
+            }
+            Backup(descent);
+        }
+    }
+
+    if (num_leaves > 0) {
+        auto states = std::vector<const GameState*>{};
+        for (int i = 0; i < num_leaves; ++i) {
+            states.emplace_back(&descents[i].state);
+        }
+        const auto results = network_.GetOutputs(
+                                 states, Network::kRandom, param_->policy_temp);
+
+        for (int i = 0; i < num_leaves; ++i) {
+            auto &descent = descents[i];
+            auto node_evals = NodeEvals{};
+            {
+                PROFILE_SCOPE(kProfileExpand);
+                descent.path.back()->ExpandChildren(
+                    results[i], descent.state, node_evals, analysis_config_);
+            }
+
+            if (!descent.had_children) {
+                descent.result.FromNetEvals(node_evals);
+                playouts += 1;
+            }
+            Backup(descent);
+        }
+    }
+    playouts_.fetch_add(playouts, std::memory_order_relaxed);
+
+    return playouts;
+}
+
 void Search::PrepareRootNode(Search::OptionTag tag) {
     bool reused = AdvanceToNewRootState(tag);
 
@@ -118,7 +330,8 @@ void Search::PrepareRootNode(Search::OptionTag tag) {
         ReleaseTree();
 
         // Do not reuse the tree, allocate new root node.
-        root_node_ = std::make_unique<Node>(param_.get(), kPass, 1.0f);
+        root_node_ = node_arena_->New<Node>(
+                         node_arena_.get(), param_.get(), kPass, 1.0f);
     }
 
     playouts_.store(0, std::memory_order_relaxed);
@@ -151,10 +364,10 @@ void Search::PrepareRootNode(Search::OptionTag tag) {
 }
 
 void Search::ReleaseTree() {
-    if (root_node_) {
-        auto p = root_node_.release();
-        group_->AddTask([p](){ delete p; });
-    }
+    // All nodes are in the arena. Release them at once.
+    root_node_ = nullptr;
+    transposition_table_->Clear();
+    node_arena_->Reset();
 }
 
 void Search::TimeSettings(const int main_time,
@@ -265,10 +478,21 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
 
     // The SMP workers run on every threads except for the main thread.
     const auto Worker = [this]() -> void {
+        // Every thread reuses its own search state.
+        auto currstate = GameState{};
+        auto pool = BoardPool{};
+
         while(running_.load(std::memory_order_relaxed)) {
-            auto currstate = std::make_unique<GameState>(root_state_);
+            if (param_->batched_search) {
+                PlayBatchedSimulation(param_->batch_size);
+                continue;
+            }
+            pool.Clear();
+            currstate.ForkFrom(root_state_, &pool);
+
+            PROFILE_SCOPE(kProfilePlayout);
             auto result = SearchResult{};
-            PlaySimulation(*currstate, root_node_.get(), 0, result);
+            PlaySimulation(currstate, root_node_, 0, result);
             if (result.IsValid()) {
                 playouts_.fetch_add(1, std::memory_order_relaxed);
             }
@@ -286,6 +510,7 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
     // Clean the timer.
     timer.Clock();
     analysis_timer.Clock();
+    const auto profile_begin = Profiler::Get().GetSnapshot();
 
     // Compute the max thinking time. The bound time is
     // max const time if we already set it.
@@ -304,9 +529,12 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
                                     color, board_size, move_num);
 
     PrepareRootNode(tag);
+    computation_result.reused_visits = root_node_->GetVisits()-1;
 
     if (param_->analysis_verbose) {
-        LOGGING << Format("Reuse %d nodes\n", root_node_->GetVisits()-1);
+        LOGGING << Format("Reuse %d nodes\n", computation_result.reused_visits);
+        LOGGING << Format("Tree memory: %.2f(MiB)\n",
+                              node_arena_->GetUsedBytes() / (1024.f * 1024.f));
         LOGGING << Format("Use %d threads for search\n", param_->threads);
         LOGGING << Format("Max thinking time: %.2f(sec)\n", thinking_time);
         LOGGING << Format("Max playouts number: %d\n", playouts);
@@ -326,14 +554,22 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
     // Main thread is running.
     auto last_updating_visits = root_node_->GetVisits();
     auto keep_running = running_.load(std::memory_order_relaxed);
+    auto currstate = GameState{};
+    auto pool = BoardPool{};
 
     while (!InputPending(tag) && keep_running) {
-        auto currstate = std::make_unique<GameState>(root_state_);
-        auto result = SearchResult{};
+        if (param_->batched_search) {
+            PlayBatchedSimulation(param_->batch_size);
+        } else {
+            pool.Clear();
+            currstate.ForkFrom(root_state_, &pool);
 
-        PlaySimulation(*currstate, root_node_.get(), 0, result);
-        if (result.IsValid()) {
-            playouts_.fetch_add(1, std::memory_order_relaxed);
+            PROFILE_SCOPE(kProfilePlayout);
+            auto result = SearchResult{};
+            PlaySimulation(currstate, root_node_, 0, result);
+            if (result.IsValid()) {
+                playouts_.fetch_add(1, std::memory_order_relaxed);
+            }
         }
 
         const auto root_visits = root_node_->GetVisits();
@@ -379,6 +615,8 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
 
     const auto played_playouts =
                    playouts_.load(std::memory_order_relaxed);
+    last_profile_ = Profiler::Get().GetSnapshot() - profile_begin;
+    last_profile_playouts_ = played_playouts;
 
     if (tag & kThinking) {
         time_control_.TookTime(color);
@@ -423,6 +661,7 @@ ComputationResult Search::Computation(int playouts, Search::OptionTag tag) {
         LOGGING << "  speed: " << (float)played_playouts /
                                       timer.GetDuration() << "(p/sec)\n";
         LOGGING << "  playouts: " << played_playouts << "\n";
+        LOGGING << GetProfileString();
     }
 
     // Record perfomance infomation.
@@ -493,7 +732,7 @@ void Search::GatherComputationResult(ComputationResult &result) const {
     for (const auto &child : children) {
         const auto node = child.Get();
         const auto visits = node->GetVisits();
-        const auto vertex = node->GetVertex();
+        const auto vertex = child.GetVertex();
 
         parentvisits += visits;
         if (vertex == kPass) {
@@ -1266,16 +1505,10 @@ bool Search::AdvanceToNewRootState(Search::OptionTag tag) {
     while (!move_list.empty()) {
         int vtx = move_list.top();
 
-        auto next_node = root_node_->PopChild(vtx);
-        auto p = root_node_.release();
-
-        // Lazy tree destruction. May save a little of time when
-        // dealing with large trees. We will collect these future
-        // resuls after the search finished.
-        group_->AddTask([p](){ delete p; });
+        auto next_node = root_node_->GetChild(vtx);
 
         if (next_node) {
-            root_node_.reset(next_node);
+            root_node_ = next_node;
         } else {
             return false;
         }
@@ -1309,6 +1542,25 @@ bool Search::AdvanceToNewRootState(Search::OptionTag tag) {
         }
     }
 
+    // Copy the reused sub-tree to a new arena. The other nodes
+    // are released with the old arena at once.
+    auto arena = std::make_unique<NodeArena>();
+    auto cloned_root = root_node_->CloneTree(*arena);
+    if (param_->tree_memory_mib > 0 &&
+            arena->GetUsedBytes() >=
+                (size_t)param_->tree_memory_mib * 1024 * 1024) {
+        // The reused sub-tree is already out of the memory budget. It
+        // would stop the search before the first playout. We build the
+        // tree from scratch instead.
+        return false;
+    }
+    root_node_ = cloned_root;
+    node_arena_ = std::move(arena);
+
+    // The shared nodes are released. The reused nodes are not in
+    // the table any more, so only the new nodes are shared.
+    transposition_table_->Clear();
+
     return true;
 }
 
@@ -1373,6 +1625,14 @@ bool Search::AchieveCap(const int cap, Search::OptionTag tag) {
         // to achieve visit cap.
         should_stop |= true;
     }
+    if (param_->tree_memory_mib > 0 &&
+            playouts > 0 &&
+            node_arena_->GetUsedBytes() >=
+                (size_t)param_->tree_memory_mib * 1024 * 1024) {
+        // The tree is out of the memory budget. The search always
+        // does at least one playout, so the root is never stale.
+        should_stop |= true;
+    }
     return should_stop;
 }
 
@@ -1389,6 +1649,14 @@ int Search::GetPonderPlayouts() const {
     return ponder_playouts;
 }
 
+std::string Search::GetProfileString() const {
+    return last_profile_.ToString(last_profile_playouts_);
+}
+
+size_t Search::GetTreeMemory() const {
+    return node_arena_->GetUsedBytes();
+}
+
 std::string Search::GetDebugMoves(std::vector<int> moves) {
     return root_node_->GetPathVerboseString(
                root_state_, root_state_.GetToMove(), moves);
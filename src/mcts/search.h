@@ -3,11 +3,13 @@
 #include "mcts/time_control.h"
 #include "mcts/parameters.h"
 #include "mcts/node.h"
+#include "mcts/transposition_table.h"
 #include "game/game_state.h"
 #include "neural/training.h"
 #include "utils/threadpool.h"
 #include "utils/operators.h"
 #include "utils/time.h"
+#include "utils/profiler.h"
 
 #include <thread>
 #include <memory>
@@ -17,18 +19,20 @@
 struct SearchResult {
 public:
     SearchResult() = default;
-    bool IsValid() const { return nn_evals_ != nullptr; }
-    NodeEvals *GetEvals() const { return nn_evals_.get(); }
+    bool IsValid() const { return valid_; }
+    const NodeEvals *GetEvals() const { return &nn_evals_; }
 
-    void FromNetEvals(NodeEvals nn_evals) { 
-        nn_evals_ = std::make_unique<NodeEvals>(nn_evals);
+    void FromNetEvals(const NodeEvals &nn_evals) {
+        nn_evals_ = nn_evals;
+        valid_ = true;
     }
 
     void FromGameOver(GameState &state) {
         assert(state.GetPasses() >= 2);
 
-        if (nn_evals_ == nullptr) {
-            nn_evals_ = std::make_unique<NodeEvals>();
+        if (!valid_) {
+            nn_evals_ = NodeEvals{};
+            valid_ = true;
         }
 
         auto black_score = 0;
@@ -38,32 +42,35 @@ public:
             auto owner = ownership[idx];
             if (owner == kBlack) {
                 black_score += 1;
-                nn_evals_->black_ownership[idx] = 1;
+                nn_evals_.black_ownership[idx] = 1;
             } else if (owner == kWhite) {
                 black_score -= 1;
-                nn_evals_->black_ownership[idx] = -1;
+                nn_evals_.black_ownership[idx] = -1;
             } else {
-                nn_evals_->black_ownership[idx] = 0;
+                nn_evals_.black_ownership[idx] = 0;
             }
         }
 
         auto black_final_score = (float)black_score - state.GetKomi();
-        nn_evals_->black_final_score = black_final_score;
+        nn_evals_.black_final_score = black_final_score;
 
         if (black_final_score > 1e-4) {
-            nn_evals_->black_wl = 1.0f;
-            nn_evals_->draw = 0.0f;
+            nn_evals_.black_wl = 1.0f;
+            nn_evals_.draw = 0.0f;
         } else if (black_final_score < -1e-4) {
-            nn_evals_->black_wl = 0.0f;
-            nn_evals_->draw = 0.0f;
+            nn_evals_.black_wl = 0.0f;
+            nn_evals_.draw = 0.0f;
         } else {
-            nn_evals_->black_wl = 0.5f;
-            nn_evals_->draw = 1.0f;
+            nn_evals_.black_wl = 0.5f;
+            nn_evals_.draw = 1.0f;
         }
     }
 
 private:
-    std::unique_ptr<NodeEvals> nn_evals_{nullptr};
+    // Keep the evals in place so that the playout does not allocate
+    // the memory.
+    bool valid_{false};
+    NodeEvals nn_evals_;
 };
 
 struct ComputationResult {
@@ -98,6 +105,9 @@ struct ComputationResult {
     int batch_size;
     float seconds;
 
+    // The root visits reused from the last search.
+    int reused_visits{0};
+
     float policy_kld;
 };
 
@@ -163,6 +173,12 @@ public:
 
     std::string GetDebugMoves(std::vector<int> moves);
 
+    // Return the per-phase profile of the last search.
+    std::string GetProfileString() const;
+
+    // Return the bytes of the tree memory, including the reused nodes.
+    size_t GetTreeMemory() const;
+
 private:
     // Try to reuse the sub-tree.
     bool AdvanceToNewRootState(Search::OptionTag tag);
@@ -187,6 +203,17 @@ private:
     void PlaySimulation(GameState &currstate, Node *const node,
                         const int depth, SearchResult &search_result);
 
+    // Return the shared node of current position if the child is not
+    // expanded yet. It is the child itself if there is no shared node
+    // or the graph search is off.
+    Node *ResolveTransposition(Node *const parent, Node *const child,
+                               GameState &currstate);
+
+    // Descend the tree several times with virtual loss and evaluate
+    // the collected leaves as one batch. Return the number of valid
+    // playouts.
+    int PlayBatchedSimulation(const int batch_size);
+
     void PrepareRootNode(Search::OptionTag tag);
     int GetPonderPlayouts() const;
 
@@ -216,8 +243,14 @@ private:
     // The forwarding network for this search.
     Network &network_;
 
-    // The root node of tree.
-    std::unique_ptr<Node> root_node_; 
+    // The root node of tree. It is owned by the arena.
+    Node *root_node_{nullptr};
+
+    // The memory of all tree nodes.
+    std::unique_ptr<NodeArena> node_arena_;
+
+    // The shared nodes of graph search.
+    std::unique_ptr<TranspositionTable> transposition_table_;
 
     // The root networl eval.
     NodeEvals root_evals_;
@@ -232,4 +265,8 @@ private:
     std::vector<double> last_root_dist_;
 
     std::vector<float> root_raw_probabilities_;
+
+    // The profile of the last search.
+    ProfileSnapshot last_profile_;
+    int last_profile_playouts_{0};
 };
@@ -0,0 +1,219 @@
+#include "mcts/suite_benchmark.h"
+#include "mcts/search.h"
+#include "game/sgf.h"
+#include "game/iterator.h"
+#include "neural/network.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/option.h"
+#include "utils/threadpool.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Return 1, 2, 4 ... max_val. The max value is always included.
+std::vector<int> GetSweep(const int max_val) {
+    auto sweep = std::vector<int>{};
+    for (int v = 1; v < max_val; v *= 2) {
+        sweep.emplace_back(v);
+    }
+    sweep.emplace_back(max_val);
+    return sweep;
+}
+
+// The number of consecutive moves searched as one window.
+constexpr int kWindowSize = 10;
+
+std::vector<GameState> GetSuitePositions(const std::string &sgf_file,
+                                         const int max_positions) {
+    // All positions and the range of their games.
+    auto all_positions = std::vector<GameState>{};
+    auto game_begins = std::vector<size_t>{};
+    auto game_ends = std::vector<size_t>{};
+    const auto sgfs = SgfParser::Get().ChopAll(sgf_file);
+
+    for (const auto &sgf : sgfs) {
+        GameState state;
+        try {
+            state = Sgf::Get().FromString(sgf, 9999);
+        } catch (const char *err) {
+            LOGGING << "Fail to load the SGF file! Discard it." << std::endl
+                        << Format("\tCause: %s.", err) << std::endl;
+            continue;
+        }
+
+        const auto game_begin = all_positions.size();
+        auto game_ite = GameStateIterator(state);
+        do {
+            all_positions.emplace_back(game_ite.GetState());
+        } while (game_ite.Next());
+        game_begins.resize(all_positions.size(), game_begin);
+        game_ends.resize(all_positions.size(), all_positions.size());
+    }
+    if (all_positions.empty()) {
+        return all_positions;
+    }
+
+    // Take the windows of consecutive moves, so the tree of last move
+    // is reused like a real game. Spread the windows evenly, so the
+    // result does not only depend on the opening.
+    const int num_windows = (max_positions + kWindowSize - 1) / kWindowSize;
+    const double stride = std::max(
+        (double)all_positions.size() / num_windows, 1.0);
+
+    auto positions = std::vector<GameState>{};
+    for (double offset = 0; (size_t)offset < all_positions.size() &&
+                                (int)positions.size() < max_positions; offset += stride) {
+        // Move the window back if it would cross the end of the game.
+        const auto window = std::min((size_t)kWindowSize,
+                                     max_positions - positions.size());
+        const auto game_end = game_ends[(size_t)offset];
+        const auto start = std::max(game_begins[(size_t)offset],
+                                    std::min((size_t)offset, game_end - std::min(window, game_end)));
+        const auto end = std::min(start + window, game_end);
+        for (auto i = start; i < end; ++i) {
+            positions.emplace_back(all_positions[i]);
+        }
+    }
+    return positions;
+}
+
+// Return the nearest-rank percentile of the sorted values.
+double GetPercentile(const std::vector<double> &sorted_vals, double p) {
+    if (sorted_vals.empty()) {
+        return 0.0;
+    }
+    const auto rank = std::max((int)(p * sorted_vals.size() + 0.999), 1);
+    return sorted_vals[std::min(rank, (int)sorted_vals.size()) - 1];
+}
+
+std::string EscapeJson(const std::string &str) {
+    auto out = std::string{};
+    for (const char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+} // namespace
+
+std::string BenchmarkSuite(const std::string &weights_file,
+                           const std::string &sgf_file,
+                           const int positions,
+                           const int playouts,
+                           const int max_threads,
+                           const int max_batch_size) {
+    const auto suite = GetSuitePositions(sgf_file, positions);
+    if (suite.empty()) {
+        return std::string{};
+    }
+
+    int max_board_size = 0;
+    for (const auto &state : suite) {
+        max_board_size = std::max(max_board_size, state.GetBoardSize());
+    }
+
+    // The search and the network read them from the options.
+    const auto saved_threads = GetOption<int>("threads");
+    const auto saved_batch_size = GetOption<int>("batch_size");
+
+    auto runs = std::vector<std::string>{};
+    for (const int batch_size : GetSweep(max_batch_size)) {
+        // The forward pipe prepares the workers for the most threads.
+        SetOption("batch_size", batch_size);
+        SetOption("threads", max_threads);
+
+        auto network = std::make_unique<Network>();
+        network->Initialize(weights_file);
+        network->Reload(max_board_size);
+
+        for (const int threads : GetSweep(max_threads)) {
+            SetOption("threads", threads);
+            ThreadPool::Get(threads);
+
+            network->ClearCache();
+            network->ResetCacheStats();
+            const auto forward_begin = network->GetForwardStats();
+
+            auto search_state = suite[0];
+            auto search = std::make_unique<Search>(search_state, *network);
+
+            auto latencies = std::vector<double>{};
+            int total_playouts = 0;
+            int total_reused_visits = 0;
+            size_t peak_tree_bytes = 0;
+            double total_seconds = 0.0;
+
+            for (const auto &state : suite) {
+                // Search the next position with the tree of last one.
+                search_state = state;
+
+                Timer timer;
+                const auto result = search->Computation(playouts, Search::kNullTag);
+                const double seconds = timer.GetDurationMicroseconds() * 1e-6;
+
+                latencies.emplace_back(1000.0 * seconds);
+                total_seconds += seconds;
+                total_playouts += result.playouts;
+                total_reused_visits += result.reused_visits;
+                peak_tree_bytes = std::max(peak_tree_bytes, search->GetTreeMemory());
+            }
+            search.reset();
+
+            const auto forward_end = network->GetForwardStats();
+            const auto cache = network->GetCacheStats();
+            const double evals = forward_end.inputs - forward_begin.inputs;
+            const double seconds = std::max(total_seconds, 1e-6);
+            std::sort(std::begin(latencies), std::end(latencies));
+
+            auto run = std::string{"{"};
+            run += Format("\"threads\": %d, ", threads);
+            run += Format("\"batch_size\": %d, ", batch_size);
+            run += Format("\"playouts\": %d, ", total_playouts);
+            run += Format("\"seconds\": %.3f, ", total_seconds);
+            run += Format("\"playouts_per_sec\": %.2f, ", total_playouts / seconds);
+            run += Format("\"nn_evals_per_sec\": %.2f, ", evals / seconds);
+            run += Format("\"move_latency_ms\": {\"p50\": %.2f, \"p99\": %.2f}, ",
+                              GetPercentile(latencies, 0.5),
+                              GetPercentile(latencies, 0.99));
+            run += Format("\"peak_tree_mib\": %.2f, ",
+                              peak_tree_bytes / (1024.0 * 1024.0));
+            run += Format("\"reused_visits_per_move\": %.1f, ",
+                              (double)total_reused_visits / suite.size());
+            run += Format("\"reuse_rate\": %.4f, ",
+                              total_reused_visits + total_playouts > 0 ?
+                                  (double)total_reused_visits / (total_reused_visits + total_playouts) : 0.0);
+            run += Format("\"cache_hit_rate\": %.4f",
+                              cache.lookups > 0 ? (double)cache.hits / cache.lookups : 0.0);
+            run += "}";
+            runs.emplace_back(run);
+        }
+        network->Destroy();
+    }
+
+    SetOption("threads", saved_threads);
+    SetOption("batch_size", saved_batch_size);
+    ThreadPool::Get(saved_threads);
+
+    auto out = std::ostringstream{};
+    out << "{";
+    out << Format("\"sgf\": \"%s\", ", EscapeJson(sgf_file).c_str());
+    out << Format("\"positions\": %d, ", (int)suite.size());
+    out << Format("\"playouts\": %d, ", playouts);
+    out << Format("\"max_threads\": %d, ", max_threads);
+    out << Format("\"max_batch_size\": %d, ", max_batch_size);
+    out << "\"runs\": [";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        out << (i == 0 ? "\n  " : ",\n  ") << runs[i];
+    }
+    out << "\n]}";
+    return out.str();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+// Search the fixed positions of the SGF file with every combination of
+// 1, 2, 4 ... max_threads threads and 1, 2, 4 ... max_batch_size batch
+// sizes. The positions are the windows of consecutive moves spread
+// evenly over the games. They are searched in order, so the tree of last
+// move is reused like a real game. Every batch size loads its own
+// network. Every combination starts from the empty tree and the empty
+// cache. Return the JSON report of playouts per second, NN evals per
+// second, per-move latency, peak tree memory, tree reuse rate and cache
+// hit rate. Return the empty string if there is no position.
+std::string BenchmarkSuite(const std::string &weights_file,
+                           const std::string &sgf_file,
+                           const int positions,
+                           const int playouts,
+                           const int max_threads,
+                           const int max_batch_size);
@@ -0,0 +1,66 @@
+#include "mcts/transposition_table.h"
+
+#include <algorithm>
+
+void TranspositionTable::SetMemory(size_t bytes) {
+    size_ = std::max(bytes / sizeof(Entry), size_t{1});
+
+    // The entries are zero-initialized.
+    table_ = std::make_unique<Entry[]>(size_);
+    num_entries_.store(0, std::memory_order_relaxed);
+}
+
+Node *TranspositionTable::LookupOrInsert(std::uint64_t key, Node *node) {
+    if (size_ == 0) {
+        return node;
+    }
+
+    // The zero key is the empty slot.
+    if (key == 0) {
+        key = 1;
+    }
+
+    for (int i = 0; i < kMaxProbes; ++i) {
+        auto &entry = table_[(key + i) % size_];
+        auto entry_key = entry.key.load(std::memory_order_acquire);
+
+        if (entry_key == 0) {
+            // Try to claim the empty slot.
+            if (entry.key.compare_exchange_strong(entry_key, key,
+                                                  std::memory_order_acq_rel)) {
+                entry.node.store(node, std::memory_order_release);
+                num_entries_.fetch_add(1, std::memory_order_relaxed);
+                return node;
+            }
+            // Another thread claimed it. The 'entry_key' is its key now.
+        }
+        if (entry_key == key) {
+            // The node may be null if the other thread is still
+            // inserting it. Treat it as missing.
+            auto shared = entry.node.load(std::memory_order_acquire);
+            return shared ? shared : node;
+        }
+    }
+
+    // The probed slots are full. Do not share this node.
+    return node;
+}
+
+void TranspositionTable::Clear() {
+    if (num_entries_.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    for (size_t i = 0; i < size_; ++i) {
+        table_[i].key.store(0, std::memory_order_relaxed);
+        table_[i].node.store(nullptr, std::memory_order_relaxed);
+    }
+    num_entries_.store(0, std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::GetNumEntries() const {
+    return num_entries_.load(std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::GetMemory() const {
+    return size_ * sizeof(Entry);
+}
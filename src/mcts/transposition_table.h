@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class Node;
+
+// The lock-free transposition table of graph search. It maps the
+// position hash to the shared node. The table is fixed-size and uses
+// the bounded linear probing. Nothing is inserted if all probed slots
+// are taken, so the memory never grows. The nodes are owned by the
+// arena. Clear the table before releasing the arena.
+class TranspositionTable {
+public:
+    TranspositionTable() = default;
+
+    // Allocate the table with given bytes. All items are removed.
+    void SetMemory(size_t bytes);
+
+    // Return the node of the position. If the position is not in the
+    // table, try to insert the given node and return it.
+    Node *LookupOrInsert(std::uint64_t key, Node *node);
+
+    // Remove all items.
+    void Clear();
+
+    // Return the number of stored nodes.
+    size_t GetNumEntries() const;
+
+    // Return the bytes of table.
+    size_t GetMemory() const;
+
+private:
+    static constexpr int kMaxProbes = 4;
+
+    struct Entry {
+        std::atomic<std::uint64_t> key;
+        std::atomic<Node*> node;
+    };
+
+    std::unique_ptr<Entry[]> table_;
+    size_t size_{0};
+
+    std::atomic<size_t> num_entries_{0};
+};
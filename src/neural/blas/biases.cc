@@ -2,13 +2,15 @@
 
 #include <cassert>
 
-void AddSpatialBiases::Forward(const size_t board_size,
+void AddSpatialBiases::Forward(const size_t batch_size,
+                               const size_t board_size,
                                const size_t channels,
                                std::vector<float> &input,
                                const std::vector<float> &biases,
                                bool ReLU) {
     auto zero_vec = std::vector<float>{};
     Forward(
+        batch_size,
         board_size,
         channels,
         input,
@@ -17,7 +19,8 @@ void AddSpatialBiases::Forward(const size_t board_size,
         ReLU);
 }
 
-void AddSpatialBiases::Forward(const size_t board_size,
+void AddSpatialBiases::Forward(const size_t batch_size,
+                               const size_t board_size,
                                const size_t channels,
                                std::vector<float> &input,
                                const std::vector<float> &biases,
@@ -25,7 +28,7 @@ void AddSpatialBiases::Forward(const size_t board_size,
                                bool ReLU) {
     const auto width = board_size;
     const auto height = board_size;
-    const auto spatial_size = width * height;
+    const auto spatial_size = batch_size * width * height;
 
     const auto lambda_ReLU = [ReLU](const auto val) {
         return (val > 0.0f || (!ReLU)) ? val : 0.0f;
@@ -53,7 +56,34 @@ void AddSpatialBiases::Forward(const size_t board_size,
     }
 }
 
-void AddVectorBiases::Forward(const size_t size,
+void AddBatchedSpatialBiases::Forward(const size_t batch_size,
+                                      const size_t board_size,
+                                      const size_t channels,
+                                      std::vector<float> &input,
+                                      const std::vector<float> &biases,
+                                      bool ReLU) {
+    const auto width = board_size;
+    const auto height = board_size;
+    const auto spatial_size = width * height;
+
+    const auto lambda_ReLU = [ReLU](const auto val) {
+        return (val > 0.0f || (!ReLU)) ? val : 0.0f;
+    };
+
+    float *input_ptr = input.data();
+    for (auto c = size_t{0}; c < channels; ++c) {
+        for (auto n = size_t{0}; n < batch_size; ++n) {
+            const float bias = biases[n * channels + c];
+            for (auto b = size_t{0}; b < spatial_size; b++) {
+                *input_ptr = lambda_ReLU(*input_ptr + bias);
+                input_ptr++;
+            }
+        }
+    }
+}
+
+void AddVectorBiases::Forward(const size_t batch_size,
+                              const size_t size,
                               std::vector<float> &input,
                               const std::vector<float> &biases,
                               bool ReLU) {
@@ -63,7 +93,10 @@ void AddVectorBiases::Forward(const size_t size,
         return (val > 0.0f || (!ReLU)) ? val : 0.0f;
     };
 
-    for (auto o = size_t{0}; o < size; ++o) {
-        input[o] = lambda_ReLU(biases[o] + input[o]);
+    for (auto b = size_t{0}; b < batch_size; ++b) {
+        for (auto o = size_t{0}; o < size; ++o) {
+            const auto idx = b * size + o;
+            input[idx] = lambda_ReLU(biases[o] + input[idx]);
+        }
     }
 }
@@ -3,16 +3,20 @@
 #include <vector>
 #include <cstddef>
 
+// The spatial planes are [channels, batch, spatial]. The biases are
+// shared by all batches.
 class AddSpatialBiases {
 public:
     AddSpatialBiases() = delete;
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t channels,
                         std::vector<float> &input,
                         const std::vector<float> &biases,
                         bool ReLU);
 
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t channels,
                         std::vector<float> &input,
                         const std::vector<float> &biases,
@@ -20,10 +24,24 @@ public:
                         bool ReLU);
 };
 
+// Same as AddSpatialBiases but every batch has its own biases. The
+// biases are [batch, channels].
+class AddBatchedSpatialBiases {
+public:
+    AddBatchedSpatialBiases() = delete;
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
+                        const size_t channels,
+                        std::vector<float> &input,
+                        const std::vector<float> &biases,
+                        bool ReLU);
+};
+
 class AddVectorBiases {
 public:
     AddVectorBiases() = delete;
-    static void Forward(const size_t size,
+    static void Forward(const size_t batch_size,
+                        const size_t size,
                         std::vector<float> &input,
                         const std::vector<float> &biases,
                         bool ReLU = false);
@@ -1,5 +1,7 @@
 #include "neural/blas/blas.h"
 
+#include <algorithm>
+
 #ifdef USE_EIGEN
 template <typename T>
 using EigenVectorMap = Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>>;
@@ -15,6 +17,16 @@ using EigenMatrixMap =
 template <typename T>
 using ConstEigenMatrixMap =
     Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
+
+template <typename T>
+using EigenStridedMatrixMap =
+    Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>,
+               0, Eigen::OuterStride<>>;
+
+template <typename T>
+using ConstEigenStridedMatrixMap =
+    Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>,
+               0, Eigen::OuterStride<>>;
 #endif
 
 void Blas::ConvolutionSgemm(const int M, const int N, const int K,
@@ -55,6 +67,56 @@ void Blas::ConvolutionSgemm(const int M, const int N, const int K,
 #endif
 }
 
+void Blas::ConvolutionSgemm(const int M, const int N, const int K,
+                            const float alpha,
+                            const float *A, const int lda,
+                            const float *B, const int ldb,
+                            const float beta,
+                            float *C, const int ldc,
+                            const SgemmEpilogue &epilogue) {
+#ifndef USE_BLAS
+    Sgemm<false, false>::apply(M, N, K,
+                               alpha,
+                               A, lda,
+                               B, ldb,
+                               beta,
+                               C, ldc,
+                               epilogue);
+#else
+    // The output block is still in the cache when applying the
+    // epilogue.
+    constexpr int kBlockSize = 256;
+
+    for (int j = 0; j < N; j += kBlockSize) {
+        const int block_size = std::min(kBlockSize, N - j);
+#ifdef USE_OPENBLAS
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                    M, block_size, K,
+                    alpha,
+                    A, lda,
+                    B + j, ldb,
+                    beta,
+                    C + j, ldc);
+#endif
+#ifdef USE_EIGEN
+        (void) alpha;
+        (void) beta;
+        auto C_mat = EigenStridedMatrixMap<float>(
+                         C + j, block_size, M, Eigen::OuterStride<>(ldc));
+        C_mat.noalias() =
+            ConstEigenStridedMatrixMap<float>(
+                B + j, block_size, K, Eigen::OuterStride<>(ldb)) *
+            ConstEigenStridedMatrixMap<float>(
+                A, K, M, Eigen::OuterStride<>(lda));
+#endif
+        auto block_epilogue = epilogue;
+        if (block_epilogue.residual) {
+            block_epilogue.residual += j;
+        }
+        ApplySgemmEpilogue(M, block_size, C + j, ldc, block_epilogue);
+    }
+#endif
+}
 
 void Blas::WinogradSgemm(const int offset_u, const int offset_v, const int offset_m,
                          const int M, const int N, const int K,
@@ -25,6 +25,17 @@ public:
                                  const float beta,
                                  float *C, const int ldc);
 
+    // Same as above but the epilogue is applied to the output. It is
+    // fused into the built-in kernel. The other backends apply it to
+    // a block of columns right after computing the block.
+    static void ConvolutionSgemm(const int M, const int N, const int K,
+                                 const float alpha,
+                                 const float *A, const int lda,
+                                 const float *B, const int ldb,
+                                 const float beta,
+                                 float *C, const int ldc,
+                                 const SgemmEpilogue &epilogue);
+
 
     // This is interface for Winograd. It is not the real general
     // matrix multiply. Some parameters may be invalid.
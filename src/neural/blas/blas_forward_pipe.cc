@@ -5,15 +5,28 @@
 #include "neural/blas/fullyconnect.h"
 #include "neural/blas/biases.h"
 #include "neural/blas/winograd_convolution3.h"
+#include "neural/blas/int8_convolution.h"
+#include "neural/blas/int8_calibration.h"
 #include "neural/winograd_helper.h"
 #include "utils/option.h"
+#include "utils/log.h"
+#include "utils/format.h"
+#include "utils/affinity.h"
 
 #include <algorithm>
+#include <chrono>
+#include <iterator>
 
 void BlasForwardPipe::Initialize(std::shared_ptr<DNNWeights> weights) {
     Load(weights);
     InitWinograd();
     use_optimistic_policy_ = GetOption<bool>("use_optimistic_policy");
+    max_batch_ = std::max(GetOption<int>("batch_size"), 1);
+    numa_ = GetOption<bool>("numa");
+    CalibrateInt8();
+    ReplicateWeights();
+
+    PrepareWorkers(); // Run the batch forwarding workers.
 }
 
 void BlasForwardPipe::InitWinograd() {
@@ -30,8 +43,12 @@ void BlasForwardPipe::InitWinograd() {
         WinogradTransformF(weights_->input_conv.GetWeights(),
                                residual_channels, kInputChannels);
 
-    // The residual tower.
+    // The residual tower. The INT8 tower does not use the Winograd
+    // algorithm.
     for (auto &residual : weights_->tower) {
+        if (weights_->int8) {
+            break;
+        }
         const auto outer_channels = residual_channels;
         const auto inner_channels = residual.apply_btl ?
                                         outer_channels/2 :
@@ -47,16 +64,161 @@ void BlasForwardPipe::InitWinograd() {
     weights_->winograd_initialized = true;
 }
 
+void BlasForwardPipe::CalibrateInt8() {
+    if (weights_ == nullptr || !weights_->int8) {
+        return;
+    }
+
+    const auto sgf_file = GetOption<std::string>("int8_calibration");
+    if (sgf_file.empty()) {
+        LOGGING << "There is no INT8 calibration file. Compute the scales per forwarding.\n";
+        return;
+    }
+
+    constexpr int kMaxCalibrationPositions = 1000;
+    const auto inputs = GetCalibrationInputs(sgf_file, kMaxCalibrationPositions);
+    if (inputs.empty()) {
+        LOGGING << "There is no position in the INT8 calibration file. Compute the scales per forwarding.\n";
+        return;
+    }
+
+    // Run the float tower and collect the maximum inputs of every
+    // INT8 convolution.
+    calibration_max_.clear();
+    calibrating_ = true;
+    Forward(inputs);
+    calibrating_ = false;
+
+    for (auto &it : calibration_max_) {
+        it.first->SetInt8InputScale(Int8Convolution::GetInputScale(it.second));
+    }
+    LOGGING << Format("Calibrated the INT8 scales with %zu positions.\n", inputs.size());
+}
+
+void BlasForwardPipe::ReplicateWeights() {
+    node_weights_.clear();
+    if (weights_ == nullptr || !numa_ || GetNumNumaNodes() <= 1) {
+        return;
+    }
+
+    // Every node reads its own copy. The node 0 keeps the original
+    // one. The copy is made on its node so that the pages are local.
+    node_weights_.emplace_back(weights_);
+    for (int n = 1; n < GetNumNumaNodes(); ++n) {
+        auto copy = std::shared_ptr<DNNWeights>{};
+        RunOnNumaNode(n, [this, &copy]() {
+            copy = std::make_shared<DNNWeights>(*weights_);
+        });
+        node_weights_.emplace_back(copy);
+    }
+    LOGGING << Format("Replicated the network weights on %d NUMA nodes.\n",
+                          (int)node_weights_.size());
+}
+
+DNNWeights *BlasForwardPipe::GetLocalWeights() {
+    if (node_weights_.empty()) {
+        return weights_.get();
+    }
+    return node_weights_[GetCurrentNumaNode() % node_weights_.size()].get();
+}
+
 void BlasForwardPipe::Load(std::shared_ptr<DNNWeights> weights) {
+    static std::atomic<std::uint64_t> num_generations{0};
+
     weights_ = weights;
+    node_weights_.clear();
+
+    // The workspaces depend on the network shape.
+    std::lock_guard<std::mutex> lock(workspace_mutex_);
+    workspaces_.clear();
+    generation_ = num_generations.fetch_add(1, std::memory_order_relaxed) + 1;
 }
 
-OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
+OutputResult BlasForwardPipe::Forward(const InputData &inpnt) {
+    OutputResult output;
+    ForwawrdEntry entry(inpnt, output);
+
+    if (workers_.empty()) {
+        // Compute the single input on the current thread.
+        auto entry_ptr = &entry;
+        BatchForward(&entry_ptr, 1);
+        return output;
+    }
+
+    std::unique_lock<std::mutex> lock(entry.mutex);
+    size_t queue_size;
+    {
+        // Push the entry.
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        entry_queue_.emplace_back(&entry);
+        queue_size = entry_queue_.size();
+    }
+
+    if (queue_size >= (size_t)max_batch_) {
+        cv_.notify_one(); // Wake up one worker if there are enough batch size.
+    }
+    // Wait for batch forwarding worker.
+    entry.cv.wait(lock, [&entry](){ return entry.done.load(std::memory_order_relaxed); });
+
+    return output;
+}
+
+std::vector<OutputResult> BlasForwardPipe::Forward(const std::vector<InputData> &inputs) {
+    const auto size = inputs.size();
+    auto outputs = std::vector<OutputResult>(size);
+    auto entries = std::vector<std::unique_ptr<ForwawrdEntry>>{};
+    auto batch = std::vector<ForwawrdEntry *>{};
+
+    for (auto i = size_t{0}; i < size; ++i) {
+        entries.emplace_back(std::make_unique<ForwawrdEntry>(inputs[i], outputs[i]));
+    }
+
+    // Compute the inputs with same board size as one batch.
+    for (auto head = size_t{0}; head < size;) {
+        const auto board_size = inputs[head].board_size;
+        auto tail = head;
+
+        batch.clear();
+        while (tail < size &&
+                   (int)(tail - head) < max_batch_ &&
+                   inputs[tail].board_size == board_size) {
+            batch.emplace_back(entries[tail++].get());
+        }
+        BatchForward(batch.data(), batch.size());
+        head = tail;
+    }
+    return outputs;
+}
+
+BlasForwardPipe::ForwardWorkspace &BlasForwardPipe::GetWorkspace(const int board_size) {
+    // The workspace of the pipe which current thread used last time.
+    // It only locks the pipe if the thread switches the pipe.
+    struct CachedWorkspace {
+        std::uint64_t generation{0};
+        ForwardWorkspace *workspace{nullptr};
+    };
+    thread_local CachedWorkspace cached;
+
+    if (cached.generation != generation_) {
+        std::lock_guard<std::mutex> lock(workspace_mutex_);
+        auto &owned = workspaces_[std::this_thread::get_id()];
+        if (!owned) {
+            owned = std::make_unique<ForwardWorkspace>();
+        }
+        cached.generation = generation_;
+        cached.workspace = owned.get();
+    }
+
+    auto &workspace = *cached.workspace;
+    if (workspace.board_size >= board_size) {
+        // The larger buffers also hold the smaller board.
+        return workspace;
+    }
 
     using Convolution3 = Convolution<3>;
 
     // Some useful information for network.
-    const auto board_size = inpnts.board_size;
+    const auto batch_size = max_batch_;
     const auto num_intersections = board_size * board_size;
     const auto output_channels = weights_->residual_channels;
     const auto max_channels = std::max({kInputChannels,
@@ -66,7 +228,12 @@ OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
     const auto plane_size = kInputChannels * num_intersections;
     const auto max_intermediates = std::max(weights_->policy_extract_channels,
                                                 weights_->value_extract_channels);
-    const auto zero_vec = std::vector<float>{};
+    auto max_se_size = 0;
+    for (const auto &residual : weights_->tower) {
+        if (residual.apply_se) {
+            max_se_size = std::max(max_se_size, residual.se_size);
+        }
+    }
 
     // Allocate the forward pipe buffers.
     bool use_winograd = weights_->winograd;
@@ -76,59 +243,178 @@ OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
     if (use_winograd) {
         workspace0_size =
             workspace1_size =
-            WinogradConvolution3::GetWorkspaceSize(board_size, max_channels);
+            WinogradConvolution3::GetWorkspaceSize(batch_size, board_size, max_channels);
     } else {
         workspace0_size =
-            Convolution3::GetWorkspaceSize(board_size, max_channels);
+            Convolution3::GetWorkspaceSize(batch_size, board_size, max_channels);
         workspace1_size = 1; // not used.
     }
+    if (weights_->int8) {
+        // The float tower is computed by im2col in the calibration.
+        workspace0_size = std::max(workspace0_size,
+            (int)Convolution3::GetWorkspaceSize(batch_size, board_size, max_channels));
+    }
 
-    auto workspace0 = std::vector<float>(workspace0_size);
-    auto workspace1 = std::vector<float>(workspace1_size);
+    // Release the old buffers before allocating the new ones.
+    workspace = ForwardWorkspace{};
+
+    workspace.workspace0.resize(workspace0_size);
+    workspace.workspace1.resize(workspace1_size);
+
+    workspace.conv_out.resize(batch_size * output_channels * num_intersections);
+    workspace.conv_in.resize(batch_size * output_channels * num_intersections);
+    workspace.res.resize(batch_size * output_channels * num_intersections);
+    workspace.intermediate.resize(batch_size * 3 * max_intermediates);
+    workspace.pooling.resize(batch_size * 3 * max_intermediates);
+    workspace.se_pooling.resize(batch_size * 3 * output_channels);
+    workspace.se_fc.resize(batch_size * max_se_size);
+    workspace.planes.resize(batch_size * plane_size);
+    workspace.policy_conv.resize(batch_size * weights_->policy_extract_channels * num_intersections);
+    workspace.value_conv.resize(batch_size * weights_->value_extract_channels * num_intersections);
+    if (weights_->int8) {
+        workspace.int8_col.resize(
+            Int8Convolution::GetWorkspaceSize(batch_size, board_size, 3, output_channels));
+    }
 
-    auto conv_out = std::vector<float>(output_channels * num_intersections);
-    auto conv_in = std::vector<float>(output_channels * num_intersections);
-    auto res = std::vector<float>(output_channels * num_intersections);
-    auto intermediate = std::vector<float>(3 * max_intermediates);
-    auto pooling = std::vector<float>(3 * max_intermediates);
+    // Allocate the output buffers.
+    workspace.output_prob.resize(batch_size * kOuputProbabilitiesChannels * num_intersections);
+    workspace.output_pass.resize(batch_size * kOuputPassProbability);
+    workspace.output_ownership.resize(batch_size * kOuputOwnershipChannels * num_intersections);
+    workspace.output_misc.resize(batch_size * kOuputValueMisc);
 
-    // Copy input plane to buffer.
-    auto planes = std::vector<float>(plane_size);
-    std::copy(std::begin(inpnts.planes),
-                  std::begin(inpnts.planes) + plane_size,
-                  std::begin(planes));
+    workspace.board_size = board_size;
 
-    // Allocate the output buffers.
-    auto output_prob = std::vector<float>(kOuputProbabilitiesChannels * num_intersections);
-    auto output_pass = std::vector<float>(kOuputPassProbability);
-    auto output_ownership = std::vector<float>(kOuputOwnershipChannels * num_intersections);
-    auto output_misc = std::vector<float>(kOuputValueMisc);
+    // Report it by the cache stats. Do not log it here. It may be on
+    // the search thread.
+    AccumulateWorkspaceAllocation();
+
+    return workspace;
+}
+
+void BlasForwardPipe::BatchForward(ForwawrdEntry **entries, const int batch_size) {
+
+    using Convolution3 = Convolution<3>;
+
+    AccumulateBatch(batch_size, max_batch_);
+
+    // The copy on the NUMA node of current thread.
+    const auto weights = GetLocalWeights();
+
+    // Some useful information for network.
+    const auto board_size = entries[0]->input.board_size;
+    const auto num_intersections = board_size * board_size;
+    const auto output_channels = weights->residual_channels;
+    const auto zero_vec = std::vector<float>{};
+    const bool use_winograd = weights->winograd;
+
+    // The buffers are reused by the following forwarding.
+    auto &workspace = GetWorkspace(board_size);
+
+    auto &workspace0 = workspace.workspace0;
+    auto &workspace1 = workspace.workspace1;
+
+    auto &conv_out = workspace.conv_out;
+    auto &conv_in = workspace.conv_in;
+    auto &res = workspace.res;
+    auto &intermediate = workspace.intermediate;
+    auto &pooling = workspace.pooling;
+
+    // The convolution of residual tower. The biases, residual and
+    // ReLU are fused into the convolution so that the outputs are
+    // written only once. The INT8 tower is computed by the float
+    // convolutions in the calibration so that it can collect the
+    // maximum inputs.
+    const bool use_int8 = weights->int8;
+    const auto TowerConvolution = [&](ConvLayer &conv,
+                                      const int in_channels,
+                                      const int out_channels,
+                                      std::vector<float> &input,
+                                      const std::vector<float> &residual,
+                                      bool relu,
+                                      std::vector<float> &output) {
+        const auto filter = conv.GetFilter();
+        if (use_int8 && !calibrating_) {
+            Int8Convolution::Forward(
+                batch_size, board_size, filter, in_channels, out_channels,
+                input,
+                conv.GetInt8Weights(),
+                conv.GetInt8Scales(),
+                conv.GetInt8InputScale(),
+                conv.GetBiases(), residual, relu,
+                workspace.int8_col, output);
+            return;
+        }
+        if (use_int8) {
+            const auto input_size = batch_size * in_channels * num_intersections;
+            auto &max_value = calibration_max_[&conv];
+            max_value = std::max(max_value,
+                                 *std::max_element(std::begin(input),
+                                                   std::begin(input) + input_size));
+        }
+
+        if (filter == 1) {
+            Convolution1::Forward(
+                batch_size, board_size, in_channels, out_channels,
+                input,
+                conv.GetWeights(),
+                conv.GetBiases(), residual, relu,
+                workspace0, output);
+        } else if (use_winograd && !use_int8) {
+            WinogradConvolution3::Forward(
+                batch_size, board_size, in_channels, out_channels,
+                input,
+                conv.GetWeights(),
+                conv.GetBiases(), residual, relu,
+                workspace0, workspace1, output);
+        } else {
+            Convolution3::Forward(
+                batch_size, board_size, in_channels, out_channels,
+                input,
+                conv.GetWeights(),
+                conv.GetBiases(), residual, relu,
+                workspace0, output);
+        }
+    };
+
+    // Copy input plane to buffer. The spatial planes in the forward
+    // pipe are [channels, batch, spatial] so that every convolution
+    // is computed by one matrix multiplication for the whole batch.
+    auto &planes = workspace.planes;
+    for (int c = 0; c < kInputChannels; ++c) {
+        for (int b = 0; b < batch_size; ++b) {
+            auto in_it = std::begin(entries[b]->input.planes) + c * num_intersections;
+            std::copy(in_it, in_it + num_intersections,
+                          std::begin(planes) + (c * batch_size + b) * num_intersections);
+        }
+    }
+
+    auto &output_prob = workspace.output_prob;
+    auto &output_pass = workspace.output_pass;
+    auto &output_ownership = workspace.output_ownership;
+    auto &output_misc = workspace.output_misc;
 
     // The input Layers.
     if (use_winograd) {
         WinogradConvolution3::Forward(
-            board_size, kInputChannels, output_channels,
+            batch_size, board_size, kInputChannels, output_channels,
             planes,
-            weights_->input_conv.GetWeights(),
+            weights->input_conv.GetWeights(),
+            weights->input_conv.GetBiases(), zero_vec, true,
             workspace0, workspace1, conv_out);
     } else {
         Convolution3::Forward(
-            board_size, kInputChannels, output_channels,
+            batch_size, board_size, kInputChannels, output_channels,
             planes,
-            weights_->input_conv.GetWeights(),
+            weights->input_conv.GetWeights(),
+            weights->input_conv.GetBiases(), zero_vec, true,
             workspace0, conv_out);
     }
 
-    AddSpatialBiases::Forward(
-        board_size, output_channels,
-        conv_out,
-        weights_->input_conv.GetBiases(), true);
-
     // The residual tower.
-    const auto residuals =  weights_->residual_blocks;
+    const auto residuals =  weights->residual_blocks;
     for (int i = 0; i < residuals; ++i) {
-        const auto tower_ptr = weights_->tower.data() + i;
-        const auto outer_channels = weights_->residual_channels;
+        const auto tower_ptr = weights->tower.data() + i;
+        const auto outer_channels = weights->residual_channels;
         const auto inner_channels = tower_ptr->apply_btl ?
                                         outer_channels/2 :
                                         outer_channels;
@@ -136,15 +422,10 @@ OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
             std::swap(conv_out, conv_in);
 
             // The pre-bottleneck conv1.
-            Convolution1::Forward(
-                board_size, outer_channels, inner_channels,
-                conv_in,
-                tower_ptr->pre_btl_conv.GetWeights(),
-                workspace0, conv_out);
-            AddSpatialBiases::Forward(
-                board_size, inner_channels,
-                conv_out,
-                tower_ptr->pre_btl_conv.GetBiases(), true);
+            TowerConvolution(
+                tower_ptr->pre_btl_conv,
+                outer_channels, inner_channels,
+                conv_in, zero_vec, true, conv_out);
 
             std::swap(conv_in, res);
         }
@@ -152,24 +433,10 @@ OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
         std::swap(conv_out, conv_in);
 
         // 1st conv3
-        if (use_winograd) {
-            WinogradConvolution3::Forward(
-                board_size, inner_channels, inner_channels,
-                conv_in,
-                tower_ptr->conv1.GetWeights(),
-                workspace0, workspace1, conv_out);
-        } else {
-            Convolution3::Forward(
-                board_size, inner_channels, inner_channels,
-                conv_in,
-                tower_ptr->conv1.GetWeights(),
-                workspace0, conv_out);
-        }
-
-        AddSpatialBiases::Forward(
-            board_size, inner_channels,
-            conv_out,
-            tower_ptr->conv1.GetBiases(), true);
+        TowerConvolution(
+            tower_ptr->conv1,
+            inner_channels, inner_channels,
+            conv_in, zero_vec, true, conv_out);
 
         if (!(tower_ptr->apply_btl)) {
             std::swap(conv_in, res);
@@ -177,193 +444,158 @@ OutputResult BlasForwardPipe::Forward(const InputData &inpnts) {
 
         std::swap(conv_out, conv_in);
 
-        // 2nd conv3
-        if (use_winograd) {
-            WinogradConvolution3::Forward(
-                board_size, inner_channels, inner_channels,
-                conv_in,
-                tower_ptr->conv2.GetWeights(),
-                workspace0, workspace1, conv_out);
-        } else {
-            Convolution3::Forward(
-                board_size, inner_channels, inner_channels,
-                conv_in,
-                tower_ptr->conv2.GetWeights(),
-                workspace0, conv_out);
-        }
+        // The last conv of the block adds the residual and applies
+        // ReLU unless the SE unit does them later.
+        auto &last_skip = tower_ptr->apply_se ? zero_vec : res;
+        bool last_relu = !(tower_ptr->apply_se);
 
+        // 2nd conv3
         if (tower_ptr->apply_btl) {
-            AddSpatialBiases::Forward(
-                board_size, inner_channels,
-                conv_out,
-                tower_ptr->conv2.GetBiases(), true);
+            TowerConvolution(
+                tower_ptr->conv2,
+                inner_channels, inner_channels,
+                conv_in, zero_vec, true, conv_out);
 
             std::swap(conv_out, conv_in);
 
             // The post-bottleneck conv1.
-            Convolution1::Forward(
-                board_size, inner_channels, outer_channels,
-                conv_in,
-                tower_ptr->post_btl_conv.GetWeights(),
-                workspace0, conv_out);
+            TowerConvolution(
+                tower_ptr->post_btl_conv,
+                inner_channels, outer_channels,
+                conv_in, last_skip, last_relu, conv_out);
+        } else {
+            TowerConvolution(
+                tower_ptr->conv2,
+                inner_channels, inner_channels,
+                conv_in, last_skip, last_relu, conv_out);
         }
 
-        auto &last_biases = tower_ptr->apply_btl ?
-                                tower_ptr->post_btl_conv.GetBiases() :
-                                tower_ptr->conv2.GetBiases();
-        auto &last_skip = tower_ptr->apply_se ? zero_vec : res;
-        bool last_relu = !(tower_ptr->apply_se);
-
-        AddSpatialBiases::Forward(
-            board_size, outer_channels,
-            conv_out,
-            last_biases,
-            last_skip, last_relu);
-
         // The SE process.
         if (tower_ptr->apply_se) {
             auto &se_skip = res;
 
             const size_t se_size = tower_ptr->se_size;
             SEUnit::Forward(
-                board_size, outer_channels, se_size,
+                batch_size, board_size, outer_channels, se_size,
                 conv_out, se_skip,
                 tower_ptr->squeeze.GetWeights(),
                 tower_ptr->squeeze.GetBiases(),
                 tower_ptr->excite.GetWeights(),
-                tower_ptr->excite.GetBiases(), true);
+                tower_ptr->excite.GetBiases(),
+                workspace.se_pooling, workspace.se_fc, true);
         }
     }
 
     // The policy head.
-    const auto policy_extract_channels = weights_->policy_extract_channels;
-    auto policy_conv = std::vector<float>(policy_extract_channels * num_intersections);
+    const auto policy_extract_channels = weights->policy_extract_channels;
+    auto &policy_conv = workspace.policy_conv;
 
     Convolution1::Forward(
-        board_size, output_channels, policy_extract_channels,
+        batch_size, board_size, output_channels, policy_extract_channels,
         conv_out,
-        weights_->p_ex_conv.GetWeights(),
+        weights->p_ex_conv.GetWeights(),
+        weights->p_ex_conv.GetBiases(), zero_vec, true,
         workspace0, policy_conv);
 
-    AddSpatialBiases::Forward(
-        board_size, policy_extract_channels,
-        policy_conv,
-        weights_->p_ex_conv.GetBiases(), true);
-
     GlobalPooling<false>::Forward(
-        board_size, policy_extract_channels,
+        batch_size, board_size, policy_extract_channels,
         policy_conv, pooling);
 
     FullyConnect::Forward(
-        3 * policy_extract_channels, policy_extract_channels,
+        batch_size, 3 * policy_extract_channels, policy_extract_channels,
         pooling,
-        weights_->p_inter_fc.GetWeights(),
-        weights_->p_inter_fc.GetBiases(),
+        weights->p_inter_fc.GetWeights(),
+        weights->p_inter_fc.GetBiases(),
         intermediate, true);
 
-    AddSpatialBiases::Forward(
-        board_size, policy_extract_channels,
+    AddBatchedSpatialBiases::Forward(
+        batch_size, board_size, policy_extract_channels,
         policy_conv,
         intermediate, false);
 
     // The policy outs.
     Convolution1::Forward(
-        board_size, policy_extract_channels, kOuputProbabilitiesChannels,
+        batch_size, board_size, policy_extract_channels, kOuputProbabilitiesChannels,
         policy_conv,
-        weights_->prob_conv.GetWeights(),
+        weights->prob_conv.GetWeights(),
+        weights->prob_conv.GetBiases(), zero_vec, false,
         workspace0, output_prob);
 
-    AddSpatialBiases::Forward(
-        board_size, kOuputProbabilitiesChannels,
-        output_prob,
-        weights_->prob_conv.GetBiases(), false);
-
     FullyConnect::Forward(
-        policy_extract_channels, kOuputPassProbability,
+        batch_size, policy_extract_channels, kOuputPassProbability,
         intermediate,
-        weights_->pass_fc.GetWeights(),
-        weights_->pass_fc.GetBiases(),
+        weights->pass_fc.GetWeights(),
+        weights->pass_fc.GetBiases(),
         output_pass, false);
 
     // The value head.
-    const auto value_extract_channels = weights_->value_extract_channels;
-    auto value_conv = std::vector<float>(value_extract_channels * num_intersections);
+    const auto value_extract_channels = weights->value_extract_channels;
+    auto &value_conv = workspace.value_conv;
 
     Convolution1::Forward(
-        board_size, output_channels, value_extract_channels,
+        batch_size, board_size, output_channels, value_extract_channels,
         conv_out,
-        weights_->v_ex_conv.GetWeights(),
+        weights->v_ex_conv.GetWeights(),
+        weights->v_ex_conv.GetBiases(), zero_vec, true,
         workspace0, value_conv);
 
-    AddSpatialBiases::Forward(
-        board_size, value_extract_channels,
-        value_conv,
-        weights_->v_ex_conv.GetBiases(), true);
-
     GlobalPooling<true>::Forward(
-        board_size, value_extract_channels,
+        batch_size, board_size, value_extract_channels,
         value_conv, pooling);
 
     FullyConnect::Forward(
-        3 * value_extract_channels, 3 * value_extract_channels,
+        batch_size, 3 * value_extract_channels, 3 * value_extract_channels,
         pooling,
-        weights_->v_inter_fc.GetWeights(),
-        weights_->v_inter_fc.GetBiases(),
+        weights->v_inter_fc.GetWeights(),
+        weights->v_inter_fc.GetBiases(),
         intermediate, true);
 
     // The value outs.
     Convolution1::Forward(
-        board_size, value_extract_channels, kOuputOwnershipChannels,
+        batch_size, board_size, value_extract_channels, kOuputOwnershipChannels,
         value_conv,
-        weights_->v_ownership.GetWeights(),
+        weights->v_ownership.GetWeights(),
+        weights->v_ownership.GetBiases(), zero_vec, false,
         workspace0, output_ownership);
 
-    AddSpatialBiases::Forward(
-        board_size, kOuputOwnershipChannels,
-        output_ownership,
-        weights_->v_ownership.GetBiases(), false);
-
     FullyConnect::Forward(
-        3 * value_extract_channels, kOuputValueMisc,
+        batch_size, 3 * value_extract_channels, kOuputValueMisc,
         intermediate,
-        weights_->v_misc.GetWeights(),
-        weights_->v_misc.GetBiases(),
+        weights->v_misc.GetWeights(),
+        weights->v_misc.GetBiases(),
         output_misc, false);
 
     // Now copy the result.
-    auto result = OutputResult{};
-
-    result.fp16 = false;
-    result.board_size = board_size;
-    result.komi = inpnts.komi;
-    result.wdl[0] = output_misc[0];
-    result.wdl[1] = output_misc[1];
-    result.wdl[2] = output_misc[2];
-    result.stm_winrate = output_misc[3];
-    result.final_score = output_misc[8];
-    result.q_error = output_misc[13];
-    result.score_error = output_misc[14];
-
-    result.pass_probability = output_pass[0];
-
-    auto pol_it = std::begin(output_prob);
-    if (!use_optimistic_policy_) {
+    for (int b = 0; b < batch_size; ++b) {
+        auto &result = entries[b]->output;
+        const auto misc_ptr = output_misc.data() + b * kOuputValueMisc;
+
+        result.fp16 = false;
+        result.board_size = board_size;
+        result.komi = entries[b]->input.komi;
+        result.wdl[0] = misc_ptr[0];
+        result.wdl[1] = misc_ptr[1];
+        result.wdl[2] = misc_ptr[2];
+        result.stm_winrate = misc_ptr[3];
+        result.final_score = misc_ptr[8];
+        result.q_error = misc_ptr[13];
+        result.score_error = misc_ptr[14];
+
+        result.pass_probability = output_pass[b * kOuputPassProbability];
+
+        const int prob_channel = use_optimistic_policy_ ? 4 : 0;
+        auto pol_it = std::begin(output_prob) +
+                          (prob_channel * batch_size + b) * num_intersections;
         std::copy(
             pol_it,
             pol_it + num_intersections,
             std::begin(result.probabilities));
-    } else {
-        pol_it += 4 * num_intersections;
-        std::copy(
-            pol_it,
-            pol_it + num_intersections,
-            std::begin(result.probabilities));
-    }
-    std::copy(std::begin(output_ownership),
-        std::begin(output_ownership) + num_intersections,
-        std::begin(result.ownership));
 
-    return result;
+        auto own_it = std::begin(output_ownership) + b * num_intersections;
+        std::copy(own_it,
+            own_it + num_intersections,
+            std::begin(result.ownership));
+    }
 }
 
 bool BlasForwardPipe::Valid() {
@@ -372,6 +604,166 @@ bool BlasForwardPipe::Valid() {
 
 void BlasForwardPipe::Release() {}
 
-void BlasForwardPipe::Destroy() {}
+void BlasForwardPipe::Destroy() {
+    QuitWorkers();
+}
 
 void BlasForwardPipe::Reload(int) {}
+
+void BlasForwardPipe::PrepareWorkers() {
+    if (max_batch_ <= 1) {
+        // There is no batch. Every search thread computes its
+        // own input.
+        return;
+    }
+    worker_running_.store(true);
+    if (workers_.empty()) {
+        // Prepare enough workers so that all search threads can be
+        // served at the same time. The BLAS library may be single
+        // threaded.
+        const int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+        const int threads = GetOption<int>("threads");
+        const int num_workers = std::min(
+            std::max((threads + max_batch_ - 1) / max_batch_, 1), cores);
+
+        for (int i = 0; i < num_workers; ++i) {
+            workers_.emplace_back([this](){ Worker(); });
+            if (numa_) {
+                // Spread the workers over the nodes like the search
+                // threads.
+                SetThreadAffinity(workers_.back(), AffinityMode::kNuma, i);
+            }
+        }
+    }
+}
+
+void BlasForwardPipe::Worker() {
+    const auto waittime_base = GetOption<int>("gpu_waittime");
+    waittime_.store(waittime_base, std::memory_order_relaxed);
+
+    const auto GatherBatches = [this, waittime_base](std::vector<ForwawrdEntry *> &entries){
+        const auto max_waittime = std::max(10 * waittime_base, 100);
+        entries.clear();
+
+        // Running the loop until there is enough entry size.
+        while(true) {
+            if (!worker_running_.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            bool should_be_fast = fast_pipe_.exchange(false, std::memory_order_relaxed);
+            int waittime = waittime_.load(std::memory_order_relaxed);
+
+            if ((int)entry_queue_.size() >= max_batch_) {
+                // Threre are enough batches. Finish the loop.
+                waittime_.store(
+                    std::min(waittime, waittime_base),
+                    std::memory_order_relaxed);
+                break;
+            }
+
+            // Wait for some time in order to avoid busy waiting.
+            std::unique_lock<std::mutex> lock(worker_mutex_);
+            bool timeout = !cv_.wait_for(lock, std::chrono::milliseconds(waittime),
+                                             [this](){ return !((int)entry_queue_.size() < max_batch_); }
+                                         );
+
+            // Reset the waiting time.
+            if (!entry_queue_.empty()) {
+                waittime = std::min(waittime, waittime_base);
+
+                if (timeout && should_be_fast) {
+                    // We wait two times and there are always not enough batches.
+                    // Simply assume threre still are not next time so set the
+                    // waiting time as zero.
+                    waittime = 0;
+                } else if (waittime > 0) {
+                    // Decrease the waiting time if it is time out.
+                    waittime -= 2;
+                }
+
+                // Set the next waiting time.
+                waittime_.store(std::max(waittime, 0), std::memory_order_relaxed);
+
+                // Finish the loop.
+                break;
+            } else {
+                if (waittime < waittime_base) {
+                    waittime_.store(waittime+1, std::memory_order_relaxed);
+                } else if (waittime < max_waittime) {
+                    waittime_.store(waittime+10, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Gather the entries.
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        auto count = entry_queue_.size();
+        if ((int)count > max_batch_) {
+            count = max_batch_;
+        }
+
+        auto end = std::begin(entry_queue_);
+        std::advance(end, count);
+        std::move(std::begin(entry_queue_), end, std::back_inserter(entries));
+        entry_queue_.erase(std::begin(entry_queue_), end);
+    };
+
+    // Reuse the entries buffer so that gathering does not allocate
+    // memory in steady state.
+    auto entries = std::vector<ForwawrdEntry *>{};
+    entries.reserve(max_batch_);
+
+    while (true) {
+        if (!worker_running_.load(std::memory_order_relaxed)) return;
+
+        GatherBatches(entries);
+        const auto batch_size = entries.size();
+
+        if (batch_size == 0) {
+            continue;
+        }
+
+        // The inputs may come from the games with different board
+        // sizes. Compute each board size as its own batch.
+        std::stable_sort(std::begin(entries), std::end(entries),
+                             [](const auto &a, const auto &b) {
+                                 return a->input.board_size < b->input.board_size;
+                             });
+
+        for (auto head = size_t{0}; head < batch_size;) {
+            const auto board_size = entries[head]->input.board_size;
+            auto tail = head;
+
+            while (tail < batch_size &&
+                       entries[tail]->input.board_size == board_size) {
+                tail++;
+            }
+
+            BatchForward(entries.data() + head, tail - head);
+
+            for (auto b = head; b < tail; ++b) {
+                // The entry is owned by the waiting thread. Notify it
+                // with the lock held so that the entry is not released
+                // before we are done with it.
+                std::lock_guard<std::mutex> lock(entries[b]->mutex);
+                entries[b]->done.store(true, std::memory_order_relaxed);
+                entries[b]->cv.notify_one();
+            }
+            head = tail;
+        }
+
+        if ((int)batch_size <= max_batch_) {
+            fast_pipe_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+void BlasForwardPipe::QuitWorkers() {
+    worker_running_.store(false);
+    cv_.notify_all();
+    for (auto &t : workers_) {
+        t.join();
+    }
+    workers_.clear();
+}
@@ -1,6 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "neural/network_basic.h"
 #include "neural/description.h"
@@ -11,6 +18,10 @@ public:
 
     virtual OutputResult Forward(const InputData &inpnt);
 
+    // Compute all inputs on the current thread. It does not go through
+    // the batch forwarding workers.
+    virtual std::vector<OutputResult> Forward(const std::vector<InputData> &inputs);
+
     virtual bool Valid();
 
     virtual void Load(std::shared_ptr<DNNWeights> weights);
@@ -22,9 +33,106 @@ public:
     virtual void Destroy();
 
 private:
+    struct ForwawrdEntry {
+        std::atomic<bool> done{false};
+        const InputData &input;
+        OutputResult &output;
+
+        std::condition_variable cv;
+        std::mutex mutex;
+
+        ForwawrdEntry(const InputData &in,
+                      OutputResult &out) :
+                      input(in), output(out) {}
+    };
+
+    // The buffers of the forward pipe. Every thread has one per pipe.
+    // It only grows if the board is larger than the ever seen ones, so
+    // the forwarding does not allocate any memory in steady state, even
+    // if the board sizes are mixed.
+    struct ForwardWorkspace {
+        int board_size{0}; // The largest board size it could hold.
+
+        std::vector<float> workspace0;
+        std::vector<float> workspace1;
+
+        std::vector<float> conv_out;
+        std::vector<float> conv_in;
+        std::vector<float> res;
+        std::vector<float> intermediate;
+        std::vector<float> pooling;
+        std::vector<float> se_pooling;
+        std::vector<float> se_fc;
+        std::vector<float> planes;
+        std::vector<float> policy_conv;
+        std::vector<float> value_conv;
+        std::vector<std::uint8_t> int8_col;
+
+        std::vector<float> output_prob;
+        std::vector<float> output_pass;
+        std::vector<float> output_ownership;
+        std::vector<float> output_misc;
+    };
+
     void InitWinograd();
 
+    // Compute the INT8 input scales from the positions of calibration
+    // SGF file. The scales are computed per forwarding if there is no
+    // calibration file.
+    void CalibrateInt8();
+
+    ForwardWorkspace &GetWorkspace(const int board_size);
+
+    // Copy the weights to every NUMA node in the NUMA mode.
+    void ReplicateWeights();
+
+    // Return the weights on the NUMA node of current thread.
+    DNNWeights *GetLocalWeights();
+
+    // Compute the whole batch at once. All inputs must have the
+    // same board size.
+    void BatchForward(ForwawrdEntry **entries, const int batch_size);
+
     bool use_optimistic_policy_;
 
     std::shared_ptr<DNNWeights> weights_{nullptr};
+
+    // The copies of weights for every NUMA node. It is empty if the
+    // NUMA mode is off.
+    bool numa_{false};
+    std::vector<std::shared_ptr<DNNWeights>> node_weights_;
+
+    // The batch forwarding workers. They are only used if the batch
+    // size is greater than one.
+    std::vector<ForwawrdEntry *> entry_queue_;
+    std::mutex worker_mutex_;
+    std::mutex queue_mutex_;
+
+    std::condition_variable cv_;
+
+    std::atomic<int> waittime_{0};
+    std::atomic<bool> worker_running_{false};
+    std::atomic<bool> fast_pipe_{false};
+
+    std::vector<std::thread> workers_;
+
+    int max_batch_{1};
+
+    // The maximum input values of INT8 convolutions. They are only
+    // collected in the calibration.
+    bool calibrating_{false};
+    std::unordered_map<ConvLayer *, float> calibration_max_;
+
+    // The workspaces of all threads. They are owned by the pipe and
+    // released with it. The generation is unique for every loaded
+    // weights, so the workspace cached by a thread never matches the
+    // released pipe or the old network shape.
+    std::uint64_t generation_{0};
+    std::mutex workspace_mutex_;
+    std::unordered_map<std::thread::id,
+                       std::unique_ptr<ForwardWorkspace>> workspaces_;
+
+    void PrepareWorkers();
+    void Worker();
+    void QuitWorkers();
 };
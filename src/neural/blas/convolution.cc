@@ -1,6 +1,7 @@
 #include "neural/blas/convolution.h"
 
-void Convolution1::Forward(const size_t board_size,
+void Convolution1::Forward(const size_t batch_size,
+                           const size_t board_size,
                            const size_t input_channels,
                            const size_t output_channels,
                            const std::vector<float> &input,
@@ -10,16 +11,53 @@ void Convolution1::Forward(const size_t board_size,
     const unsigned int width = board_size;
     const unsigned int height = board_size;
     const unsigned int spatial_size = width * height;
+    const unsigned int batch_spatial_size = batch_size * spatial_size;
 
     Blas::ConvolutionSgemm((int)output_channels,
-                           (int)spatial_size,
+                           (int)batch_spatial_size,
                            (int)input_channels,
                            1.0f,
                            weights.data(),
                            (int)input_channels,
                            input.data(),
-                           (int)spatial_size,
+                           (int)batch_spatial_size,
                            0.0f,
                            output.data(),
-                           (int)spatial_size);
+                           (int)batch_spatial_size);
+}
+
+void Convolution1::Forward(const size_t batch_size,
+                           const size_t board_size,
+                           const size_t input_channels,
+                           const size_t output_channels,
+                           const std::vector<float> &input,
+                           const std::vector<float> &weights,
+                           const std::vector<float> &biases,
+                           const std::vector<float> &residual,
+                           bool ReLU,
+                           std::vector<float> &/* col */,
+                           std::vector<float> &output) {
+    const unsigned int width = board_size;
+    const unsigned int height = board_size;
+    const unsigned int spatial_size = width * height;
+    const unsigned int batch_spatial_size = batch_size * spatial_size;
+
+    auto epilogue = SgemmEpilogue{};
+    epilogue.biases = biases.empty() ? nullptr : biases.data();
+    epilogue.residual = residual.empty() ? nullptr : residual.data();
+    epilogue.ldr = (int)batch_spatial_size;
+    epilogue.relu = ReLU;
+
+    Blas::ConvolutionSgemm((int)output_channels,
+                           (int)batch_spatial_size,
+                           (int)input_channels,
+                           1.0f,
+                           weights.data(),
+                           (int)input_channels,
+                           input.data(),
+                           (int)batch_spatial_size,
+                           0.0f,
+                           output.data(),
+                           (int)batch_spatial_size,
+                           epilogue);
 }
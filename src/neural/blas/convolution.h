@@ -8,13 +8,28 @@
 class Convolution1 {
 public:
     Convolution1() = delete;
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
                         const std::vector<float> &weights,
                         std::vector<float> &col,
                         std::vector<float> &output);
+
+    // Same as above but the biases, residual and ReLU are fused into
+    // the matrix multiplication. The residual may be empty.
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float> &input,
+                        const std::vector<float> &weights,
+                        const std::vector<float> &biases,
+                        const std::vector<float> &residual,
+                        bool ReLU,
+                        std::vector<float> &col,
+                        std::vector<float> &output);
 };
 
 
@@ -22,25 +37,44 @@ template<unsigned int FILTERS>
 class Convolution {
 public:
     Convolution() = delete;
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float> &input,
+                        const std::vector<float> &weights,
+                        std::vector<float> &col,
+                        std::vector<float> &output);
+
+    // Same as above but the biases, residual and ReLU are fused into
+    // the matrix multiplication. The residual may be empty.
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float> &input,
                         const std::vector<float> &weights,
+                        const std::vector<float> &biases,
+                        const std::vector<float> &residual,
+                        bool ReLU,
                         std::vector<float> &col,
                         std::vector<float> &output);
 
-    static size_t GetWorkspaceSize(const size_t board_size, const size_t input_channels);
+    static size_t GetWorkspaceSize(const size_t batch_size,
+                                   const size_t board_size,
+                                   const size_t input_channels);
 
 private:
-    static void Im2col(const size_t board_size,
+    static void Im2col(const size_t batch_size,
+                       const size_t board_size,
                        const int channels,
                        const std::vector<float> &input,
                        std::vector<float> &col);
 };
 
 template<unsigned int FILTERS>
-void Convolution<FILTERS>::Forward(const size_t board_size,
+void Convolution<FILTERS>::Forward(const size_t batch_size,
+                                   const size_t board_size,
                                    const size_t input_channels,
                                    const size_t output_channels,
                                    const std::vector<float> &input,
@@ -51,6 +85,7 @@ void Convolution<FILTERS>::Forward(const size_t board_size,
     const unsigned int width = board_size;
     const unsigned int height = board_size;
     const unsigned int spatial_size = width * height;
+    const unsigned int batch_spatial_size = batch_size * spatial_size;
 
     constexpr int filter_len = filter_size * filter_size;
     const int filter_dim = filter_len * input_channels;
@@ -59,6 +94,10 @@ void Convolution<FILTERS>::Forward(const size_t board_size,
     // 96 18 3 3
     // C←αAB + βC
     // outputs[96,19x19] = weights[96,18x3x3] x col[18x3x3,19x19]
+    //
+    // The batched planes are stored as [channels, batch, spatial] so
+    // the whole batch is computed by one wider matrix multiplication.
+    // outputs[96,Bx19x19] = weights[96,18x3x3] x col[18x3x3,Bx19x19]
     // M Number of rows in matrices A and C.
     // N Number of columns in matrices B and C.
     // K Number of columns in matrix A; number of rows in matrix B.
@@ -67,22 +106,63 @@ void Convolution<FILTERS>::Forward(const size_t board_size,
     //    cblas_sgemm(CblasRowMajor, TransA, TransB, M, N, K, alpha, A, lda, B,
     //                ldb, beta, C, N);
 
-    Im2col(board_size, input_channels, input, col);
+    Im2col(batch_size, board_size, input_channels, input, col);
     Blas::ConvolutionSgemm((int)output_channels,
-                           (int)spatial_size,
+                           (int)batch_spatial_size,
                            filter_dim,
                            1.0f,
                            weights.data(),
                            filter_dim,
                            col.data(),
-                           (int)spatial_size,
+                           (int)batch_spatial_size,
                            0.0f,
                            output.data(),
-                           (int)spatial_size);
+                           (int)batch_spatial_size);
 }
 
 template<unsigned int FILTERS>
-void Convolution<FILTERS>::Im2col(const size_t board_size,
+void Convolution<FILTERS>::Forward(const size_t batch_size,
+                                   const size_t board_size,
+                                   const size_t input_channels,
+                                   const size_t output_channels,
+                                   const std::vector<float> &input,
+                                   const std::vector<float> &weights,
+                                   const std::vector<float> &biases,
+                                   const std::vector<float> &residual,
+                                   bool ReLU,
+                                   std::vector<float> &col,
+                                   std::vector<float> &output) {
+    constexpr unsigned int filter_size = FILTERS;
+    const unsigned int spatial_size = board_size * board_size;
+    const unsigned int batch_spatial_size = batch_size * spatial_size;
+
+    constexpr int filter_len = filter_size * filter_size;
+    const int filter_dim = filter_len * input_channels;
+
+    auto epilogue = SgemmEpilogue{};
+    epilogue.biases = biases.empty() ? nullptr : biases.data();
+    epilogue.residual = residual.empty() ? nullptr : residual.data();
+    epilogue.ldr = (int)batch_spatial_size;
+    epilogue.relu = ReLU;
+
+    Im2col(batch_size, board_size, input_channels, input, col);
+    Blas::ConvolutionSgemm((int)output_channels,
+                           (int)batch_spatial_size,
+                           filter_dim,
+                           1.0f,
+                           weights.data(),
+                           filter_dim,
+                           col.data(),
+                           (int)batch_spatial_size,
+                           0.0f,
+                           output.data(),
+                           (int)batch_spatial_size,
+                           epilogue);
+}
+
+template<unsigned int FILTERS>
+void Convolution<FILTERS>::Im2col(const size_t batch_size,
+                                  const size_t board_size,
                                   const int channels,
                                   const std::vector<float> &input,
                                   std::vector<float> &output) {
@@ -98,27 +178,30 @@ void Convolution<FILTERS>::Im2col(const size_t board_size,
     const float *data_im = input.data();
     float *data_col = output.data();
 
-    for (int channel = channels; channel--; data_im += spatial_size) {
+    for (int channel = channels; channel--; data_im += batch_size * spatial_size) {
         for (unsigned int kernel_row = 0; kernel_row < filter_size; kernel_row++) {
             for (unsigned int kernel_col = 0; kernel_col < filter_size;  kernel_col++) {
-                int input_row = -pad + kernel_row;
-                for (int output_rows = output_h; output_rows; output_rows--) {
-                    if (unsigned(input_row) < height) {
-                        int input_col = -pad + kernel_col;
-                        for (int output_col = output_w; output_col; output_col--) {
-                            if (unsigned(input_col) < width) {
-                                *(data_col++) = data_im[input_row * width + input_col];
-                            } else {
+                for (auto b = size_t{0}; b < batch_size; ++b) {
+                    const float *batch_im = data_im + b * spatial_size;
+                    int input_row = -pad + kernel_row;
+                    for (int output_rows = output_h; output_rows; output_rows--) {
+                        if (unsigned(input_row) < height) {
+                            int input_col = -pad + kernel_col;
+                            for (int output_col = output_w; output_col; output_col--) {
+                                if (unsigned(input_col) < width) {
+                                    *(data_col++) = batch_im[input_row * width + input_col];
+                                } else {
+                                    *(data_col++) = 0;
+                                }
+                                input_col++;
+                            }
+                        } else {
+                            for (int output_cols = output_w; output_cols; output_cols--) {
                                 *(data_col++) = 0;
                             }
-                            input_col++;
-                        }
-                    } else {
-                        for (int output_cols = output_w; output_cols; output_cols--) {
-                            *(data_col++) = 0;
                         }
+                        input_row++;
                     }
-                    input_row++;
                 }
             }
         }
@@ -126,12 +209,14 @@ void Convolution<FILTERS>::Im2col(const size_t board_size,
 }
 
 template<unsigned int FILTERS>
-size_t Convolution<FILTERS>::GetWorkspaceSize(const size_t board_size, const size_t input_channels) {
+size_t Convolution<FILTERS>::GetWorkspaceSize(const size_t batch_size,
+                                               const size_t board_size,
+                                               const size_t input_channels) {
     const auto width = board_size;
     const auto height = board_size;
 
     constexpr auto filter_size = FILTERS;
     const auto filter_len = filter_size * filter_size;
     const auto filter_dim = filter_len * input_channels;
-    return filter_dim * width * height;
+    return filter_dim * batch_size * width * height;
 }
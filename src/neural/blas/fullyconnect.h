@@ -6,7 +6,8 @@
 class FullyConnect {
 public:
     FullyConnect() = delete;
-    static void Forward(const size_t inputs_size,
+    static void Forward(const size_t batch_size,
+                        const size_t inputs_size,
                         const size_t outputs_size,
                         const std::vector<float> &input,
                         const std::vector<float> &weights,
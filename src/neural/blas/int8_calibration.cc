@@ -0,0 +1,151 @@
+#include "neural/blas/int8_calibration.h"
+#include "neural/blas/blas_forward_pipe.h"
+#include "neural/blas/int8_convolution.h"
+#include "neural/encoder.h"
+#include "neural/loader.h"
+#include "game/sgf.h"
+#include "game/iterator.h"
+#include "utils/log.h"
+#include "utils/format.h"
+#include "utils/option.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sstream>
+
+std::vector<InputData> GetCalibrationInputs(const std::string &sgf_file,
+                                            const int max_positions) {
+    // Skip some positions so that the samples come from more games.
+    constexpr int kSampleInterval = 3;
+
+    auto inputs = std::vector<InputData>{};
+    const auto sgfs = SgfParser::Get().ChopAll(sgf_file);
+
+    for (const auto &sgf : sgfs) {
+        if ((int)inputs.size() >= max_positions) {
+            break;
+        }
+
+        GameState state;
+        try {
+            state = Sgf::Get().FromString(sgf, 9999);
+        } catch (const char *err) {
+            LOGGING << "Fail to load the SGF file! Discard it." << std::endl
+                        << Format("\tCause: %s.", err) << std::endl;
+            continue;
+        }
+
+        auto game_ite = GameStateIterator(state);
+        int i = 0;
+        do {
+            if (i++ % kSampleInterval != 0) {
+                continue;
+            }
+            inputs.emplace_back(Encoder::Get().GetInputs(game_ite.GetState()));
+        } while (game_ite.Next() && (int)inputs.size() < max_positions);
+    }
+    return inputs;
+}
+
+std::string ReportInt8Accuracy(const std::string &weights_file,
+                               const std::string &sgf_file,
+                               const int max_positions) {
+    const auto inputs = GetCalibrationInputs(sgf_file, max_positions);
+    if (inputs.empty()) {
+        return "There is no position in the SGF file.";
+    }
+
+    auto fp32_weights = std::make_shared<DNNWeights>();
+    DNNLoder::Get().FromFile(fp32_weights, weights_file);
+    if (!fp32_weights->loaded) {
+        return "There is no network weights.";
+    }
+
+    // Both networks share the loaded weights. The float weights are
+    // kept after quantization.
+    auto int8_weights = std::make_shared<DNNWeights>(*fp32_weights);
+    if (!int8_weights->int8) {
+        DNNLoder::Get().QuantizeWeights(int8_weights);
+    }
+    fp32_weights->int8 = false;
+
+    auto fp32_pipe = std::make_unique<BlasForwardPipe>();
+    auto int8_pipe = std::make_unique<BlasForwardPipe>();
+    fp32_pipe->Initialize(fp32_weights);
+    int8_pipe->Initialize(int8_weights);
+
+    const auto Measure = [&inputs](BlasForwardPipe *pipe,
+                                   std::vector<OutputResult> &outputs) {
+        // Warm up so that the workspace is allocated.
+        const auto warmup = std::vector<InputData>(
+                                std::begin(inputs), std::begin(inputs) + 1);
+        pipe->Forward(warmup);
+
+        Timer timer;
+        timer.Clock();
+        outputs = pipe->Forward(inputs);
+        return std::max(timer.GetDuration(), 1e-6f);
+    };
+
+    auto fp32_outputs = std::vector<OutputResult>{};
+    auto int8_outputs = std::vector<OutputResult>{};
+    const auto fp32_elapsed = Measure(fp32_pipe.get(), fp32_outputs);
+    const auto int8_elapsed = Measure(int8_pipe.get(), int8_outputs);
+
+    fp32_pipe->Destroy();
+    int8_pipe->Destroy();
+
+    const auto GetBestPolicy = [](const OutputResult &result) {
+        const auto num_intersections = result.board_size * result.board_size;
+        const auto begin = std::begin(result.probabilities);
+        const auto best = std::max_element(begin, begin + num_intersections);
+        if (result.pass_probability > *best) {
+            return num_intersections; // pass
+        }
+        return (int)std::distance(begin, best);
+    };
+
+    const auto num_positions = (int)inputs.size();
+    int agreements = 0;
+    double winrate_mse = 0.0;
+    double score_mse = 0.0;
+
+    for (int i = 0; i < num_positions; ++i) {
+        const auto &fp32_result = fp32_outputs[i];
+        const auto &int8_result = int8_outputs[i];
+
+        if (GetBestPolicy(fp32_result) == GetBestPolicy(int8_result)) {
+            agreements += 1;
+        }
+
+        const auto fp32_winrate = (std::tanh(fp32_result.stm_winrate) + 1.0) / 2.0;
+        const auto int8_winrate = (std::tanh(int8_result.stm_winrate) + 1.0) / 2.0;
+        const auto fp32_score = 20.0 * fp32_result.final_score;
+        const auto int8_score = 20.0 * int8_result.final_score;
+
+        winrate_mse += (fp32_winrate - int8_winrate) * (fp32_winrate - int8_winrate);
+        score_mse += (fp32_score - int8_score) * (fp32_score - int8_score);
+    }
+    winrate_mse /= num_positions;
+    score_mse /= num_positions;
+
+    auto out = std::ostringstream{};
+    out << Format("kernel=%s, scales=%s, positions=%d, batch=%d\n",
+                      Int8Convolution::GetKernelName().c_str(),
+                      GetOption<std::string>("int8_calibration").empty() ?
+                          "dynamic" : "calibrated",
+                      num_positions,
+                      GetOption<int>("batch_size"));
+    out << Format("policy top-1 agreement: %.2f%%\n",
+                      100.0 * agreements / num_positions);
+    out << Format("winrate MSE: %.6f\n", winrate_mse);
+    out << Format("score MSE: %.4f\n", score_mse);
+    out << Format("fp32: %.2f pos/s, int8: %.2f pos/s, speedup: %.2fx",
+                      num_positions / fp32_elapsed,
+                      num_positions / int8_elapsed,
+                      fp32_elapsed / int8_elapsed);
+
+    return out.str();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "neural/network_basic.h"
+
+#include <string>
+#include <vector>
+
+// Collect the network inputs from the positions of SGF file. They are
+// used for calibrating the INT8 activation scales.
+std::vector<InputData> GetCalibrationInputs(const std::string &sgf_file,
+                                            const int max_positions);
+
+// Compare the INT8 network with the float network on the positions of
+// SGF file. Report the policy top-1 agreement, the value MSE and the
+// speed of both networks.
+std::string ReportInt8Accuracy(const std::string &weights_file,
+                               const std::string &sgf_file,
+                               const int max_positions);
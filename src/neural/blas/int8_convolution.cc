@@ -0,0 +1,470 @@
+#include "neural/blas/int8_convolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INT8_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The quantized weights are packed into the panels of 16 output
+// channels. Every channel in the panel keeps 4 consecutive depths so
+// that the kernels compute 4 products in one 32-bit lane.
+//     weights[channels / 16][depth / 4][16][4]
+//
+// The depth is ordered as [filter_size, filter_size, input_channels].
+// The input channels are padded to the multiple of 4. The inputs are
+// quantized to the padded [batch, height, width, input_channels] planes
+// so that the kernels read 4 input channels of one pixel at once.
+constexpr int kPanelWidth = 16;
+constexpr int kDepthGroup = 4;
+constexpr int kPanelGroupSize = kPanelWidth * kDepthGroup;
+
+int GetPaddedChannels(const int channels) {
+    return (channels + kDepthGroup - 1) / kDepthGroup * kDepthGroup;
+}
+
+int GetPaddedOutputs(const int channels) {
+    return (channels + kPanelWidth - 1) / kPanelWidth * kPanelWidth;
+}
+
+// The arguments of one output tile. The tile is kNP panels of output
+// channels for kMR pixels.
+struct TileArgs {
+    int taps;                       // filter_size * filter_size
+    int groups;                     // padded input channels / 4
+    const int *tap_offsets;         // offsets of filter taps in the input
+    const std::int8_t *weights[2];  // the panels of weights
+    const std::uint8_t *pixels[8];  // the input of top-left tap
+    const float *scales;            // the scales of first panel
+    float input_scale;
+    const float *biases;            // the biases of first panel, may be null
+    const float *residual;          // residual[channel, pixel], may be null
+    bool relu;
+    float *output;                  // output[channel, pixel]
+    int ldo;                        // the number of pixels
+    int channels;                   // valid channels in the tile
+    int mr;                         // valid pixels in the tile
+};
+
+// Scatter the [kMR, 16] float block of one panel to the channel major
+// output. The biases, residual and ReLU are applied here.
+inline void StorePanel(const float *buf, const TileArgs &args,
+                       const int panel, const int mr) {
+    const int first = panel * kPanelWidth;
+    const int last = std::min(args.channels, first + kPanelWidth);
+    for (int j = first; j < last; ++j) {
+        float *out = args.output + j * args.ldo;
+        const float *res = args.residual ?
+                               args.residual + j * args.ldo : nullptr;
+        const float bias = args.biases ? args.biases[j] : 0.0f;
+        for (int i = 0; i < mr; ++i) {
+            float val = buf[i * kPanelWidth + (j - first)] + bias;
+            if (res) {
+                val += res[i];
+            }
+            if (args.relu && val < 0.0f) {
+                val = 0.0f;
+            }
+            out[i] = val;
+        }
+    }
+}
+
+// The portable kernel.
+struct KernelGeneric {
+    static constexpr int kMR = 4;
+    static constexpr int kNP = 1;
+    static constexpr int kActivationMax = 255;
+
+    static void Compute(const TileArgs &args) {
+        float buf[kMR * kPanelWidth];
+        for (int i = 0; i < args.mr; ++i) {
+            for (int j = 0; j < kPanelWidth; ++j) {
+                std::int32_t sum = 0;
+                const std::int8_t *w_ptr = args.weights[0] + j * kDepthGroup;
+                for (int t = 0; t < args.taps; ++t) {
+                    const std::uint8_t *x_ptr = args.pixels[i] + args.tap_offsets[t];
+                    for (int g = 0; g < args.groups; ++g) {
+                        for (int r = 0; r < kDepthGroup; ++r) {
+                            sum += (std::int32_t)x_ptr[r] * (std::int32_t)w_ptr[r];
+                        }
+                        x_ptr += kDepthGroup;
+                        w_ptr += kPanelGroupSize;
+                    }
+                }
+                buf[i * kPanelWidth + j] = (float)sum * args.scales[j] * args.input_scale;
+            }
+        }
+        StorePanel(buf, args, 0, args.mr);
+    }
+};
+
+#ifdef INT8_X86_DISPATCH
+// The AVX2 kernel. There is no VNNI instruction so the products are
+// summed in 16-bit by vpmaddubsw. The activations are limited to 7 bits
+// to avoid the saturation.
+struct KernelAvx2 {
+    static constexpr int kMR = 4;
+    static constexpr int kNP = 1;
+    static constexpr int kActivationMax = 127;
+
+    __attribute__((target("avx2")))
+    static void Compute(const TileArgs &args) {
+        const __m256i ones = _mm256_set1_epi16(1);
+        __m256i acc[kMR][2];
+        for (int i = 0; i < kMR; ++i) {
+            acc[i][0] = _mm256_setzero_si256();
+            acc[i][1] = _mm256_setzero_si256();
+        }
+
+        const std::int8_t *w_ptr = args.weights[0];
+        for (int t = 0; t < args.taps; ++t) {
+            const int offset = args.tap_offsets[t];
+            for (int g = 0; g < args.groups; ++g) {
+                const __m256i w0 = _mm256_loadu_si256((const __m256i *)w_ptr);
+                const __m256i w1 = _mm256_loadu_si256((const __m256i *)(w_ptr + 32));
+                for (int i = 0; i < kMR; ++i) {
+                    std::int32_t x;
+                    std::memcpy(&x, args.pixels[i] + offset + g * kDepthGroup, sizeof(x));
+                    const __m256i x_val = _mm256_set1_epi32(x);
+                    const __m256i p0 = _mm256_madd_epi16(_mm256_maddubs_epi16(x_val, w0), ones);
+                    const __m256i p1 = _mm256_madd_epi16(_mm256_maddubs_epi16(x_val, w1), ones);
+                    acc[i][0] = _mm256_add_epi32(acc[i][0], p0);
+                    acc[i][1] = _mm256_add_epi32(acc[i][1], p1);
+                }
+                w_ptr += kPanelGroupSize;
+            }
+        }
+
+        const __m256 input_scale = _mm256_set1_ps(args.input_scale);
+        const __m256 s0 = _mm256_mul_ps(_mm256_loadu_ps(args.scales), input_scale);
+        const __m256 s1 = _mm256_mul_ps(_mm256_loadu_ps(args.scales + 8), input_scale);
+        alignas(32) float buf[kMR * kPanelWidth];
+        for (int i = 0; i < kMR; ++i) {
+            _mm256_store_ps(buf + i * kPanelWidth,
+                            _mm256_mul_ps(_mm256_cvtepi32_ps(acc[i][0]), s0));
+            _mm256_store_ps(buf + i * kPanelWidth + 8,
+                            _mm256_mul_ps(_mm256_cvtepi32_ps(acc[i][1]), s1));
+        }
+        StorePanel(buf, args, 0, args.mr);
+    }
+};
+
+// The AVX-512 VNNI kernel. It computes two panels for 8 pixels and
+// keeps 16 accumulators in the zmm registers.
+struct KernelAvx512Vnni {
+    static constexpr int kMR = 8;
+    static constexpr int kNP = 2;
+    static constexpr int kActivationMax = 255;
+
+    __attribute__((target("avx512f,avx512vnni")))
+    static void Compute(const TileArgs &args) {
+        __m512i acc[kMR][kNP];
+        for (int i = 0; i < kMR; ++i) {
+            acc[i][0] = _mm512_setzero_si512();
+            acc[i][1] = _mm512_setzero_si512();
+        }
+
+        const std::int8_t *w0_ptr = args.weights[0];
+        const std::int8_t *w1_ptr = args.weights[1];
+        for (int t = 0; t < args.taps; ++t) {
+            const int offset = args.tap_offsets[t];
+            for (int g = 0; g < args.groups; ++g) {
+                const __m512i w0 = _mm512_loadu_si512(w0_ptr);
+                const __m512i w1 = _mm512_loadu_si512(w1_ptr);
+                for (int i = 0; i < kMR; ++i) {
+                    std::int32_t x;
+                    std::memcpy(&x, args.pixels[i] + offset + g * kDepthGroup, sizeof(x));
+                    const __m512i x_val = _mm512_set1_epi32(x);
+                    acc[i][0] = _mm512_dpbusd_epi32(acc[i][0], x_val, w0);
+                    acc[i][1] = _mm512_dpbusd_epi32(acc[i][1], x_val, w1);
+                }
+                w0_ptr += kPanelGroupSize;
+                w1_ptr += kPanelGroupSize;
+            }
+        }
+
+        const __m512 input_scale = _mm512_set1_ps(args.input_scale);
+        alignas(64) float buf[kMR * kPanelWidth];
+        for (int p = 0; p < kNP; ++p) {
+            if (p * kPanelWidth >= args.channels) {
+                break;
+            }
+            const __m512 scale = _mm512_mul_ps(
+                _mm512_loadu_ps(args.scales + p * kPanelWidth), input_scale);
+            for (int i = 0; i < kMR; ++i) {
+                _mm512_store_ps(buf + i * kPanelWidth,
+                                _mm512_mul_ps(_mm512_cvtepi32_ps(acc[i][p]), scale));
+            }
+            StorePanel(buf, args, p, args.mr);
+        }
+    }
+};
+#endif
+
+// Compute all output tiles. The panels and pixels out of range are
+// clamped to the last one and they are not stored.
+template <typename Kernel>
+void ConvolutionDriver(const int batch_size,
+                       const int board_size,
+                       const int filter_size,
+                       const int input_channels,
+                       const int output_channels,
+                       const std::uint8_t *input,
+                       const std::int8_t *weights,
+                       const float *scales,
+                       const float input_scale,
+                       const float *biases,
+                       const float *residual,
+                       const bool relu,
+                       float *output) {
+    constexpr int kMR = Kernel::kMR;
+    constexpr int kNP = Kernel::kNP;
+
+    const int pad = filter_size / 2;
+    const int width = board_size;
+    const int spatial_size = board_size * board_size;
+    const int batch_spatial_size = batch_size * spatial_size;
+    const int padded_width = board_size + 2 * pad;
+    const int padded_channels = GetPaddedChannels(input_channels);
+    const int groups = padded_channels / kDepthGroup;
+    const int taps = filter_size * filter_size;
+    const int panel_size = taps * groups * kPanelGroupSize;
+    const int num_panels = GetPaddedOutputs(output_channels) / kPanelWidth;
+
+    int tap_offsets[9];
+    for (int ky = 0; ky < filter_size; ++ky) {
+        for (int kx = 0; kx < filter_size; ++kx) {
+            tap_offsets[ky * filter_size + kx] =
+                (ky * padded_width + kx) * padded_channels;
+        }
+    }
+
+    TileArgs args;
+    args.taps = taps;
+    args.groups = groups;
+    args.tap_offsets = tap_offsets;
+    args.input_scale = input_scale;
+    args.relu = relu;
+    args.ldo = batch_spatial_size;
+
+    for (int p = 0; p < num_panels; p += kNP) {
+        for (int q = 0; q < kNP; ++q) {
+            args.weights[q] = weights + std::min(p + q, num_panels - 1) * panel_size;
+        }
+        args.scales = scales + p * kPanelWidth;
+        args.biases = biases ? biases + p * kPanelWidth : nullptr;
+        args.channels = std::min(kNP * kPanelWidth, output_channels - p * kPanelWidth);
+
+        for (int n = 0; n < batch_spatial_size; n += kMR) {
+            args.mr = std::min(kMR, batch_spatial_size - n);
+            for (int i = 0; i < kMR; ++i) {
+                const int pixel = std::min(n + i, batch_spatial_size - 1);
+                const int b = pixel / spatial_size;
+                const int y = (pixel % spatial_size) / width;
+                const int x = (pixel % spatial_size) % width;
+                args.pixels[i] = input +
+                    ((b * padded_width + y) * padded_width + x) * padded_channels;
+            }
+            args.output = output + p * kPanelWidth * batch_spatial_size + n;
+            args.residual = residual ?
+                                residual + p * kPanelWidth * batch_spatial_size + n :
+                                nullptr;
+            Kernel::Compute(args);
+        }
+    }
+}
+
+enum class KernelType {
+    kGeneric,
+    kAvx2,
+    kAvx512Vnni
+};
+
+KernelType SelectKernel() {
+#ifdef INT8_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512vnni")) {
+        return KernelType::kAvx512Vnni;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelType::kAvx2;
+    }
+#endif
+    return KernelType::kGeneric;
+}
+
+const KernelType kSelectedKernel = SelectKernel();
+
+int GetActivationMax() {
+    switch (kSelectedKernel) {
+#ifdef INT8_X86_DISPATCH
+        case KernelType::kAvx512Vnni:
+            return KernelAvx512Vnni::kActivationMax;
+        case KernelType::kAvx2:
+            return KernelAvx2::kActivationMax;
+#endif
+        default:
+            break;
+    }
+    return KernelGeneric::kActivationMax;
+}
+
+} // namespace
+
+void Int8Convolution::Forward(const size_t batch_size,
+                              const size_t board_size,
+                              const size_t filter_size,
+                              const size_t input_channels,
+                              const size_t output_channels,
+                              const std::vector<float> &input,
+                              const std::vector<std::int8_t> &weights,
+                              const std::vector<float> &scales,
+                              const float input_scale,
+                              const std::vector<float> &biases,
+                              const std::vector<float> &residual,
+                              bool ReLU,
+                              std::vector<std::uint8_t> &workspace,
+                              std::vector<float> &output) {
+    const int spatial_size = board_size * board_size;
+    const int batch_spatial_size = batch_size * spatial_size;
+    const int input_size = input_channels * batch_spatial_size;
+    const int pad = filter_size / 2;
+    const int padded_width = board_size + 2 * pad;
+    const int padded_channels = GetPaddedChannels(input_channels);
+
+    // Quantize the input planes. The inputs are the outputs of ReLU.
+    auto scale = input_scale;
+    if (scale <= 0.0f) {
+        const auto max_value = *std::max_element(
+                                   std::begin(input),
+                                   std::begin(input) + input_size);
+        scale = GetInputScale(max_value);
+    }
+    const float inv_scale = 1.0f / scale;
+    const int activation_max = GetActivationMax();
+    const float *biases_ptr = biases.empty() ?
+                                  nullptr : biases.data();
+    const float *residual_ptr = residual.empty() ?
+                                    nullptr : residual.data();
+
+    // The [channels, batch, height, width] input is transposed to the
+    // padded [batch, height, width, channels] planes. The padding is
+    // zero.
+    std::uint8_t *data_im = workspace.data();
+    std::fill(data_im,
+              data_im + batch_size * padded_width * padded_width * padded_channels, 0);
+
+    for (int channel = 0; channel < (int)input_channels; ++channel) {
+        const float *channel_in = input.data() + channel * batch_spatial_size;
+        for (int b = 0; b < (int)batch_size; ++b) {
+            for (int y = 0; y < (int)board_size; ++y) {
+                std::uint8_t *row_im = data_im +
+                    ((b * padded_width + y + pad) * padded_width + pad) * padded_channels + channel;
+                for (int x = 0; x < (int)board_size; ++x) {
+                    const float val = std::max(*(channel_in++), 0.0f) * inv_scale + 0.5f;
+                    row_im[x * padded_channels] = std::min((int)val, activation_max);
+                }
+            }
+        }
+    }
+
+    switch (kSelectedKernel) {
+#ifdef INT8_X86_DISPATCH
+        case KernelType::kAvx512Vnni:
+            ConvolutionDriver<KernelAvx512Vnni>(
+                batch_size, board_size, filter_size, input_channels, output_channels,
+                data_im, weights.data(), scales.data(), scale,
+                biases_ptr, residual_ptr, ReLU, output.data());
+            break;
+        case KernelType::kAvx2:
+            ConvolutionDriver<KernelAvx2>(
+                batch_size, board_size, filter_size, input_channels, output_channels,
+                data_im, weights.data(), scales.data(), scale,
+                biases_ptr, residual_ptr, ReLU, output.data());
+            break;
+#endif
+        default:
+            ConvolutionDriver<KernelGeneric>(
+                batch_size, board_size, filter_size, input_channels, output_channels,
+                data_im, weights.data(), scales.data(), scale,
+                biases_ptr, residual_ptr, ReLU, output.data());
+            break;
+    }
+}
+
+size_t Int8Convolution::GetWorkspaceSize(const size_t batch_size,
+                                         const size_t board_size,
+                                         const size_t filter_size,
+                                         const size_t input_channels) {
+    const auto padded_width = board_size + 2 * (filter_size / 2);
+    return batch_size * padded_width * padded_width *
+               GetPaddedChannels(input_channels);
+}
+
+void Int8Convolution::QuantizeWeights(const size_t filter_size,
+                                      const size_t input_channels,
+                                      const size_t output_channels,
+                                      const std::vector<float> &weights,
+                                      std::vector<std::int8_t> &quantized,
+                                      std::vector<float> &scales) {
+    const int taps = filter_size * filter_size;
+    const int filter_dim = taps * input_channels;
+    const int padded_channels = GetPaddedChannels(input_channels);
+    const int padded_dim = taps * padded_channels;
+    const int padded_outputs = GetPaddedOutputs(output_channels);
+
+    quantized.assign(padded_outputs * padded_dim, 0);
+    scales.assign(padded_outputs, 0.0f);
+
+    for (int o = 0; o < (int)output_channels; ++o) {
+        const auto w_ptr = weights.data() + o * filter_dim;
+        auto max_value = 0.0f;
+        for (int k = 0; k < filter_dim; ++k) {
+            max_value = std::max(max_value, std::abs(w_ptr[k]));
+        }
+        if (max_value == 0.0f) {
+            continue;
+        }
+
+        const auto scale = max_value / 127.0f;
+        const auto panel_ptr = quantized.data() +
+                                   (o / kPanelWidth) * padded_dim * kPanelWidth +
+                                   (o % kPanelWidth) * kDepthGroup;
+        for (int c = 0; c < (int)input_channels; ++c) {
+            for (int t = 0; t < taps; ++t) {
+                const auto val = std::round(w_ptr[c * taps + t] / scale);
+                const int k = t * padded_channels + c;
+                panel_ptr[(k / kDepthGroup) * kPanelGroupSize + (k % kDepthGroup)] =
+                    (std::int8_t)std::max(-127.0f, std::min(val, 127.0f));
+            }
+        }
+        scales[o] = scale;
+    }
+}
+
+float Int8Convolution::GetInputScale(const float max_value) {
+    if (max_value <= 0.0f) {
+        // All inputs are zero. Any scale is fine.
+        return 1.0f;
+    }
+    return max_value / GetActivationMax();
+}
+
+std::string Int8Convolution::GetKernelName() {
+    switch (kSelectedKernel) {
+        case KernelType::kAvx512Vnni:
+            return "avx512-vnni";
+        case KernelType::kAvx2:
+            return "avx2";
+        default:
+            break;
+    }
+    return "generic";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// The INT8 convolution for the residual tower. The weights are
+// quantized per output channel symmetrically. The inputs of tower
+// are always the outputs of ReLU so they are quantized to unsigned
+// 8-bit integers with one scale for whole tensor. The accumulators
+// are 32-bit integers and the outputs are dequantized to float.
+class Int8Convolution {
+public:
+    Int8Convolution() = delete;
+
+    // The input scale is the float value of one quantized step. The
+    // input scale is computed from the input itself if it is zero.
+    // The biases, residual and ReLU are applied when the outputs are
+    // dequantized. The residual may be empty.
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
+                        const size_t filter_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float> &input,
+                        const std::vector<std::int8_t> &weights,
+                        const std::vector<float> &scales,
+                        const float input_scale,
+                        const std::vector<float> &biases,
+                        const std::vector<float> &residual,
+                        bool ReLU,
+                        std::vector<std::uint8_t> &workspace,
+                        std::vector<float> &output);
+
+    static size_t GetWorkspaceSize(const size_t batch_size,
+                                   const size_t board_size,
+                                   const size_t filter_size,
+                                   const size_t input_channels);
+
+    // Quantize the weights which shape is (output, input, filter_size,
+    // filter_size). The quantized weights and scales are packed and
+    // padded with zeros for the kernels.
+    static void QuantizeWeights(const size_t filter_size,
+                                const size_t input_channels,
+                                const size_t output_channels,
+                                const std::vector<float> &weights,
+                                std::vector<std::int8_t> &quantized,
+                                std::vector<float> &scales);
+
+    // Return the input scale for the given maximum absolute value.
+    static float GetInputScale(const float max_value);
+
+    // Return the name of selected kernel, e.g. "avx512-vnni".
+    static std::string GetKernelName();
+};
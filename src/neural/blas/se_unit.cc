@@ -6,7 +6,8 @@
 #include <cassert>
 
 template<>
-void GlobalPooling<false>::Forward(const size_t board_size,
+void GlobalPooling<false>::Forward(const size_t batch_size,
+                                   const size_t board_size,
                                    const size_t channels,
                                    const std::vector<float> &input,
                                    std::vector<float> &output) {
@@ -16,27 +17,33 @@ void GlobalPooling<false>::Forward(const size_t board_size,
     const float b_coeff = ((float)board_size - kAvgBSize) / 10.f;
     const float *input_ptr = input.data();
 
+    // The input is [channels, batch, spatial] and the output
+    // is [batch, 3 x channels].
     for (auto c = size_t{0}; c < channels; ++c) {
-        float sum = 0.0f;
-        float max = -5000.0f; // crazy negative value
-        for (auto b = size_t{0}; b < spatial_size; ++b) {
-            float val = *input_ptr;
+        for (auto n = size_t{0}; n < batch_size; ++n) {
+            float sum = 0.0f;
+            float max = -5000.0f; // crazy negative value
+            for (auto b = size_t{0}; b < spatial_size; ++b) {
+                float val = *input_ptr;
 
-            sum += val;
-            max = std::max(val, max);
+                sum += val;
+                max = std::max(val, max);
 
-            input_ptr++;
-        }
+                input_ptr++;
+            }
 
-        const float mean = sum / (float)spatial_size;
-        output[c + 0 * channels] = mean;
-        output[c + 1 * channels] = mean * b_coeff;
-        output[c + 2 * channels] = max;
+            const float mean = sum / (float)spatial_size;
+            float *output_ptr = output.data() + n * 3 * channels;
+            output_ptr[c + 0 * channels] = mean;
+            output_ptr[c + 1 * channels] = mean * b_coeff;
+            output_ptr[c + 2 * channels] = max;
+        }
     }
 }
 
 template<>
-void GlobalPooling<true>::Forward(const size_t board_size,
+void GlobalPooling<true>::Forward(const size_t batch_size,
+                                  const size_t board_size,
                                   const size_t channels,
                                   const std::vector<float> &input,
                                   std::vector<float> &output) {
@@ -50,23 +57,27 @@ void GlobalPooling<true>::Forward(const size_t board_size,
     const float b_coeff1 = b_diff * b_diff / 100.f - kBSizeVaraince;
 
     for (auto c = size_t{0}; c < channels; ++c) {
-        float sum = 0.0f;
-        for (auto b = size_t{0}; b < spatial_size; ++b) {
-            float val = *input_ptr;
+        for (auto n = size_t{0}; n < batch_size; ++n) {
+            float sum = 0.0f;
+            for (auto b = size_t{0}; b < spatial_size; ++b) {
+                float val = *input_ptr;
 
-            sum += val;
+                sum += val;
 
-            input_ptr++;
-        }
+                input_ptr++;
+            }
 
-        const float mean = sum / (float)spatial_size;
-        output[c + 0 * channels] = mean;
-        output[c + 1 * channels] = mean * b_coeff0;
-        output[c + 2 * channels] = mean * b_coeff1;
+            const float mean = sum / (float)spatial_size;
+            float *output_ptr = output.data() + n * 3 * channels;
+            output_ptr[c + 0 * channels] = mean;
+            output_ptr[c + 1 * channels] = mean * b_coeff0;
+            output_ptr[c + 2 * channels] = mean * b_coeff1;
+        }
     }
 }
 
-void SEUnit::Forward(const size_t board_size,
+void SEUnit::Forward(const size_t batch_size,
+                     const size_t board_size,
                      const size_t channels,
                      const size_t se_size,
                      std::vector<float> &input,
@@ -75,18 +86,22 @@ void SEUnit::Forward(const size_t board_size,
                      const std::vector<float> &weights_b1,
                      const std::vector<float> &weights_w2,
                      const std::vector<float> &weights_b2,
+                     std::vector<float> &pooling,
+                     std::vector<float> &fc_out,
                      bool ReLU) {
     using Pooling = GlobalPooling<false>;
-    auto pool = std::vector<float>(3 * channels);
-    auto fc_out = std::vector<float>(se_size);
 
-    Pooling::Forward(board_size, channels, input, pool);
-    FullyConnect::Forward(3*channels, se_size, pool, weights_w1, weights_b1, fc_out, true);
-    FullyConnect::Forward(se_size, 2*channels, fc_out, weights_w2, weights_b2, pool, false);
-    SEProcess(board_size, channels, input, residual, pool, ReLU);
+    // The pooling buffer is at least [batch, 3 x channels] and the fc_out
+    // buffer is at least [batch, se_size]. The pooling buffer is reused
+    // for the scale.
+    Pooling::Forward(batch_size, board_size, channels, input, pooling);
+    FullyConnect::Forward(batch_size, 3*channels, se_size, pooling, weights_w1, weights_b1, fc_out, true);
+    FullyConnect::Forward(batch_size, se_size, 2*channels, fc_out, weights_w2, weights_b2, pooling, false);
+    SEProcess(batch_size, board_size, channels, input, residual, pooling, ReLU);
 }
 
-void SEUnit::SEProcess(const size_t board_size,
+void SEUnit::SEProcess(const size_t batch_size,
+                       const size_t board_size,
                        const size_t channels,
                        std::vector<float> &input,
                        const std::vector<float> &residual,
@@ -104,27 +119,27 @@ void SEUnit::SEProcess(const size_t board_size,
         return 1.0f / (1.0f + std::exp(-val));
     };
 
-    auto gamma_ptr = scale.data();
-    auto beta_ptr = scale.data() + channels;
     auto input_ptr = input.data();
     const float *residual_ptr = residual.empty() ?
                                     nullptr : residual.data();
     for (auto c = size_t{0}; c < channels; ++c) {
-        const auto gamma = lambda_sigmoid(*gamma_ptr);
-        const auto beta = *beta_ptr;
-
-        gamma_ptr++;
-        beta_ptr++;
-
-        for (auto i = size_t{0}; i < spatial_size; ++i) {
-            float val = *input_ptr;
-            val = gamma * val + beta;
-            if (residual_ptr) {
-                val += *residual_ptr;
-                residual_ptr++;
+        for (auto n = size_t{0}; n < batch_size; ++n) {
+            // The scale is [batch, 2 x channels].
+            const auto gamma_ptr = scale.data() + n * 2 * channels;
+            const auto beta_ptr = gamma_ptr + channels;
+            const auto gamma = lambda_sigmoid(gamma_ptr[c]);
+            const auto beta = beta_ptr[c];
+
+            for (auto i = size_t{0}; i < spatial_size; ++i) {
+                float val = *input_ptr;
+                val = gamma * val + beta;
+                if (residual_ptr) {
+                    val += *residual_ptr;
+                    residual_ptr++;
+                }
+                *input_ptr = lambda_ReLU(val);
+                input_ptr++;
             }
-            *input_ptr = lambda_ReLU(val);
-            input_ptr++;
         }
     }
 }
@@ -7,7 +7,8 @@ template<bool kIsValueHead>
 class GlobalPooling {
 public:
     GlobalPooling() = delete;
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t channels,
                         const std::vector<float> &input,
                         std::vector<float> &output);
@@ -22,7 +23,8 @@ private:
 class SEUnit {
 public:
     SEUnit() = delete;
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t channels,
                         const size_t se_size,
                         std::vector<float> &input,
@@ -31,10 +33,13 @@ public:
                         const std::vector<float> &weights_b1,
                         const std::vector<float> &weights_w2,
                         const std::vector<float> &weights_b2,
+                        std::vector<float> &pooling,
+                        std::vector<float> &fc_out,
                         bool ReLU);
 
 private:
-    static void SEProcess(const size_t board_size,
+    static void SEProcess(const size_t batch_size,
+                          const size_t board_size,
                           const size_t channels,
                           std::vector<float> &input,
                           const std::vector<float> &residual,
@@ -1,5 +1,13 @@
 #include "neural/blas/sgemm.h"
 
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SGEMM_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 void sgemm_nn(int M, int N, int K, float alpha, const float *A, int lda,
               const float *B, int ldb, float *C, int ldc) {
     for (int i = 0; i < M; ++i) {
@@ -57,49 +65,570 @@ void sgemm_tt(int M, int N, int K, float alpha, const float *A, int lda,
         }                             \
     }
 
+namespace {
+
+inline float EpilogueValue(float val, const SgemmEpilogue &epilogue,
+                           int i, int j) {
+    if (epilogue.biases) {
+        val += epilogue.biases[i];
+    }
+    if (epilogue.residual) {
+        val += epilogue.residual[i * epilogue.ldr + j];
+    }
+    if (epilogue.relu && val < 0.0f) {
+        val = 0.0f;
+    }
+    return val;
+}
+
+// Write the MR x NR block of accumulators back to C. Only the
+// top-left mr x nr elements are valid. The C is not read if beta
+// is zero so that the uninitialized memory is safe. The epilogue
+// points to the tile and it is null if it is not the last block
+// of K.
+template <int MR, int NR>
+inline void StoreTile(const float *acc,
+                      float *C, int ldc,
+                      int mr, int nr,
+                      float alpha, float beta,
+                      const SgemmEpilogue *epilogue) {
+    for (int i = 0; i < mr; ++i) {
+        float *c_row = C + i * ldc;
+        const float *acc_row = acc + i * NR;
+        if (beta == 0.0f) {
+            for (int j = 0; j < nr; ++j) {
+                c_row[j] = alpha * acc_row[j];
+            }
+        } else {
+            for (int j = 0; j < nr; ++j) {
+                c_row[j] = alpha * acc_row[j] + beta * c_row[j];
+            }
+        }
+        if (epilogue) {
+            for (int j = 0; j < nr; ++j) {
+                c_row[j] = EpilogueValue(c_row[j], *epilogue, i, j);
+            }
+        }
+    }
+}
+
+// The portable micro-kernel. The compiler may still vectorize it.
+struct KernelGeneric {
+    static constexpr int kMR = 4;
+    static constexpr int kNR = 8;
+    static constexpr int kMC = 128;
+    static constexpr int kKC = 256;
+    static constexpr int kNC = 2048;
+
+    static void Compute(int kc, const float *a, const float *b,
+                        float *C, int ldc, int mr, int nr,
+                        float alpha, float beta,
+                        const SgemmEpilogue *epilogue) {
+        float acc[kMR * kNR] = {0.0f};
+        for (int k = 0; k < kc; ++k) {
+            for (int i = 0; i < kMR; ++i) {
+                const float a_val = a[i];
+                for (int j = 0; j < kNR; ++j) {
+                    acc[i * kNR + j] += a_val * b[j];
+                }
+            }
+            a += kMR;
+            b += kNR;
+        }
+        StoreTile<kMR, kNR>(acc, C, ldc, mr, nr, alpha, beta, epilogue);
+    }
+
+    static float Dot(int K, const float *x, const float *y) {
+        float sum = 0.0f;
+        for (int k = 0; k < K; ++k) {
+            sum += x[k] * y[k];
+        }
+        return sum;
+    }
+};
+
+#ifdef SGEMM_X86_DISPATCH
+// The 6x16 AVX2/FMA micro-kernel. It keeps 12 accumulators in
+// the ymm registers.
+struct KernelAvx2 {
+    static constexpr int kMR = 6;
+    static constexpr int kNR = 16;
+    static constexpr int kMC = 96;
+    static constexpr int kKC = 256;
+    static constexpr int kNC = 2048;
+
+    __attribute__((target("avx2,fma")))
+    static void Compute(int kc, const float *a, const float *b,
+                        float *C, int ldc, int mr, int nr,
+                        float alpha, float beta,
+                        const SgemmEpilogue *epilogue) {
+        __m256 acc[kMR][2];
+        for (int i = 0; i < kMR; ++i) {
+            acc[i][0] = _mm256_setzero_ps();
+            acc[i][1] = _mm256_setzero_ps();
+        }
+        for (int k = 0; k < kc; ++k) {
+            const __m256 b0 = _mm256_loadu_ps(b);
+            const __m256 b1 = _mm256_loadu_ps(b + 8);
+            for (int i = 0; i < kMR; ++i) {
+                const __m256 a_val = _mm256_broadcast_ss(a + i);
+                acc[i][0] = _mm256_fmadd_ps(a_val, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_ps(a_val, b1, acc[i][1]);
+            }
+            a += kMR;
+            b += kNR;
+        }
+
+        const __m256 alpha_v = _mm256_set1_ps(alpha);
+        if (mr == kMR && nr == kNR) {
+            const __m256 beta_v = _mm256_set1_ps(beta);
+            for (int i = 0; i < kMR; ++i) {
+                float *c_row = C + i * ldc;
+                __m256 c0 = _mm256_mul_ps(alpha_v, acc[i][0]);
+                __m256 c1 = _mm256_mul_ps(alpha_v, acc[i][1]);
+                if (beta != 0.0f) {
+                    c0 = _mm256_fmadd_ps(beta_v, _mm256_loadu_ps(c_row), c0);
+                    c1 = _mm256_fmadd_ps(beta_v, _mm256_loadu_ps(c_row + 8), c1);
+                }
+                if (epilogue) {
+                    if (epilogue->biases) {
+                        const __m256 bias = _mm256_broadcast_ss(epilogue->biases + i);
+                        c0 = _mm256_add_ps(c0, bias);
+                        c1 = _mm256_add_ps(c1, bias);
+                    }
+                    if (epilogue->residual) {
+                        const float *r_row = epilogue->residual + i * epilogue->ldr;
+                        c0 = _mm256_add_ps(c0, _mm256_loadu_ps(r_row));
+                        c1 = _mm256_add_ps(c1, _mm256_loadu_ps(r_row + 8));
+                    }
+                    if (epilogue->relu) {
+                        c0 = _mm256_max_ps(c0, _mm256_setzero_ps());
+                        c1 = _mm256_max_ps(c1, _mm256_setzero_ps());
+                    }
+                }
+                _mm256_storeu_ps(c_row, c0);
+                _mm256_storeu_ps(c_row + 8, c1);
+            }
+        } else {
+            alignas(32) float buf[kMR * kNR];
+            for (int i = 0; i < kMR; ++i) {
+                _mm256_store_ps(buf + i * kNR, acc[i][0]);
+                _mm256_store_ps(buf + i * kNR + 8, acc[i][1]);
+            }
+            StoreTile<kMR, kNR>(buf, C, ldc, mr, nr, alpha, beta, epilogue);
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    static float Dot(int K, const float *x, const float *y) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        int k = 0;
+        for (; k + 16 <= K; k += 16) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k),
+                                   _mm256_loadu_ps(y + k), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k + 8),
+                                   _mm256_loadu_ps(y + k + 8), sum1);
+        }
+        alignas(32) float buf[8];
+        _mm256_store_ps(buf, _mm256_add_ps(sum0, sum1));
+        float sum = buf[0] + buf[1] + buf[2] + buf[3] +
+                        buf[4] + buf[5] + buf[6] + buf[7];
+        for (; k < K; ++k) {
+            sum += x[k] * y[k];
+        }
+        return sum;
+    }
+};
+
+// The 8x32 AVX-512 micro-kernel. It keeps 16 accumulators in
+// the zmm registers.
+struct KernelAvx512 {
+    static constexpr int kMR = 8;
+    static constexpr int kNR = 32;
+    static constexpr int kMC = 128;
+    static constexpr int kKC = 256;
+    static constexpr int kNC = 2048;
+
+    __attribute__((target("avx512f")))
+    static void Compute(int kc, const float *a, const float *b,
+                        float *C, int ldc, int mr, int nr,
+                        float alpha, float beta,
+                        const SgemmEpilogue *epilogue) {
+        __m512 acc[kMR][2];
+        for (int i = 0; i < kMR; ++i) {
+            acc[i][0] = _mm512_setzero_ps();
+            acc[i][1] = _mm512_setzero_ps();
+        }
+        for (int k = 0; k < kc; ++k) {
+            const __m512 b0 = _mm512_loadu_ps(b);
+            const __m512 b1 = _mm512_loadu_ps(b + 16);
+            for (int i = 0; i < kMR; ++i) {
+                const __m512 a_val = _mm512_set1_ps(a[i]);
+                acc[i][0] = _mm512_fmadd_ps(a_val, b0, acc[i][0]);
+                acc[i][1] = _mm512_fmadd_ps(a_val, b1, acc[i][1]);
+            }
+            a += kMR;
+            b += kNR;
+        }
+
+        const __m512 alpha_v = _mm512_set1_ps(alpha);
+        if (mr == kMR && nr == kNR) {
+            const __m512 beta_v = _mm512_set1_ps(beta);
+            for (int i = 0; i < kMR; ++i) {
+                float *c_row = C + i * ldc;
+                __m512 c0 = _mm512_mul_ps(alpha_v, acc[i][0]);
+                __m512 c1 = _mm512_mul_ps(alpha_v, acc[i][1]);
+                if (beta != 0.0f) {
+                    c0 = _mm512_fmadd_ps(beta_v, _mm512_loadu_ps(c_row), c0);
+                    c1 = _mm512_fmadd_ps(beta_v, _mm512_loadu_ps(c_row + 16), c1);
+                }
+                if (epilogue) {
+                    if (epilogue->biases) {
+                        const __m512 bias = _mm512_set1_ps(epilogue->biases[i]);
+                        c0 = _mm512_add_ps(c0, bias);
+                        c1 = _mm512_add_ps(c1, bias);
+                    }
+                    if (epilogue->residual) {
+                        const float *r_row = epilogue->residual + i * epilogue->ldr;
+                        c0 = _mm512_add_ps(c0, _mm512_loadu_ps(r_row));
+                        c1 = _mm512_add_ps(c1, _mm512_loadu_ps(r_row + 16));
+                    }
+                    if (epilogue->relu) {
+                        c0 = _mm512_max_ps(c0, _mm512_setzero_ps());
+                        c1 = _mm512_max_ps(c1, _mm512_setzero_ps());
+                    }
+                }
+                _mm512_storeu_ps(c_row, c0);
+                _mm512_storeu_ps(c_row + 16, c1);
+            }
+        } else {
+            alignas(64) float buf[kMR * kNR];
+            for (int i = 0; i < kMR; ++i) {
+                _mm512_store_ps(buf + i * kNR, acc[i][0]);
+                _mm512_store_ps(buf + i * kNR + 16, acc[i][1]);
+            }
+            StoreTile<kMR, kNR>(buf, C, ldc, mr, nr, alpha, beta, epilogue);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static float Dot(int K, const float *x, const float *y) {
+        __m512 sum0 = _mm512_setzero_ps();
+        __m512 sum1 = _mm512_setzero_ps();
+        int k = 0;
+        for (; k + 32 <= K; k += 32) {
+            sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + k),
+                                   _mm512_loadu_ps(y + k), sum0);
+            sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + k + 16),
+                                   _mm512_loadu_ps(y + k + 16), sum1);
+        }
+        float sum = _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+        for (; k < K; ++k) {
+            sum += x[k] * y[k];
+        }
+        return sum;
+    }
+};
+#endif
+
+// Pack the mc x kc block of op(A) into the panels of MR rows. Each
+// panel is stored as [kc, MR]. The rows out of range are zero.
+template <bool TA, int MR>
+void PackA(int mc, int kc,
+           const float *A, int lda,
+           float *packed) {
+    for (int i = 0; i < mc; i += MR) {
+        const int mr = std::min(MR, mc - i);
+        for (int k = 0; k < kc; ++k) {
+            for (int r = 0; r < mr; ++r) {
+                packed[r] = TA ? A[k * lda + (i + r)] :
+                                 A[(i + r) * lda + k];
+            }
+            for (int r = mr; r < MR; ++r) {
+                packed[r] = 0.0f;
+            }
+            packed += MR;
+        }
+    }
+}
 
+// Pack the kc x nc block of op(B) into the panels of NR columns. Each
+// panel is stored as [kc, NR]. The columns out of range are zero.
+template <bool TB, int NR>
+void PackB(int kc, int nc,
+           const float *B, int ldb,
+           float *packed) {
+    for (int j = 0; j < nc; j += NR) {
+        const int nr = std::min(NR, nc - j);
+        for (int k = 0; k < kc; ++k) {
+            if (!TB && nr == NR) {
+                std::copy(B + k * ldb + j, B + k * ldb + j + NR, packed);
+            } else {
+                for (int c = 0; c < nr; ++c) {
+                    packed[c] = TB ? B[(j + c) * ldb + k] :
+                                     B[k * ldb + (j + c)];
+                }
+                for (int c = nr; c < NR; ++c) {
+                    packed[c] = 0.0f;
+                }
+            }
+            packed += NR;
+        }
+    }
+}
+
+template <typename Kernel, bool TA, bool TB>
+void GemmDriver(int M, int N, int K,
+                float alpha,
+                const float *A, int lda,
+                const float *B, int ldb,
+                float beta,
+                float *C, int ldc,
+                const SgemmEpilogue *epilogue) {
+    constexpr int kMR = Kernel::kMR;
+    constexpr int kNR = Kernel::kNR;
+    constexpr int kMC = Kernel::kMC;
+    constexpr int kKC = Kernel::kKC;
+    constexpr int kNC = Kernel::kNC;
+
+    if (!TA && TB && M < kMR) {
+        // The fully connected layer with a few batches. It is almost
+        // matrix-vector multiplication. Packing would cost more than
+        // the compute.
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < N; ++j) {
+                const float val = alpha * Kernel::Dot(K, A + i * lda, B + j * ldb);
+                float *c_ptr = C + i * ldc + j;
+                *c_ptr = beta == 0.0f ? val : val + beta * (*c_ptr);
+                if (epilogue) {
+                    *c_ptr = EpilogueValue(*c_ptr, *epilogue, i, j);
+                }
+            }
+        }
+        return;
+    }
+
+    // The packing buffers are reused by the following calls.
+    thread_local std::vector<float> packed_a;
+    thread_local std::vector<float> packed_b;
+
+    const int max_nc = std::min(kNC, (N + kNR - 1) / kNR * kNR);
+    const int max_mc = std::min(kMC, (M + kMR - 1) / kMR * kMR);
+    const int max_kc = std::min(kKC, K);
+    if ((int)packed_a.size() < max_mc * max_kc) {
+        packed_a.resize(max_mc * max_kc);
+    }
+    if ((int)packed_b.size() < max_kc * max_nc) {
+        packed_b.resize(max_kc * max_nc);
+    }
+
+    if (K == 0) {
+        for (int i = 0; i < M; ++i) {
+            for (int j = 0; j < N; ++j) {
+                C[i * ldc + j] = beta == 0.0f ? 0.0f : beta * C[i * ldc + j];
+            }
+        }
+        if (epilogue) {
+            ApplySgemmEpilogue(M, N, C, ldc, *epilogue);
+        }
+        return;
+    }
+
+    for (int jc = 0; jc < N; jc += kNC) {
+        const int nc = std::min(kNC, N - jc);
+
+        for (int pc = 0; pc < K; pc += kKC) {
+            const int kc = std::min(kKC, K - pc);
+
+            // Accumulate the following blocks of K. The epilogue is
+            // applied by the last block.
+            const float curr_beta = pc == 0 ? beta : 1.0f;
+            const bool last_block = pc + kc == K;
+
+            const float *B_block = TB ? B + jc * ldb + pc :
+                                        B + pc * ldb + jc;
+            PackB<TB, kNR>(kc, nc, B_block, ldb, packed_b.data());
+
+            for (int ic = 0; ic < M; ic += kMC) {
+                const int mc = std::min(kMC, M - ic);
+
+                const float *A_block = TA ? A + pc * lda + ic :
+                                            A + ic * lda + pc;
+                PackA<TA, kMR>(mc, kc, A_block, lda, packed_a.data());
+
+                for (int jr = 0; jr < nc; jr += kNR) {
+                    const int nr = std::min(kNR, nc - jr);
+                    const float *b_panel = packed_b.data() + jr * kc;
+
+                    for (int ir = 0; ir < mc; ir += kMR) {
+                        const int mr = std::min(kMR, mc - ir);
+                        const float *a_panel = packed_a.data() + ir * kc;
+
+                        SgemmEpilogue tile_epilogue;
+                        if (epilogue && last_block) {
+                            const int row = ic + ir;
+                            const int col = jc + jr;
+                            tile_epilogue = *epilogue;
+                            if (tile_epilogue.biases) {
+                                tile_epilogue.biases += row;
+                            }
+                            if (tile_epilogue.residual) {
+                                tile_epilogue.residual += row * epilogue->ldr + col;
+                            }
+                        }
+
+                        Kernel::Compute(kc, a_panel, b_panel,
+                                        C + (ic + ir) * ldc + (jc + jr), ldc,
+                                        mr, nr, alpha, curr_beta,
+                                        epilogue && last_block ?
+                                            &tile_epilogue : nullptr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+enum class KernelType {
+    kGeneric,
+    kAvx2,
+    kAvx512
+};
+
+KernelType SelectKernel() {
+#ifdef SGEMM_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return KernelType::kAvx512;
+    }
+    if (__builtin_cpu_supports("avx2") &&
+            __builtin_cpu_supports("fma")) {
+        return KernelType::kAvx2;
+    }
+#endif
+    return KernelType::kGeneric;
+}
+
+const KernelType kSelectedKernel = SelectKernel();
+
+template <bool TA, bool TB>
+void Gemm(int M, int N, int K,
+          float alpha,
+          const float *A, int lda,
+          const float *B, int ldb,
+          float beta,
+          float *C, int ldc,
+          const SgemmEpilogue *epilogue) {
+    switch (kSelectedKernel) {
+#ifdef SGEMM_X86_DISPATCH
+        case KernelType::kAvx512:
+            GemmDriver<KernelAvx512, TA, TB>(
+                M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+            break;
+        case KernelType::kAvx2:
+            GemmDriver<KernelAvx2, TA, TB>(
+                M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+            break;
+#endif
+        default:
+            GemmDriver<KernelGeneric, TA, TB>(
+                M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, epilogue);
+            break;
+    }
+}
+
+} // namespace
+
+void ApplySgemmEpilogue(int M, int N,
+                        float *C, int ldc,
+                        const SgemmEpilogue &epilogue) {
+    for (int i = 0; i < M; ++i) {
+        float *c_row = C + i * ldc;
+        for (int j = 0; j < N; ++j) {
+            c_row[j] = EpilogueValue(c_row[j], epilogue, i, j);
+        }
+    }
+}
+
+std::string GetSgemmKernelName() {
+    switch (kSelectedKernel) {
+        case KernelType::kAvx512:
+            return "avx512";
+        case KernelType::kAvx2:
+            return "avx2";
+        default:
+            break;
+    }
+    return "generic";
+}
+
+template <bool TA, bool TB>
+void Sgemm<TA, TB>::apply(int M, int N, int K,
+                          float alpha,
+                          const float *A, int lda,
+                          const float *B, int ldb,
+                          float beta,
+                          float *C, int ldc) {
+    Gemm<TA, TB>(M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, nullptr);
+}
+
+template <bool TA, bool TB>
+void Sgemm<TA, TB>::apply(int M, int N, int K,
+                          float alpha,
+                          const float *A, int lda,
+                          const float *B, int ldb,
+                          float beta,
+                          float *C, int ldc,
+                          const SgemmEpilogue &epilogue) {
+    Gemm<TA, TB>(M, N, K, alpha, A, lda, B, ldb, beta, C, ldc, &epilogue);
+}
 
 template <>
-void Sgemm<false, false>::apply(int M, int N, int K,
-                                float alpha,
-                                const float *A, int lda,
-                                const float *B, int ldb,
-                                float beta,
-                                float *C, int ldc) {
+void Sgemm<false, false>::apply_reference(int M, int N, int K,
+                                          float alpha,
+                                          const float *A, int lda,
+                                          const float *B, int ldb,
+                                          float beta,
+                                          float *C, int ldc) {
     INITIALIZE_SGEMM(M, N, beta);
     sgemm_nn(M, N, K, alpha, A, lda, B, ldb, C, ldc);
 }
 
 template <>
-void Sgemm<true, false>::apply(int M, int N, int K,
-                               float alpha,
-                               const float *A, int lda,
-                               const float *B, int ldb,
-                               float beta,
-                               float *C, int ldc) {
+void Sgemm<true, false>::apply_reference(int M, int N, int K,
+                                         float alpha,
+                                         const float *A, int lda,
+                                         const float *B, int ldb,
+                                         float beta,
+                                         float *C, int ldc) {
     INITIALIZE_SGEMM(M, N, beta);
     sgemm_tn(M, N, K, alpha, A, lda, B, ldb, C, ldc);
 }
 
 template <>
-void Sgemm<false, true>::apply(int M, int N, int K,
-                               float alpha,
-                               const float *A, int lda,
-                               const float *B, int ldb,
-                               float beta,
-                               float *C, int ldc) {
+void Sgemm<false, true>::apply_reference(int M, int N, int K,
+                                         float alpha,
+                                         const float *A, int lda,
+                                         const float *B, int ldb,
+                                         float beta,
+                                         float *C, int ldc) {
     INITIALIZE_SGEMM(M, N, beta);
     sgemm_nt(M, N, K, alpha, A, lda, B, ldb, C, ldc);
 }
 
 template <>
-void Sgemm<true, true>::apply(int M, int N, int K,
-                              float alpha,
-                              const float *A, int lda,
-                              const float *B, int ldb,
-                              float beta,
-                              float *C, int ldc) {
+void Sgemm<true, true>::apply_reference(int M, int N, int K,
+                                        float alpha,
+                                        const float *A, int lda,
+                                        const float *B, int ldb,
+                                        float beta,
+                                        float *C, int ldc) {
     INITIALIZE_SGEMM(M, N, beta);
     sgemm_tt(M, N, K, alpha, A, lda, B, ldb, C, ldc);
 }
 
+template class Sgemm<false, false>;
+template class Sgemm<true, false>;
+template class Sgemm<false, true>;
+template class Sgemm<true, true>;
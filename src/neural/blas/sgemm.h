@@ -1,5 +1,28 @@
 #pragma once
 
+#include <string>
+
+// The optional epilogue of the multiplication. It is applied when
+// the tile of C is written the last time so that the output is still
+// in the registers or L1 cache.
+//     C = ReLU(C + biases[i] + residual[i][j])
+// The biases has one value per row of C. The residual is row major
+// with the leading dimension ldr. Both of them are optional.
+struct SgemmEpilogue {
+    const float *biases{nullptr};
+    const float *residual{nullptr};
+    int ldr{0};
+    bool relu{false};
+};
+
+// The built-in matrix multiplication. All matrices are row major.
+//     C = alpha * op(A) * op(B) + beta * C
+//
+// The op(A) is A^T if TA is true. The op(B) is B^T if TB is true.
+// The matrices are packed into small panels and computed by a
+// register blocked micro-kernel. The kernel is selected at runtime.
+// The AVX-512 and AVX2/FMA kernels are used if the CPU supports them.
+// Otherwise it falls back to the portable kernel.
 template <bool TA, bool TB>
 class Sgemm {
 public:
@@ -9,4 +32,28 @@ public:
                       const float *B, int ldb,
                       float beta,
                       float *C, int ldc);
+
+    static void apply(int M, int N, int K,
+                      float alpha,
+                      const float *A, int lda,
+                      const float *B, int ldb,
+                      float beta,
+                      float *C, int ldc,
+                      const SgemmEpilogue &epilogue);
+
+    // The naive loops. Only for verifying and benchmarking.
+    static void apply_reference(int M, int N, int K,
+                                float alpha,
+                                const float *A, int lda,
+                                const float *B, int ldb,
+                                float beta,
+                                float *C, int ldc);
 };
+
+// Apply the epilogue to the M x N matrix C.
+void ApplySgemmEpilogue(int M, int N,
+                        float *C, int ldc,
+                        const SgemmEpilogue &epilogue);
+
+// Return the name of selected micro-kernel, e.g. "avx2".
+std::string GetSgemmKernelName();
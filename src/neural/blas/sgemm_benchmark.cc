@@ -0,0 +1,181 @@
+#include "neural/blas/sgemm_benchmark.h"
+#include "neural/blas/sgemm.h"
+#include "neural/blas/blas.h"
+#include "neural/winograd_helper.h"
+#include "utils/random.h"
+#include "utils/format.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+using SgemmFunction = void (*)(int, int, int, float,
+                               const float *, int,
+                               const float *, int,
+                               float, float *, int);
+
+struct SgemmShape {
+    std::string name;
+    bool trans_a;
+    bool trans_b;
+    int M, N, K;
+    int repeats; // The number of multiplications in one layer.
+};
+
+// Run the function until it takes enough time. Return the
+// GFLOPS of it.
+double MeasureGflops(const SgemmShape &shape,
+                     std::function<void()> func) {
+    constexpr float kMinSeconds = 0.2f;
+    constexpr int kMaxIterations = 10000;
+
+    func(); // warm up
+
+    Timer timer;
+    timer.Clock();
+
+    int iterations = 0;
+    float elapsed = 0.f;
+    while (elapsed < kMinSeconds && iterations < kMaxIterations) {
+        func();
+        iterations++;
+        elapsed = timer.GetDuration();
+    }
+    const double flops = 2.0 * shape.M * shape.N * shape.K *
+                             shape.repeats * iterations;
+    return flops / std::max(elapsed, 1e-6f) / 1e9;
+}
+
+std::string GetBackendName() {
+#if defined(USE_EIGEN)
+    return "eigen";
+#elif defined(USE_OPENBLAS)
+    return "openblas";
+#else
+    return "built-in";
+#endif
+}
+
+} // namespace
+
+std::string BenchmarkSgemm(const int channels,
+                           const int batch_size,
+                           const int board_size) {
+    const int spatial = board_size * board_size;
+    const int ptiles = GetWinogradP(board_size);
+
+    // The shapes are same as the BLAS forward pipe.
+    const auto shapes = std::vector<SgemmShape>{
+        {"conv3x3",  false, false, channels, batch_size * spatial, 9 * channels, 1},
+        {"winograd", true,  false, channels, batch_size * ptiles,  channels,     kWinogradTile},
+        {"conv1x1",  false, false, channels, batch_size * spatial, channels,     1},
+        {"dense",    false, true,  batch_size, channels,           3 * channels, 1}
+    };
+
+    auto out = std::ostringstream{};
+    out << Format("kernel=%s, backend=%s, channels=%d, batch=%d, board size=%d\n",
+                      GetSgemmKernelName().c_str(), GetBackendName().c_str(),
+                      channels, batch_size, board_size);
+    out << Format("%-10s %6s %6s %6s %10s %10s %10s %10s\n",
+                      "shape", "M", "N", "K",
+                      "built-in", "naive", "backend", "max-error");
+
+    auto &rng = Random<>::Get();
+    auto dist = std::uniform_real_distribution<float>(-1.f, 1.f);
+
+    for (const auto &shape : shapes) {
+        const int M = shape.M;
+        const int N = shape.N;
+        const int K = shape.K;
+        const int lda = shape.trans_a ? M : K;
+        const int ldb = shape.trans_b ? K : N;
+        const int ldc = N;
+        const int size_a = M * K * shape.repeats;
+        const int size_b = K * N * shape.repeats;
+        const int size_c = M * N * shape.repeats;
+
+        auto A = std::vector<float>(size_a);
+        auto B = std::vector<float>(size_b);
+        auto C = std::vector<float>(size_c);
+        auto C_ref = std::vector<float>(size_c);
+        for (auto &v : A) v = dist(rng);
+        for (auto &v : B) v = dist(rng);
+
+        const auto Run = [&](SgemmFunction sgemm, float *C_ptr) {
+            for (int r = 0; r < shape.repeats; ++r) {
+                sgemm(M, N, K, 1.0f,
+                      A.data() + r * M * K, lda,
+                      B.data() + r * K * N, ldb,
+                      0.0f, C_ptr + r * M * N, ldc);
+            }
+        };
+        const auto RunBuildIn = [&](float *C_ptr) {
+            if (shape.trans_a) {
+                Run(Sgemm<true, false>::apply, C_ptr);
+            } else if (shape.trans_b) {
+                Run(Sgemm<false, true>::apply, C_ptr);
+            } else {
+                Run(Sgemm<false, false>::apply, C_ptr);
+            }
+        };
+        const auto RunNaive = [&](float *C_ptr) {
+            if (shape.trans_a) {
+                Run(Sgemm<true, false>::apply_reference, C_ptr);
+            } else if (shape.trans_b) {
+                Run(Sgemm<false, true>::apply_reference, C_ptr);
+            } else {
+                Run(Sgemm<false, false>::apply_reference, C_ptr);
+            }
+        };
+        const auto RunBackend = [&](float *C_ptr) {
+            for (int r = 0; r < shape.repeats; ++r) {
+                if (shape.trans_a) {
+                    Blas::WinogradSgemm(r * M * K, r * K * N, r * M * N,
+                                        M, N, K, 1.0f,
+                                        A.data(), lda,
+                                        B.data(), ldb,
+                                        0.0f, C_ptr, ldc);
+                } else if (shape.trans_b) {
+                    Blas::DenseSgemm(K, N, M,
+                                     A.data() + r * M * K,
+                                     B.data() + r * K * N,
+                                     C_ptr + r * M * N);
+                } else {
+                    Blas::ConvolutionSgemm(M, N, K, 1.0f,
+                                           A.data() + r * M * K, lda,
+                                           B.data() + r * K * N, ldb,
+                                           0.0f, C_ptr + r * M * N, ldc);
+                }
+            }
+        };
+
+        // Verify the built-in kernel with the naive loops.
+        std::fill(std::begin(C_ref), std::end(C_ref), 0.0f);
+        RunNaive(C_ref.data());
+        RunBuildIn(C.data());
+        float max_error = 0.0f;
+        for (int i = 0; i < size_c; ++i) {
+            max_error = std::max(max_error, std::abs(C[i] - C_ref[i]));
+        }
+
+        const double buildin_gflops = MeasureGflops(
+            shape, [&](){ RunBuildIn(C.data()); });
+        const double naive_gflops = MeasureGflops(
+            shape, [&](){ RunNaive(C_ref.data()); });
+        const double backend_gflops = MeasureGflops(
+            shape, [&](){ RunBackend(C.data()); });
+
+        out << Format("%-10s %6d %6d %6d %10.2f %10.2f %10.2f %10.2e\n",
+                          shape.name.c_str(), M, N, K,
+                          buildin_gflops, naive_gflops,
+                          backend_gflops, max_error);
+    }
+    out << "(GFLOPS)";
+
+    return out.str();
+}
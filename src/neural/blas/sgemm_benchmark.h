@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// Measure the matrix multiplications which the BLAS forward pipe
+// issues for a network with the given residual channels. Compare the
+// built-in kernel with the naive loops and the linked BLAS backend,
+// e.g. Eigen. Return the report.
+std::string BenchmarkSgemm(const int channels,
+                           const int batch_size,
+                           const int board_size);
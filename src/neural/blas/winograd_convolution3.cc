@@ -1,30 +1,29 @@
 #include "neural/blas/winograd_convolution3.h"
 #include "neural/blas/blas.h"
 #include "neural/winograd_helper.h"
+#include "game/types.h"
 
-void ClearVector2D(std::vector<std::vector<float>> &vec2d) {
-    for (auto &v: vec2d) {
-        std::fill(std::begin(v), std::end(v), 0.f);
-    }
-}
+#include <algorithm>
+#include <array>
 
-void WinogradConvolution3::TransformIn(const int board_size,
+void WinogradConvolution3::TransformIn(const int batch_size,
+                                       const int board_size,
                                        const std::vector<float>& in,
                                        std::vector<float>& V, const int C) {
     const int W = board_size;
     const int H = board_size;
     const int WTILES = GetWinogradWTiles(board_size);
     const int P = GetWinogradP(board_size);
+    const int BP = batch_size * P;
 
     const auto Wpad = 2 + kWinogradM * WTILES;
     constexpr auto buffersize = 32;
 
-    // std::array<std::array<float, Wpad>, Wpad> in_pad{{{0.0f}}};
-    std::vector<std::vector<float>> in_pad;
-    in_pad.resize(Wpad);
-    for (auto &v: in_pad) {
-        v.resize(Wpad);
-    }
+    // The padded plane is on the stack. It is big enough for the
+    // largest board size.
+    constexpr auto kMaxWpad =
+        2 + kWinogradM * ((kBoardSize + kWinogradM - 1) / kWinogradM);
+    std::array<std::array<float, kMaxWpad>, kMaxWpad> in_pad;
 
     std::array<float, buffersize * kWinogradAlpha * kWinogradAlpha> buffer;
     auto buffer_offset = 0;
@@ -58,12 +57,19 @@ void WinogradConvolution3::TransformIn(const int board_size,
         o5 = i1 + i3 * (-5.0f / 2.0f) + i5;
     };
 
-    for (int ch = 0; ch < C; ch++) {
-        ClearVector2D(in_pad);
+    // The input is [C, batch, H, W]. The tiles of each batch are placed
+    // next to each other so that V is [36, C, batch x P].
+    for (int ch_b = 0; ch_b < C * batch_size; ch_b++) {
+        const int ch = ch_b / batch_size;
+        const int b = ch_b % batch_size;
+
+        for (int y = 0; y < Wpad; y++) {
+            std::fill(std::begin(in_pad[y]), std::begin(in_pad[y]) + Wpad, 0.f);
+        }
 
         for (int yin = 0; yin < H; yin++) {
             for (int xin = 0; xin < W; xin++) {
-                in_pad[yin + 1][xin + 1] = in[ch * (W * H) + yin * W + xin];
+                in_pad[yin + 1][xin + 1] = in[ch_b * (W * H) + yin * W + xin];
             }
         }
         for (int block_y = 0; block_y < WTILES; block_y++) {
@@ -116,17 +122,17 @@ void WinogradConvolution3::TransformIn(const int board_size,
                 MULTIPLY_B(5)
 
                 if (buffer_entries == 0) {
-                    buffer_offset = ch * P + block_y * WTILES + block_x;
+                    buffer_offset = ch * BP + b * P + block_y * WTILES + block_x;
                 }
                 buffer_entries++;
 
                 if (buffer_entries >= buffersize
-                    || (ch == C - 1 && block_x == WTILES - 1
-                        && block_y == WTILES - 1)) {
+                    || (ch == C - 1 && b == batch_size - 1
+                        && block_x == WTILES - 1 && block_y == WTILES - 1)) {
 
                     for (int i = 0; i < kWinogradAlpha * kWinogradAlpha; i++) {
                         for (int entry = 0; entry < buffer_entries; entry++) {
-                            V[i * C * P + buffer_offset + entry] =
+                            V[i * C * BP + buffer_offset + entry] =
                                 buffer[i * buffersize + entry];
                         }
                     }
@@ -137,38 +143,44 @@ void WinogradConvolution3::TransformIn(const int board_size,
     }
 }
 
-void WinogradConvolution3::Sgemm(const int board_size,
+void WinogradConvolution3::Sgemm(const int batch_size,
+                                 const int board_size,
                                  const std::vector<float>& U,
                                  const std::vector<float>& V,
                                  std::vector<float>& M,
                                  const int C, const int K) {
     //    [C, K, P] are [input_channels, output_channels, Ptiles]
     // U dimensions is [36,  input_channels, output_channels].
-    // V dimensions is [36,  input_channels, p_tiles].
-    // M dimensions is [36, output_channels, p_tiles].
+    // V dimensions is [36,  input_channels, batch x p_tiles].
+    // M dimensions is [36, output_channels, batch x p_tiles].
 
-    const int P = GetWinogradP(board_size);
+    const int BP = batch_size * GetWinogradP(board_size);
     for (int b = 0; b < kWinogradTile; b++) {
         const int offset_u = b * K * C;
-        const int offset_v = b * C * P;
-        const int offset_m = b * K * P;
+        const int offset_v = b * C * BP;
+        const int offset_m = b * K * BP;
         Blas::WinogradSgemm(offset_u, offset_v, offset_m,
-                                K, P, C,
+                                K, BP, C,
                                 1.0f,
                                 U.data(), K,
-                                V.data(), P,
+                                V.data(), BP,
                                 0.0f,
-                                M.data(), P);
+                                M.data(), BP);
     }
 }
 
-void WinogradConvolution3::TransformOut(const int board_size,
+void WinogradConvolution3::TransformOut(const int batch_size,
+                                        const int board_size,
                                         const std::vector<float>& M,
+                                        const std::vector<float>& biases,
+                                        const std::vector<float>& residual,
+                                        bool ReLU,
                                         std::vector<float>& Y, const int K) {
     const int W = board_size;
     const int H = board_size;
     const int WTILES = GetWinogradWTiles(board_size);
     const int P = GetWinogradP(board_size);
+    const int BP = batch_size * P;
 
     // multiple vector [i0..i5] by At and produce [o0..o3]
     // const auto At = std::array<float, kWinogradAlpha * kWinogradM>{
@@ -191,13 +203,21 @@ void WinogradConvolution3::TransformOut(const int board_size,
         o3 = t1m2 + t3m4 + t3m4 + i5;
     };
 
-    for (int k = 0; k < K; k++) {
+    const float *biases_ptr = biases.empty() ?
+                                  nullptr : biases.data();
+    const float *residual_ptr = residual.empty() ?
+                                    nullptr : residual.data();
+
+    for (int k_b = 0; k_b < K * batch_size; k_b++) {
+        const int k = k_b / batch_size;
+        const int n = k_b % batch_size;
+        const float bias = biases_ptr ? biases_ptr[k] : 0.0f;
         for (int block_x = 0; block_x < WTILES; block_x++) {
             const auto x = kWinogradM * block_x;
             for (int block_y = 0; block_y < WTILES; block_y++) {
                 const auto y = kWinogradM * block_y;
 
-                const auto b = block_y * WTILES + block_x;
+                const auto b = n * P + block_y * WTILES + block_x;
                 using WinogradTile =
                     std::array<std::array<float, kWinogradAlpha>,
                                kWinogradAlpha>;
@@ -205,7 +225,7 @@ void WinogradConvolution3::TransformOut(const int board_size,
                 for (int xi = 0; xi < kWinogradAlpha; xi++) {
                     for (int nu = 0; nu < kWinogradAlpha; nu++) {
                         temp_m[xi][nu] =
-                            M[(xi * kWinogradAlpha + nu) * K * P + k * P + b];
+                            M[(xi * kWinogradAlpha + nu) * K * BP + k * BP + b];
                     }
                 }
                 std::array<std::array<float, kWinogradAlpha>, kWinogradM> temp;
@@ -224,11 +244,21 @@ void WinogradConvolution3::TransformOut(const int board_size,
                                 temp[i][3], temp[i][4], temp[i][5]);
                 }
 
-                const auto y_ind = k * H * W + y * W + x;
+                // The tile is still in the registers. Apply the
+                // biases, residual and ReLU before writing it back.
+                const auto y_ind = k_b * H * W + y * W + x;
                 for (int i = 0; i < kWinogradM; i++) {
                     for (int j = 0; j < kWinogradM; j++) {
                         if (y + i < H && x + j < W) {
-                            Y[y_ind + i * W + j] = o[i][j];
+                            const auto ind = y_ind + i * W + j;
+                            float val = o[i][j] + bias;
+                            if (residual_ptr) {
+                                val += residual_ptr[ind];
+                            }
+                            if (ReLU && val < 0.0f) {
+                                val = 0.0f;
+                            }
+                            Y[ind] = val;
                         }
                     }
                 }
@@ -237,20 +267,41 @@ void WinogradConvolution3::TransformOut(const int board_size,
     }
 }
 
-void WinogradConvolution3::Forward(const size_t board_size,
+void WinogradConvolution3::Forward(const size_t batch_size,
+                                   const size_t board_size,
+                                   const size_t input_channels,
+                                   const size_t output_channels,
+                                   const std::vector<float>& input,
+                                   const std::vector<float>& U,
+                                   std::vector<float>& V,
+                                   std::vector<float>& M,
+                                   std::vector<float>& output) {
+    const auto zero_vec = std::vector<float>{};
+    Forward(batch_size, board_size, input_channels, output_channels,
+            input, U, zero_vec, zero_vec, false, V, M, output);
+}
+
+void WinogradConvolution3::Forward(const size_t batch_size,
+                                   const size_t board_size,
                                    const size_t input_channels,
                                    const size_t output_channels,
                                    const std::vector<float>& input,
                                    const std::vector<float>& U,
+                                   const std::vector<float>& biases,
+                                   const std::vector<float>& residual,
+                                   bool ReLU,
                                    std::vector<float>& V,
                                    std::vector<float>& M,
                                    std::vector<float>& output) {
-    TransformIn(board_size, input, V, input_channels);
-    Sgemm(board_size, U, V, M, input_channels, output_channels);
-    TransformOut(board_size, M, output, output_channels);
+    TransformIn(batch_size, board_size, input, V, input_channels);
+    Sgemm(batch_size, board_size, U, V, M, input_channels, output_channels);
+    TransformOut(batch_size, board_size, M, biases, residual, ReLU,
+                 output, output_channels);
 }
 
 
-size_t WinogradConvolution3::GetWorkspaceSize(const size_t board_size, const size_t channels) {
-    return kWinogradTile * channels * GetWinogradP(board_size);
+size_t WinogradConvolution3::GetWorkspaceSize(const size_t batch_size,
+                                              const size_t board_size,
+                                              const size_t channels) {
+    return kWinogradTile * channels * batch_size * GetWinogradP(board_size);
 }
@@ -5,7 +5,8 @@
 
 class WinogradConvolution3 {
 public:
-    static void Forward(const size_t board_size,
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
                         const size_t input_channels,
                         const size_t output_channels,
                         const std::vector<float>& input,
@@ -14,20 +15,43 @@ public:
                         std::vector<float>& M,
                         std::vector<float>& output);
 
-    static size_t GetWorkspaceSize(const size_t board_size, const size_t channels);
+    // Same as above but the biases, residual and ReLU are fused into
+    // the output transform. The residual may be empty.
+    static void Forward(const size_t batch_size,
+                        const size_t board_size,
+                        const size_t input_channels,
+                        const size_t output_channels,
+                        const std::vector<float>& input,
+                        const std::vector<float>& U,
+                        const std::vector<float>& biases,
+                        const std::vector<float>& residual,
+                        bool ReLU,
+                        std::vector<float>& V,
+                        std::vector<float>& M,
+                        std::vector<float>& output);
+
+    static size_t GetWorkspaceSize(const size_t batch_size,
+                                   const size_t board_size,
+                                   const size_t channels);
 
 private:
-    static void TransformIn(const int board_size,
+    static void TransformIn(const int batch_size,
+                            const int board_size,
                             const std::vector<float>& in,
                             std::vector<float>& V, int C);
 
-    static void Sgemm(const int board_size,
+    static void Sgemm(const int batch_size,
+                      const int board_size,
                       const std::vector<float>& U,
                       const std::vector<float>& V,
                       std::vector<float>& M, int C, int K);
 
-    static void TransformOut(const int board_size,
+    static void TransformOut(const int batch_size,
+                             const int board_size,
                              const std::vector<float>& M,
+                             const std::vector<float>& biases,
+                             const std::vector<float>& residual,
+                             bool ReLU,
                              std::vector<float>& Y, int K);
 };
 
@@ -22,6 +22,65 @@ void CudaForwardPipe::Initialize(std::shared_ptr<DNNWeights> weights) {
 
 OutputResult CudaForwardPipe::Forward(const InputData &input) {
     OutputResult output;
+    InputData reordered_input = ReorderInput(input);
+
+    auto entry = std::make_shared<ForwawrdEntry>(reordered_input, output);
+    std::unique_lock<std::mutex> lock(entry->mutex);
+    size_t queue_size;
+    {
+        // Push the entry.
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        entry_queue_.emplace_back(entry);
+        queue_size = entry_queue_.size();
+    }
+
+    if (queue_size >= (size_t)max_batch_) {
+        cv_.notify_one(); // Wake up one worker if there are enough batch size.
+    }
+    // Wait for batch forwarding worker.
+    entry->cv.wait(lock, [&entry](){ return entry->done.load(std::memory_order_relaxed); });
+
+    return ReorderOutput(output, input.board_size);
+}
+
+std::vector<OutputResult> CudaForwardPipe::Forward(const std::vector<InputData> &inputs) {
+    const auto size = inputs.size();
+    auto reordered_inputs = std::vector<InputData>(size);
+    auto outputs = std::vector<OutputResult>(size);
+    auto entries = std::vector<std::shared_ptr<ForwawrdEntry>>(size);
+
+    for (auto i = size_t{0}; i < size; ++i) {
+        reordered_inputs[i] = ReorderInput(inputs[i]);
+        entries[i] = std::make_shared<ForwawrdEntry>(reordered_inputs[i], outputs[i]);
+    }
+    size_t queue_size;
+    {
+        // Push all entries.
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        for (auto &entry : entries) {
+            entry_queue_.emplace_back(entry);
+        }
+        queue_size = entry_queue_.size();
+    }
+
+    if (queue_size >= (size_t)max_batch_) {
+        cv_.notify_one(); // Wake up one worker if there are enough batch size.
+    }
+
+    // The worker marks the entry done under its lock. So waiting the
+    // entries in any order never misses the result.
+    for (auto i = size_t{0}; i < size; ++i) {
+        auto &entry = entries[i];
+        std::unique_lock<std::mutex> lock(entry->mutex);
+        entry->cv.wait(lock, [&entry](){ return entry->done.load(std::memory_order_relaxed); });
+
+        outputs[i] = ReorderOutput(outputs[i], inputs[i].board_size);
+    }
+
+    return outputs;
+}
+
+InputData CudaForwardPipe::ReorderInput(const InputData &input) const {
     InputData reordered_input = input;
 
     // Reorder the inputs data.
@@ -44,23 +103,14 @@ OutputResult CudaForwardPipe::Forward(const InputData &input) {
             }
         }
     }
+    return reordered_input;
+}
 
-    auto entry = std::make_shared<ForwawrdEntry>(reordered_input, output);
-    std::unique_lock<std::mutex> lock(entry->mutex);
-    {
-        // Push the entry.
-        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
-        entry_queue_.emplace_back(entry);
-    }
-
-    if (entry_queue_.size() >= (size_t)max_batch_) {
-        cv_.notify_one(); // Wake up one worker if there are enough batch size.
-    }
-    entry->cv.wait(lock); // Wait for batch forwarding worker.
-    entry->done.store(true, std::memory_order_relaxed);
-
+OutputResult CudaForwardPipe::ReorderOutput(const OutputResult &output,
+                                            const int planes_bsize) const {
     // Reorder the outputs data.
     OutputResult reordered_ouput = output;
+    const bool should_reorder = planes_bsize != board_size_;
 
     if (should_reorder) {
         int offset_r = 0;
@@ -78,7 +128,6 @@ OutputResult CudaForwardPipe::Forward(const InputData &input) {
             }
         }
     }
-
     return reordered_ouput;
 }
 
@@ -886,7 +935,12 @@ void CudaForwardPipe::Worker(int gpu) {
     const auto gpu_waittime_base = GetOption<int>("gpu_waittime");
     waittime_.store(gpu_waittime_base, std::memory_order_relaxed);
 
-    const auto GatherBatches = [this, gpu_waittime_base](){
+    const auto GetQueueSize = [this]() {
+        std::lock_guard<std::mutex> queue_lock(queue_mutex_);
+        return (int)entry_queue_.size();
+    };
+
+    const auto GatherBatches = [this, gpu_waittime_base, &GetQueueSize](){
         const auto max_waittime = std::max(10 * gpu_waittime_base, 100);
         auto entries = std::vector<std::shared_ptr<ForwawrdEntry>>{};
 
@@ -899,7 +953,7 @@ void CudaForwardPipe::Worker(int gpu) {
             bool should_be_fast = fast_pipe_.exchange(false, std::memory_order_relaxed);
             int waittime = waittime_.load(std::memory_order_relaxed);
 
-            if ((int)entry_queue_.size() >= max_batch_) {
+            if (GetQueueSize() >= max_batch_) {
                 // Threre are enough batches. Finish the loop.
                 waittime_.store(
                     std::min(waittime, gpu_waittime_base),
@@ -910,11 +964,11 @@ void CudaForwardPipe::Worker(int gpu) {
             // Wait for some time in order to avoid busy waiting.
             std::unique_lock<std::mutex> lock(worker_mutex_);
             bool timeout = !cv_.wait_for(lock, std::chrono::milliseconds(waittime),
-                                             [this](){ return !((int)entry_queue_.size() < max_batch_); }
+                                             [this, &GetQueueSize](){ return !(GetQueueSize() < max_batch_); }
                                          );
 
             // Reset the waiting time.
-            if (!entry_queue_.empty()) {
+            if (GetQueueSize() > 0) {
                 waittime = std::min(waittime, gpu_waittime_base);
 
                 if (timeout && should_be_fast) {
@@ -972,12 +1026,15 @@ void CudaForwardPipe::Worker(int gpu) {
         }
 
         auto outputs = nngraphs_[gpu]->BatchForward(inputs);
+        AccumulateBatch(batch_size, max_batch_);
 
         for (auto b = size_t{0}; b < batch_size; ++b) {
+            // Write the output and mark it under the entry lock, so the
+            // waiting thread never misses it.
+            std::lock_guard<std::mutex> lock(entries[b]->mutex);
             entries[b]->output = outputs[b];
-            while (!entries[b]->done.load(std::memory_order_relaxed)) {
-                entries[b]->cv.notify_all();
-            }
+            entries[b]->done.store(true, std::memory_order_relaxed);
+            entries[b]->cv.notify_one();
         }
 
         if ((int)batch_size <= max_batch_) {
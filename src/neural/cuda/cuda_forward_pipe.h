@@ -21,6 +21,10 @@ public:
 
     virtual OutputResult Forward(const InputData &input);
 
+    // Push all inputs to the queue at once so that the workers can
+    // forward them in the same batch.
+    virtual std::vector<OutputResult> Forward(const std::vector<InputData> &inputs);
+
     virtual bool Valid();
 
     virtual void Load(std::shared_ptr<DNNWeights> weights);
@@ -145,6 +149,10 @@ private:
     int max_batch_;
     int board_size_{0};
 
+    // Move the planes to the network board size and back.
+    InputData ReorderInput(const InputData &input) const;
+    OutputResult ReorderOutput(const OutputResult &output, const int planes_bsize) const;
+
     void PrepareWorkers();
     void Worker(int gpu);
     void QuitWorkers();
@@ -109,3 +109,19 @@ std::vector<float>& ConvLayer::GetWeights() {
 std::vector<float>& ConvLayer::GetBiases() {
     return biases_;
 }
+
+std::vector<std::int8_t>& ConvLayer::GetInt8Weights() {
+    return int8_weights_;
+}
+
+std::vector<float>& ConvLayer::GetInt8Scales() {
+    return int8_scales_;
+}
+
+void ConvLayer::SetInt8InputScale(float scale) {
+    int8_input_scale_ = scale;
+}
+
+float ConvLayer::GetInt8InputScale() const {
+    return int8_input_scale_;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <vector>
 
 class LinearLayer {
@@ -72,10 +73,22 @@ public:
     std::vector<float>& GetWeights();
     std::vector<float>& GetBiases();
 
+    // The INT8 weights are quantized per output channel. The input
+    // scale is zero if it is not calibrated.
+    std::vector<std::int8_t>& GetInt8Weights();
+    std::vector<float>& GetInt8Scales();
+
+    void SetInt8InputScale(float scale);
+    float GetInt8InputScale() const;
+
 private:
     std::vector<float> weights_;
     std::vector<float> biases_;
 
+    std::vector<std::int8_t> int8_weights_;
+    std::vector<float> int8_scales_;
+    float int8_input_scale_{0.0f};
+
     int inputs_{0};
     int outputs_{0};
     int filter_{0};
@@ -105,6 +118,7 @@ public:
     bool loaded{false};
     bool winograd{false};
     bool winograd_initialized{false};
+    bool int8{false};
 
     int input_channels{0};
 
@@ -1,5 +1,6 @@
 #include "neural/encoder.h"
 #include "utils/format.h"
+#include "utils/profiler.h"
 
 #include <sstream>
 #include <iomanip>
@@ -11,6 +12,8 @@ Encoder& Encoder::Get() {
 }
 
 InputData Encoder::GetInputs(const GameState &state, int symmetry) const {
+    PROFILE_SCOPE(kProfileEncode);
+
     auto data = InputData{};
 
     data.board_size = state.GetBoardSize();
@@ -171,19 +174,14 @@ void Encoder::FillKoMove(const Board* board,
 }
 
 void Encoder::FillArea(const Board* board,
+                       const BoardAnalysis &analysis,
                        const int to_move,
                        std::vector<float>::iterator area_it) const {
     auto num_intersections = board->GetNumIntersections();
 
-    auto ownership = std::vector<int>(num_intersections, kInvalid);
-    auto safe_area = std::vector<bool>(num_intersections, false);
-
-    board->ComputeScoreArea(ownership);
-    board->ComputeSafeArea(safe_area, false);
-
     for (int index = 0; index < num_intersections; ++index) {
-        bool safe = safe_area[index];
-        int owner = ownership[index];
+        bool safe = analysis.safe_area[index];
+        int owner = analysis.score_area[index];
 
         if (safe) {
             if (owner == to_move) {
@@ -228,12 +226,12 @@ void Encoder::FillLiberties(const Board* board,
 }
 
 void Encoder::FillLadder(const Board* board,
+                         const BoardAnalysis &analysis,
                          std::vector<float>::iterator ladder_it) const {
     auto num_intersections = board->GetNumIntersections();
-    auto ladders = board->GetLadderMap();
 
     for (int index = 0; index < num_intersections; ++index) {
-        auto ladder = ladders[index];
+        auto ladder = analysis.ladders[index];
 
         if (ladder == kLadderDeath) {
             ladder_it[index + 0 * num_intersections] = static_cast<float>(true);
@@ -295,10 +293,14 @@ void Encoder::EncoderFeatures(const GameState &state,
 
     auto color = state.GetToMove();
 
+    // The expansion reuses the analysis for its move pruning.
+    auto analysis = BoardAnalysis{};
+    BoardAnalysisCache::Get().GetAnalysis(*board, analysis);
+
     FillKoMove(board.get(), ko_it);
-    FillArea(board.get(), color, area_it);
+    FillArea(board.get(), analysis, color, area_it);
     FillLiberties(board.get(), liberties_it);
-    FillLadder(board.get(), ladder_it);
+    FillLadder(board.get(), analysis, ladder_it);
     FillMisc(board.get(), color, state.GetRule(),
                  state.GetWave(), state.GetKomi(), misc_it);
 }
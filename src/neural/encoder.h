@@ -4,6 +4,7 @@
 #include <array>
 #include "game/symmetry.h"
 #include "game/game_state.h"
+#include "game/board_analysis.h"
 #include "neural/network_basic.h"
 
 class Encoder {
@@ -58,6 +59,7 @@ private:
                     std::vector<float>::iterator ko_it) const;
 
     void FillArea(const Board* board,
+                  const BoardAnalysis &analysis,
                   const int to_move,
                   std::vector<float>::iterator area_it) const;
 
@@ -65,6 +67,7 @@ private:
                        std::vector<float>::iterator liberties_it) const;
 
     void FillLadder(const Board* board,
+                    const BoardAnalysis &analysis,
                     std::vector<float>::iterator ladder_it) const;
 
     void FillMisc(const Board* board,
@@ -1,5 +1,8 @@
 #include "neural/loader.h"
 #include "neural/network_basic.h"
+#include "neural/blas/int8_convolution.h"
+#include "neural/winograd_helper.h"
+#include "utils/filesystem.h"
 #include "utils/splitter.h"
 #include "utils/log.h"
 #include "utils/format.h"
@@ -7,6 +10,8 @@
 #include "utils/option.h"
 #include "config.h"
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
@@ -14,6 +19,131 @@
 #include "fast_float.h"
 #endif
 
+namespace {
+
+/*
+ * The binary weights file. All values are little endian.
+ *
+ * BinaryHeader                   (64 bytes)
+ * BinaryBlock  x residual_blocks (16 bytes per block)
+ * BinaryLayer  x num_layers      (48 bytes per layer)
+ * tensors                        (float32, 64-byte aligned offsets)
+ *
+ * The layers are in the same order as the text weights file. The batch
+ * normalization layers are already merged into the convolutions.
+ */
+constexpr char kBinaryMagic[8] = {'S', 'Y', 'W', 'E', 'I', 'G', 'H', 'T'};
+constexpr std::uint32_t kBinaryFormatVersion = 1;
+constexpr std::uint32_t kBinaryWinogradFlag = 1;
+constexpr std::uint64_t kBinaryAlignment = 64;
+
+struct BinaryHeader {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t flags;
+    std::uint32_t net_version;
+    std::uint32_t input_channels;
+    std::uint32_t residual_blocks;
+    std::uint32_t residual_channels;
+    std::uint32_t policy_extract_channels;
+    std::uint32_t value_extract_channels;
+    std::uint32_t num_layers;
+    std::uint32_t reserved[5];
+};
+
+struct BinaryBlock {
+    std::uint32_t apply_btl;
+    std::uint32_t apply_se;
+    std::uint32_t se_size;
+    std::uint32_t reserved;
+};
+
+enum BinaryLayerType : std::uint32_t {
+    kBinaryConvolution = 0,
+    kBinaryBatchNorm = 1,
+    kBinaryFullyConnect = 2
+};
+
+struct BinaryLayer {
+    std::uint32_t type;
+    std::int32_t shape[3];
+    std::uint64_t offsets[2];
+    std::uint64_t sizes[2]; // the number of floats
+};
+
+static_assert(sizeof(BinaryHeader) == 64, "");
+static_assert(sizeof(BinaryBlock) == 16, "");
+static_assert(sizeof(BinaryLayer) == 48, "");
+
+struct LayerRef {
+    std::uint32_t type;
+    ConvLayer *conv{nullptr};
+    BatchNormLayer *bn{nullptr};
+    LinearLayer *fc{nullptr};
+    bool winograd{false}; // Is it transformed by the Winograd?
+};
+
+// Collect the layers in the order of weights file. The tower must be
+// built before collecting.
+std::vector<LayerRef> CollectLayers(DNNWeights &weights) {
+    auto layers = std::vector<LayerRef>{};
+    const auto AddConv = [&layers](ConvLayer &conv, bool winograd) {
+        layers.push_back({kBinaryConvolution, &conv, nullptr, nullptr, winograd});
+    };
+    const auto AddBatchNorm = [&layers](BatchNormLayer &bn) {
+        layers.push_back({kBinaryBatchNorm, nullptr, &bn, nullptr, false});
+    };
+    const auto AddFullyConnect = [&layers](LinearLayer &fc) {
+        layers.push_back({kBinaryFullyConnect, nullptr, nullptr, &fc, false});
+    };
+
+    // input layers
+    AddConv(weights.input_conv, true);
+    AddBatchNorm(weights.input_bn);
+
+    // residual tower
+    for (auto &residual : weights.tower) {
+        if (residual.apply_btl) {
+            AddConv(residual.pre_btl_conv, false);
+            AddBatchNorm(residual.pre_btl_bn);
+        }
+        AddConv(residual.conv1, true);
+        AddBatchNorm(residual.bn1);
+        AddConv(residual.conv2, true);
+        AddBatchNorm(residual.bn2);
+        if (residual.apply_btl) {
+            AddConv(residual.post_btl_conv, false);
+            AddBatchNorm(residual.post_btl_bn);
+        }
+        if (residual.apply_se) {
+            AddFullyConnect(residual.squeeze);
+            AddFullyConnect(residual.excite);
+        }
+    }
+
+    // policy head
+    AddConv(weights.p_ex_conv, false);
+    AddBatchNorm(weights.p_ex_bn);
+    AddFullyConnect(weights.p_inter_fc);
+    AddConv(weights.prob_conv, false);
+    AddFullyConnect(weights.pass_fc);
+
+    // value head
+    AddConv(weights.v_ex_conv, false);
+    AddBatchNorm(weights.v_ex_bn);
+    AddFullyConnect(weights.v_inter_fc);
+    AddConv(weights.v_ownership, false);
+    AddFullyConnect(weights.v_misc);
+
+    return layers;
+}
+
+std::uint64_t AlignOffset(std::uint64_t offset) {
+    return (offset + kBinaryAlignment - 1) / kBinaryAlignment * kBinaryAlignment;
+}
+
+} // namespace
+
 DNNLoder& DNNLoder::Get() {
     static DNNLoder lodaer;
     return lodaer;
@@ -29,6 +159,22 @@ void DNNLoder::FromFile(std::shared_ptr<DNNWeights> weights, std::string filenam
         return;
     }
 
+    MappedFile mapped_file;
+    if (mapped_file.Open(filename) &&
+            mapped_file.GetSize() >= sizeof(kBinaryMagic) &&
+            std::memcmp(mapped_file.GetData(),
+                            kBinaryMagic, sizeof(kBinaryMagic)) == 0) {
+        // It is the binary weights file.
+        try {
+            ParseBinary(weights, mapped_file);
+        } catch (const char *err) {
+            LOGGING << "Fail to load the network file!" << std::endl
+                        << Format("    Cause: %s.", err) << std::endl;
+        }
+        return;
+    }
+    mapped_file.Close();
+
     file.open(filename, std::ifstream::binary | std::ifstream::in);
 
     if (!file.is_open()) {
@@ -36,11 +182,8 @@ void DNNLoder::FromFile(std::shared_ptr<DNNWeights> weights, std::string filenam
         return;
     }
 
-    char c;
-    while (file.get(c)) {
-        // Copy the file data to buffer.
-        buffer << c;
-    }
+    // Copy the file data to buffer.
+    buffer << file.rdbuf();
 
     file.close();
 
@@ -121,6 +264,249 @@ void DNNLoder::Parse(std::shared_ptr<DNNWeights> weights, std::istream &buffer)
     }
 }
 
+void DNNLoder::ParseBinary(std::shared_ptr<DNNWeights> weights, const MappedFile &file) {
+    const auto data = file.GetData();
+    const auto size = file.GetSize();
+
+    auto header = BinaryHeader{};
+    if (size < sizeof(header)) {
+        throw "The binary weights file is too small";
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.format_version != kBinaryFormatVersion) {
+        throw "Do not support this binary weights version";
+    }
+    version_ = header.net_version;
+    if (version_ != 3) {
+        throw "Do not support this version";
+    }
+    if ((int)header.input_channels != kInputChannels) {
+        throw "The number of input channels is wrong";
+    }
+
+    const bool transformed = header.flags & kBinaryWinogradFlag;
+#ifdef USE_CUDA
+    if (transformed) {
+        throw "The GPU backend does not support the Winograd transformed weights";
+    }
+#endif
+
+    weights->input_channels = header.input_channels;
+    weights->residual_blocks = header.residual_blocks;
+    weights->residual_channels = header.residual_channels;
+    weights->policy_extract_channels = header.policy_extract_channels;
+    weights->value_extract_channels = header.value_extract_channels;
+
+    // Build the tower.
+    auto offset = std::uint64_t{sizeof(header)};
+    if (offset + header.residual_blocks * sizeof(BinaryBlock) > size) {
+        throw "The binary weights file is truncated";
+    }
+    weights->tower.clear();
+    for (int i = 0; i < weights->residual_blocks; ++i) {
+        auto block = BinaryBlock{};
+        std::memcpy(&block, data + offset, sizeof(block));
+        offset += sizeof(block);
+
+        weights->tower.emplace_back(ResidualBlock{});
+        auto &residual = weights->tower.back();
+        residual.apply_btl = block.apply_btl;
+        residual.apply_se = block.apply_se;
+        residual.se_size = block.se_size;
+    }
+
+    const auto layers = CollectLayers(*weights);
+    if (header.num_layers != layers.size()) {
+        throw "The number of binary weights layers is wrong";
+    }
+    if (offset + layers.size() * sizeof(BinaryLayer) > size) {
+        throw "The binary weights file is truncated";
+    }
+
+    // Copy the tensors from the mapped file. There is no parsing.
+    for (const auto &layer : layers) {
+        auto entry = BinaryLayer{};
+        std::memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        if (entry.type != layer.type) {
+            throw "The binary weights layer type is wrong";
+        }
+        const auto CopyTensor = [&](int idx, std::vector<float> &tensor) {
+            const auto tensor_offset = entry.offsets[idx];
+            const auto tensor_size = entry.sizes[idx];
+            if (tensor_offset % kBinaryAlignment != 0 ||
+                    tensor_offset + tensor_size * sizeof(float) > size) {
+                throw "The binary weights tensor is out of range";
+            }
+            tensor.resize(tensor_size);
+            std::memcpy(tensor.data(), data + tensor_offset, tensor_size * sizeof(float));
+        };
+
+        if (layer.type == kBinaryConvolution) {
+            const auto inputs = entry.shape[0];
+            const auto outputs = entry.shape[1];
+            const auto filter = entry.shape[2];
+            const auto weights_size = (transformed && layer.winograd) ?
+                                          kWinogradTile * inputs * outputs :
+                                          inputs * outputs * filter * filter;
+            if ((int)entry.sizes[0] != weights_size ||
+                    (int)entry.sizes[1] != outputs) {
+                throw "The binary convolution layer size is wrong";
+            }
+            layer.conv->Set(inputs, outputs, filter);
+            CopyTensor(0, layer.conv->GetWeights());
+            CopyTensor(1, layer.conv->GetBiases());
+        } else if (layer.type == kBinaryBatchNorm) {
+            const auto channels = entry.shape[0];
+            if ((int)entry.sizes[0] != channels ||
+                    (int)entry.sizes[1] != channels) {
+                throw "The binary batch normalization layer size is wrong";
+            }
+            layer.bn->Set(channels);
+            CopyTensor(0, layer.bn->GetMeans());
+            CopyTensor(1, layer.bn->GetStddevs());
+        } else {
+            const auto inputs = entry.shape[0];
+            const auto outputs = entry.shape[1];
+            if ((int)entry.sizes[0] != inputs * outputs ||
+                    (int)entry.sizes[1] != outputs) {
+                throw "The binary fully connect layer size is wrong";
+            }
+            layer.fc->Set(inputs, outputs);
+            CopyTensor(0, layer.fc->GetWeights());
+            CopyTensor(1, layer.fc->GetBiases());
+        }
+    }
+
+    weights->loaded = true;
+    DumpInfo(weights);
+
+    // The batch normalization layers are already merged.
+    weights->winograd = transformed || GetOption<bool>("winograd");
+    weights->winograd_initialized = transformed;
+
+    if (GetOption<bool>("int8")) {
+        if (transformed) {
+            LOGGING << "The INT8 tower needs the weights without Winograd transformation. Disable it.\n";
+        } else {
+            QuantizeWeights(weights);
+        }
+    }
+}
+
+bool DNNLoder::ToBinaryFile(std::shared_ptr<DNNWeights> weights,
+                            std::string filename,
+                            bool winograd) const {
+    if (weights == nullptr || !weights->loaded) {
+        LOGGING << "There is no weights to save." << std::endl;
+        return false;
+    }
+
+    // The weights may be transformed by the forward pipe.
+    const bool already_transformed = weights->winograd_initialized;
+    const bool transformed = winograd || already_transformed;
+    const auto layers = CollectLayers(*weights);
+
+    auto header = BinaryHeader{};
+    std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+    header.format_version = kBinaryFormatVersion;
+    header.flags = transformed ? kBinaryWinogradFlag : 0;
+    header.net_version = 3;
+    header.input_channels = weights->input_channels;
+    header.residual_blocks = weights->residual_blocks;
+    header.residual_channels = weights->residual_channels;
+    header.policy_extract_channels = weights->policy_extract_channels;
+    header.value_extract_channels = weights->value_extract_channels;
+    header.num_layers = layers.size();
+
+    // Collect the tensors and compute the offsets.
+    auto tensors = std::vector<const std::vector<float> *>{};
+    auto transformed_tensors = std::vector<std::vector<float>>{};
+    auto entries = std::vector<BinaryLayer>(layers.size(), BinaryLayer{});
+
+    transformed_tensors.reserve(layers.size());
+    auto offset = AlignOffset(sizeof(header) +
+                                  weights->residual_blocks * sizeof(BinaryBlock) +
+                                  layers.size() * sizeof(BinaryLayer));
+
+    for (auto i = size_t{0}; i < layers.size(); ++i) {
+        const auto &layer = layers[i];
+        auto &entry = entries[i];
+        const std::vector<float> *pair[2];
+
+        entry.type = layer.type;
+        if (layer.type == kBinaryConvolution) {
+            entry.shape[0] = layer.conv->GetInputs();
+            entry.shape[1] = layer.conv->GetOutputs();
+            entry.shape[2] = layer.conv->GetFilter();
+            pair[0] = &layer.conv->GetWeights();
+            pair[1] = &layer.conv->GetBiases();
+
+            if (layer.winograd && winograd && !already_transformed) {
+                transformed_tensors.emplace_back(
+                    WinogradTransformF(layer.conv->GetWeights(),
+                                       layer.conv->GetOutputs(),
+                                       layer.conv->GetInputs()));
+                pair[0] = &transformed_tensors.back();
+            }
+        } else if (layer.type == kBinaryBatchNorm) {
+            entry.shape[0] = layer.bn->GetChannels();
+            pair[0] = &layer.bn->GetMeans();
+            pair[1] = &layer.bn->GetStddevs();
+        } else {
+            entry.shape[0] = layer.fc->GetInputs();
+            entry.shape[1] = layer.fc->GetOutputs();
+            pair[0] = &layer.fc->GetWeights();
+            pair[1] = &layer.fc->GetBiases();
+        }
+
+        for (int idx = 0; idx < 2; ++idx) {
+            entry.offsets[idx] = offset;
+            entry.sizes[idx] = pair[idx]->size();
+            tensors.emplace_back(pair[idx]);
+            offset = AlignOffset(offset + pair[idx]->size() * sizeof(float));
+        }
+    }
+
+    auto file = std::ofstream{};
+    file.open(filename, std::ofstream::binary | std::ofstream::out);
+    if (!file.is_open()) {
+        LOGGING << "Fail to create the file: " << filename << '!' << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &residual : weights->tower) {
+        auto block = BinaryBlock{};
+        block.apply_btl = residual.apply_btl;
+        block.apply_se = residual.apply_se;
+        block.se_size = residual.se_size;
+        file.write(reinterpret_cast<const char *>(&block), sizeof(block));
+    }
+    for (const auto &entry : entries) {
+        file.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    }
+
+    auto tensor_idx = size_t{0};
+    for (const auto &entry : entries) {
+        for (int idx = 0; idx < 2; ++idx) {
+            // Fill zeros until the aligned offset.
+            const auto padding = entry.offsets[idx] - (std::uint64_t)file.tellp();
+            const char zeros[kBinaryAlignment] = {0};
+            file.write(zeros, padding);
+
+            const auto tensor = tensors[tensor_idx++];
+            file.write(reinterpret_cast<const char *>(tensor->data()),
+                           tensor->size() * sizeof(float));
+        }
+    }
+    file.close();
+
+    return !file.fail();
+}
+
 void DNNLoder::ParseInfo(NetInfo &netinfo, std::istream &buffer) const {
     auto line = std::string{};
     while (std::getline(buffer, line)) {
@@ -638,6 +1024,10 @@ void DNNLoder::FillWeights(NetInfo &netinfo,
     DumpInfo(weights);
     ProcessWeights(weights);
     weights->winograd = GetOption<bool>("winograd");
+
+    if (GetOption<bool>("int8")) {
+        QuantizeWeights(weights);
+    }
 }
 
 void DNNLoder::ProcessWeights(std::shared_ptr<DNNWeights> weights) const {
@@ -685,6 +1075,32 @@ void DNNLoder::ProcessWeights(std::shared_ptr<DNNWeights> weights) const {
         weights->v_ex_conv, weights->v_ex_bn);
 }
 
+void DNNLoder::QuantizeWeights(std::shared_ptr<DNNWeights> weights) const {
+    const auto QuantizeConv = [](ConvLayer &conv) {
+        Int8Convolution::QuantizeWeights(
+            conv.GetFilter(), conv.GetInputs(), conv.GetOutputs(),
+            conv.GetWeights(),
+            conv.GetInt8Weights(), conv.GetInt8Scales());
+        conv.SetInt8InputScale(0.0f);
+    };
+
+    // Only the residual tower is quantized. The input layer and
+    // heads are small and sensitive so they are still float.
+    for (auto &residual : weights->tower) {
+        QuantizeConv(residual.conv1);
+        QuantizeConv(residual.conv2);
+
+        if (residual.apply_btl) {
+            QuantizeConv(residual.pre_btl_conv);
+            QuantizeConv(residual.post_btl_conv);
+        }
+    }
+    weights->int8 = true;
+
+    LOGGING << Format("Quantized the residual tower to INT8 (%s kernel).\n",
+                          Int8Convolution::GetKernelName().c_str());
+}
+
 void DNNLoder::GetWeightsFromBuffer(std::vector<float> &weights, std::istream &buffer) const {
     weights.clear();
 
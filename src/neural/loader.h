@@ -7,12 +7,26 @@
 #include <fstream>
 #include <unordered_map>
 
+class MappedFile;
+
 class DNNLoder {
 public:
     static DNNLoder& Get();
 
     void FromFile(std::shared_ptr<DNNWeights> weights, std::string filename);
 
+    // Quantize the residual tower convolutions to INT8. The float
+    // weights are kept.
+    void QuantizeWeights(std::shared_ptr<DNNWeights> weights) const;
+
+    // Save the weights as the binary file. The binary file is memory
+    // mapped and copied without parsing when loading. The 3x3
+    // convolutions are stored after the Winograd transformation if
+    // winograd is true. Return false if it fails.
+    bool ToBinaryFile(std::shared_ptr<DNNWeights> weights,
+                      std::string filename,
+                      bool winograd) const;
+
 private:
     using LayerShape = std::vector<int>;
     using NetStack = std::vector<std::string>;
@@ -20,6 +34,7 @@ private:
     using NetInfo = std::unordered_map<std::string, std::string>;
 
     void Parse(std::shared_ptr<DNNWeights> weights, std::istream &buffer);
+    void ParseBinary(std::shared_ptr<DNNWeights> weights, const MappedFile &file);
     void ParseInfo(NetInfo &netinfo, std::istream &buffer) const;
     void ParseStack(NetStack &netstack, std::istream &buffer) const;
     void ParseStruct(NetStruct &netstruct, std::istream &buffer) const;
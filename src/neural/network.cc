@@ -27,6 +27,9 @@
 #include "utils/format.h"
 #include "utils/option.h"
 #include "utils/logits.h"
+#include "utils/profiler.h"
+#include "utils/affinity.h"
+#include "utils/fiber.h"
 
 #include <random>
 #include <sstream>
@@ -63,6 +66,7 @@ void Network::Initialize(const std::string &weightsfile) {
     // Initialize the parameters.
     no_cache_ = GetOption<bool>("no_cache");
     early_symm_cache_ = GetOption<bool>("early_symm_cache");
+    numa_ = GetOption<bool>("numa");
     cache_memory_mib_ = 0;
 
     pipe_ = std::make_unique<Backend>();
@@ -92,21 +96,51 @@ size_t Network::SetCacheSize(size_t MiB) {
                                size_t{128 * 1024}        // max: 128 GB
                            );
 
-    const size_t entry_byte = nn_cache_.GetEntrySize();
     const size_t mem_byte = mem_mib * 1024 * 1024;
-    size_t num_entries = mem_byte / entry_byte + 1;
 
     cache_memory_mib_ = mem_mib;
-    nn_cache_.SetCapacity(num_entries);
+
+    // The NUMA nodes share the memory. Every cache is first touched
+    // on its own node, so its pages are local.
+    const int num_caches = numa_ ? GetNumNumaNodes() : 1;
+    if ((int)nn_caches_.size() != num_caches) {
+        nn_caches_.clear();
+        for (int n = 0; n < num_caches; ++n) {
+            nn_caches_.emplace_back(std::make_unique<Cache>());
+        }
+    }
+    for (int n = 0; n < num_caches; ++n) {
+        auto &cache = *nn_caches_[n];
+        if (numa_) {
+            RunOnNumaNode(n, [&cache, mem_byte, num_caches]() {
+                cache.SetMemory(mem_byte / num_caches);
+            });
+        } else {
+            cache.SetMemory(mem_byte);
+        }
+    }
+
+    // The entries are variable-size. Report the number of entries
+    // on the default board size.
+    const int board_size = GetOption<int>("defualt_boardsize");
+    size_t num_entries = 0;
+    size_t mem_bytes = 0;
+    for (const auto &cache : nn_caches_) {
+        num_entries += cache->GetEffectiveCapacity(board_size);
+        mem_bytes += cache->GetMemory();
+    }
 
     const double mem_used =
-        static_cast<double>(num_entries * entry_byte) / (1024.f * 1024.f);
+        static_cast<double>(mem_bytes) / (1024.f * 1024.f);
     if (no_cache_) {
         LOGGING << "Disable the NN cache.\n";
     } else {
         LOGGING << Format(
-            "Allocated %.2f MiB memory for NN cache (%zu entries).\n",
-            mem_used, num_entries);
+            "Allocated %.2f MiB memory for NN cache (%zu entries on %dx%d).\n",
+            mem_used, num_entries, board_size, board_size);
+        if (num_caches > 1) {
+            LOGGING << Format("The NN cache is split into %d NUMA nodes.\n", num_caches);
+        }
     }
     return num_entries;
 }
@@ -116,7 +150,94 @@ size_t Network::GetCacheMib() const {
 }
 
 void Network::ClearCache() {
-    nn_cache_.Clear();
+    for (auto &cache : nn_caches_) {
+        cache->Clear();
+    }
+}
+
+Network::Cache &Network::GetLocalCache() {
+    if (nn_caches_.size() == 1) {
+        return *nn_caches_[0];
+    }
+    // The thread which is not pinned may move between the nodes. It
+    // always uses the first cache, so it finds its own results.
+    const int node = std::max(GetPinnedNumaNode(), 0);
+    return *nn_caches_[node % nn_caches_.size()];
+}
+
+Network::Cache::Stats Network::GetCacheStats() {
+    // Sum all caches.
+    auto stats = Cache::Stats{};
+    for (auto &cache : nn_caches_) {
+        const auto s = cache->GetStats();
+        stats.lookups += s.lookups;
+        stats.hits += s.hits;
+        stats.inserts += s.inserts;
+        stats.evictions += s.evictions;
+    }
+    return stats;
+}
+
+ForwardPipeStats Network::GetForwardStats() const {
+    return pipe_ ? pipe_->GetStats() : ForwardPipeStats{};
+}
+
+std::string Network::GetCacheStatsString() {
+    const auto stats = GetCacheStats();
+    auto num_entries = std::array<size_t, kBoardSize + 1>{};
+    size_t mem_bytes = 0;
+    for (auto &cache : nn_caches_) {
+        const auto n = cache->GetNumEntries();
+        for (int bsize = 0; bsize <= kBoardSize; ++bsize) {
+            num_entries[bsize] += n[bsize];
+        }
+        mem_bytes += cache->GetMemory();
+    }
+    const auto GetCapacity = [this](int bsize) {
+        size_t capacity = 0;
+        for (const auto &cache : nn_caches_) {
+            capacity += cache->GetEffectiveCapacity(bsize);
+        }
+        return capacity;
+    };
+
+    const auto misses = stats.lookups - stats.hits;
+    const auto hit_rate = stats.lookups == 0 ?
+                              0.0 : 100.0 * stats.hits / stats.lookups;
+
+    auto out = std::ostringstream{};
+    out << Format("memory: %.2f MiB\n",
+                      static_cast<double>(mem_bytes) / (1024.f * 1024.f));
+    if (nn_caches_.size() > 1) {
+        out << Format("numa caches: %zu\n", nn_caches_.size());
+    }
+
+    // The entries of each board size and the number of entries which
+    // the whole table could hold in this board size.
+    for (int bsize = kMinGTPBoardSize; bsize <= kBoardSize; ++bsize) {
+        if (num_entries[bsize] == 0 && bsize != GetOption<int>("defualt_boardsize")) {
+            continue;
+        }
+        out << Format("%dx%d entries: %zu / %zu (%zu bytes per entry)\n",
+                          bsize, bsize,
+                          num_entries[bsize],
+                          GetCapacity(bsize),
+                          NNCache::GetEntrySize(bsize));
+    }
+    out << Format("lookups: %llu\n", (unsigned long long)stats.lookups)
+        << Format("hits: %llu (%.2f%%)\n", (unsigned long long)stats.hits, hit_rate)
+        << Format("misses: %llu\n", (unsigned long long)misses)
+        << Format("inserts: %llu\n", (unsigned long long)stats.inserts)
+        << Format("evictions: %llu\n", (unsigned long long)stats.evictions)
+        << Format("workspace allocations: %llu",
+                      (unsigned long long)GetForwardStats().workspace_allocations);
+    return out.str();
+}
+
+void Network::ResetCacheStats() {
+    for (auto &cache : nn_caches_) {
+        cache->ResetStats();
+    }
 }
 
 size_t Network::GetNumQueries() const {
@@ -147,21 +268,31 @@ Network::Result Network::DummyForward(const Network::Inputs& inputs) const {
 
 Network::Result
 Network::GetOutputInternal(const GameState &state, const int symmetry) {
-    Network::Result out_result;
     Network::Result result_buf;
 
     // apply symmetry
     auto inputs = Encoder::Get().GetInputs(state, symmetry);
 
-    if (pipe_->Valid()) {
+    if (pipe_->Valid() && Fiber::Current()) {
+        num_queries_.fetch_add(1, std::memory_order_relaxed);
+        GetPendingForwards().emplace_back(PendingForward{this, inputs, &result_buf});
+        PROFILE_YIELD();
+        Fiber::Yield();
+    } else if (pipe_->Valid()) {
+        PROFILE_SCOPE(kProfileForward);
         num_queries_.fetch_add(1, std::memory_order_relaxed);
         result_buf = pipe_->Forward(inputs);
     } else {
         result_buf = DummyForward(inputs);
     }
-    out_result = result_buf;
 
-    const auto boardsize = inputs.board_size;
+    return PostProcess(result_buf, inputs.board_size, symmetry);
+}
+
+Network::Result
+Network::PostProcess(const Result &result_buf, const int boardsize, const int symmetry) const {
+    Network::Result out_result = result_buf;
+
     const auto num_intersections = boardsize * boardsize;
 
     auto probabilities_buffer = std::vector<float>(num_intersections);
@@ -213,39 +344,24 @@ Network::GetOutputInternal(const GameState &state, const int symmetry) {
 }
 
 bool Network::ProbeCache(const GameState &state,
-                         Network::Result &result) {
-    if (nn_cache_.LookupItem(state.GetHash(), result)) {
-        if (result.board_size == state.GetBoardSize()) {
-            return true;
-        }
+                         Network::Result &result,
+                         const int fields) {
+    PROFILE_SCOPE(kProfileCacheProbe);
+    PROFILE_COUNT(kProfileCacheLookups, 1);
+
+    const int boardsize = state.GetBoardSize();
+    if (GetLocalCache().Lookup(state.GetHash(), boardsize,
+                         Symmetry::kIdentitySymmetry, result, fields)) {
+        PROFILE_COUNT(kProfileCacheHits, 1);
+        return true;
     }
 
     if (state.GetBoardSize() >= state.GetMoveNumber() && early_symm_cache_) {
         for (int symm = Symmetry::kIdentitySymmetry+1; symm < Symmetry::kNumSymmetris; ++symm) {
-            if (nn_cache_.LookupItem(state.ComputeSymmetryHash(symm), result)) {
-                if (result.board_size != state.GetBoardSize()) {
-                    break;
-                }
-                const int boardsize = result.board_size;
-                const int num_intersections = state.GetNumIntersections();
-
-                auto probabilities_buffer = std::vector<float>(num_intersections);
-                auto ownership_buffer = std::vector<float>(num_intersections);
-
-                // copy result to buffer
-                std::copy(std::begin(result.probabilities),
-                              std::begin(result.probabilities) + num_intersections,
-                              std::begin(probabilities_buffer));
-                std::copy(std::begin(result.ownership),
-                              std::begin(result.ownership) + num_intersections,
-                              std::begin(ownership_buffer));
-
-                // apply invert symmetry
-                for (int idx = 0; idx < num_intersections; ++idx) {
-                    const auto symm_index = Symmetry::Get().TransformIndex(boardsize, symm, idx);
-                    result.probabilities[idx] = probabilities_buffer[symm_index];
-                    result.ownership[idx] = ownership_buffer[symm_index];
-                }
+            // The cache applies the invert symmetry.
+            if (GetLocalCache().Lookup(state.ComputeSymmetryHash(symm), boardsize,
+                                 symm, result, fields)) {
+                PROFILE_COUNT(kProfileCacheHits, 1);
                 return true;
             }
         }
@@ -260,6 +376,26 @@ Network::GetOutput(const GameState &state,
                    int symmetry,
                    const bool read_cache,
                    const bool write_cache) {
+    return GetOutputFields(state, ensemble, temperature, symmetry,
+                           read_cache, write_cache, Cache::kAllFields);
+}
+
+Network::Result
+Network::GetPolicyOutput(const GameState &state,
+                         const Ensemble ensemble,
+                         const float temperature) {
+    return GetOutputFields(state, ensemble, temperature, -1,
+                           true, true, Cache::kPolicyField);
+}
+
+Network::Result
+Network::GetOutputFields(const GameState &state,
+                         const Ensemble ensemble,
+                         const float temperature,
+                         int symmetry,
+                         const bool read_cache,
+                         const bool write_cache,
+                         const int fields) {
     Result result;
     if (ensemble == kNone) {
         symmetry = Symmetry::kIdentitySymmetry;
@@ -273,7 +409,7 @@ Network::GetOutput(const GameState &state,
 
     // Try to get forwarding result from cache.
     if (read_cache && !no_cache_) {
-        if (ProbeCache(state, result)) {
+        if (ProbeCache(state, result, fields)) {
             probed = true;
         }
     }
@@ -283,7 +419,7 @@ Network::GetOutput(const GameState &state,
 
         // Write forwarding result to cache.
         if (write_cache && !no_cache_) {
-            nn_cache_.Insert(state.GetHash(), result);
+            GetLocalCache().Insert(state.GetHash(), result);
         }
     }
 
@@ -292,6 +428,129 @@ Network::GetOutput(const GameState &state,
     return result;
 }
 
+std::vector<Network::Result>
+Network::GetOutputs(const std::vector<const GameState*> &states,
+                    const Ensemble ensemble,
+                    const float temperature) {
+    assert(ensemble != kDirect);
+
+    const auto size = states.size();
+    auto results = std::vector<Result>(size);
+
+    auto symmetries = std::vector<int>{};
+    auto indices = std::vector<size_t>{};
+    auto inputs = std::vector<Inputs>{};
+
+    for (auto i = size_t{0}; i < size; ++i) {
+        const auto &state = *states[i];
+
+        // Try to get forwarding result from cache.
+        if (!no_cache_ && ProbeCache(state, results[i])) {
+            continue;
+        }
+
+        auto symmetry = Symmetry::kIdentitySymmetry;
+        if (ensemble == kRandom) {
+            symmetry = Random<>::Get().RandFix<Symmetry::kNumSymmetris>();
+        }
+        symmetries.emplace_back(symmetry);
+        indices.emplace_back(i);
+        inputs.emplace_back(Encoder::Get().GetInputs(state, symmetry));
+    }
+
+    // Forward all missing positions as one group.
+    auto raw_results = std::vector<Result>{};
+    if (inputs.empty()) {
+        // All positions are found in the cache.
+    } else if (pipe_->Valid()) {
+        num_queries_.fetch_add(inputs.size(), std::memory_order_relaxed);
+        ForwardInputs(inputs, raw_results);
+    } else {
+        for (const auto &in : inputs) {
+            raw_results.emplace_back(DummyForward(in));
+        }
+    }
+
+    for (auto j = size_t{0}; j < indices.size(); ++j) {
+        const auto i = indices[j];
+        results[i] = PostProcess(raw_results[j], inputs[j].board_size, symmetries[j]);
+
+        // Write forwarding result to cache.
+        if (!no_cache_) {
+            GetLocalCache().Insert(states[i]->GetHash(), results[i]);
+        }
+    }
+
+    for (auto &result : results) {
+        ActivatePolicy(result, temperature);
+    }
+
+    return results;
+}
+
+void Network::ForwardInputs(const std::vector<Inputs> &inputs,
+                            std::vector<Result> &results) {
+    if (!Fiber::Current()) {
+        PROFILE_SCOPE(kProfileForward);
+        results = pipe_->Forward(inputs);
+        return;
+    }
+
+    results.resize(inputs.size());
+    auto &pending = GetPendingForwards();
+    for (auto i = size_t{0}; i < inputs.size(); ++i) {
+        pending.emplace_back(PendingForward{this, inputs[i], &results[i]});
+    }
+    PROFILE_YIELD();
+    Fiber::Yield();
+}
+
+std::vector<Network::PendingForward> &Network::GetPendingForwards() {
+    thread_local std::vector<PendingForward> pending;
+    return pending;
+}
+
+size_t Network::GetNumPendingForwards() {
+    return GetPendingForwards().size();
+}
+
+void Network::ForwardPending() {
+    auto &pending = GetPendingForwards();
+    if (pending.empty()) {
+        return;
+    }
+
+    // The pipe forwards the same board size inputs as one batch, so
+    // group them by the network and the board size first.
+    std::stable_sort(std::begin(pending), std::end(pending),
+                         [](const PendingForward &a, const PendingForward &b) {
+                             return std::make_pair(a.network, a.inputs.board_size) <
+                                        std::make_pair(b.network, b.inputs.board_size);
+                         });
+
+    auto inputs = std::vector<Inputs>{};
+    for (auto head = size_t{0}; head < pending.size();) {
+        auto network = pending[head].network;
+        auto tail = head;
+
+        inputs.clear();
+        while (tail < pending.size() && pending[tail].network == network) {
+            inputs.emplace_back(pending[tail++].inputs);
+        }
+
+        auto results = std::vector<Result>{};
+        {
+            PROFILE_SCOPE(kProfileForward);
+            results = network->pipe_->Forward(inputs);
+        }
+        for (auto i = head; i < tail; ++i) {
+            *pending[i].result = results[i - head];
+        }
+        head = tail;
+    }
+    pending.clear();
+}
+
 std::string Network::GetOutputString(const GameState &state,
                                      const Ensemble ensemble,
                                      int symmetry) {
@@ -351,7 +610,7 @@ void Network::ActivatePolicy(Result &result, const float temperature) const {
 int Network::GetVertexWithPolicy(const GameState &state,
                                  const float temperature,
                                  const bool allow_pass) {
-    const auto result = GetOutput(state, kRandom, temperature);
+    const auto result = GetPolicyOutput(state, kRandom, temperature);
     const auto boardsize = result.board_size;
     const auto num_intersections = boardsize * boardsize;
 
@@ -3,7 +3,7 @@
 #include "neural/network_basic.h"
 #include "neural/description.h"
 #include "game/game_state.h"
-#include "utils/cache.h"
+#include "neural/nn_cache.h"
 
 #include <memory>
 #include <array>
@@ -11,6 +11,7 @@
 #include <cmath>
 #include <string>
 #include <atomic>
+#include <vector>
 
 class Network {
 public:
@@ -20,7 +21,7 @@ public:
 
     using Inputs = InputData;
     using Result = OutputResult;
-    using Cache = HashKeyCache<Result>;
+    using Cache = NNCache;
     using PolicyVertexPair = std::pair<float, int>;
 
     void Initialize(const std::string &weights);
@@ -38,6 +39,18 @@ public:
                      const bool read_cache = true,
                      const bool write_cache = true);
 
+    // Same as GetOutput() but the ownership of a cached result is not
+    // expanded. It is for the callers which only read the policy.
+    Result GetPolicyOutput(const GameState &state,
+                           const Ensemble ensemble,
+                           const float temperature = 1.f);
+
+    // Compute the results of a group of positions. The positions missing
+    // in the cache are sent to the forward pipe together.
+    std::vector<Result> GetOutputs(const std::vector<const GameState*> &states,
+                                   const Ensemble ensemble,
+                                   const float temperature = 1.f);
+
     std::string GetOutputString(const GameState &state,
                                 const Ensemble ensemble,
                                 int symmetry = -1);
@@ -48,19 +61,68 @@ public:
     size_t GetCacheMib() const;
     void ClearCache();
 
+    // Return the hit/miss/eviction counters of NN cache.
+    std::string GetCacheStatsString();
+    Cache::Stats GetCacheStats();
+    void ResetCacheStats();
+
     size_t GetNumQueries() const;
 
+    // Return the batch counters of the forward pipe.
+    ForwardPipeStats GetForwardStats() const;
+
+    // The games running in the fibers suspend in the network forwarding.
+    // Their inputs wait in the queue of current thread until the
+    // scheduler forwards all of them as one group. The queue is shared
+    // by all networks, so the games may use the different networks.
+    static size_t GetNumPendingForwards();
+    static void ForwardPending();
+
 private:
+    struct PendingForward {
+        Network *network;
+        Inputs inputs;
+        Result *result;
+    };
+
+    // Forward the inputs in the forward pipe. Suspend the current fiber
+    // until ForwardPending() if it is in one.
+    void ForwardInputs(const std::vector<Inputs> &inputs,
+                       std::vector<Result> &results);
+
+    static std::vector<PendingForward> &GetPendingForwards();
+
     void ActivatePolicy(Result &result, const float temperature) const;
 
-    bool ProbeCache(const GameState &state, Result &result);
+    bool ProbeCache(const GameState &state, Result &result,
+                    const int fields = Cache::kAllFields);
+
+    Result GetOutputFields(const GameState &state,
+                           const Ensemble ensemble,
+                           const float temperature,
+                           int symmetry,
+                           const bool read_cache,
+                           const bool write_cache,
+                           const int fields);
 
     Result GetOutputInternal(const GameState &state, const int symmetry);
 
+    // Apply the inverse symmetry and the activations to the raw
+    // outputs of the forward pipe.
+    Result PostProcess(const Result &result_buf, const int boardsize, const int symmetry) const;
+
     Network::Result DummyForward(const Network::Inputs& inputs) const;
 
+    // Return the NN cache of the NUMA node which current thread is
+    // pinned to.
+    Cache &GetLocalCache();
+
     std::unique_ptr<NetworkForwardPipe> pipe_{nullptr};
-    Cache nn_cache_;
+
+    // Every NUMA node has its own cache in the NUMA mode. Otherwise
+    // there is only one.
+    std::vector<std::unique_ptr<Cache>> nn_caches_;
+    bool numa_{false};
 
     bool no_cache_;
     bool early_symm_cache_;
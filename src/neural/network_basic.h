@@ -3,7 +3,10 @@
 #include "neural/description.h"
 #include "game/types.h"
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 static constexpr int kInputChannels = 43; // 8 past moves * 3
                                           // 13 binary features
@@ -48,12 +51,34 @@ struct OutputResult {
     std::array<float, kNumIntersections> ownership;
 };
 
+// The batch counters of the forward pipe. The capacity is the sum of max
+// batch sizes, so the fill ratio is the inputs over the capacity.
+struct ForwardPipeStats {
+    std::uint64_t batches{0};
+    std::uint64_t inputs{0};
+    std::uint64_t capacity{0};
+    std::uint64_t workspace_allocations{0};
+};
+
 class NetworkForwardPipe {
 public:
+    virtual ~NetworkForwardPipe() = default;
+
     virtual void Initialize(std::shared_ptr<DNNWeights> weights) = 0;
 
     virtual OutputResult Forward(const InputData &inpnt) = 0;
 
+    // Compute a group of inputs. The backend may forward them as one
+    // batch. The default implementation computes them one by one.
+    virtual std::vector<OutputResult> Forward(const std::vector<InputData> &inputs) {
+        auto outputs = std::vector<OutputResult>{};
+        outputs.reserve(inputs.size());
+        for (const auto &input : inputs) {
+            outputs.emplace_back(Forward(input));
+        }
+        return outputs;
+    }
+
     virtual bool Valid() = 0;
 
     virtual void Load(std::shared_ptr<DNNWeights> weights) = 0;
@@ -63,4 +88,33 @@ public:
     virtual void Release() = 0;
 
     virtual void Destroy() = 0;
+
+    ForwardPipeStats GetStats() const {
+        auto stats = ForwardPipeStats{};
+        stats.batches = num_batches_.load(std::memory_order_relaxed);
+        stats.inputs = num_inputs_.load(std::memory_order_relaxed);
+        stats.capacity = batch_capacity_.load(std::memory_order_relaxed);
+        stats.workspace_allocations = workspace_allocations_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+protected:
+    // The backend calls it once per computed batch.
+    void AccumulateBatch(const int batch_size, const int max_batch_size) {
+        num_batches_.fetch_add(1, std::memory_order_relaxed);
+        num_inputs_.fetch_add(batch_size, std::memory_order_relaxed);
+        batch_capacity_.fetch_add(max_batch_size, std::memory_order_relaxed);
+    }
+
+    // The backend calls it when it (re)allocates the buffers of a
+    // thread. It should stop growing in steady state.
+    void AccumulateWorkspaceAllocation() {
+        workspace_allocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<std::uint64_t> num_batches_{0};
+    std::atomic<std::uint64_t> num_inputs_{0};
+    std::atomic<std::uint64_t> batch_capacity_{0};
+    std::atomic<std::uint64_t> workspace_allocations_{0};
 };
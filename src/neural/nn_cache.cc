@@ -0,0 +1,279 @@
+#include "neural/nn_cache.h"
+#include "game/symmetry.h"
+#include "utils/half.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// The cluster begins with the number of used bytes. The entries
+// follow it.
+constexpr size_t kClusterHeaderBytes = 8;
+
+// The fixed part of compact entry. The fp16 policy logits and
+// 8-bit ownership of every intersection follow it.
+struct EntryHeader {
+    std::uint64_t key;
+    std::uint16_t bytes;
+    std::uint8_t board_size;
+    std::uint8_t fp16;
+    float komi;
+    float pass_probability;
+    float wdl_winrate;
+    float stm_winrate;
+    float final_score;
+    float q_error;
+    float score_error;
+    float wdl[3];
+};
+
+constexpr float kOwnershipScale = 127.0f;
+
+std::uint32_t GetUsedBytes(const std::uint8_t *cluster) {
+    std::uint32_t used;
+    std::memcpy(&used, cluster, sizeof(used));
+    return used;
+}
+
+void SetUsedBytes(std::uint8_t *cluster, std::uint32_t used) {
+    std::memcpy(cluster, &used, sizeof(used));
+}
+
+EntryHeader GetHeader(const std::uint8_t *entry) {
+    EntryHeader header;
+    std::memcpy(&header, entry, sizeof(header));
+    return header;
+}
+
+} // namespace
+
+size_t NNCache::GetEntrySize(const int board_size) {
+    const size_t num_intersections = board_size * board_size;
+    const size_t bytes = sizeof(EntryHeader) +
+                             num_intersections * sizeof(half_float_t) +
+                             num_intersections * sizeof(std::int8_t);
+    return (bytes + 7) / 8 * 8;
+}
+
+void NNCache::SetMemory(size_t bytes) {
+    clusters_per_shard_ = std::max(
+        bytes / (kNumShards * kClusterBytes), size_t{1});
+
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+
+        shard.clusters = clusters_per_shard_;
+        shard.table.clear();
+        shard.table.resize(clusters_per_shard_ * kClusterBytes, 0);
+        shard.table.shrink_to_fit();
+        shard.num_entries.fill(0);
+    }
+}
+
+void NNCache::RemoveEntries(Shard &shard, std::uint8_t *cluster,
+                            size_t begin, size_t end, bool evicted) {
+    std::uint8_t *entries = cluster + kClusterHeaderBytes;
+    const auto used = GetUsedBytes(cluster);
+
+    for (size_t offset = begin; offset < end;) {
+        const auto header = GetHeader(entries + offset);
+        shard.num_entries[header.board_size]--;
+        if (evicted) {
+            shard.stats.evictions++;
+        }
+        offset += header.bytes;
+    }
+    std::memmove(entries + begin, entries + end, used - end);
+    SetUsedBytes(cluster, used - (end - begin));
+}
+
+void NNCache::Insert(std::uint64_t key, const OutputResult &result) {
+    const int board_size = result.board_size;
+    if (board_size <= 0 || board_size > kBoardSize) {
+        return;
+    }
+    const int num_intersections = board_size * board_size;
+    const size_t entry_bytes = GetEntrySize(board_size);
+    const size_t capacity = kClusterBytes - kClusterHeaderBytes;
+
+    auto &shard = GetShard(key);
+
+    SpinLock::Lock lock(shard.mutex);
+
+    if (shard.clusters == 0 || entry_bytes > capacity) {
+        return;
+    }
+
+    std::uint8_t *cluster = shard.table.data() +
+                                (key % shard.clusters) * kClusterBytes;
+    std::uint8_t *entries = cluster + kClusterHeaderBytes;
+
+    // Remove the old item with same key.
+    for (size_t offset = 0; offset < GetUsedBytes(cluster);) {
+        const auto header = GetHeader(entries + offset);
+        if (header.key == key) {
+            RemoveEntries(shard, cluster, offset, offset + header.bytes, false);
+            break;
+        }
+        offset += header.bytes;
+    }
+
+    // Evict the oldest items until the new item fits.
+    const auto used = GetUsedBytes(cluster);
+    if (used + entry_bytes > capacity) {
+        size_t end = 0;
+        while (used - end + entry_bytes > capacity) {
+            end += GetHeader(entries + end).bytes;
+        }
+        RemoveEntries(shard, cluster, 0, end, true);
+    }
+
+    std::uint8_t *entry = entries + GetUsedBytes(cluster);
+
+    EntryHeader header;
+    header.key = key;
+    header.bytes = entry_bytes;
+    header.board_size = board_size;
+    header.fp16 = result.fp16;
+    header.komi = result.komi;
+    header.pass_probability = result.pass_probability;
+    header.wdl_winrate = result.wdl_winrate;
+    header.stm_winrate = result.stm_winrate;
+    header.final_score = result.final_score;
+    header.q_error = result.q_error;
+    header.score_error = result.score_error;
+    std::copy(std::begin(result.wdl), std::end(result.wdl), header.wdl);
+    std::memcpy(entry, &header, sizeof(header));
+
+    std::uint8_t *policy = entry + sizeof(header);
+    std::uint8_t *ownership = policy + num_intersections * sizeof(half_float_t);
+    for (int idx = 0; idx < num_intersections; ++idx) {
+        const auto logit = GetFp16(result.probabilities[idx]);
+        const auto owner = std::min(std::max(result.ownership[idx], -1.0f), 1.0f);
+        std::memcpy(policy + idx * sizeof(half_float_t), &logit, sizeof(logit));
+        ownership[idx] = (std::int8_t)std::round(owner * kOwnershipScale);
+    }
+
+    SetUsedBytes(cluster, GetUsedBytes(cluster) + entry_bytes);
+    shard.num_entries[board_size]++;
+    shard.stats.inserts++;
+}
+
+bool NNCache::Lookup(std::uint64_t key, const int board_size,
+                     const int symmetry, OutputResult &result,
+                     const int fields) {
+    auto &shard = GetShard(key);
+
+    SpinLock::Lock lock(shard.mutex);
+
+    shard.stats.lookups++;
+    if (shard.clusters == 0) {
+        return false;
+    }
+
+    const std::uint8_t *cluster = shard.table.data() +
+                                      (key % shard.clusters) * kClusterBytes;
+    const std::uint8_t *entries = cluster + kClusterHeaderBytes;
+    const auto used = GetUsedBytes(cluster);
+
+    for (size_t offset = 0; offset < used;) {
+        const auto header = GetHeader(entries + offset);
+        if (header.key != key) {
+            offset += header.bytes;
+            continue;
+        }
+        if (header.board_size != board_size) {
+            return false;
+        }
+
+        result.fp16 = header.fp16;
+        result.board_size = header.board_size;
+        result.komi = header.komi;
+        result.pass_probability = header.pass_probability;
+        result.wdl_winrate = header.wdl_winrate;
+        result.stm_winrate = header.stm_winrate;
+        result.final_score = header.final_score;
+        result.q_error = header.q_error;
+        result.score_error = header.score_error;
+        std::copy(header.wdl, header.wdl + 3, std::begin(result.wdl));
+
+        // Expand the planes and apply the inverse symmetry.
+        const int num_intersections = board_size * board_size;
+        const std::uint8_t *policy = entries + offset + sizeof(header);
+        const std::uint8_t *ownership = policy + num_intersections * sizeof(half_float_t);
+
+        const bool read_policy = fields & kPolicyField;
+        const bool read_ownership = fields & kOwnershipField;
+
+        for (int idx = 0; idx < num_intersections; ++idx) {
+            const auto symm_index = symmetry == Symmetry::kIdentitySymmetry ?
+                                        idx :
+                                        Symmetry::Get().TransformIndex(board_size, symmetry, idx);
+            if (read_policy) {
+                half_float_t logit;
+                std::memcpy(&logit, policy + symm_index * sizeof(half_float_t), sizeof(logit));
+                result.probabilities[idx] = GetFp32(logit);
+            }
+            if (read_ownership) {
+                result.ownership[idx] = (std::int8_t)ownership[symm_index] / kOwnershipScale;
+            }
+        }
+        shard.stats.hits++;
+        return true;
+    }
+    return false;
+}
+
+void NNCache::Clear() {
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+
+        for (size_t i = 0; i < shard.clusters; ++i) {
+            SetUsedBytes(shard.table.data() + i * kClusterBytes, 0);
+        }
+        shard.num_entries.fill(0);
+    }
+}
+
+void NNCache::ResetStats() {
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        shard.stats = Stats{};
+    }
+}
+
+NNCache::Stats NNCache::GetStats() {
+    auto stats = Stats{};
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        stats.lookups += shard.stats.lookups;
+        stats.hits += shard.stats.hits;
+        stats.inserts += shard.stats.inserts;
+        stats.evictions += shard.stats.evictions;
+    }
+    return stats;
+}
+
+size_t NNCache::GetMemory() const {
+    return clusters_per_shard_ * kNumShards * kClusterBytes;
+}
+
+size_t NNCache::GetEffectiveCapacity(const int board_size) const {
+    const auto entries_per_cluster =
+        (kClusterBytes - kClusterHeaderBytes) / GetEntrySize(board_size);
+    return entries_per_cluster * clusters_per_shard_ * kNumShards;
+}
+
+std::array<size_t, kBoardSize + 1> NNCache::GetNumEntries() {
+    auto num_entries = std::array<size_t, kBoardSize + 1>{};
+    num_entries.fill(0);
+    for (auto &shard : shards_) {
+        SpinLock::Lock lock(shard.mutex);
+        for (int i = 0; i <= kBoardSize; ++i) {
+            num_entries[i] += shard.num_entries[i];
+        }
+    }
+    return num_entries;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "neural/network_basic.h"
+#include "game/types.h"
+#include "utils/mutex.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The NN cache with the compact entries. The entry only keeps the
+// intersections of its own board size. The policy logits are stored
+// as fp16 and the ownership is quantized to 8-bit. So the small
+// boards use much less memory than the full OutputResult.
+//
+// The table is split into shards and each shard has its own lock.
+// Every shard is divided into fixed-size clusters. The entries are
+// variable-size and packed in the cluster by insertion order. The
+// oldest entries are evicted if the new entry doesn't fit.
+class NNCache {
+public:
+    struct Stats {
+        std::uint64_t lookups{0};
+        std::uint64_t hits{0};
+        std::uint64_t inserts{0};
+        std::uint64_t evictions{0};
+    };
+
+    // The planes which the lookup expands. The scalar values are
+    // always read.
+    enum Field {
+        kPolicyField = 1 << 0,
+        kOwnershipField = 1 << 1,
+        kAllFields = kPolicyField | kOwnershipField
+    };
+
+    NNCache() = default;
+
+    // Allocate the table with given bytes. All items are removed.
+    void SetMemory(size_t bytes);
+
+    // Insert the new result to the cache.
+    void Insert(std::uint64_t key, const OutputResult &result);
+
+    // Lookup the item and expand it back to the result. Only the planes
+    // in the fields are expanded, the others are left untouched. The
+    // planes are transformed by the inverse of symmetry. Returns false
+    // if the item is not found or its board size is different.
+    bool Lookup(std::uint64_t key, const int board_size,
+                const int symmetry, OutputResult &result,
+                const int fields = kAllFields);
+
+    // Clear the hash table.
+    void Clear();
+
+    // Reset the hit/miss/eviction counters.
+    void ResetStats();
+
+    Stats GetStats();
+
+    // Return the bytes of table.
+    size_t GetMemory() const;
+
+    // Return the size of compact entry for the board size.
+    static size_t GetEntrySize(const int board_size);
+
+    // Return the number of entries which the table can hold if all
+    // of them are in this board size.
+    size_t GetEffectiveCapacity(const int board_size) const;
+
+    // Return the number of entries in the table for each board size.
+    std::array<size_t, kBoardSize + 1> GetNumEntries();
+
+private:
+    struct Shard {
+        SpinLock mutex;
+
+        std::vector<std::uint8_t> table GUARDED_BY(mutex);
+
+        size_t clusters GUARDED_BY(mutex){0};
+        Stats stats GUARDED_BY(mutex);
+        std::array<size_t, kBoardSize + 1> num_entries GUARDED_BY(mutex);
+    };
+
+    static constexpr size_t kClusterBytes = 8 * 1024;
+    static constexpr size_t kNumShards = 64;
+
+    // The low bits select the cluster in the shard so the shard is
+    // selected by the high bits.
+    Shard& GetShard(std::uint64_t key) {
+        return shards_[(key >> 48) % kNumShards];
+    }
+
+    // Remove the entries in the range of [begin, end) from cluster.
+    void RemoveEntries(Shard &shard, std::uint8_t *cluster,
+                       size_t begin, size_t end, bool evicted);
+
+    std::array<Shard, kNumShards> shards_;
+    size_t clusters_per_shard_{0};
+};
@@ -1,6 +1,18 @@
 #include "game/types.h"
 #include "neural/training.h"
 #include "neural/encoder.h"
+#include "utils/half.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+static constexpr char kBinaryMagic[4] = {'S', 'Y', 'B', 'D'};
+static constexpr size_t kBinaryHeaderSize = 80;
+
+// The version of binary records. It is independent of the text
+// version. The version 2 has no network hash, the header is 72 bytes.
+static constexpr std::uint8_t kBinaryVersion = 3;
 
 void ArrayStreamOut(std::ostream &out, const std::vector<float> &arr) {
     const auto size = arr.size();
@@ -95,6 +107,96 @@ void Training::StreamOut(std::ostream &out) const {
     out << kld << std::endl;
 }
 
+template<typename T>
+void BinaryPut(std::string &buf, const T val) {
+    // Assume that the machine is little-endian.
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &val, sizeof(T));
+    buf.append(bytes, sizeof(T));
+}
+
+void Fp16ArrayOut(std::string &buf, const std::vector<float> &arr) {
+    for (const auto v : arr) {
+        BinaryPut<half_float_t>(buf, GetFp16(v));
+    }
+}
+
+void BinaryPlanesOut(std::string &buf, const std::vector<float> &arr) {
+    const auto planes = Encoder::kPlaneChannels;
+    const auto spatial = arr.size() / planes;
+    const auto saved_planes = planes - Encoder::kNumMiscFeatures;
+
+    for (size_t p = 0; p < saved_planes; ++p) {
+        const auto *plane = arr.data() + spatial * p;
+        for (size_t idx = 0; idx < spatial; idx += 8) {
+            std::uint8_t byte = 0;
+            for (size_t b = 0; b < 8 && idx + b < spatial; ++b) {
+                byte |= (plane[idx + b] != 0.f) << b;
+            }
+            buf.push_back(byte);
+        }
+    }
+}
+
+void BinaryOwnershipOut(std::string &buf, const std::vector<int> &arr) {
+    const auto size = arr.size();
+    for (size_t idx = 0; idx < size; idx += 4) {
+        std::uint8_t byte = 0;
+        for (size_t b = 0; b < 4 && idx + b < size; ++b) {
+            const auto v = arr[idx + b];
+            const int code = v == 1 ? 1 : (v == -1 ? 3 : 0);
+            byte |= code << (2 * b);
+        }
+        buf.push_back(byte);
+    }
+}
+
+void Training::BinaryStreamOut(std::ostream &out) const {
+    if (discard) {
+        return;
+    }
+
+    auto buf = std::string{};
+    buf.reserve(GetBinaryTrainingSize(board_size));
+
+    // the "Header" part
+    buf.append(kBinaryMagic, sizeof(kBinaryMagic));
+    BinaryPut<std::uint8_t>(buf, kBinaryVersion);
+    BinaryPut<std::uint8_t>(buf, mode);
+    BinaryPut<std::uint8_t>(buf, board_size);
+    BinaryPut<std::uint8_t>(buf, side_to_move == kBlack ? 1 : 0);
+    BinaryPut<std::int8_t>(buf, result);
+    BinaryPut<std::uint8_t>(buf, Encoder::kPlaneChannels - Encoder::kNumMiscFeatures);
+    BinaryPut<std::uint16_t>(buf, 0);
+
+    for (const float v : {komi, rule, wave,
+                          avg_q_value, short_avg_q, middle_avg_q, long_avg_q,
+                          final_score,
+                          avg_score_lead, short_avg_score, middle_avg_score, long_avg_score,
+                          q_stddev, score_stddev,
+                          kld}) {
+        BinaryPut<float>(buf, v);
+    }
+    BinaryPut<std::uint64_t>(buf, net_hash);
+
+    // the "Body" part
+    BinaryPlanesOut(buf, planes);
+    Fp16ArrayOut(buf, probabilities);
+    Fp16ArrayOut(buf, auxiliary_probabilities);
+    BinaryOwnershipOut(buf, ownership);
+
+    out.write(buf.data(), buf.size());
+}
+
+size_t GetBinaryTrainingSize(int board_size) {
+    const size_t num_intersections = board_size * board_size;
+    const size_t binary_planes = Encoder::kPlaneChannels - Encoder::kNumMiscFeatures;
+    return kBinaryHeaderSize +
+               binary_planes * ((num_intersections + 7) / 8) +
+               2 * (num_intersections + 1) * sizeof(half_float_t) +
+               (num_intersections + 3) / 4;
+}
+
 int GetTrainingVersion() {
     return 2;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <iostream>
 
@@ -32,6 +33,10 @@ struct Training {
     float rule;
     float wave;
 
+    // The hash of network weights which played this move. It is only
+    // saved in the binary format.
+    std::uint64_t net_hash{0};
+
     bool discard{false};
 
  /*
@@ -64,8 +69,46 @@ struct Training {
 
   */
     void StreamOut(std::ostream &out) const;
+
+ /*
+    Binary format is here. Every record is a fixed size header followed
+    by the body. The body size only depends on the board size, so a chunk
+    of the same board size is an array of fixed size records. All values
+    are little-endian. The N is the number of intersections.
+
+    ------- Header (80 bytes) -------
+     char[4]   : Magic "SYBD"
+     uint8     : Binary Version, 3. The version 2 is the same without the
+                 network hash, the header is 72 bytes.
+     uint8     : Mode
+     uint8     : Board Size
+     uint8     : Current Player
+     int8      : Result
+     uint8     : Number of Binary Features
+     uint16    : Reserved
+     float32   : Komi, Rule, Wave
+     float32   : Average Q Value, Short, Middel, Long
+     float32   : Final Score
+     float32   : Average Score Lead, Short, Middel, Long
+     float32   : Q Stddev, Score Stddev
+     float32   : KLD
+     uint64    : Network Hash
+
+     ------- Body -------
+     Binary Features         : ceil(N/8) bytes per plane, bit-packed from
+                               the lowest bit
+     Probabilities           : (N+1) float16
+     Auxiliary Probabilities : (N+1) float16
+     Ownership               : ceil(N/4) bytes, 2 bits per intersection
+                               from the lowest bits, same code as the text
+
+  */
+    void BinaryStreamOut(std::ostream &out) const;
 };
 
+// The size in bytes of one binary record.
+size_t GetBinaryTrainingSize(int board_size);
+
 int GetTrainingVersion();
 
 int GetTrainingMode();
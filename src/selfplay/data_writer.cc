@@ -0,0 +1,105 @@
+#include "selfplay/data_writer.h"
+#include "utils/gzip_helper.h"
+#include "utils/filesystem.h"
+#include "utils/log.h"
+
+#include <algorithm>
+
+DataWriter::DataWriter(bool binary, int compression_level, size_t max_queue)
+    : binary_(binary),
+      compression_level_(compression_level),
+      max_queue_(std::max(max_queue, size_t{1})) {
+    thread_ = std::thread([this]() { Loop(); });
+}
+
+DataWriter::~DataWriter() {
+    Finish();
+}
+
+bool DataWriter::Push(std::string filename, std::vector<Training> &chunk) {
+    filename += binary_ ? ".bin" : ".txt";
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        space_cv_.wait(lock, [this]() {
+            return queue_.size() < max_queue_ || !running_;
+        });
+        if (!running_) {
+            // No thread would write it.
+            LOGGING << "The data writer is finished. Discard the chunk: "
+                        << filename << '!' << std::endl;
+            return false;
+        }
+        queue_.emplace_back(Job{filename, std::move(chunk)});
+    }
+    chunk.clear();
+    cv_.notify_one();
+    return !fail_.load(std::memory_order_relaxed);
+}
+
+void DataWriter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+size_t DataWriter::GetWrittenChunks() const {
+    return written_chunks_.load(std::memory_order_relaxed);
+}
+
+size_t DataWriter::GetWrittenBytes() const {
+    return written_bytes_.load(std::memory_order_relaxed);
+}
+
+void DataWriter::Loop() {
+    while (true) {
+        auto job = Job{};
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() {
+                return !queue_.empty() || !running_;
+            });
+
+            // Drain the queue before exiting.
+            if (queue_.empty()) {
+                return;
+            }
+            job = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        space_cv_.notify_one();
+
+        if (!WriteChunk(job)) {
+            fail_.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool DataWriter::WriteChunk(Job &job) {
+    GzipOutputStream out(job.filename, compression_level_);
+    if (!out.IsOpen()) {
+        LOGGING << "Fail to create the file: " << out.GetFileName() << '!' << std::endl;
+        return false;
+    }
+
+    for (auto &data : job.chunk) {
+        if (binary_) {
+            data.BinaryStreamOut(out);
+        } else {
+            data.StreamOut(out);
+        }
+    }
+    const auto filename = out.GetFileName();
+    if (!out.Close()) {
+        LOGGING << "Fail to write the file: " << filename << '!' << std::endl;
+        return false;
+    }
+
+    written_chunks_.fetch_add(1, std::memory_order_relaxed);
+    written_bytes_.fetch_add(GetFileSize(filename), std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "neural/training.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The background writer of the training data. The self-play threads
+// only move the chunks into the queue. The writer thread serializes
+// and compresses them, so the compression never runs in the lock of
+// self-play threads. The queue is bounded. The self-play threads only
+// wait for it if the disk is much slower than the games.
+class DataWriter {
+public:
+    DataWriter(bool binary, int compression_level, size_t max_queue = 16);
+    ~DataWriter();
+
+    // Queue the chunk and clear it. The file suffix depends on the
+    // format. Return false if the writer failed before or it is
+    // finished. The chunk is kept if it is not queued.
+    bool Push(std::string filename, std::vector<Training> &chunk);
+
+    // Write all queued chunks and stop the writer thread.
+    void Finish();
+
+    size_t GetWrittenChunks() const;
+    size_t GetWrittenBytes() const;
+
+private:
+    struct Job {
+        std::string filename;
+        std::vector<Training> chunk;
+    };
+
+    void Loop();
+    bool WriteChunk(Job &job);
+
+    bool binary_;
+    int compression_level_;
+    size_t max_queue_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;       // Notify the writer thread.
+    std::condition_variable space_cv_; // Notify the self-play threads.
+    std::deque<Job> queue_;
+    bool running_{true};
+
+    std::atomic<bool> fail_{false};
+    std::atomic<size_t> written_chunks_{0};
+    std::atomic<size_t> written_bytes_{0};
+
+    std::thread thread_;
+};
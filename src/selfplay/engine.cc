@@ -4,12 +4,25 @@
 #include "utils/komi.h"
 #include "utils/filesystem.h"
 #include "game/sgf.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/time.h"
 #include "config.h"
 
 #include <sstream>
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 
+Engine::~Engine() {
+    StopWatcher();
+
+    // Release the searches before their networks.
+    search_pool_.clear();
+    game_networks_.clear();
+    network_.reset();
+}
+
 void Engine::Initialize() {
     default_playouts_ = GetOption<int>("playouts");
     komi_stddev_ = GetOption<float>("komi_stddev");
@@ -22,10 +35,14 @@ void Engine::Initialize() {
     parallel_games_ = GetOption<int>("parallel_games");
     last_net_accm_queries_ = 0;
 
-    if (!network_) {
-        network_ = std::make_unique<Network>();
-    }
-    network_->Initialize(SelectWeights());
+    ParseQueries();
+
+    StopWatcher();
+    weights_file_.name = SelectWeights();
+    weights_file_.time = GetFileTime(weights_file_.name);
+    weights_file_.size = GetFileSize(weights_file_.name);
+    net_hash_ = GetFileHash(weights_file_.name);
+    network_ = LoadNetwork(weights_file_.name);
 
     game_pool_.clear();
     for (int i = 0; i < parallel_games_; ++i) {
@@ -35,13 +52,138 @@ void Engine::Initialize() {
     }
 
     search_pool_.clear();
+    game_networks_.clear();
+    game_net_hashes_.clear();
     for (int i = 0; i < parallel_games_; ++i) {
         search_pool_.emplace_back(std::make_unique<Search>(game_pool_[i], *network_));
+        game_networks_.emplace_back(network_);
+        game_net_hashes_.emplace_back(net_hash_);
     }
 
-    ThreadPool::Get(GetOption<int>("threads") * parallel_games_);
+    // Every game searches in its own thread or fiber. Only the helper
+    // threads are in the pool.
+    ThreadPool::Get((GetOption<int>("threads") - 1) * parallel_games_);
 
-    ParseQueries();
+    // Only watch the directory if the weights file is not fixed.
+    if (GetOption<std::string>("weights_file").empty() &&
+            !GetOption<std::string>("weights_dir").empty()) {
+        watching_ = true;
+        watcher_ = std::thread([this]() { WatchWeights(); });
+    }
+}
+
+std::shared_ptr<Network> Engine::LoadNetwork(const std::string &weights) {
+    // Count the queries of the network before it is released.
+    auto network = std::shared_ptr<Network>(
+                       new Network,
+                       [this](Network *n) {
+                           const auto cache = n->GetCacheStats();
+                           const auto forward = n->GetForwardStats();
+                           {
+                               std::lock_guard<std::mutex> lock(stats_mutex_);
+                               released_stats_.queries += n->GetNumQueries();
+                               released_stats_.cache_lookups += cache.lookups;
+                               released_stats_.cache_hits += cache.hits;
+                               released_stats_.forward.batches += forward.batches;
+                               released_stats_.forward.inputs += forward.inputs;
+                               released_stats_.forward.capacity += forward.capacity;
+                           }
+                           n->Destroy();
+                           delete n;
+                       });
+    network->Initialize(weights);
+
+    // Adjust the matched NN size.
+    network->Reload(max_board_size_);
+    return network;
+}
+
+void Engine::WatchWeights() {
+    constexpr int kWatchIntervalSeconds = 10;
+    auto candidate = WeightsFile{};
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(watcher_mutex_);
+            watcher_cv_.wait_for(lock, std::chrono::seconds(kWatchIntervalSeconds),
+                                 [this]() { return !watching_; });
+            if (!watching_) {
+                break;
+            }
+        }
+
+        auto newest = WeightsFile{};
+        newest.name = SelectWeights();
+        newest.time = GetFileTime(newest.name);
+        newest.size = GetFileSize(newest.name);
+
+        if (newest.name.empty() ||
+                (newest.name == weights_file_.name &&
+                     newest.time == weights_file_.time &&
+                     newest.size == weights_file_.size)) {
+            continue;
+        }
+
+        // The file may be still being written. Load it if it does not
+        // change in the last interval.
+        if (newest.name != candidate.name ||
+                newest.time != candidate.time ||
+                newest.size != candidate.size) {
+            candidate = newest;
+            continue;
+        }
+
+        // Load it in this thread. The games keep playing with the
+        // current network.
+        Timer timer;
+        auto network = LoadNetwork(newest.name);
+        const auto net_hash = GetFileHash(newest.name);
+        weights_file_ = newest;
+
+        if (!network->Valid()) {
+            LOGGING << "Fail to load the new weights: " << newest.name << std::endl;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(network_mutex_);
+            network_ = network;
+            net_hash_ = net_hash;
+        }
+        LOGGING << '[' << CurrentDateTime() << ']'
+                    << " Load the new weights " << newest.name
+                    << Format(" (hash %016llx)", (unsigned long long)net_hash)
+                    << Format(" in %.2f sec.", timer.GetDuration()) << std::endl;
+    }
+}
+
+void Engine::StopWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(watcher_mutex_);
+        watching_ = false;
+    }
+    watcher_cv_.notify_all();
+    if (watcher_.joinable()) {
+        watcher_.join();
+    }
+}
+
+void Engine::UpdateNetwork(int g) {
+    std::lock_guard<std::mutex> lock(network_mutex_);
+    if (game_networks_[g] == network_) {
+        return;
+    }
+
+    // Release the old search before its network. The old network and
+    // its cache are released after its last game.
+    search_pool_[g].reset();
+    search_pool_[g] = std::make_unique<Search>(game_pool_[g], *network_);
+    game_networks_[g] = network_;
+    game_net_hashes_[g] = net_hash_;
+}
+
+Network &Engine::GetNetwork(int g) {
+    return *game_networks_[g];
 }
 
 std::string Engine::SelectWeights() const {
@@ -130,22 +272,36 @@ void Engine::ParseQueries() {
         }
     }
 
-    // Adjust the matched NN size.
-    network_->Reload(max_bsize);
+    max_board_size_ = max_bsize;
 }
 
 void Engine::SaveSgf(std::string filename, int g) {
     Handel(g);
-    Sgf::Get().ToFile(filename, game_pool_[g]);
+    auto &state = game_pool_[g];
+
+    // Record the network in the root comment.
+    auto comment = Format("network hash: %016llx",
+                              (unsigned long long)game_net_hashes_[g]);
+    if (!state.GetComment(0).empty()) {
+        comment = state.GetComment(0) + ", " + comment;
+    }
+    state.RewriteComment(comment, 0);
+    Sgf::Get().ToFile(filename, state);
 }
 
 void Engine::GatherTrainingData(std::vector<Training> &chunk, int g) {
     Handel(g);
+    const auto begin = chunk.size();
     search_pool_[g]->GatherTrainingBuffer(chunk, game_pool_[g]);
+
+    for (auto i = begin; i < chunk.size(); ++i) {
+        chunk[i].net_hash = game_net_hashes_[g];
+    }
 }
 
 void Engine::PrepareGame(int g) {
     Handel(g);
+    UpdateNetwork(g);
     auto &state = game_pool_[g];
 
     state.ClearBoard();
@@ -175,12 +331,15 @@ void Engine::PrepareGame(int g) {
     }
 }
 
-void Engine::Selfplay(int g) {
+int Engine::Selfplay(int g) {
     Handel(g);
     auto &state = game_pool_[g];
+    int moves = 0;
     while (!state.IsGameOver()) {
         state.PlayMove(search_pool_[g]->GetSelfPlayMove());
+        moves += 1;
     }
+    return moves;
 }
 
 void Engine::SetNormalGame(int g) {
@@ -197,7 +356,7 @@ void Engine::SetHandicapGame(int g, int handicaps) {
 
     for (int i = 0; i < handicaps-1; ++i) {
         state.SetToMove(kBlack);
-        int random_move = network_->GetVertexWithPolicy(state, 0.8f, false);
+        int random_move = GetNetwork(g).GetVertexWithPolicy(state, 0.8f, false);
         state.AppendMove(random_move, kBlack);
     }
     state.SetHandicap(handicaps);
@@ -235,7 +394,7 @@ void Engine::SetRandomOpeningGame(int g) {
         float curr_temp = std::max(
             init_temp * std::exp(-(lambda * times)), 0.8f);
 
-        int random_move = network_->GetVertexWithPolicy(state, curr_temp, false);
+        int random_move = GetNetwork(g).GetVertexWithPolicy(state, curr_temp, false);
         state.PlayMove(random_move);
         times += 1;
     }
@@ -292,14 +451,56 @@ int Engine::GetParallelGames() const {
     return parallel_games_;
 }
 
+Engine::NetworkStats Engine::GetNetworkStats() {
+    auto networks = std::vector<std::shared_ptr<Network>>{};
+    {
+        // Count every alive network once.
+        std::lock_guard<std::mutex> lock(network_mutex_);
+        networks = game_networks_;
+        networks.emplace_back(network_);
+    }
+    std::sort(std::begin(networks), std::end(networks));
+    networks.erase(std::unique(std::begin(networks), std::end(networks)),
+                   std::end(networks));
+
+    auto stats = NetworkStats{};
+    for (const auto &network : networks) {
+        const auto cache = network->GetCacheStats();
+        const auto forward = network->GetForwardStats();
+        stats.queries += network->GetNumQueries();
+        stats.cache_lookups += cache.lookups;
+        stats.cache_hits += cache.hits;
+        stats.forward.batches += forward.batches;
+        stats.forward.inputs += forward.inputs;
+        stats.forward.capacity += forward.capacity;
+    }
+
+    // Release the copies first. The deleter of the last network
+    // locks the stats.
+    networks.clear();
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats.queries += released_stats_.queries;
+    stats.cache_lookups += released_stats_.cache_lookups;
+    stats.cache_hits += released_stats_.cache_hits;
+    stats.forward.batches += released_stats_.forward.batches;
+    stats.forward.inputs += released_stats_.forward.inputs;
+    stats.forward.capacity += released_stats_.forward.capacity;
+    return stats;
+}
+
 size_t Engine::GetNetReportQueries() {
-    size_t curr_net_accm_queries = network_->GetNumQueries();
+    const size_t curr_net_accm_queries = GetNetworkStats().queries;
     const auto report_queries =
         curr_net_accm_queries - last_net_accm_queries_;
     last_net_accm_queries_ = curr_net_accm_queries;
     return report_queries;
 }
 
+void Engine::ForwardPending() {
+    Network::ForwardPending();
+}
+
 void Engine::Handel(int g) {
     if (g < 0 || g >= parallel_games_) {
         throw std::runtime_error("Selection is out of array.");
@@ -4,20 +4,44 @@
 #include "game/types.h"
 #include "mcts/search.h"
 
-#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 class Engine {
 public:
+    // The counters of all networks, including the released ones.
+    struct NetworkStats {
+        std::uint64_t queries{0};
+        std::uint64_t cache_lookups{0};
+        std::uint64_t cache_hits{0};
+        ForwardPipeStats forward;
+    };
+
+    ~Engine();
+
     void Initialize();
 
     void SaveSgf(std::string filename, int g);
     void GatherTrainingData(std::vector<Training> &chunk, int g);
     void PrepareGame(int g);
-    void Selfplay(int g);
+
+    // Play the game until it is over. Return the number of searched
+    // moves.
+    int Selfplay(int g);
 
     int GetParallelGames() const;
     size_t GetNetReportQueries();
+    NetworkStats GetNetworkStats();
+
+    // Forward the inputs of the games suspended in current thread.
+    void ForwardPending();
 
 private:
     struct BoardQuery {
@@ -31,8 +55,27 @@ private:
         float probabilities;
     };
 
+    struct WeightsFile {
+        std::string name;
+        std::time_t time{0};
+        std::uint64_t size{0};
+    };
+
     std::string SelectWeights() const;
 
+    // Load the network and adjust it to the max board size.
+    std::shared_ptr<Network> LoadNetwork(const std::string &weights);
+
+    // Watch the weights directory. Load the new weights in the
+    // background and publish it. The games switch to it at their
+    // next start.
+    void WatchWeights();
+    void StopWatcher();
+
+    // Switch the game to the newest network if it is not.
+    void UpdateNetwork(int g);
+    Network &GetNetwork(int g);
+
     void ParseQueries();
     void SetNormalGame(int g);
     void SetHandicapGame(int g, int handicaps);
@@ -58,9 +101,27 @@ private:
     std::vector<BoardQuery> board_queries_;
     std::vector<HandicapQuery> handicap_queries_;
 
-    std::unique_ptr<Network> network_{nullptr};
+    int max_board_size_;
+
+    // The newest network. The older ones are released after their last
+    // games end.
+    std::shared_ptr<Network> network_{nullptr};
+    std::uint64_t net_hash_{0};
+    std::mutex network_mutex_;
+
+    std::vector<std::shared_ptr<Network>> game_networks_;
+    std::vector<std::uint64_t> game_net_hashes_;
     std::vector<std::unique_ptr<Search>> search_pool_;
     std::vector<GameState> game_pool_;
 
+    WeightsFile weights_file_;
+    std::thread watcher_;
+    std::mutex watcher_mutex_;
+    std::condition_variable watcher_cv_;
+    bool watching_{false};
+
+    // The counters of the released networks.
+    NetworkStats released_stats_;
+    std::mutex stats_mutex_;
     size_t last_net_accm_queries_;
 };
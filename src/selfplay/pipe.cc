@@ -3,8 +3,13 @@
 #include "utils/filesystem.h"
 #include "utils/log.h"
 #include "utils/gzip_helper.h"
+#include "utils/fiber.h"
+#include "utils/format.h"
 #include "config.h"
 
+#include <algorithm>
+#include <chrono>
+
 SelfPlayPipe::SelfPlayPipe() {
     Initialize();
     Loop();
@@ -24,6 +29,8 @@ void SelfPlayPipe::Initialize() {
     accmulate_games_.store(0, std::memory_order_relaxed);
     played_games_.store(0, std::memory_order_relaxed);
     running_threads_.store(0, std::memory_order_relaxed);
+    played_moves_.store(0, std::memory_order_relaxed);
+    data_wait_ns_.store(0, std::memory_order_relaxed);
 
     chunk_games_ = 0;
 
@@ -57,39 +64,15 @@ void SelfPlayPipe::Initialize() {
 
 bool SelfPlayPipe::SaveChunk(const int out_id,
                              std::vector<Training> &chunk) {
+    // The writer adds the file suffix.
     auto out_name = ConcatPath(
                         data_directory_hash_,
                         filename_hash_ +
                             "_" +
-                            std::to_string(out_id) +
-                            ".txt");
-
-    auto oss = std::ostringstream{};
-    for (auto &data : chunk) {
-        data.StreamOut(oss);
-    }
+                            std::to_string(out_id));
 
-    bool is_open = true;
-
-    try {
-        auto buf = oss.str();
-        SaveGzip(out_name, buf);
-    } catch (const char *err) {
-        auto file = std::ofstream{};
-        file.open(out_name, std::ios_base::app);
-
-        if (!file.is_open()) {
-            is_open = false;
-            LOGGING << "Fail to create the file: " << out_name << '!' << std::endl;
-        } else {
-            for (auto &data : chunk) {
-                data.StreamOut(file);
-            }
-            file.close();
-        }
-    }
-    chunk.clear();
-    return is_open;
+    // Only queue the chunk. The writer thread compresses it.
+    return data_writer_->Push(out_name, chunk);
 }
 
 bool SelfPlayPipe::SaveNetQueries(const size_t queries) {
@@ -112,6 +95,102 @@ bool SelfPlayPipe::SaveNetQueries(const size_t queries) {
     return is_open;
 }
 
+float SelfPlayPipe::GetGamesPerHour() const {
+    const auto elapsed = std::max(timer_.GetDuration(), 1e-3f);
+    return played_games_.load(std::memory_order_relaxed) * 3600.f / elapsed;
+}
+
+SelfPlayCounters SelfPlayPipe::GetCounters() {
+    auto counters = SelfPlayCounters{};
+    counters.games = played_games_.load(std::memory_order_relaxed);
+    counters.moves = played_moves_.load(std::memory_order_relaxed);
+    counters.data_wait_ns = data_wait_ns_.load(std::memory_order_relaxed);
+    counters.network = engine_.GetNetworkStats();
+    return counters;
+}
+
+void SelfPlayPipe::PlayGames(const int g) {
+    constexpr int kGamesPerChunk = 25;
+    auto sgf_filename = ConcatPath(
+                            sgf_directory_, filename_hash_ + ".sgf");
+    running_threads_.fetch_add(1, std::memory_order_relaxed);
+
+    while (accmulate_games_.fetch_add(1) < max_games_) {
+        engine_.PrepareGame(g);
+        const int moves = engine_.Selfplay(g);
+        played_moves_.fetch_add(moves, std::memory_order_relaxed);
+
+        {
+            // Save the current chunk.
+            const auto wait_begin = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(data_mutex_);
+            data_wait_ns_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - wait_begin).count(),
+                std::memory_order_relaxed);
+
+            engine_.GatherTrainingData(chunk_, g);
+
+            if ((chunk_games_+1) % kGamesPerChunk == 0) {
+                if (!SaveChunk(chunk_games_/kGamesPerChunk, chunk_)) {
+                    break;
+                }
+            }
+            engine_.SaveSgf(sgf_filename, g);
+            chunk_games_ += 1;
+        }
+
+        played_games_.fetch_add(1);
+        auto played_games = played_games_.load(std::memory_order_relaxed);
+
+        if (played_games % 100 == 0) {
+            std::lock_guard<std::mutex> lock(log_mutex_);
+            LOGGING << '[' << CurrentDateTime() << ']' << " Played " << played_games << " games, "
+                        << Format("%.1f", GetGamesPerHour()) << " games/hour." << std::endl;
+            SaveNetQueries(engine_.GetNetReportQueries());
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        running_threads_.fetch_sub(1, std::memory_order_relaxed);
+
+        // The last thread saves the remaining training data.
+        if (!chunk_.empty() &&
+                running_threads_.load(std::memory_order_relaxed) == 0) {
+            SaveChunk(chunk_games_/kGamesPerChunk, chunk_);
+            chunk_games_ += 1;
+        }
+    }
+}
+
+void SelfPlayPipe::CooperativeLoop(const int index, const int num_threads) {
+    // Every game of this thread runs in its own fiber. The fiber
+    // suspends in the network forwarding, so the next game runs.
+    auto fibers = std::vector<std::unique_ptr<Fiber>>{};
+    for (int g = index; g < engine_.GetParallelGames(); g += num_threads) {
+        fibers.emplace_back(std::make_unique<Fiber>(
+                                [this, g]() -> void {
+                                    PlayGames(g);
+                                }));
+    }
+
+    while (true) {
+        bool running = false;
+        for (auto &fiber : fibers) {
+            fiber->Resume();
+            running |= !fiber->Finished();
+        }
+        if (!running) {
+            break;
+        }
+
+        // All unfinished games are waiting for the network. Forward
+        // them as one group.
+        engine_.ForwardPending();
+    }
+}
+
 void SelfPlayPipe::Loop() {
     // Be sure that all data are ready.
     if (target_directory_.size() == 0) {
@@ -135,6 +214,12 @@ void SelfPlayPipe::Loop() {
     LOGGING << "Hash value: " << filename_hash_ << std::endl;
     LOGGING << "Target self-play games: " << max_games_ << std::endl;
     LOGGING << "Directory for saving: " << target_directory_  << std::endl;
+    LOGGING << "Training data format: " << (GetOption<bool>("binary_data") ? "binary" : "text")
+                << ", compression level " << GetOption<int>("compression_level") << std::endl;
+    if (GetOption<int>("stats_interval") > 0) {
+        LOGGING << "Throughput stats: every " << GetOption<int>("stats_interval")
+                    << " seconds to selfplay_stats.jsonl" << std::endl;
+    }
     LOGGING << "Starting time is: " << CurrentDateTime()  << std::endl;
 
     if (!IsDirectoryExist(data_directory_)) {
@@ -147,62 +232,56 @@ void SelfPlayPipe::Loop() {
         TryCreateDirectory(sgf_directory_);
     }
 
-    for (int g = 0; g < engine_.GetParallelGames(); ++g) {
-        workers_.emplace_back(
-            [this, g]() -> void {
-                constexpr int kGamesPerChunk = 25;
-                auto sgf_filename = ConcatPath(
-                                        sgf_directory_, filename_hash_ + ".sgf");
-                running_threads_.fetch_add(1, std::memory_order_relaxed);
-
-                while (accmulate_games_.fetch_add(1) < max_games_) {
-                    engine_.PrepareGame(g);
-                    engine_.Selfplay(g);
-
-                    {
-                        // Save the current chunk.
-                        std::lock_guard<std::mutex> lock(data_mutex_);
-
-                        engine_.GatherTrainingData(chunk_, g);
-
-                        if ((chunk_games_+1) % kGamesPerChunk == 0) {
-                            if (!SaveChunk(chunk_games_/kGamesPerChunk, chunk_)) {
-                                break;
-                            }
-                        }
-                        engine_.SaveSgf(sgf_filename, g);
-                        chunk_games_ += 1;
-                    }
-
-                    played_games_.fetch_add(1);
-                    auto played_games = played_games_.load(std::memory_order_relaxed);
-
-                    if (played_games % 100 == 0) {
-                        std::lock_guard<std::mutex> lock(log_mutex_);
-                        LOGGING << '[' << CurrentDateTime() << ']' << " Played " << played_games << " games." << std::endl;
-                        SaveNetQueries(engine_.GetNetReportQueries());
-                    }
-                }
+    data_writer_ = std::make_unique<DataWriter>(
+                       GetOption<bool>("binary_data"),
+                       GetOption<int>("compression_level"));
 
-                {
-                    std::lock_guard<std::mutex> lock(data_mutex_);
-                    running_threads_.fetch_sub(1, std::memory_order_relaxed);
+    const int stats_interval = GetOption<int>("stats_interval");
+    if (stats_interval > 0) {
+        stats_reporter_ = std::make_unique<StatsReporter>(
+                              ConcatPath(target_directory_, "selfplay_stats.jsonl"),
+                              stats_interval,
+                              [this]() { return GetCounters(); });
+    }
 
-                    // The last thread saves the remaining training data.
-                    if (!chunk_.empty() &&
-                            running_threads_.load(std::memory_order_relaxed) == 0) {
-                        SaveChunk(chunk_games_/kGamesPerChunk, chunk_);
-                        chunk_games_ += 1;
-                    }
+    timer_.Clock();
+    const int parallel_games = engine_.GetParallelGames();
+    const int cooperative_threads = std::min(
+        GetOption<int>("cooperative_threads"), parallel_games);
+
+    if (cooperative_threads > 0 && Fiber::Supported()) {
+        LOGGING << "Run " << parallel_games << " games on "
+                    << cooperative_threads << " cooperative threads." << std::endl;
+        for (int t = 0; t < cooperative_threads; ++t) {
+            workers_.emplace_back(
+                [this, t, cooperative_threads]() -> void {
+                    CooperativeLoop(t, cooperative_threads);
                 }
-            }
-        );
+            );
+        }
+    } else {
+        for (int g = 0; g < parallel_games; ++g) {
+            workers_.emplace_back(
+                [this, g]() -> void {
+                    PlayGames(g);
+                }
+            );
+        }
     }
 
     for (auto &t : workers_) {
         t.join();
     }
+    data_writer_->Finish();
+    if (stats_reporter_) {
+        stats_reporter_->Finish();
+    }
+
+    LOGGING << '[' << CurrentDateTime() << ']'
+                << " Saved " << data_writer_->GetWrittenChunks() << " chunks, "
+                << data_writer_->GetWrittenBytes() / 1024 << " KiB." << std::endl;
     LOGGING << '[' << CurrentDateTime() << ']'
                 << " Finish the self-play loop. Totally played "
-                << played_games_.load(std::memory_order_relaxed) << " games." << std::endl;
+                << played_games_.load(std::memory_order_relaxed) << " games, "
+                << Format("%.1f", GetGamesPerHour()) << " games/hour." << std::endl;
 }
@@ -1,11 +1,15 @@
 #pragma once
 
 #include "selfplay/engine.h"
+#include "selfplay/data_writer.h"
+#include "selfplay/stats_reporter.h"
+#include "utils/time.h"
 
 #include <vector>
 #include <thread>
 #include <string>
 #include <atomic>
+#include <memory>
 
 class SelfPlayPipe {
 public:
@@ -20,6 +24,17 @@ private:
 
     bool SaveNetQueries(const size_t queries);
 
+    // Play the games of the slot until the target number of games.
+    void PlayGames(const int g);
+
+    // Multiplex the slots 'index', 'index + num_threads', ... on the
+    // current thread.
+    void CooperativeLoop(const int index, const int num_threads);
+
+    float GetGamesPerHour() const;
+
+    SelfPlayCounters GetCounters();
+
     std::mutex data_mutex_;
     std::mutex log_mutex_;
 
@@ -28,6 +43,8 @@ private:
     std::atomic<int> accmulate_games_;
     std::atomic<int> played_games_;
     std::atomic<int> running_threads_;
+    std::atomic<std::uint64_t> played_moves_;
+    std::atomic<std::uint64_t> data_wait_ns_;
 
     int chunk_games_;
     int max_games_;
@@ -40,4 +57,7 @@ private:
     std::string filename_hash_;
 
     std::vector<std::thread> workers_;
+    std::unique_ptr<DataWriter> data_writer_;
+    std::unique_ptr<StatsReporter> stats_reporter_;
+    Timer timer_;
 };
@@ -0,0 +1,137 @@
+#include "selfplay/stats_reporter.h"
+#include "utils/format.h"
+#include "utils/log.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Return the resident set size in bytes. Return zero if it is not
+// supported.
+std::uint64_t GetResidentMemory() {
+#ifdef __linux__
+    auto file = std::ifstream{"/proc/self/statm"};
+    std::uint64_t size = 0, resident = 0;
+    if (file >> size >> resident) {
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+double SafeDivide(double a, double b) {
+    return b > 0.0 ? a / b : 0.0;
+}
+
+} // namespace
+
+StatsReporter::StatsReporter(std::string filename,
+                             int interval_seconds,
+                             Sampler sampler)
+    : filename_(std::move(filename)),
+      interval_(std::max(interval_seconds, 1)),
+      sampler_(std::move(sampler)) {
+    last_counters_ = sampler_();
+    last_profile_ = Profiler::Get().GetSnapshot();
+    start_time_ = last_time_ = std::chrono::steady_clock::now();
+    thread_ = std::thread([this]() { Loop(); });
+}
+
+StatsReporter::~StatsReporter() {
+    Finish();
+}
+
+void StatsReporter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    cv_.notify_all();
+    thread_.join();
+    Report();
+}
+
+void StatsReporter::Loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        const auto stopped = cv_.wait_for(lock, interval_, [this]() {
+            return !running_;
+        });
+        if (stopped) {
+            break;
+        }
+        lock.unlock();
+        Report();
+        lock.lock();
+    }
+}
+
+void StatsReporter::Report() {
+    const auto counters = sampler_();
+    const auto profile = Profiler::Get().GetSnapshot();
+    const auto now = std::chrono::steady_clock::now();
+
+    const auto ToSeconds = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+    };
+    const double elapsed = ToSeconds(now - start_time_);
+    const double duration = ToSeconds(now - last_time_);
+
+    const auto &curr_net = counters.network;
+    const auto &last_net = last_counters_.network;
+    const double lookups = curr_net.cache_lookups - last_net.cache_lookups;
+    const double hits = curr_net.cache_hits - last_net.cache_hits;
+    const double batches = curr_net.forward.batches - last_net.forward.batches;
+    const double inputs = curr_net.forward.inputs - last_net.forward.inputs;
+    const double capacity = curr_net.forward.capacity - last_net.forward.capacity;
+    const double wait_ms = 1e-6 * (counters.data_wait_ns - last_counters_.data_wait_ns);
+
+    // Only the searches of the worker threads record the latency. It
+    // is zero if the profiler is not compiled in.
+    const auto forward_profile = profile - last_profile_;
+    const double rss_mib = GetResidentMemory() / (1024.0 * 1024.0);
+
+    auto line = std::string{"{"};
+    line += Format("\"time\": \"%s\", ", CurrentDateTime().c_str());
+    line += Format("\"elapsed\": %.1f, ", elapsed);
+    line += Format("\"interval\": %.1f, ", duration);
+    line += Format("\"games\": %d, ", counters.games);
+    line += Format("\"games_per_hour\": %.1f, ", SafeDivide(3600.0 * counters.games, elapsed));
+    line += Format("\"moves_per_sec\": %.2f, ",
+                       SafeDivide(counters.moves - last_counters_.moves, duration));
+    line += Format("\"nn_evals_per_sec\": %.1f, ", SafeDivide(inputs, duration));
+    line += Format("\"nn_queries_per_sec\": %.1f, ",
+                       SafeDivide(curr_net.queries - last_net.queries, duration));
+    line += Format("\"cache_hit_rate\": %.4f, ", SafeDivide(hits, lookups));
+    line += Format("\"avg_batch_size\": %.2f, ", SafeDivide(inputs, batches));
+    line += Format("\"batch_fill_ratio\": %.4f, ", SafeDivide(inputs, capacity));
+    line += Format("\"forward_latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f}, ",
+                       forward_profile.GetForwardLatency(0.5),
+                       forward_profile.GetForwardLatency(0.9),
+                       forward_profile.GetForwardLatency(0.99));
+    line += Format("\"data_lock_wait_ms\": %.2f, ", wait_ms);
+    line += Format("\"data_lock_wait_ratio\": %.4f, ", SafeDivide(1e-3 * wait_ms, duration));
+    line += Format("\"rss_mib\": %.1f", rss_mib);
+    line += "}";
+
+    last_counters_ = counters;
+    last_profile_ = profile;
+    last_time_ = now;
+
+    auto file = std::ofstream{};
+    file.open(filename_, std::ios_base::app);
+    if (file.is_open()) {
+        file << line << std::endl;
+    } else {
+        LOGGING << "Fail to create the file: " << filename_ << '!' << std::endl;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "selfplay/engine.h"
+#include "utils/profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// The accumulated counters of the self-play loop. They are never
+// reset, so the rates are the differences of two samples.
+struct SelfPlayCounters {
+    int games{0};
+    std::uint64_t moves{0};
+    std::uint64_t data_wait_ns{0}; // The time waiting for the data lock.
+    Engine::NetworkStats network;
+};
+
+// The periodic reporter of the self-play throughput. It samples the
+// counters every interval and appends one JSON object per line to the
+// file, so the throughput drop can be traced to the underfilled batch,
+// the cache or the lock contention. The last line is written when it
+// finishes.
+class StatsReporter {
+public:
+    using Sampler = std::function<SelfPlayCounters()>;
+
+    StatsReporter(std::string filename, int interval_seconds, Sampler sampler);
+    ~StatsReporter();
+
+    // Write the last line and stop the reporter thread.
+    void Finish();
+
+private:
+    void Loop();
+    void Report();
+
+    std::string filename_;
+    std::chrono::seconds interval_;
+    Sampler sampler_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_{true};
+
+    // The last sample. The rates of the line are since it.
+    SelfPlayCounters last_counters_;
+    ProfileSnapshot last_profile_;
+    std::chrono::steady_clock::time_point start_time_;
+    std::chrono::steady_clock::time_point last_time_;
+
+    std::thread thread_;
+};
@@ -0,0 +1,237 @@
+#include "utils/affinity.h"
+#include "utils/format.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+struct NumaTopology {
+    std::vector<int> allowed_cpus;
+    std::vector<std::vector<int>> nodes;
+
+    // The node index of every CPU. It is -1 if the CPU is not allowed.
+    std::vector<int> cpu_to_node;
+};
+
+// Parse the CPU list of sysfs, like "0-3,8-11".
+std::vector<int> ParseCpuList(const std::string &list) {
+    auto cpus = std::vector<int>{};
+    auto iss = std::istringstream{list};
+    auto range = std::string{};
+
+    while (std::getline(iss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const auto dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ?
+                                 first : std::stoi(range.substr(dash + 1));
+            for (int c = first; c <= last; ++c) {
+                cpus.emplace_back(c);
+            }
+        } catch (...) {
+            return std::vector<int>{};
+        }
+    }
+    return cpus;
+}
+
+NumaTopology ReadTopology() {
+    auto topology = NumaTopology{};
+    auto &allowed = topology.allowed_cpus;
+    auto &nodes = topology.nodes;
+
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c) {
+            if (CPU_ISSET(c, &set)) {
+                allowed.emplace_back(c);
+            }
+        }
+    }
+#endif
+    if (allowed.empty()) {
+        const int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+        for (int c = 0; c < cores; ++c) {
+            allowed.emplace_back(c);
+        }
+    }
+
+#ifdef __linux__
+    for (int n = 0; ; ++n) {
+        auto file = std::ifstream{
+            Format("/sys/devices/system/node/node%d/cpulist", n)};
+        if (!file.is_open()) {
+            break;
+        }
+        auto line = std::string{};
+        std::getline(file, line);
+
+        auto cpus = std::vector<int>{};
+        for (int c : ParseCpuList(line)) {
+            if (std::find(std::begin(allowed), std::end(allowed), c) !=
+                    std::end(allowed)) {
+                cpus.emplace_back(c);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.emplace_back(cpus);
+        }
+    }
+#endif
+    if (nodes.empty()) {
+        nodes.emplace_back(allowed);
+    }
+
+    const int max_cpu = *std::max_element(std::begin(allowed), std::end(allowed));
+    topology.cpu_to_node.assign(max_cpu + 1, -1);
+    for (int n = 0; n < (int)nodes.size(); ++n) {
+        for (int c : nodes[n]) {
+            topology.cpu_to_node[c] = n;
+        }
+    }
+    return topology;
+}
+
+const NumaTopology &GetTopology() {
+    static const NumaTopology topology = ReadTopology();
+    return topology;
+}
+
+thread_local int pinned_numa_node = -1;
+
+#ifdef __linux__
+bool SetAffinity(pthread_t handle, AffinityMode mode, int index) {
+    const auto &topology = GetTopology();
+    auto cpus = std::vector<int>{};
+    if (mode == AffinityMode::kCore) {
+        const auto &allowed = topology.allowed_cpus;
+        cpus.emplace_back(allowed[index % allowed.size()]);
+    } else {
+        const auto &nodes = topology.nodes;
+        cpus = nodes[index % nodes.size()];
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : cpus) {
+        CPU_SET(c, &set);
+    }
+    return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+}
+#endif
+
+} // namespace
+
+AffinityMode GetAffinityMode(const std::string &name) {
+    if (name == "core") {
+        return AffinityMode::kCore;
+    } else if (name == "numa") {
+        return AffinityMode::kNuma;
+    }
+    return AffinityMode::kNone;
+}
+
+std::string GetAffinityModeName(AffinityMode mode) {
+    switch (mode) {
+        case AffinityMode::kCore:
+            return "core";
+        case AffinityMode::kNuma:
+            return "numa";
+        default:
+            return "none";
+    }
+}
+
+std::vector<int> GetAllowedCpus() {
+    return GetTopology().allowed_cpus;
+}
+
+std::vector<std::vector<int>> GetNumaNodeCpus() {
+    return GetTopology().nodes;
+}
+
+int GetNumNumaNodes() {
+    return GetTopology().nodes.size();
+}
+
+int GetCurrentNumaNode() {
+#ifdef __linux__
+    const auto &topology = GetTopology();
+    if (topology.nodes.size() == 1) {
+        return 0;
+    }
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && cpu < (int)topology.cpu_to_node.size()) {
+        return std::max(topology.cpu_to_node[cpu], 0);
+    }
+#endif
+    return 0;
+}
+
+int GetAffinityNumaNode(AffinityMode mode, int index) {
+    const auto &topology = GetTopology();
+    if (mode == AffinityMode::kCore) {
+        const auto &allowed = topology.allowed_cpus;
+        return std::max(topology.cpu_to_node[allowed[index % allowed.size()]], 0);
+    } else if (mode == AffinityMode::kNuma) {
+        return index % topology.nodes.size();
+    }
+    return -1;
+}
+
+int GetPinnedNumaNode() {
+    return pinned_numa_node;
+}
+
+void SetPinnedNumaNode(int node) {
+    pinned_numa_node = node;
+}
+
+bool SetThreadAffinity(std::thread &thread, AffinityMode mode, int index) {
+    if (mode == AffinityMode::kNone) {
+        return true;
+    }
+#ifdef __linux__
+    return SetAffinity(thread.native_handle(), mode, index);
+#else
+    (void) thread;
+    (void) index;
+    return false;
+#endif
+}
+
+bool SetCurrentThreadAffinity(AffinityMode mode, int index) {
+    if (mode == AffinityMode::kNone) {
+        return true;
+    }
+#ifdef __linux__
+    if (!SetAffinity(pthread_self(), mode, index)) {
+        return false;
+    }
+    pinned_numa_node = GetAffinityNumaNode(mode, index);
+    return true;
+#else
+    (void) index;
+    return false;
+#endif
+}
+
+void RunOnNumaNode(int node, std::function<void()> func) {
+    auto thread = std::thread([node, &func]() {
+        SetCurrentThreadAffinity(AffinityMode::kNuma, node);
+        func();
+    });
+    thread.join();
+}
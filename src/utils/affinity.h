@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class AffinityMode {
+    kNone, // Let the OS place the threads.
+    kCore, // Pin every thread to one CPU.
+    kNuma  // Pin every thread to all CPUs of one NUMA node.
+};
+
+// Returns kNone if the name is unknown.
+AffinityMode GetAffinityMode(const std::string &name);
+std::string GetAffinityModeName(AffinityMode mode);
+
+// Returns the CPUs which the process may run on. The topology is read
+// once, so it is the affinity of the process before any thread is
+// pinned.
+std::vector<int> GetAllowedCpus();
+
+// Returns the allowed CPUs of every NUMA node. The nodes without
+// allowed CPUs are skipped. There is only one node if the system
+// does not report them.
+std::vector<std::vector<int>> GetNumaNodeCpus();
+
+int GetNumNumaNodes();
+
+// Returns the index of NUMA node in GetNumaNodeCpus() which the
+// current thread runs on. Returns 0 if it is unknown.
+int GetCurrentNumaNode();
+
+// Returns the index of NUMA node which the thread of index is pinned
+// to. Returns -1 if the mode does not pin the threads.
+int GetAffinityNumaNode(AffinityMode mode, int index);
+
+// Returns the index of NUMA node which the current thread is pinned
+// to. Returns -1 if it is not pinned, so it may move between the nodes.
+int GetPinnedNumaNode();
+
+// Record the pinned NUMA node of current thread. It is for the thread
+// pinned by another thread, like the workers of the pool.
+void SetPinnedNumaNode(int node);
+
+// Pin the thread by its index. The threads are spread over the CPUs
+// or the NUMA nodes in round robin. Returns false if the platform
+// does not support it or it fails.
+bool SetThreadAffinity(std::thread &thread, AffinityMode mode, int index);
+bool SetCurrentThreadAffinity(AffinityMode mode, int index);
+
+// Run the function on a new thread pinned to the NUMA node and wait
+// for it. The memory first touched in it is local to the node.
+void RunOnNumaNode(int node, std::function<void()> func);
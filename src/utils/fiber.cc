@@ -0,0 +1,142 @@
+#include "utils/fiber.h"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#define FIBER_USE_UCONTEXT
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+thread_local Fiber *current_fiber = nullptr;
+
+} // namespace
+
+#ifdef FIBER_USE_UCONTEXT
+
+struct Fiber::Context {
+    ucontext_t fiber;
+    ucontext_t caller;
+
+    char *stack{nullptr};
+    size_t mapped_size{0};
+};
+
+Fiber::Fiber(Function func, size_t stack_size)
+    : context_(std::make_unique<Context>()), func_(std::move(func)) {
+    const size_t page = sysconf(_SC_PAGESIZE);
+    stack_size = (stack_size + page - 1) / page * page;
+
+    // The lowest page is the guard page. The stack pages are only
+    // committed when they are touched.
+    context_->mapped_size = stack_size + page;
+    void *mem = mmap(nullptr, context_->mapped_size,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        throw std::bad_alloc{};
+    }
+    mprotect(mem, page, PROT_NONE);
+    context_->stack = static_cast<char*>(mem);
+
+    getcontext(&context_->fiber);
+    context_->fiber.uc_stack.ss_sp = context_->stack + page;
+    context_->fiber.uc_stack.ss_size = stack_size;
+    context_->fiber.uc_link = &context_->caller;
+
+    // The makecontext() only passes the int arguments.
+    const auto ptr = reinterpret_cast<std::uintptr_t>(this);
+    makecontext(&context_->fiber, (void (*)())&Fiber::Entry, 2,
+                (unsigned int)(ptr & 0xffffffff),
+                (unsigned int)((std::uint64_t)ptr >> 32));
+}
+
+Fiber::~Fiber() {
+    munmap(context_->stack, context_->mapped_size);
+}
+
+void Fiber::Entry(unsigned int low, unsigned int high) {
+    const auto ptr = ((std::uint64_t)high << 32) | low;
+    auto fiber = reinterpret_cast<Fiber*>((std::uintptr_t)ptr);
+
+    try {
+        fiber->func_();
+    } catch (...) {
+        fiber->exception_ = std::current_exception();
+    }
+    fiber->finished_ = true;
+
+    // Return to the caller by the uc_link.
+}
+
+void Fiber::Resume() {
+    if (finished_ || current_fiber) {
+        return;
+    }
+    current_fiber = this;
+    swapcontext(&context_->caller, &context_->fiber);
+    current_fiber = nullptr;
+
+    if (exception_) {
+        auto e = exception_;
+        exception_ = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void Fiber::Yield() {
+    auto fiber = current_fiber;
+    if (fiber) {
+        swapcontext(&fiber->context_->fiber, &fiber->context_->caller);
+    }
+}
+
+bool Fiber::Supported() {
+    return true;
+}
+
+#else
+
+struct Fiber::Context {};
+
+Fiber::Fiber(Function func, size_t /* stack_size */)
+    : context_(std::make_unique<Context>()), func_(std::move(func)) {}
+
+Fiber::~Fiber() {}
+
+void Fiber::Entry(unsigned int, unsigned int) {}
+
+void Fiber::Resume() {
+    // Run it to the end without the suspending.
+    if (finished_ || current_fiber) {
+        return;
+    }
+    func_();
+    finished_ = true;
+}
+
+void Fiber::Yield() {}
+
+bool Fiber::Supported() {
+    return false;
+}
+
+#endif
+
+bool Fiber::Finished() const {
+    return finished_;
+}
+
+Fiber *Fiber::Current() {
+    return current_fiber;
+}
+
+int Fiber::AllocateLocalKey() {
+    static std::atomic<int> next_key{0};
+    return next_key.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// The stackful coroutine. The fiber runs the function on its own stack
+// in the thread which resumes it. It suspends itself by Yield(), then
+// Resume() returns to the caller. A fiber must be always resumed by the
+// same thread because the compiler may keep the addresses of thread
+// local variables across the Yield().
+//
+// It is based on the ucontext. Supported() is false on the platforms
+// without it.
+class Fiber {
+public:
+    using Function = std::function<void()>;
+
+    static constexpr size_t kDefaultStackSize = 1024 * 1024;
+
+    explicit Fiber(Function func, size_t stack_size = kDefaultStackSize);
+    ~Fiber();
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    // Run the fiber until it yields or finishes. Rethrow the exception
+    // thrown by the function. It can not be called in a fiber.
+    void Resume();
+
+    bool Finished() const;
+
+    // Suspend the current fiber and return to the Resume() caller.
+    static void Yield();
+
+    // Return the running fiber of the current thread, or null.
+    static Fiber *Current();
+
+    static bool Supported();
+
+    // Return the storage of the key. It is created at the first time.
+    template<typename T>
+    T &GetLocal(const int key);
+
+    static int AllocateLocalKey();
+
+private:
+    static void Entry(unsigned int low, unsigned int high);
+
+    struct Context;
+    std::unique_ptr<Context> context_;
+
+    Function func_;
+    bool finished_{false};
+    std::exception_ptr exception_{nullptr};
+
+    std::vector<std::shared_ptr<void>> locals_;
+};
+
+template<typename T>
+T &Fiber::GetLocal(const int key) {
+    if ((int)locals_.size() <= key) {
+        locals_.resize(key + 1);
+    }
+    if (!locals_[key]) {
+        locals_[key] = std::make_shared<T>();
+    }
+    return *static_cast<T*>(locals_[key].get());
+}
+
+// The fibers in one thread share the thread local variables. Use this
+// one instead if the variable must stay valid across the Yield(). It is
+// the thread local variable if it is not in a fiber.
+template<typename T>
+T &GetFiberLocal() {
+    static const int key = Fiber::AllocateLocalKey();
+
+    auto fiber = Fiber::Current();
+    if (!fiber) {
+        thread_local T local;
+        return local;
+    }
+    return fiber->GetLocal<T>(key);
+}
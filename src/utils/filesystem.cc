@@ -1,5 +1,6 @@
 #include <stdexcept>
 #include <algorithm>
+#include <fstream>
 #include "utils/filesystem.h"
 
 #ifdef WIN32
@@ -7,6 +8,9 @@
 #else
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #endif
 
@@ -197,3 +201,95 @@ time_t GetFileTime(const std::string& filename) {
 #endif
 #endif
 }
+
+std::uint64_t GetFileHash(const std::string& filename) {
+    auto file = std::ifstream(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    auto buf = std::vector<char>(1024 * 1024);
+    while (file) {
+        file.read(buf.data(), buf.size());
+        const auto size = file.gcount();
+        for (std::streamsize i = 0; i < size; ++i) {
+            hash ^= (unsigned char)buf[i];
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+bool MappedFile::Open(const std::string& filename) {
+    Close();
+#ifdef WIN32
+    const auto file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+    const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const char*>(data);
+    size_ = size.QuadPart;
+#else
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat s;
+    if (fstat(fd, &s) < 0 || s.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping is still valid after closing the file.
+    if (data == MAP_FAILED) return false;
+
+    data_ = static_cast<const char*>(data);
+    size_ = s.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_ == nullptr) return;
+#ifdef WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    file_ = nullptr;
+    mapping_ = nullptr;
+#else
+    munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+const char* MappedFile::GetData() const {
+    return data_;
+}
+
+std::uint64_t MappedFile::GetSize() const {
+    return size_;
+}
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 // Concatenate paths or filenames.
 std::string ConcatPath(const std::string path_1, const std::string path_2);
@@ -31,3 +32,34 @@ std::uint64_t GetFileSize(const std::string& filename);
 
 // Returns modification time of a file, 0 if file doesn't exist or can't be read.
 time_t GetFileTime(const std::string& filename);
+
+// Returns the 64-bit FNV-1a hash of file content, 0 if file doesn't exist
+// or can't be read.
+std::uint64_t GetFileHash(const std::string& filename);
+
+// The read-only memory mapped file. The pages are shared by all
+// processes which map the same file.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file can't be mapped.
+    bool Open(const std::string& filename);
+    void Close();
+
+    const char* GetData() const;
+    std::uint64_t GetSize() const;
+
+private:
+    const char* data_{nullptr};
+    std::uint64_t size_{0};
+
+#ifdef WIN32
+    void* file_{nullptr};
+    void* mapping_{nullptr};
+#endif
+};
@@ -1,8 +1,13 @@
 #include "utils/gzip_helper.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <stdexcept>
 #include <memory>
 #include <cstring>
+#include <streambuf>
+#include <vector>
 
 #ifdef USE_ZLIB
 
@@ -23,12 +28,53 @@ void SaveGzip(std::string filename, std::string &buffer) {
     gzclose(out);
 }
 
+bool LoadGzip(std::string filename, std::string &buffer) {
+    // The gzread() reads the plain file as it is.
+    auto in = gzopen(filename.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+    gzbuffer(in, 256 * 1024);
+
+    constexpr int kChunkSize = 256 * 1024;
+    auto chunk = std::make_unique<char[]>(kChunkSize);
+    buffer.clear();
+
+    int size;
+    while ((size = gzread(in, chunk.get(), kChunkSize)) > 0) {
+        buffer.append(chunk.get(), size);
+    }
+    const bool success = size == 0;
+    gzclose(in);
+    return success;
+}
+
 #else
 
 void SaveGzip(std::string /* filename */, std::string & /* buffer */ ) {
     throw "No gzip library";
 }
 
+bool LoadGzip(std::string filename, std::string &buffer) {
+    auto in = std::fopen(filename.c_str(), "rb");
+    if (!in) {
+        return false;
+    }
+    constexpr size_t kChunkSize = 256 * 1024;
+    auto chunk = std::make_unique<char[]>(kChunkSize);
+    buffer.clear();
+
+    size_t size;
+    while ((size = std::fread(chunk.get(), 1, kChunkSize, in)) > 0) {
+        buffer.append(chunk.get(), size);
+    }
+    std::fclose(in);
+
+    // Can not decompress it without the gzip library.
+    return buffer.size() < 2 ||
+               !((std::uint8_t)buffer[0] == 0x1f && (std::uint8_t)buffer[1] == 0x8b);
+}
+
 #endif
 
 
@@ -39,3 +85,138 @@ bool IsGzipValid() {
     return false;
 #endif
 }
+
+class GzipOutputStream::Buffer : public std::streambuf {
+public:
+    Buffer(std::string filename, int level);
+    ~Buffer();
+
+    bool IsOpen() const;
+    bool Close();
+    std::string GetFileName() const;
+
+protected:
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    static constexpr size_t kBufferSize = 64 * 1024;
+
+    // Write the pending data to the file.
+    bool WriteOut();
+
+    std::vector<char> buffer_;
+    std::string filename_;
+    bool fail_{false};
+
+#ifdef USE_ZLIB
+    gzFile file_{nullptr};
+#else
+    std::FILE *file_{nullptr};
+#endif
+};
+
+GzipOutputStream::Buffer::Buffer(std::string filename, int level)
+    : buffer_(kBufferSize) {
+#ifdef USE_ZLIB
+    filename_ = filename + ".gz";
+    level = std::min(std::max(level, 0), 9);
+
+    const auto mode = std::string{"wb"} + std::to_string(level);
+    file_ = gzopen(filename_.c_str(), mode.c_str());
+    if (file_) {
+        gzbuffer(file_, kBufferSize);
+    }
+#else
+    (void) level;
+    filename_ = filename;
+    file_ = std::fopen(filename_.c_str(), "wb");
+#endif
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+GzipOutputStream::Buffer::~Buffer() {
+    Close();
+}
+
+bool GzipOutputStream::Buffer::IsOpen() const {
+    return file_ != nullptr;
+}
+
+std::string GzipOutputStream::Buffer::GetFileName() const {
+    return filename_;
+}
+
+bool GzipOutputStream::Buffer::WriteOut() {
+    const auto size = pptr() - pbase();
+    if (size > 0 && file_ && !fail_) {
+#ifdef USE_ZLIB
+        fail_ = gzwrite(file_, pbase(), size) != size;
+#else
+        fail_ = std::fwrite(pbase(), 1, size, file_) != (size_t)size;
+#endif
+    }
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return file_ && !fail_;
+}
+
+GzipOutputStream::Buffer::int_type GzipOutputStream::Buffer::overflow(int_type ch) {
+    if (!WriteOut()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int GzipOutputStream::Buffer::sync() {
+    return WriteOut() ? 0 : -1;
+}
+
+bool GzipOutputStream::Buffer::Close() {
+    if (!file_) {
+        return false;
+    }
+    WriteOut();
+#ifdef USE_ZLIB
+    fail_ |= gzclose(file_) != Z_OK;
+#else
+    fail_ |= std::fclose(file_) != 0;
+#endif
+    file_ = nullptr;
+    return !fail_;
+}
+
+GzipOutputStream::GzipOutputStream(std::string filename, int level)
+    : std::ostream(nullptr),
+      buffer_(std::make_unique<Buffer>(filename, level)) {
+    rdbuf(buffer_.get());
+    if (!buffer_->IsOpen()) {
+        setstate(std::ios_base::failbit);
+    }
+}
+
+GzipOutputStream::~GzipOutputStream() {
+    Close();
+}
+
+bool GzipOutputStream::IsOpen() const {
+    return buffer_->IsOpen();
+}
+
+bool GzipOutputStream::Close() {
+    if (!buffer_->IsOpen()) {
+        return false;
+    }
+    const bool success = buffer_->Close() && good();
+    if (!success) {
+        setstate(std::ios_base::badbit);
+    }
+    return success;
+}
+
+std::string GzipOutputStream::GetFileName() const {
+    return buffer_->GetFileName();
+}
@@ -1,7 +1,37 @@
 #pragma once
 
+#include <memory>
+#include <ostream>
 #include <string>
 
 void SaveGzip(std::string filename, std::string &buffer);
 
+// Read the whole file into the buffer. The gzip file is decompressed
+// and the plain file is read as it is. Return false if the file can not
+// be read or it is broken.
+bool LoadGzip(std::string filename, std::string &buffer);
+
 bool IsGzipValid();
+
+// The output file stream which compresses the data on the fly, so the
+// whole file never stays in the memory. The ".gz" is appended to the
+// file name. It writes the plain file if there is no gzip library. The
+// level is from 0 (no compression) to 9 (best compression).
+class GzipOutputStream : public std::ostream {
+public:
+    GzipOutputStream(std::string filename, int level);
+    ~GzipOutputStream();
+
+    bool IsOpen() const;
+
+    // Flush the data and close the file. Return false if any writing
+    // fails.
+    bool Close();
+
+    // The real file name.
+    std::string GetFileName() const;
+
+private:
+    class Buffer;
+    std::unique_ptr<Buffer> buffer_;
+};
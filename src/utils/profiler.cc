@@ -0,0 +1,235 @@
+#include "utils/profiler.h"
+#include "utils/format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILER_USE_TSC
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+const char *kPhaseNames[kNumProfilePhases] = {
+    "none",
+    "other",
+    "select",
+    "play move",
+    "cache probe",
+    "encode",
+    "nn forward",
+    "expand",
+    "backup"
+};
+
+double GetSteadySeconds() {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(now).count();
+}
+
+// The lower bound of the bucket.
+std::uint64_t GetBucketLowerBound(const int bucket) {
+    if (bucket < 4) {
+        return bucket;
+    } else if (bucket < 8) {
+        // Not used.
+        return 4;
+    }
+    const int b = bucket / 4;
+    const int sub = bucket % 4;
+    return std::uint64_t(4 + sub) << (b - 2);
+}
+
+} // namespace
+
+int GetProfileLatencyBucket(const std::uint64_t ticks) {
+    if (ticks < 4) {
+        return ticks;
+    }
+    const int b = 63 - __builtin_clzll(ticks);
+    const int sub = (ticks >> (b - 2)) & 3;
+    return 4 * b + sub;
+}
+
+Profiler &Profiler::Get() {
+    static Profiler profiler;
+    return profiler;
+}
+
+std::uint64_t Profiler::GetTicks() {
+#ifdef PROFILER_USE_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool Profiler::Enabled() {
+#ifdef ENABLE_PROFILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Profiler::PhaseState::Charge(ThreadData &data, const std::uint64_t now) {
+    if (current != kProfileNone) {
+        ProfileAdd(data.ticks[current], now - last);
+    }
+    last = now;
+}
+
+Profiler::PhaseState &Profiler::GetPhaseState() {
+    return GetFiberLocal<PhaseState>();
+}
+
+Profiler::ThreadData &Profiler::GetThreadData() {
+    // Constant-initialized, so it is cheap to access.
+    static thread_local ThreadData *data = nullptr;
+    if (!data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_data_.emplace_back(std::make_unique<ThreadData>());
+        data = threads_data_.back().get();
+    }
+    return *data;
+}
+
+ProfileSnapshot Profiler::GetSnapshot() {
+    auto snapshot = ProfileSnapshot{};
+    snapshot.timestamp = GetTicks();
+    snapshot.seconds = GetSteadySeconds();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &data : threads_data_) {
+        for (int i = 0; i < kNumProfilePhases; ++i) {
+            snapshot.ticks[i] += data->ticks[i].load(std::memory_order_relaxed);
+            snapshot.calls[i] += data->calls[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < kNumProfileCounters; ++i) {
+            snapshot.counters[i] += data->counters[i].load(std::memory_order_relaxed);
+        }
+        for (int i = 0; i < kProfileHistogramSize; ++i) {
+            snapshot.forward_latency[i] += data->forward_latency[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+ProfileSnapshot ProfileSnapshot::operator-(const ProfileSnapshot &other) const {
+    auto diff = ProfileSnapshot{};
+    for (int i = 0; i < kNumProfilePhases; ++i) {
+        diff.ticks[i] = ticks[i] - other.ticks[i];
+        diff.calls[i] = calls[i] - other.calls[i];
+    }
+    for (int i = 0; i < kNumProfileCounters; ++i) {
+        diff.counters[i] = counters[i] - other.counters[i];
+    }
+    for (int i = 0; i < kProfileHistogramSize; ++i) {
+        diff.forward_latency[i] = forward_latency[i] - other.forward_latency[i];
+    }
+    diff.timestamp = timestamp - other.timestamp;
+    diff.seconds = seconds - other.seconds;
+    return diff;
+}
+
+double ProfileSnapshot::GetForwardLatency(double p) const {
+    const auto forwards = GetNumForwards();
+    if (forwards == 0 || timestamp == 0 || seconds <= 0.0) {
+        return 0.0;
+    }
+
+    // The snapshots are taken at the same moments on the TSC and
+    // the steady clock, so they give the TSC frequency.
+    const double ticks_per_sec = timestamp / seconds;
+
+    // The percentiles are the middles of quarter-octave buckets.
+    const auto target = std::max<std::uint64_t>(p * forwards, 1);
+    std::uint64_t acc = 0;
+    for (int b = 0; b < kProfileHistogramSize; ++b) {
+        acc += forward_latency[b];
+        if (acc >= target) {
+            const auto lower = GetBucketLowerBound(b);
+            const auto upper = b + 1 < kProfileHistogramSize ?
+                                   GetBucketLowerBound(b + 1) : lower;
+            return 1e6 * 0.5 * (lower + upper) / ticks_per_sec;
+        }
+    }
+    return 0.0;
+}
+
+std::uint64_t ProfileSnapshot::GetNumForwards() const {
+    std::uint64_t forwards = 0;
+    for (auto v : forward_latency) {
+        forwards += v;
+    }
+    return forwards;
+}
+
+std::string ProfileSnapshot::ToString(const int playouts) const {
+    auto out = std::ostringstream{};
+    out << " * Search Profile:\n";
+
+    if (!Profiler::Enabled()) {
+        out << "  The profiler is disabled. Build it without DISABLE_PROFILER.\n";
+        return out.str();
+    }
+    if (timestamp == 0 || seconds <= 0.0) {
+        out << "  No search yet.\n";
+        return out.str();
+    }
+
+    // The snapshots are taken at the same moments on the TSC and
+    // the steady clock, so they give the TSC frequency.
+    const double ticks_per_sec = timestamp / seconds;
+    const auto ToMicroseconds = [ticks_per_sec](double t) {
+        return 1e6 * t / ticks_per_sec;
+    };
+
+    std::uint64_t total_ticks = 0;
+    for (int i = kProfilePlayout; i < kNumProfilePhases; ++i) {
+        total_ticks += ticks[i];
+    }
+    total_ticks = std::max(total_ticks, std::uint64_t{1});
+
+    constexpr int kBarWidth = 30;
+    out << Format("  %-12s %10s %7s %10s %10s\n",
+                      "phase", "time(ms)", "share", "calls", "mean(us)");
+    for (int i = kProfilePlayout; i < kNumProfilePhases; ++i) {
+        const double share = (double)ticks[i] / total_ticks;
+        const auto bar = std::string((int)(share * kBarWidth + 0.5), '#');
+        out << Format("  %-12s %10.1f %6.2f%% %10llu %10.2f %s\n",
+                          kPhaseNames[i],
+                          ToMicroseconds(ticks[i]) / 1000.0,
+                          100.0 * share,
+                          (unsigned long long)calls[i],
+                          calls[i] ? ToMicroseconds(ticks[i]) / calls[i] : 0.0,
+                          bar.c_str());
+    }
+    out << Format("  thread time: %.1f(ms) over %.1f(ms) wall time\n",
+                      ToMicroseconds(total_ticks) / 1000.0, 1000.0 * seconds);
+
+    const auto forwards = GetNumForwards();
+    if (forwards > 0) {
+        out << Format("  nn latency: p50 %.1f(us), p90 %.1f(us), p99 %.1f(us), %llu forwards\n",
+                          GetForwardLatency(0.5), GetForwardLatency(0.9), GetForwardLatency(0.99),
+                          (unsigned long long)forwards);
+    }
+
+    const auto lookups = counters[kProfileCacheLookups];
+    const auto hits = counters[kProfileCacheHits];
+    out << Format("  nn cache: %llu lookups, %llu hits (%.2f%%)\n",
+                      (unsigned long long)lookups,
+                      (unsigned long long)hits,
+                      lookups ? 100.0 * hits / lookups : 0.0);
+
+    const auto leaves = counters[kProfileLeaves];
+    out << Format("  average depth: %.2f\n",
+                      leaves ? (double)counters[kProfileLeafDepth] / leaves : 0.0);
+    out << Format("  speed: %.2f(p/sec), playouts: %d\n",
+                      playouts / seconds, playouts);
+
+    return out.str();
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "utils/fiber.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The phases of one playout. The time of phases is exclusive. The
+// nested phase pauses the outer one, so the expansion does not count
+// the network time in it.
+enum ProfilePhase : int {
+    kProfileNone = 0, // Not in the search. It is not counted.
+    kProfilePlayout,  // The rest of the playout.
+    kProfileSelect,
+    kProfilePlayMove,
+    kProfileCacheProbe,
+    kProfileEncode,
+    kProfileForward,  // Queue the inputs and wait for the network.
+    kProfileExpand,
+    kProfileBackup,
+    kNumProfilePhases
+};
+
+enum ProfileCounter : int {
+    kProfileCacheLookups = 0,
+    kProfileCacheHits,
+    kProfileLeaves,
+    kProfileLeafDepth,
+    kNumProfileCounters
+};
+
+// The quarter-octave latency buckets of the network forwarding.
+static constexpr int kProfileHistogramSize = 4 * 64;
+
+// The sums of all threads at one moment. The profile of a search is
+// the difference of two snapshots.
+struct ProfileSnapshot {
+    std::array<std::uint64_t, kNumProfilePhases> ticks{};
+    std::array<std::uint64_t, kNumProfilePhases> calls{};
+    std::array<std::uint64_t, kNumProfileCounters> counters{};
+    std::array<std::uint64_t, kProfileHistogramSize> forward_latency{};
+
+    // The ticks and the seconds of steady clock when it is taken.
+    std::uint64_t timestamp{0};
+    double seconds{0.0};
+
+    ProfileSnapshot operator-(const ProfileSnapshot &other) const;
+
+    // Return the percentile of the network latency in microseconds. It
+    // is the middle of the bucket. Return zero if there is no forward.
+    double GetForwardLatency(double p) const;
+
+    std::uint64_t GetNumForwards() const;
+
+    // Return the report. The playouts are counted by the search.
+    std::string ToString(const int playouts) const;
+};
+
+// The per-thread counters are only written by their own threads, so
+// taking the snapshot never blocks the search. The counters are never
+// reset. The TSC is used on x86, the steady clock on the others.
+class Profiler {
+public:
+    static Profiler &Get();
+
+    static std::uint64_t GetTicks();
+
+    // Return true if it is compiled in.
+    static bool Enabled();
+
+    ProfileSnapshot GetSnapshot();
+
+    struct ThreadData {
+        std::array<std::atomic<std::uint64_t>, kNumProfilePhases> ticks{};
+        std::array<std::atomic<std::uint64_t>, kNumProfilePhases> calls{};
+        std::array<std::atomic<std::uint64_t>, kNumProfileCounters> counters{};
+        std::array<std::atomic<std::uint64_t>, kProfileHistogramSize> forward_latency{};
+    };
+
+    // The open phase of current fiber. The fibers of one thread yield
+    // with their scopes still open, so every fiber keeps its own one.
+    struct PhaseState {
+        ProfilePhase current{kProfileNone};
+        std::uint64_t last{0};
+
+        // Charge the ticks since the last event to current phase.
+        void Charge(ThreadData &data, const std::uint64_t now);
+    };
+
+    // Return the counters of current thread.
+    ThreadData &GetThreadData();
+
+    // Return the phase of current fiber, or current thread if it is
+    // not in a fiber.
+    static PhaseState &GetPhaseState();
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadData>> threads_data_;
+};
+
+// Only the owner thread writes the counter. No need for RMW.
+inline void ProfileAdd(std::atomic<std::uint64_t> &counter,
+                       const std::uint64_t val) {
+    counter.store(counter.load(std::memory_order_relaxed) + val,
+                  std::memory_order_relaxed);
+}
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const ProfilePhase phase);
+    ~ProfileScope();
+
+private:
+    Profiler::ThreadData &data_;
+    Profiler::PhaseState &state_;
+    ProfilePhase phase_;
+    ProfilePhase saved_;
+    std::uint64_t start_;
+};
+
+// Pause the phase of current fiber while it yields. The time of the
+// scheduler and the other fibers is not charged to it.
+class ProfileYield {
+public:
+    ProfileYield();
+    ~ProfileYield();
+
+private:
+    Profiler::ThreadData &data_;
+    Profiler::PhaseState &state_;
+};
+
+int GetProfileLatencyBucket(const std::uint64_t ticks);
+
+inline ProfileScope::ProfileScope(const ProfilePhase phase)
+    : data_(Profiler::Get().GetThreadData()),
+      state_(Profiler::GetPhaseState()),
+      phase_(phase) {
+    start_ = Profiler::GetTicks();
+    state_.Charge(data_, start_);
+    saved_ = state_.current;
+    state_.current = phase_;
+    ProfileAdd(data_.calls[phase_], 1);
+}
+
+inline ProfileScope::~ProfileScope() {
+    const auto now = Profiler::GetTicks();
+    state_.Charge(data_, now);
+    state_.current = saved_;
+    if (phase_ == kProfileForward) {
+        ProfileAdd(data_.forward_latency[
+                       GetProfileLatencyBucket(now - start_)], 1);
+    }
+}
+
+inline ProfileYield::ProfileYield()
+    : data_(Profiler::Get().GetThreadData()),
+      state_(Profiler::GetPhaseState()) {
+    state_.Charge(data_, Profiler::GetTicks());
+}
+
+inline ProfileYield::~ProfileYield() {
+    state_.last = Profiler::GetTicks();
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILER
+// Profile the rest of current scope.
+#define PROFILE_SCOPE(phase) \
+    ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(phase)
+
+#define PROFILE_COUNT(counter, val) \
+    ProfileAdd(Profiler::Get().GetThreadData().counters[counter], (val))
+
+// Pause the phase of current fiber until the rest of current scope.
+#define PROFILE_YIELD() \
+    ProfileYield PROFILE_CONCAT(profile_yield_, __LINE__)
+#else
+#define PROFILE_SCOPE(phase)
+#define PROFILE_YIELD()
+#define PROFILE_COUNT(counter, val)
+#endif
@@ -27,9 +27,12 @@
 
 # pragma once
 
+#include "utils/affinity.h"
+#include "utils/work_stealing_deque.h"
+
 #include <atomic>
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
@@ -37,8 +40,120 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
-#include <iostream>
+#include <exception>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+
+// The type-erased task of the pool. The small callable is stored in the
+// inline buffer, so setting it does not allocate. The owner keeps the
+// task alive until the callback is called.
+class PoolTask {
+public:
+    static constexpr size_t kInlineSize = 64;
+
+    // It is called after the callable is done and destroyed. It may
+    // release the task.
+    using Callback = void (*)(PoolTask *task, void *context);
+
+    PoolTask() = default;
+    ~PoolTask() { Clear(); }
+
+    PoolTask(const PoolTask&) = delete;
+    PoolTask& operator=(const PoolTask&) = delete;
+
+    template<class F>
+    void Set(F&& f, Callback callback, void *context);
+
+    // Run the callable, destroy it and then call the callback. The
+    // exception from the callable is kept.
+    void Run();
+
+    // Return the exception and reset it.
+    std::exception_ptr TakeException();
+
+private:
+    template<class F>
+    void Store(F&& f, std::true_type /* fits the inline buffer */);
+
+    template<class F>
+    void Store(F&& f, std::false_type /* fits the inline buffer */);
+
+    void Clear();
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    void (*invoke_)(void *storage){nullptr};
+    void (*destroy_)(void *storage){nullptr};
+
+    Callback callback_{nullptr};
+    void *context_{nullptr};
+    std::exception_ptr exception_;
+};
+
+template<class F>
+void PoolTask::Set(F&& f, Callback callback, void *context) {
+    using Fn = typename std::decay<F>::type;
+    using Fits = std::integral_constant<bool,
+                     sizeof(Fn) <= kInlineSize &&
+                     alignof(Fn) <= alignof(std::max_align_t)>;
+    Clear();
+    Store(std::forward<F>(f), Fits{});
+    callback_ = callback;
+    context_ = context;
+}
+
+template<class F>
+void PoolTask::Store(F&& f, std::true_type) {
+    using Fn = typename std::decay<F>::type;
+    new (storage_) Fn(std::forward<F>(f));
+    invoke_ = [](void *storage) { (*static_cast<Fn*>(storage))(); };
+    destroy_ = [](void *storage) { static_cast<Fn*>(storage)->~Fn(); };
+}
+
+template<class F>
+void PoolTask::Store(F&& f, std::false_type) {
+    // Too large. Keep it on the heap.
+    using Fn = typename std::decay<F>::type;
+    new (storage_) Fn*(new Fn(std::forward<F>(f)));
+    invoke_ = [](void *storage) { (**static_cast<Fn**>(storage))(); };
+    destroy_ = [](void *storage) { delete *static_cast<Fn**>(storage); };
+}
+
+inline void PoolTask::Run() {
+    try {
+        invoke_(storage_);
+    } catch (...) {
+        exception_ = std::current_exception();
+    }
+    Clear();
 
+    // The task may be released in the callback. Do not touch it after
+    // that.
+    const auto callback = callback_;
+    const auto context = context_;
+    if (callback) {
+        callback(this, context);
+    }
+}
+
+inline std::exception_ptr PoolTask::TakeException() {
+    auto e = exception_;
+    exception_ = nullptr;
+    return e;
+}
+
+inline void PoolTask::Clear() {
+    if (destroy_) {
+        destroy_(storage_);
+    }
+    invoke_ = nullptr;
+    destroy_ = nullptr;
+}
+
+// The work-stealing thread pool. Every worker owns one lock-free deque.
+// The tasks submitted by a worker go to its own deque and the idle
+// workers steal from the others. The tasks from the threads outside
+// the pool go to the shared queue.
 class ThreadPool {
 public:
     ThreadPool(size_t threads);
@@ -50,10 +165,46 @@ public:
     auto AddTask(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
+    // Queue the task. The caller keeps it alive until its callback
+    // is called.
+    void Submit(PoolTask *task);
+
     size_t GetNumThreads() const;
 
+    // Pin the workers to the CPUs. It is also applied to the workers
+    // added later. Returns false if some workers can not be pinned.
+    bool SetAffinity(AffinityMode mode);
+    AffinityMode GetAffinity() const;
+
 private:
+    static constexpr size_t kMaxThreads = 4096;
+
+    // The idle worker yields this many times before it sleeps.
+    static constexpr int kIdleSpins = 64;
+
+    struct Worker {
+        WorkStealingDeque<PoolTask> deque;
+        std::thread thread;
+
+        // The NUMA node which the thread is pinned to. It is -1 if
+        // the thread is not pinned.
+        std::atomic<int> numa_node{-1};
+    };
+
+    // Pin the worker and record its NUMA node.
+    bool PinWorker(const int index, AffinityMode mode);
+
+    struct WorkerId {
+        const ThreadPool *pool;
+        int index;
+    };
+
+    // The pool and worker index of the current thread.
+    static WorkerId &GetWorkerId();
+
     void AddThread(std::function<void()> initializer);
+    void WorkerLoop(const int index);
+    PoolTask *FindTask(const int index);
 
     bool IsStopRunning() const;
     std::atomic<bool> stop_running_{false};
@@ -61,15 +212,23 @@ private:
     // Number of allocated threads.
     std::atomic<size_t> num_threads_{0};
 
-    // Need to keep track of threads so we can join them.
-    std::vector<std::thread> workers_;
+    // The slots are allocated at the beginning and never move, so the
+    // thieves may read them while the new worker is added.
+    std::vector<std::unique_ptr<Worker>> workers_;
 
-    // The task queue.
-    std::queue<std::function<void(void)>> tasks_;
+    // The tasks from the threads outside the pool.
+    std::deque<PoolTask*> shared_tasks_;
+    std::atomic<int> num_shared_tasks_{0};
+    std::mutex shared_mutex_;
 
-    std::mutex queue_mutex_;
+    // The number of queued tasks which are not taken yet.
+    std::atomic<int> pending_tasks_{0};
 
+    std::atomic<int> sleeping_threads_{0};
+    std::mutex sleep_mutex_;
     std::condition_variable cv_;
+
+    AffinityMode affinity_{AffinityMode::kNone};
 };
 
 // Get the global thread pool.
@@ -85,9 +244,15 @@ inline ThreadPool& ThreadPool::Get(size_t threads) {
     return pool;
 }
 
+inline ThreadPool::WorkerId &ThreadPool::GetWorkerId() {
+    static thread_local WorkerId id{nullptr, -1};
+    return id;
+}
+
 // The constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads) {
     stop_running_.store(false);
+    workers_.resize(kMaxThreads);
     for (auto t = size_t{0}; t < threads ; ++t) {
         AddThread([](){});
     }
@@ -96,30 +261,128 @@ inline ThreadPool::ThreadPool(size_t threads) {
 }
 
 inline void ThreadPool::AddThread(std::function<void()> initializer) {
-    num_threads_.fetch_add(1);
-    workers_.emplace_back(
-        [this, initializer]() -> void {
+    const auto index = num_threads_.load();
+    if (index >= kMaxThreads) {
+        throw "Too many threads in the pool.";
+    }
+    workers_[index] = std::make_unique<Worker>();
+    workers_[index]->thread = std::thread(
+        [this, index, initializer]() -> void {
             initializer();
-            while (true) {
-                auto task = std::function<void(void)>{};
-                {
-                    std::unique_lock<std::mutex> lock(queue_mutex_);
-                    cv_.wait(lock,
-                        [this](){ return IsStopRunning() || !tasks_.empty(); });
-                    if (IsStopRunning() && tasks_.empty()) break;
-                    task = std::move(tasks_.front());
-                    tasks_.pop();
-                }
-                task();
-            }
+            WorkerLoop(index);
         }
     );
+    PinWorker(index, affinity_);
+
+    // Now the thieves may see it.
+    num_threads_.fetch_add(1);
+}
+
+inline void ThreadPool::WorkerLoop(const int index) {
+    GetWorkerId() = WorkerId{this, index};
+
+    int idle = 0;
+    while (true) {
+        auto task = FindTask(index);
+        if (task) {
+            // The pool may pin the worker again at any time.
+            SetPinnedNumaNode(
+                workers_[index]->numa_node.load(std::memory_order_relaxed));
+            pending_tasks_.fetch_sub(1);
+            task->Run();
+            idle = 0;
+            continue;
+        }
+        if (pending_tasks_.load() > 0 || ++idle < kIdleSpins) {
+            // Some task is being pushed or stolen. Try again soon.
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleeping_threads_.fetch_add(1);
+        cv_.wait(lock,
+            [this](){ return IsStopRunning() || pending_tasks_.load() > 0; });
+        sleeping_threads_.fetch_sub(1);
+        if (IsStopRunning() && pending_tasks_.load() == 0) break;
+        idle = 0;
+    }
+}
+
+inline PoolTask *ThreadPool::FindTask(const int index) {
+    auto task = workers_[index]->deque.Pop();
+    if (task) {
+        return task;
+    }
+
+    if (num_shared_tasks_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+        if (!shared_tasks_.empty()) {
+            task = shared_tasks_.front();
+            shared_tasks_.pop_front();
+            num_shared_tasks_.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    // Steal from the others, starting from the next worker.
+    const int num_threads = num_threads_.load();
+    for (int i = 1; i < num_threads; ++i) {
+        const int victim = (index + i) % num_threads;
+        task = workers_[victim]->deque.Steal();
+        if (task) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::Submit(PoolTask *task) {
+    // Count it before it is visible, so the thief never makes the
+    // counter negative.
+    pending_tasks_.fetch_add(1);
+
+    const auto &id = GetWorkerId();
+    if (!(id.pool == this && workers_[id.index]->deque.Push(task))) {
+        std::lock_guard<std::mutex> lock(shared_mutex_);
+        shared_tasks_.emplace_back(task);
+        num_shared_tasks_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (sleeping_threads_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        cv_.notify_one();
+    }
 }
 
 inline size_t ThreadPool::GetNumThreads() const {
     return num_threads_.load();
 }
 
+inline bool ThreadPool::SetAffinity(AffinityMode mode) {
+    affinity_ = mode;
+
+    bool success = true;
+    const auto num_threads = GetNumThreads();
+    for (auto t = size_t{0}; t < num_threads; ++t) {
+        success &= PinWorker(t, mode);
+    }
+    return success;
+}
+
+inline bool ThreadPool::PinWorker(const int index, AffinityMode mode) {
+    auto &worker = *workers_[index];
+    const bool success = mode != AffinityMode::kNone &&
+                             SetThreadAffinity(worker.thread, mode, index);
+    worker.numa_node.store(success ? GetAffinityNumaNode(mode, index) : -1,
+                               std::memory_order_relaxed);
+    return mode == AffinityMode::kNone || success;
+}
+
+inline AffinityMode ThreadPool::GetAffinity() const {
+    return affinity_;
+}
+
 inline bool ThreadPool::IsStopRunning() const {
     return stop_running_.load();
 }
@@ -135,24 +398,31 @@ auto ThreadPool::AddTask(F&& f, Args&&... args)
         );
 
     std::future<return_type> res = task->get_future();
-    {
-        std::lock_guard<std::mutex> lock(queue_mutex_);
-        tasks_.emplace([task](){ (*task)(); });
-    }
-    cv_.notify_one();
+
+    auto pool_task = new PoolTask;
+    pool_task->Set([task](){ (*task)(); },
+                   [](PoolTask *t, void*){ delete t; }, nullptr);
+    Submit(pool_task);
     return res;
 }
 
 // The destructor joins all threads.
 inline ThreadPool::~ThreadPool()
 {
-    stop_running_.store(true);
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        stop_running_.store(true);
+    }
     cv_.notify_all();
-    for(auto &worker: workers_) {
-        worker.join();
+    const auto num_threads = GetNumThreads();
+    for (auto t = size_t{0}; t < num_threads; ++t) {
+        workers_[t]->thread.join();
     }
 }
 
+// The group of tasks which are waited together. The tasks are kept
+// by the group and reused after joining, so adding the small task
+// does not allocate.
 template<typename T>
 class ThreadGroup {
 public:
@@ -168,18 +438,56 @@ public:
 
     template<class F, class... Args>
     void AddTask(F&& f, Args&&... args) {
-        tasks_future_.emplace_back(
-            pool_->AddTask(std::forward<F>(f), std::forward<Args>(args)...));
+        if (num_used_ == tasks_.size()) {
+            tasks_.emplace_back(std::make_unique<PoolTask>());
+        }
+        auto task = tasks_[num_used_++].get();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++num_running_;
+        }
+        task->Set(std::bind(std::forward<F>(f), std::forward<Args>(args)...),
+                  &ThreadGroup::OnTaskDone, this);
+        pool_->Submit(task);
     }
 
+    // Wait for all tasks. Rethrow the first exception from them.
     void WaitToJoin() {
-        for (auto &&res : tasks_future_) {
-            res.get();
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this](){ return num_running_ == 0; });
+        }
+        auto exception = std::exception_ptr{};
+        for (auto t = size_t{0}; t < num_used_; ++t) {
+            auto e = tasks_[t]->TakeException();
+            if (e && !exception) {
+                exception = e;
+            }
+        }
+        num_used_ = 0;
+        if (exception) {
+            std::rethrow_exception(exception);
         }
-        tasks_future_.clear();
     }
 
 private:
+    static void OnTaskDone(PoolTask*, void *context) {
+        auto group = static_cast<ThreadGroup*>(context);
+
+        // The group may be destroyed right after the waiting thread
+        // sees zero. Only touch it under the lock.
+        std::lock_guard<std::mutex> lock(group->mutex_);
+        if (--group->num_running_ == 0) {
+            group->cv_.notify_all();
+        }
+    }
+
     ThreadPool *pool_;
-    std::vector<std::future<T>> tasks_future_;
+
+    std::vector<std::unique_ptr<PoolTask>> tasks_;
+    size_t num_used_{0};
+
+    int num_running_{0};
+    std::mutex mutex_;
+    std::condition_variable cv_;
 };
@@ -0,0 +1,163 @@
+#include "utils/threadpool_benchmark.h"
+#include "utils/threadpool.h"
+#include "utils/format.h"
+#include "utils/time.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The old pool. All workers share one queue and one lock, and every
+// task allocates the packaged task and the function.
+class SharedQueuePool {
+public:
+    SharedQueuePool(const int threads) {
+        for (int t = 0; t < threads; ++t) {
+            workers_.emplace_back([this]() {
+                while (true) {
+                    auto task = std::function<void(void)>{};
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this](){ return stop_ || !tasks_.empty(); });
+                        if (stop_ && tasks_.empty()) break;
+                        task = std::move(tasks_.front());
+                        tasks_.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ~SharedQueuePool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &w : workers_) {
+            w.join();
+        }
+    }
+
+    std::future<void> AddTask(std::function<void()> f) {
+        auto task = std::make_shared<std::packaged_task<void()>>(f);
+        auto res = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.emplace([task](){ (*task)(); });
+        }
+        cv_.notify_one();
+        return res;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void(void)>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_{false};
+};
+
+double MeasureRate(const int tasks, std::function<void()> func) {
+    constexpr float kMinSeconds = 0.2f;
+
+    func(); // warm up
+
+    Timer timer;
+    timer.Clock();
+
+    int iterations = 0;
+    float elapsed = 0.f;
+    while (elapsed < kMinSeconds) {
+        func();
+        iterations++;
+        elapsed = timer.GetDuration();
+    }
+    return (double)tasks * iterations / std::max(elapsed, 1e-6f);
+}
+
+} // namespace
+
+std::string BenchmarkThreadPool(const int threads, const int tasks) {
+    std::atomic<int> counter{0};
+    const auto Work = [&counter]() {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    auto shared_pool = std::make_unique<SharedQueuePool>(threads);
+    const double shared_rate = MeasureRate(tasks, [&]() {
+        auto futures = std::vector<std::future<void>>{};
+        for (int i = 0; i < tasks; ++i) {
+            futures.emplace_back(shared_pool->AddTask(Work));
+        }
+        for (auto &f : futures) {
+            f.get();
+        }
+    });
+    shared_pool.reset();
+
+    auto &pool = ThreadPool::Get(threads);
+    const double future_rate = MeasureRate(tasks, [&]() {
+        auto futures = std::vector<std::future<void>>{};
+        for (int i = 0; i < tasks; ++i) {
+            futures.emplace_back(pool.AddTask(Work));
+        }
+        for (auto &f : futures) {
+            f.get();
+        }
+    });
+
+    auto group = ThreadGroup<void>(&pool);
+    const double group_rate = MeasureRate(tasks, [&]() {
+        for (int i = 0; i < tasks; ++i) {
+            group.AddTask(Work);
+        }
+        group.WaitToJoin();
+    });
+
+    // One worker submits the tasks to its own deque and the others
+    // steal them. The submitting worker blocks, so it needs at least
+    // two workers.
+    double nested_rate = 0.0;
+    if (pool.GetNumThreads() >= 2) {
+        auto inner_group = ThreadGroup<void>(&pool);
+        nested_rate = MeasureRate(tasks, [&]() {
+            auto outer_group = ThreadGroup<void>(&pool);
+            outer_group.AddTask([&]() {
+                for (int i = 0; i < tasks; ++i) {
+                    inner_group.AddTask(Work);
+                }
+                inner_group.WaitToJoin();
+            });
+            outer_group.WaitToJoin();
+        });
+    }
+
+    auto out = std::ostringstream{};
+    out << Format("threads=%d, tasks=%d, affinity=%s\n",
+                      (int)pool.GetNumThreads(), tasks,
+                      GetAffinityModeName(pool.GetAffinity()).c_str());
+    out << Format("shared queue: %.0f(tasks/s)\n", shared_rate);
+    out << Format("work-stealing, future: %.0f(tasks/s), %.2fx\n",
+                      future_rate, future_rate / shared_rate);
+    out << Format("work-stealing, group: %.0f(tasks/s), %.2fx\n",
+                      group_rate, group_rate / shared_rate);
+    if (nested_rate > 0.0) {
+        out << Format("work-stealing, from worker: %.0f(tasks/s), %.2fx",
+                          nested_rate, nested_rate / shared_rate);
+    } else {
+        out << "work-stealing, from worker: skipped, it needs two threads";
+    }
+    return out.str();
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Submit many small tasks and wait for them. Compare the old single
+// shared queue with the work-stealing pool, from the outside thread and
+// from inside one worker. Return the report.
+std::string BenchmarkThreadPool(const int threads, const int tasks);
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// The lock-free Chase-Lev deque of pointers with the fixed capacity. The
+// owner thread pushes and pops at the bottom. The other threads steal
+// from the top. The memory orders follow "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (Le et al., 2013).
+//
+// It does not grow. Push() returns false if the deque is full, then the
+// caller should put the item somewhere else.
+template<typename T>
+class WorkStealingDeque {
+public:
+    // The capacity must be a power of two.
+    explicit WorkStealingDeque(const int capacity = 1024)
+        : capacity_(capacity), mask_(capacity - 1),
+          buffer_(std::make_unique<std::atomic<T*>[]>(capacity)) {
+        for (int i = 0; i < capacity_; ++i) {
+            buffer_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // Only the owner.
+    bool Push(T *item) {
+        const auto b = bottom_.load(std::memory_order_relaxed);
+        const auto t = top_.load(std::memory_order_acquire);
+        if (b - t >= capacity_) {
+            return false;
+        }
+        buffer_[b & mask_].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Only the owner. Return null if it is empty.
+    T *Pop() {
+        const auto b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto t = top_.load(std::memory_order_relaxed);
+
+        T *item = nullptr;
+        if (t <= b) {
+            item = buffer_[b & mask_].load(std::memory_order_relaxed);
+            if (t == b) {
+                // The last item. Race with the thieves.
+                if (!top_.compare_exchange_strong(t, t + 1,
+                                                  std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread. Return null if it is empty or another thread took the
+    // item first.
+    T *Steal() {
+        auto t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const auto b = bottom_.load(std::memory_order_acquire);
+
+        if (t < b) {
+            T *item = buffer_[t & mask_].load(std::memory_order_relaxed);
+            if (top_.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
+    // It is only a hint if other threads are using the deque.
+    bool Empty() const {
+        const auto t = top_.load(std::memory_order_relaxed);
+        const auto b = bottom_.load(std::memory_order_relaxed);
+        return b <= t;
+    }
+
+private:
+    const std::int64_t capacity_;
+    const std::int64_t mask_;
+    std::unique_ptr<std::atomic<T*>[]> buffer_;
+
+    // Keep the indices of owner and thieves on the different cache
+    // lines.
+    char padding0_[64];
+    std::atomic<std::int64_t> top_{0};
+    char padding1_[64];
+    std::atomic<std::int64_t> bottom_{0};
+};
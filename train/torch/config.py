@@ -21,6 +21,7 @@ class Config:
         self.fixup_batch_norm = None
         self.store_path = None
         self.down_sample_rate = None
+        self.native_loader = None
         self.stack = []
         self.residual_channels = None
         self.policy_extract = None
@@ -59,6 +60,7 @@ def parse_training_config(json_data, config):
     config.fixup_batch_norm = train.get("FixUpBatchNorm", False)
     config.down_sample_rate = train.get("DownSampleRate", 16)
     config.num_chunks  = train.get("NumberChunks", None)
+    config.native_loader  = train.get("NativeLoader", None)
     config.soft_loss_weight  = train.get("SoftLossWeight", 0.1)
     config.swa_max_count  = train.get("SwaMaxCount", 16)
     config.swa_steps  = train.get("SwaSteps", 100)
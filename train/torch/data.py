@@ -1,8 +1,17 @@
 import numpy as np
+import io, struct
 from symmetry import numpy_symmetry_planes, numpy_symmetry_plane, numpy_symmetry_prob
 
 V2_DATA_LINES = 53
 
+BINARY_MAGIC = b'SYBD'
+
+# The binary header of each version. The version 2 has no network hash.
+BINARY_HEADERS = {
+    2 : struct.Struct('<4sBBBBbBH15f'),
+    3 : struct.Struct('<4sBBBBbBH15fQ')
+}
+
 '''
     Output format is here. Every v2 data package is 54 lines.
 
@@ -30,6 +39,9 @@ V2_DATA_LINES = 53
      ------- Misc data -------
      L52       : Q Stddev, Score Stddev
      L53       : KLD
+
+    The binary format is written by the '--binary-data' option. See
+    the 'src/neural/training.h' for the layout.
 '''
 
 class Data():
@@ -64,6 +76,7 @@ class Data():
         self.score_stddev = None
 
         self.kld = None
+        self.net_hash = None
 
     def _hex_to_int(self, h):
         if h == '0':
@@ -213,7 +226,64 @@ class Data():
         self.aux_prob      = numpy_symmetry_prob(symm, self.aux_prob)
 
 
+    def _parse_binary(self, stream, skip):
+        # The magic and the version are the same in all versions.
+        header = stream.read(5)
+        if len(header) == 0:
+            return False # stream is end
+        if len(header) != 5:
+            raise Exception("The binary data is truncated.")
+        if header[:4] != BINARY_MAGIC:
+            raise Exception("The binary data is not correct.")
+
+        binary_header = BINARY_HEADERS.get(header[4])
+        if binary_header is None:
+            raise Exception("The binary data version {} is not supported.".format(header[4]))
+        header += stream.read(binary_header.size - len(header))
+        if len(header) != binary_header.size:
+            raise Exception("The binary data is truncated.")
+
+        _, self.version, self.mode, self.board_size, self.to_move, \
+            self.result, num_planes, _, *vals = binary_header.unpack(header)
+
+        num_intersections = self.board_size * self.board_size
+        plane_bytes = (num_intersections + 7) // 8
+        prob_bytes = 2 * (num_intersections + 1)
+        owner_bytes = (num_intersections + 3) // 4
+
+        if self.version == 2:
+            vals.append(0) # no network hash
+        body = stream.read(num_planes * plane_bytes + 2 * prob_bytes + owner_bytes)
+
+        if skip:
+            return True
+
+        self.komi, self.rule, self.wave, \
+            self.avg_q, self.short_avg_q, self.mid_avg_q, self.long_avg_q, \
+            self.final_score, \
+            self.avg_score, self.short_avg_score, self.mid_avg_score, self.long_avg_score, \
+            self.q_stddev, self.score_stddev, \
+            self.kld, self.net_hash = vals
+
+        buf = np.frombuffer(body, dtype=np.uint8)
+        offset = num_planes * plane_bytes
+        planes = np.unpackbits(np.reshape(buf[:offset], (num_planes, plane_bytes)), axis=1, bitorder='little')
+        self.planes = planes[:, :num_intersections].astype(np.int8)
+
+        self.prob = np.frombuffer(body, dtype='<f2', count=num_intersections+1, offset=offset).astype(np.float32)
+        offset += prob_bytes
+        self.aux_prob = np.frombuffer(body, dtype='<f2', count=num_intersections+1, offset=offset).astype(np.float32)
+        offset += prob_bytes
+
+        owner = buf[offset:offset+owner_bytes]
+        codes = np.stack([(owner >> (2 * i)) & 3 for i in range(4)], axis=1).flatten()[:num_intersections]
+        self.ownership = np.select([codes == 1, codes == 3], [1, -1], 0).astype(np.int8)
+        return True
+
     def parse_from_stream(self, stream, skip=False):
+        if isinstance(stream, io.BytesIO):
+            return self._parse_binary(stream, skip)
+
         line = stream.readline()
         if len(line) == 0:
             return False # stream is end
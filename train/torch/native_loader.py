@@ -0,0 +1,94 @@
+import numpy as np
+import torch
+import struct, subprocess
+
+BATCH_MAGIC = b'SYBB'
+BATCH_HEADER = struct.Struct('<4siii')
+
+'''
+    The batches of the C++ loader, 'sayuri-loader'. It parses the chunks
+    with multiple threads, applies the random symmetry and shuffles the
+    records, so it is much faster than the python LazyLoader. Every batch
+    is the header followed by the float32 tensors. See the
+    'src/loader/training_batch.h' for the layout.
+
+     ------- Header (16 bytes) -------
+      char[4]   : Magic "SYBB"
+      int32     : Batch Size (N)
+      int32     : Board Size (B)
+      int32     : Input Channels (C)
+
+     ------- Body (float32) -------
+      Planes                  : [N, C, B, B]
+      Probabilities           : [N, B*B+1]
+      Auxiliary Probabilities : [N, B*B+1]
+      Ownership               : [N, B*B]
+      WDL                     : [N, 3]
+      Q Values                : [N, 5]
+      Scores                  : [N, 5]
+'''
+
+class NativeLoader:
+    def __init__(self, executable, data_dir, num_chunks, batch_size,
+                 board_size, input_channels, num_workers, buffer_size, down_sample_rate):
+        args = [
+            executable,
+            "--data-directory", data_dir,
+            "--batch-size", str(batch_size),
+            "--board-size", str(board_size),
+            "--input-channels", str(input_channels),
+            "--threads", str(num_workers),
+            "--buffer-size", str(buffer_size),
+            "--down-sample", str(down_sample_rate)
+        ]
+        if num_chunks is not None:
+            args.extend(["--num-chunks", str(num_chunks)])
+
+        self.proc = subprocess.Popen(args, stdout=subprocess.PIPE, bufsize=0)
+        self.stream = self.proc.stdout
+
+        nn_num_intersections = board_size * board_size
+        self.shapes = [
+            ("planes",    (batch_size, input_channels, board_size, board_size)),
+            ("prob",      (batch_size, nn_num_intersections+1)),
+            ("aux_prob",  (batch_size, nn_num_intersections+1)),
+            ("ownership", (batch_size, nn_num_intersections)),
+            ("wdl",       (batch_size, 3)),
+            ("q_vals",    (batch_size, 5)),
+            ("scores",    (batch_size, 5))
+        ]
+        self.header = (BATCH_MAGIC, batch_size, board_size, input_channels)
+        self.body_size = sum(4 * int(np.prod(s)) for _, s in self.shapes)
+
+    def _read_exactly(self, size):
+        # Read into the writable buffer, so torch can share the memory.
+        buf = bytearray(size)
+        view = memoryview(buf)
+        pos = 0
+        while pos < size:
+            n = self.stream.readinto(view[pos:])
+            if not n:
+                raise Exception("The native loader is closed.")
+            pos += n
+        return buf
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        header = BATCH_HEADER.unpack(self._read_exactly(BATCH_HEADER.size))
+        if header != self.header:
+            raise Exception("The native loader batch is not correct.")
+
+        body = np.frombuffer(self._read_exactly(self.body_size), dtype='<f4')
+        batch_dict = dict()
+        offset = 0
+        for name, shape in self.shapes:
+            size = int(np.prod(shape))
+            batch_dict[name] = torch.from_numpy(body[offset:offset+size].reshape(shape))
+            offset += size
+        return batch_dict
+
+    def close(self):
+        self.proc.terminate()
+        self.proc.wait()
@@ -8,6 +8,7 @@ from data import Data
 
 from torch.nn import DataParallel
 from lazy_loader import LazyLoader, LoaderFlag
+from native_loader import NativeLoader
 from status_loader import StatusLoader
 
 def gather_filenames(root, num_chunks=None, sort_key_fn=None):
@@ -40,7 +41,11 @@ class StreamLoader:
             return stream
 
         try:
-            if filename.find(".gz") >= 0:
+            if filename.find(".bin") >= 0:
+                open_func = gzip.open if filename.find(".gz") >= 0 else open
+                with open_func(filename, 'rb') as f:
+                    stream = io.BytesIO(f.read())
+            elif filename.find(".gz") >= 0:
                 with gzip.open(filename, 'rt') as f:
                     stream = io.StringIO(f.read())
             else:
@@ -224,6 +229,9 @@ class TrainingPipe():
         self.validation_buffer_size = self.cfg.buffersize // 10
         self.down_sample_rate = cfg.down_sample_rate
 
+        # The C++ loader executable. Use the python loader if it is None.
+        self.native_loader = cfg.native_loader
+
         # Max steps per training task.
         self.max_steps =  cfg.max_steps
 
@@ -361,7 +369,44 @@ class TrainingPipe():
             self.module = self.module.to(self.device)
             self.swa_net = self.swa_net.to(self.device)
 
+    def _init_native_loader(self):
+        print("Use the native loader: {}".format(self.native_loader))
+
+        self.flag = LoaderFlag()
+        self.train_lazy_loader = NativeLoader(
+            executable = self.native_loader,
+            data_dir = self.train_dir,
+            num_chunks = self.num_chunks,
+            batch_size = self.macrobatchsize,
+            board_size = self.cfg.boardsize,
+            input_channels = self.cfg.input_channels,
+            num_workers = self.num_workers,
+            buffer_size = self.train_buffer_size,
+            down_sample_rate = self.down_sample_rate
+        )
+        batch = next(self.train_lazy_loader)
+
+        if self.validation_dir is not None:
+            self.validation_lazy_loader = NativeLoader(
+                executable = self.native_loader,
+                data_dir = self.validation_dir,
+                num_chunks = None if self.num_chunks is None else max(self.num_chunks//10, 1),
+                batch_size = self.macrobatchsize,
+                board_size = self.cfg.boardsize,
+                input_channels = self.cfg.input_channels,
+                num_workers = self.num_workers,
+                buffer_size = self.validation_buffer_size,
+                down_sample_rate = self.down_sample_rate
+            )
+            batch = next(self.validation_lazy_loader)
+        else:
+            self.validation_lazy_loader = None
+
     def _init_loader(self):
+        if self.native_loader is not None:
+            self._init_native_loader()
+            return
+
         self._stream_loader = StreamLoader()
         self._stream_parser = StreamParser(self.down_sample_rate)
         self._batch_gen = BatchGenerator(self.cfg.boardsize, self.cfg.input_channels)
@@ -560,8 +605,13 @@ class TrainingPipe():
             # store the last network
             self._save_current_status(num_steps)
         self.flag.set_stop_flag()
-        try:
-            planes, target = self._gather_data_from_loader(True)
-        except StopIteration:
-            pass
+        if self.native_loader is not None:
+            for loader in [self.train_lazy_loader, self.validation_lazy_loader]:
+                if loader is not None:
+                    loader.close()
+        else:
+            try:
+                planes, target = self._gather_data_from_loader(True)
+            except StopIteration:
+                pass
         print("Training is over.")